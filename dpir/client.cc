@@ -16,6 +16,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,9 +27,11 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dpir/parameters.h"
 #include "dpir/serialization.pb.h"
 #include "dpir/utils.h"
+#include "hintless_simplepir/crt_hwy.h"
 #include "lwe/encode.h"
 #include "lwe/lwe_symmetric_encryption.h"
 #include "lwe/types.h"
@@ -84,10 +87,20 @@ absl::StatusOr<std::unique_ptr<Client>> Client::Create(
       RlweRnsContext crt_context,
       RlweRnsContext::Create(rlwe_params.log_n, rlwe_params.ts, /*ps=*/{}, 2));
 
-  return absl::WrapUnique(
-      new Client(params, public_params.prng_seed_lwe_query_pad(),
-                 std::move(rlwe_contexts), std::move(rlwe_moduli),
-                 std::move(linpir_clients), std::move(crt_context)));
+  // The common case of two small plaintext moduli avoids big integers.
+  std::optional<internal::TwoPrimeCrtParams> two_prime_crt_params;
+  if (num_linpir_instances == 2) {
+    auto crt_params = internal::TwoPrimeCrtParams::Create(
+        rlwe_params.ts[0], rlwe_params.ts[1], params.lwe_modulus_bit_size);
+    if (crt_params.ok()) {
+      two_prime_crt_params = *std::move(crt_params);
+    }
+  }
+
+  return absl::WrapUnique(new Client(
+      params, public_params.prng_seed_lwe_query_pad(), std::move(rlwe_contexts),
+      std::move(rlwe_moduli), std::move(linpir_clients), std::move(crt_context),
+      std::move(two_prime_crt_params)));
 }
 
 absl::StatusOr<HintlessPirRequest> Client::GenerateRequest(std::vector<int64_t> indices) {
@@ -328,62 +341,86 @@ absl::StatusOr<std::vector<std::vector<lwe::Vector>>> Client::RecoverLweDecrypti
         "`response` contains an expected number of shards.");
   }
 
+  // CRT interpolates to get Hint * LWE secrets as balanced mod-t values, where
+  // t is the product of plaintext moduli. Then convert them wrt LWE modulus.
+  BigInteger p = 1;
+  for (auto pi : plaintext_moduli) {
+    p *= rlwe::ConvertToBigInteger<RlweInteger, BigInteger>(pi->Modulus());
+  }
+  BigInteger p_half = p / 2;
+  BigInteger lwe_modulus = BigInteger(1) << params_.lwe_modulus_bit_size;
+  std::vector<BigInteger> p_hats =
+      rlwe::RnsModulusComplements<RlweModularInt, BigInteger>(plaintext_moduli);
+  RLWE_ASSIGN_OR_RETURN(
+      std::vector<RlweModularInt> p_hat_invs,
+      crt_context_.MainPrimeModulusCrtFactors(num_linpir_plaintext_moduli - 1));
+
   std::vector<std::vector<lwe::Vector>> results(batch_size_);
   for (int i = 0; i < batch_size_; i++) {
-      // CRT decomposed values of Hint * LWE secrets, where the first dimension
-      // is per database shard, then per CRT modulus, and then per block in the
-      // shard.
-      std::vector<std::vector<std::vector<RlweModularInt>>> hint_crt_values(
-          num_shards);
-      for (auto& h : hint_crt_values) {
-        h.resize(num_linpir_plaintext_moduli);
-      }
-      for (int k = 0; k < num_linpir_plaintext_moduli; ++k) {
-        RLWE_ASSIGN_OR_RETURN(
-            auto hint_values_mod_tk,
-            linpir_clients_[k]->Recover(response.linpir_responses(k * batch_size_ + i)));
-        auto mod_params_tk = plaintext_moduli[k]->ModParams();
-        for (int j = 0; j < num_shards; ++j) {
-          hint_crt_values[j][k].reserve(hint_values_mod_tk[j].size());
-          for (auto const& hint_value : hint_values_mod_tk[j]) {
-            RLWE_ASSIGN_OR_RETURN(auto hint_mod_tk, RlweModularInt::ImportInt(
-                                                        hint_value, mod_params_tk));
-            hint_crt_values[j][k].push_back(std::move(hint_mod_tk));
-          }
-        }
-      }
+    // Hint * LWE secrets modulo each plaintext modulus, where the first
+    // dimension is per CRT modulus, then per database shard, and then per
+    // block in the shard.
+    std::vector<std::vector<std::vector<RlweInteger>>> hint_values;
+    hint_values.reserve(num_linpir_plaintext_moduli);
+    for (int k = 0; k < num_linpir_plaintext_moduli; ++k) {
+      RLWE_ASSIGN_OR_RETURN(
+          auto hint_values_mod_tk,
+          linpir_clients_[k]->Recover(
+              response.linpir_responses(k * batch_size_ + i)));
+      hint_values.push_back(std::move(hint_values_mod_tk));
+    }
 
-      // CRT interpolates to get Hint * LWE secrets as balanced mod-t values, where
-      // t is the product of plaintext moduli. Then convert them wrt LWE modulus.
-      BigInteger p = 1;
-      for (auto pi : plaintext_moduli) {
-        p *= rlwe::ConvertToBigInteger<RlweInteger, BigInteger>(pi->Modulus());
+    std::vector<lwe::Vector> hint_vectors;
+    hint_vectors.reserve(num_shards);
+    if (two_prime_crt_params_.has_value()) {
+      // Interpolate and lift whole vectors at once with 64-bit arithmetic.
+      for (int j = 0; j < num_shards; ++j) {
+        lwe::Vector hint(hint_values[0][j].size());
+        RLWE_RETURN_IF_ERROR(internal::TwoPrimeCrtLift(
+            *two_prime_crt_params_, hint_values[0][j], hint_values[1][j],
+            absl::MakeSpan(hint.data(), hint.size())));
+        hint_vectors.push_back(std::move(hint));
       }
-      BigInteger p_half = p / 2;
-      BigInteger lwe_modulus = BigInteger(1) << params_.lwe_modulus_bit_size;
-      std::vector<BigInteger> p_hats =
-          rlwe::RnsModulusComplements<RlweModularInt, BigInteger>(plaintext_moduli);
-      RLWE_ASSIGN_OR_RETURN(
-          std::vector<RlweModularInt> p_hat_invs,
-          crt_context_.MainPrimeModulusCrtFactors(num_linpir_plaintext_moduli - 1));
+      results[i] = std::move(hint_vectors);
+      continue;
+    }
 
-      std::vector<lwe::Vector> hint_vectors;
-      hint_vectors.reserve(num_shards);
+    // CRT decomposed values of Hint * LWE secrets, where the first dimension
+    // is per database shard, then per CRT modulus, and then per block in the
+    // shard.
+    std::vector<std::vector<std::vector<RlweModularInt>>> hint_crt_values(
+        num_shards);
+    for (auto& h : hint_crt_values) {
+      h.resize(num_linpir_plaintext_moduli);
+    }
+    for (int k = 0; k < num_linpir_plaintext_moduli; ++k) {
+      auto mod_params_tk = plaintext_moduli[k]->ModParams();
       for (int j = 0; j < num_shards; ++j) {
-        RLWE_ASSIGN_OR_RETURN(
-            std::vector<BigInteger> hint_values,
-            (rlwe::CrtInterpolation<RlweModularInt, BigInteger>(
-                hint_crt_values[j], plaintext_moduli, p_hats, p_hat_invs)));
-
-        lwe::Vector hint = lwe::Vector::Zero(hint_values.size());
-        for (int m = 0; m < hint_values.size(); ++m) {
-          BigInteger x = hint_values[m] % p;
-          hint[m] =
-              static_cast<RlweInteger>(ConvertModulus(x, p, lwe_modulus, p_half));
+        hint_crt_values[j][k].reserve(hint_values[k][j].size());
+        for (auto const& hint_value : hint_values[k][j]) {
+          RLWE_ASSIGN_OR_RETURN(
+              auto hint_mod_tk,
+              RlweModularInt::ImportInt(hint_value, mod_params_tk));
+          hint_crt_values[j][k].push_back(std::move(hint_mod_tk));
         }
-        hint_vectors.push_back(std::move(hint));
       }
-      results[i] = hint_vectors;
+    }
+
+    for (int j = 0; j < num_shards; ++j) {
+      RLWE_ASSIGN_OR_RETURN(
+          std::vector<BigInteger> hint_big_values,
+          (rlwe::CrtInterpolation<RlweModularInt, BigInteger>(
+              hint_crt_values[j], plaintext_moduli, p_hats, p_hat_invs)));
+
+      lwe::Vector hint = lwe::Vector::Zero(hint_big_values.size());
+      for (int m = 0; m < hint_big_values.size(); ++m) {
+        BigInteger x = hint_big_values[m] % p;
+        hint[m] = static_cast<RlweInteger>(
+            ConvertModulus(x, p, lwe_modulus, p_half));
+      }
+      hint_vectors.push_back(std::move(hint));
+    }
+    results[i] = std::move(hint_vectors);
   }
   return results;
 }
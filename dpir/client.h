@@ -18,6 +18,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -28,6 +29,7 @@
 #include "absl/strings/string_view.h"
 #include "dpir/parameters.h"
 #include "dpir/serialization.pb.h"
+#include "hintless_simplepir/crt_hwy.h"
 #include "linpir/client.h"
 #include "lwe/types.h"
 #include "shell_encryption/montgomery.h"
@@ -84,13 +86,15 @@ class Client {
       std::vector<std::unique_ptr<const RlweRnsContext>> rlwe_contexts,
       std::vector<const RlwePrimeModulus*> rlwe_moduli,
       std::vector<std::unique_ptr<LinPirClient>> linpir_clients,
-      RlweRnsContext crt_context)
+      RlweRnsContext crt_context,
+      std::optional<internal::TwoPrimeCrtParams> two_prime_crt_params)
       : params_(std::move(params)),
         prng_seed_lwe_query_pad_(std::string(prng_seed_lwe_query_pad)),
         rlwe_contexts_(std::move(rlwe_contexts)),
         rlwe_moduli_(std::move(rlwe_moduli)),
         linpir_clients_(std::move(linpir_clients)),
-        crt_context_(std::move(crt_context)) {}
+        crt_context_(std::move(crt_context)),
+        two_prime_crt_params_(std::move(two_prime_crt_params)) {}
 
   static std::vector<RlweInteger> EncodeLweVector(const lwe::Vector& lwe_vector,
                                                   RlweInteger lwe_modulus,
@@ -121,6 +125,11 @@ class Client {
 
   const RlweRnsContext crt_context_;
 
+  // Constants for interpolating with 64-bit arithmetic when there are two
+  // plaintext moduli, each less than 2^31. Otherwise the interpolation is
+  // computed over 256-bit integers with `crt_context_`.
+  const std::optional<internal::TwoPrimeCrtParams> two_prime_crt_params_;
+
   // Per batch request state.
   ClientState state_;
   size_t batch_size_;
@@ -1,6 +1,9 @@
 #include <cstdint>
+#include <iostream>
 #include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "dpir/socket.h"
 
@@ -39,7 +42,7 @@ const Parameters kParameters{
 int run_client() {
     // Connect to the socket
     Socket socket;
-    if(socket.Connect(CLIENT_SOCKET)) {
+    if(!socket.Connect(kClientSocket).ok()) {
         std::cerr << "Error connecting" << std::endl;
         return -1;
     };
@@ -47,11 +50,19 @@ int run_client() {
     // Wait for parameters
     auto params = kParameters;
     auto dims = socket.RecvUints();
-    params.db_rows = dims[0];
-    params.db_cols = dims[1];
-    params.batch_size = dims[2];
+    if (!dims.ok() || dims->size() < 3) {
+        std::cerr << "Error receiving dims" << std::endl;
+        return -1;
+    }
+    params.db_rows = (*dims)[0];
+    params.db_cols = (*dims)[1];
+    params.batch_size = (*dims)[2];
 
-    auto bytes = socket.RecvBytes();
+    std::vector<char> bytes;
+    if (!socket.RecvBytes(bytes).ok()) {
+        std::cerr << "Error receiving public_params" << std::endl;
+        return -1;
+    }
     HintlessPirServerPublicParams public_params;
     bool success = public_params.ParseFromArray(bytes.data(), bytes.size());
     if (!success) {
@@ -67,7 +78,12 @@ int run_client() {
         // Wait for keys and generate query
         std::vector<std::vector<uint32_t>> keys(params.batch_size);
         for (int i = 0; i < keys.size(); i++) {
-            keys[i] = socket.RecvUints();
+            auto key = socket.RecvUints();
+            if (!key.ok()) {
+                std::cerr << "Error receiving keys" << std::endl;
+                return -1;
+            }
+            keys[i] = *std::move(key);
         }
 
         auto proto = client->GenerateQuery(keys).value();
@@ -76,14 +92,21 @@ int run_client() {
         size_t num_bytes = proto.ByteSizeLong();
         std::vector<char> serialized(num_bytes);
         proto.SerializeToArray(serialized.data(), num_bytes);
-        socket.SendBytes(serialized);
+        if (!socket.SendBytes(serialized).ok()) {
+            std::cerr << "Error sending query" << std::endl;
+            return -1;
+        }
     
         std::cout << "Client generated query!" << std::endl;
 
-        // Wait for query responses
+        // Wait for query responses, reusing the response buffer
+        std::vector<char> bytes;
         while (true) {
             // Wait for response
-            auto bytes = socket.RecvBytes();
+            if (!socket.RecvBytes(bytes).ok()) {
+                std::cerr << "Error receiving response" << std::endl;
+                return -1;
+            }
             HintlessPirResponse response;
             bool success = response.ParseFromArray(bytes.data(), bytes.size());
             if (!success) {
@@ -93,7 +116,10 @@ int run_client() {
             // Send the final result back to host
             auto results = client->RecoverInts(response).value();
             for (int i = 0; i < results.size(); i++) {
-                socket.SendUints(results[i]);
+                if (!socket.SendUints(results[i]).ok()) {
+                    std::cerr << "Error sending result" << std::endl;
+                    return -1;
+                }
             }
             std::cout << "Client produced answer!" << std::endl;
         }
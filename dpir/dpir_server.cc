@@ -1,6 +1,8 @@
 #include <cstdint>
+#include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "dpir/socket.h"
 
@@ -39,7 +41,7 @@ const Parameters kParameters{
 int run_server() {
     // Connect to socket
     Socket socket;
-    if(socket.Connect(SERVER_SOCKET)) {
+    if(!socket.Connect(kServerSocket).ok()) {
         std::cerr << "Error connecting" << std::endl;
         return -1;
     };
@@ -47,16 +49,24 @@ int run_server() {
     // Wait for parameters
     auto params = kParameters;
     auto dims = socket.RecvUints();
-    params.db_rows = dims[0];
-    params.db_cols = dims[1];
-    std::cout << "got dims: " << dims[0] << ", " << dims[1] << std::endl;
+    if (!dims.ok() || dims->size() < 2) {
+        std::cerr << "Error receiving dims" << std::endl;
+        return -1;
+    }
+    params.db_rows = (*dims)[0];
+    params.db_cols = (*dims)[1];
+    std::cout << "got dims: " << (*dims)[0] << ", " << (*dims)[1] << std::endl;
 
     // Initialize server
     auto server = Server::Create(params).value();
 
     // Receive hint and set on server
     auto hint_vals = socket.RecvUints();
-    server->GetDatabase()->SetHint(hint_vals);
+    if (!hint_vals.ok()) {
+        std::cerr << "Error receiving hint" << std::endl;
+        return -1;
+    }
+    server->GetDatabase()->SetHint(*hint_vals);
     
     // Preprocess and grab the public parameters
     if (!server->Preprocess().ok()) {
@@ -70,29 +80,43 @@ int run_server() {
     public_params.SerializeToArray(serialized.data(), num_bytes);
     
     // Send to the host
-    socket.SendBytes(serialized);
+    if (!socket.SendBytes(serialized).ok()) {
+        std::cerr << "Error sending public params" << std::endl;
+        return -1;
+    }
 
     std::cout << "Server preprocessed!" << std::endl;
     
     // Receive query from client and forward to server
-    auto query_ser = socket.RecvBytes();
+    std::vector<char> query_ser;
+    if (!socket.RecvBytes(query_ser).ok()) {
+        std::cerr << "Error receiving query" << std::endl;
+        return -1;
+    }
     
     HintlessPirRequest query;
     bool success = query.ParseFromArray(query_ser.data(), query_ser.size());
     if (!success) {
         std::cerr << "Error parsing query" << std::endl;
     }
-    server->PreprocessQueries(query);
+    auto prepared_queries = server->PrepareQueries(query).value();
     std::cout << "Server preprocessed query!" << std::endl;
    
-    // Wait for query requests
+    // Wait for query requests, reusing the request buffer
+    std::vector<char> request;
     while (true) {
-        auto request = socket.RecvBytes();
-        auto answer = server->ProcessQueries().value();
+        if (!socket.RecvBytes(request).ok()) {
+            std::cerr << "Error receiving request" << std::endl;
+            return -1;
+        }
+        auto answer = server->ProcessQueries(*prepared_queries).value();
         size_t num_bytes = answer.ByteSizeLong();
         std::vector<char> serialized(num_bytes);
         answer.SerializeToArray(serialized.data(), num_bytes);
-        socket.SendBytes(serialized);
+        if (!socket.SendBytes(serialized).ok()) {
+            std::cerr << "Error sending answer" << std::endl;
+            return -1;
+        }
         std::cout << "Server processed query!" << std::endl;
     }
     
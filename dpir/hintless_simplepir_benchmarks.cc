@@ -76,17 +76,17 @@ void BM_HintCompr(benchmark::State& state) {
   std::vector<int64_t> indices = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12};
   auto request = client->GenerateRequest(indices).value();
     
-  server->PreprocessQueries(request);
+  auto prepared_queries = server->PrepareQueries(request).value();
   for (auto _ : state) {
-    auto response = server->ProcessQueries();
+    auto response = server->ProcessQueries(*prepared_queries);
     benchmark::DoNotOptimize(response);
   }
 
 // Need to change server preprocessing + processing to check 
 // 
 //  // Print size of the response
-//  server->PreprocessQueries(request);
-//  auto response = server->ProcessQueries().value();
+//  auto prepared_queries = server->PrepareQueries(request).value();
+//  auto response = server->ProcessQueries(*prepared_queries).value();
 // 
 //  std::cout << "Response size: " << response.ByteSize() / (1 << 10) << "KB" << std::endl;
 //
@@ -27,6 +27,7 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "dpir/database.h"
 #include "dpir/parameters.h"
 #include "dpir/serialization.pb.h"
@@ -221,49 +222,53 @@ absl::Status Server::Preprocess() {
   return absl::OkStatus();
 }
 
-absl::Status Server::PreprocessQueries(const HintlessPirRequest request) {
-    if (!IsPreprocessed()) {
-        return absl::FailedPreconditionError("Server has not been preprocessed.");
-    }
-
-    // Compute the rotations
-    batch_size_ = request.linpir_ct_bs().size() / linpir_servers_.size();
-    for (size_t k = 0; k < linpir_servers_.size(); k++) {
-        std::vector<rlwe::SerializedRnsPolynomial> queries(
-            request.linpir_ct_bs().begin() + k * batch_size_,
-            request.linpir_ct_bs().begin() + (k + 1) * batch_size_
-        );
-        linpir_servers_[k]->PreprocessRequest(queries, request.linpir_gk_bs());
-    }
-    request_ = std::move(request);
+absl::StatusOr<std::unique_ptr<const Server::PreparedQueries>>
+Server::PrepareQueries(const HintlessPirRequest& request) const {
+  if (!IsPreprocessed()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
+  int num_linpir_servers = linpir_servers_.size();
+  if (request.linpir_ct_bs_size() % num_linpir_servers != 0) {
+    return absl::InvalidArgumentError(
+        "`request` contains unexpected number of LinPir queries.");
+  }
 
-    return absl::OkStatus();
+  int batch_size = request.linpir_ct_bs_size() / num_linpir_servers;
+  auto proto_ct_bs = absl::MakeConstSpan(request.linpir_ct_bs().data(),
+                                         request.linpir_ct_bs_size());
+  std::vector<std::unique_ptr<const PreparedQueries::LinPirPreparedRequest>>
+      linpir_requests;
+  linpir_requests.reserve(num_linpir_servers);
+  for (int k = 0; k < num_linpir_servers; ++k) {
+    RLWE_ASSIGN_OR_RETURN(
+        auto linpir_request,
+        linpir_servers_[k]->PrepareRequest(
+            proto_ct_bs.subspan(k * batch_size, batch_size),
+            request.linpir_gk_bs()));
+    linpir_requests.push_back(std::move(linpir_request));
+  }
+  return absl::WrapUnique<const PreparedQueries>(
+      new PreparedQueries(batch_size, std::move(linpir_requests)));
 }
 
-absl::StatusOr<HintlessPirResponse> Server::ProcessQueries() {
-  if (!IsPreprocessed()) {
-    return absl::FailedPreconditionError("Server has not been preprocessed.");
+absl::StatusOr<HintlessPirResponse> Server::ProcessQueries(
+    const PreparedQueries& prepared_queries) const {
+  if (prepared_queries.linpir_requests_.size() != linpir_servers_.size()) {
+    return absl::InvalidArgumentError(
+        "`prepared_queries` contains unexpected number of LinPir requests.");
   }
 
   HintlessPirResponse response;
-//  for (int i = 0; i < request_.ct_query_vector().size(); i++) {
-//      // Handle the LWE part of the request.
-//      lwe::Vector ct_query_vector =
-//          DeserializeLweCiphertext(request_.ct_query_vector()[i]);
-//      RLWE_ASSIGN_OR_RETURN(std::vector<lwe::Vector> ct_records,
-//                            database_->InnerProductWith(ct_query_vector));
-//      for (auto& ct_record : ct_records) {
-//        *response.add_ct_records() = SerializeLweCiphertext(ct_record);
-//      }
-//  }
-
-  std::vector<LinPirResponse> answers;
-  answers.reserve(linpir_servers_.size() * batch_size_);
+  response.mutable_linpir_responses()->Reserve(linpir_servers_.size() *
+                                               prepared_queries.BatchSize());
   for (int k = 0; k < linpir_servers_.size(); ++k) {
-    auto responses = linpir_servers_[k]->ProcessRequest().value();
-    answers.insert(answers.end(), responses.begin(), responses.end());
+    RLWE_ASSIGN_OR_RETURN(std::vector<LinPirResponse> answers,
+                          linpir_servers_[k]->ProcessPreparedRequest(
+                              *prepared_queries.linpir_requests_[k]));
+    for (auto& answer : answers) {
+      *response.add_linpir_responses() = std::move(answer);
+    }
   }
-  *response.mutable_linpir_responses() = {answers.begin(), answers.end()};
   return response;
 }
 
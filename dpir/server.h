@@ -52,9 +52,42 @@ class Server {
   // be called before accepting client requests.
   absl::Status Preprocess();
 
-  absl::Status PreprocessQueries(const HintlessPirRequest request);
-  
-  absl::StatusOr<HintlessPirResponse> ProcessQueries();
+  // A batch of queries prepared by `PrepareQueries`, holding a prepared LinPir
+  // request per LinPir instance. It is immutable, so it can be processed by
+  // any number of threads concurrently, and any number of prepared batches can
+  // coexist. It must be destroyed before the server, and it is invalidated by
+  // calling `Preprocess()` again.
+  class PreparedQueries {
+   public:
+    int BatchSize() const { return batch_size_; }
+
+   private:
+    friend class Server;
+    using LinPirPreparedRequest =
+        linpir::Server<Parameters::RlweInteger>::PreparedRequest;
+
+    PreparedQueries(
+        int batch_size,
+        std::vector<std::unique_ptr<const LinPirPreparedRequest>>
+            linpir_requests)
+        : batch_size_(batch_size),
+          linpir_requests_(std::move(linpir_requests)) {}
+
+    const int batch_size_;
+    const std::vector<std::unique_ptr<const LinPirPreparedRequest>>
+        linpir_requests_;
+  };
+
+  // Deserializes the batch of LinPir queries in `request`, where the "b"
+  // components of the ciphertexts for LinPir instance k are stored
+  // contiguously in `linpir_ct_bs`.
+  absl::StatusOr<std::unique_ptr<const PreparedQueries>> PrepareQueries(
+      const HintlessPirRequest& request) const;
+
+  // Processes all queries in `prepared_queries`, returning the LinPir
+  // responses ordered as the queries in the request.
+  absl::StatusOr<HintlessPirResponse> ProcessQueries(
+      const PreparedQueries& prepared_queries) const;
 
   // Returns the server's public parameters that are sent to the client.
   HintlessPirServerPublicParams GetPublicParams() const;
@@ -100,9 +133,6 @@ class Server {
 
   std::vector<std::vector<std::unique_ptr<LinPirDatabase>>> linpir_databases_;
   std::vector<std::unique_ptr<LinPirServer>> linpir_servers_;
-
-  size_t batch_size_;
-  HintlessPirRequest request_;
 };
 
 }  // namespace hintless_simplepir
@@ -0,0 +1,279 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dpir/socket.h"
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+
+namespace {
+
+// Requests larger kernel buffers for `fd`. This is best effort, as the kernel
+// caps the sizes.
+void EnlargeBuffers(int fd) {
+  int size = Socket::kSocketBufferBytes;
+  setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+}
+
+absl::Status NotConnectedError() {
+  return absl::FailedPreconditionError("The socket is not connected.");
+}
+
+}  // namespace
+
+Socket::Socket(int fd) : fd_(fd) { EnlargeBuffers(fd_); }
+
+Socket::Socket(Socket&& other)
+    : fd_(std::exchange(other.fd_, -1)),
+      socket_path_(std::exchange(other.socket_path_, "")),
+      max_frame_bytes_(other.max_frame_bytes_) {}
+
+Socket& Socket::operator=(Socket&& other) {
+  if (this != &other) {
+    Close();
+    fd_ = std::exchange(other.fd_, -1);
+    socket_path_ = std::exchange(other.socket_path_, "");
+    max_frame_bytes_ = other.max_frame_bytes_;
+  }
+  return *this;
+}
+
+Socket::~Socket() { Close(); }
+
+void Socket::Close() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  if (!socket_path_.empty()) {
+    unlink(socket_path_.c_str());
+    socket_path_.clear();
+  }
+}
+
+absl::Status Socket::Connect(absl::string_view path) {
+  Close();
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid socket path: ", path));
+  }
+  address.sun_family = AF_UNIX;
+  std::memcpy(address.sun_path, path.data(), path.size());
+
+  std::string socket_path(path);
+  unlink(socket_path.c_str());
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    return absl::ErrnoToStatus(errno, "Failed to create socket");
+  }
+  if (bind(listen_fd, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) != 0 ||
+      listen(listen_fd, /*backlog=*/1) != 0) {
+    int error = errno;
+    close(listen_fd);
+    return absl::ErrnoToStatus(error,
+                               absl::StrCat("Failed to listen on ", path));
+  }
+  socket_path_ = std::move(socket_path);
+
+  int fd;
+  do {
+    fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+  } while (fd < 0 && errno == EINTR);
+  int error = errno;
+  close(listen_fd);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(error, "Failed to accept a connection");
+  }
+  fd_ = fd;
+  EnlargeBuffers(fd_);
+  return absl::OkStatus();
+}
+
+absl::Status Socket::SendBytes(absl::Span<const char> bytes) {
+  return SendFrame(bytes.data(), bytes.size());
+}
+
+absl::Status Socket::SendUints(absl::Span<const uint32_t> values) {
+  return SendFrame(values.data(), values.size() * sizeof(uint32_t));
+}
+
+absl::Status Socket::SendSegments(
+    absl::Span<const absl::string_view> segments) {
+  uint64_t header = 0;
+  std::vector<iovec> parts;
+  parts.reserve(segments.size() + 1);
+  parts.push_back({.iov_base = &header, .iov_len = sizeof(header)});
+  for (absl::string_view segment : segments) {
+    if (!segment.empty()) {
+      header += segment.size();
+      parts.push_back({.iov_base = const_cast<char*>(segment.data()),
+                       .iov_len = segment.size()});
+    }
+  }
+  return SendParts(absl::MakeSpan(parts));
+}
+
+absl::Status Socket::SendFrame(const void* data, size_t size) {
+  uint64_t header = size;
+  iovec parts[2] = {
+      {.iov_base = &header, .iov_len = sizeof(header)},
+      {.iov_base = const_cast<void*>(data), .iov_len = size},
+  };
+  return SendParts(absl::MakeSpan(parts));
+}
+
+absl::Status Socket::SendParts(absl::Span<iovec> parts) {
+  if (!IsConnected()) {
+    return NotConnectedError();
+  }
+  msghdr message;
+  std::memset(&message, 0, sizeof(message));
+  iovec* next = parts.data();
+  size_t num_parts = parts.size();
+  while (num_parts > 0) {
+    // A single call takes at most IOV_MAX parts; the rest follow in the next
+    // iterations.
+    message.msg_iov = next;
+    message.msg_iovlen = std::min<size_t>(num_parts, IOV_MAX);
+    // Unlike writev, sendmsg reports a closed peer as EPIPE without raising
+    // SIGPIPE.
+    ssize_t num_sent = sendmsg(fd_, &message, MSG_NOSIGNAL);
+    if (num_sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return absl::ErrnoToStatus(errno, "Failed to send frame");
+    }
+    // Skip the parts written in full, and the written prefix of the next one.
+    size_t num_remaining = num_sent;
+    while (num_parts > 0 && num_remaining >= next->iov_len) {
+      num_remaining -= next->iov_len;
+      ++next;
+      --num_parts;
+    }
+    if (num_parts > 0) {
+      next->iov_base = static_cast<char*>(next->iov_base) + num_remaining;
+      next->iov_len -= num_remaining;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Socket::RecvFully(void* data, size_t size) {
+  char* buffer = static_cast<char*>(data);
+  while (size > 0) {
+    // MSG_WAITALL returns fewer bytes only on a signal, error, or shutdown.
+    ssize_t num_received = recv(fd_, buffer, size, MSG_WAITALL);
+    if (num_received < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return absl::ErrnoToStatus(errno, "Failed to receive frame");
+    }
+    if (num_received == 0) {
+      return absl::UnavailableError("The peer closed the connection.");
+    }
+    buffer += num_received;
+    size -= num_received;
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<uint64_t> Socket::RecvFrameSize() {
+  if (!IsConnected()) {
+    return NotConnectedError();
+  }
+  uint64_t size;
+  RLWE_RETURN_IF_ERROR(RecvFully(&size, sizeof(size)));
+  if (size > max_frame_bytes_) {
+    return absl::DataLossError(
+        absl::StrCat("The frame size, ", size, ", exceeds the maximum of ",
+                     max_frame_bytes_, " bytes."));
+  }
+  return size;
+}
+
+template <typename T>
+absl::Status Socket::RecvPayload(uint64_t size, std::vector<T>& buffer) {
+  size_t num_values = (size + sizeof(T) - 1) / sizeof(T);
+  if (buffer.capacity() >= num_values) {
+    buffer.resize(num_values);
+    return RecvFully(buffer.data(), size);
+  }
+  // Double the buffer as the payload arrives, starting from the size of the
+  // socket buffers, so that memory is only committed for bytes received.
+  buffer.clear();
+  uint64_t num_received = 0;
+  while (num_received < size) {
+    uint64_t num_bytes = std::min<uint64_t>(
+        size, std::max<uint64_t>(2 * num_received, kSocketBufferBytes));
+    buffer.resize((num_bytes + sizeof(T) - 1) / sizeof(T));
+    RLWE_RETURN_IF_ERROR(
+        RecvFully(reinterpret_cast<char*>(buffer.data()) + num_received,
+                  num_bytes - num_received));
+    num_received = num_bytes;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status Socket::RecvBytes(std::vector<char>& buffer) {
+  RLWE_ASSIGN_OR_RETURN(uint64_t size, RecvFrameSize());
+  return RecvPayload(size, buffer);
+}
+
+absl::StatusOr<std::vector<char>> Socket::RecvBytes() {
+  std::vector<char> buffer;
+  RLWE_RETURN_IF_ERROR(RecvBytes(buffer));
+  return buffer;
+}
+
+absl::StatusOr<std::vector<uint32_t>> Socket::RecvUints() {
+  RLWE_ASSIGN_OR_RETURN(uint64_t size, RecvFrameSize());
+  // Receive the whole frame even if it is malformed, so that the next frame
+  // can still be read.
+  std::vector<uint32_t> values;
+  RLWE_RETURN_IF_ERROR(RecvPayload(size, values));
+  if (size % sizeof(uint32_t) != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The frame size, ", size, ", is not a multiple of 4 bytes."));
+  }
+  return values;
+}
+
+}  // namespace hintless_pir
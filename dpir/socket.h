@@ -1,128 +1,134 @@
-//#include <sys/socket.h>
-//#include <arpa/inet.h>
-//#include <netdb.h>
-//#include <unistd.h>
-//#include <iostream>
-//#include <string>
-//#include <cstring>
-//#include <unordered_map>
-//#include <atomic>
-//#include <functional>
-//#include <exception>
-
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <algorithm>
-#include <unistd.h>
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HINTLESS_PIR_DPIR_SOCKET_H_
+#define HINTLESS_PIR_DPIR_SOCKET_H_
+
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <iostream>
 
-using namespace std;
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace hintless_pir {
+
+// The Unix domain sockets on which the DPIR server and client binaries wait
+// for the host.
+inline constexpr char kServerSocket[] = "/tmp/dpir_server.sock";
+inline constexpr char kClientSocket[] = "/tmp/dpir_client.sock";
+
+// A stream socket to a single peer on the same host, exchanging messages
+// framed by their size as a native-endian uint64.
+//
+// Frames are written with a single gather write of the size and the payload,
+// retried until all bytes are written, and read with `MSG_WAITALL`, so that
+// multi-MB hints and queries are not split into small chunks. The receive
+// buffer grows as the payload arrives instead of being sized by the header,
+// so a corrupted header cannot allocate more than the peer actually sends.
+// The socket buffers are enlarged to `kSocketBufferBytes` to cut down on the
+// number of context switches.
+class Socket {
+ public:
+  // The requested size of the kernel send and receive buffers.
+  static constexpr int kSocketBufferBytes = 8 << 20;
 
-#define SERVER_SOCKET "/tmp/dpir_server.sock"
-#define CLIENT_SOCKET "/tmp/dpir_client.sock"
+  // The largest frame accepted by default; see `SetMaxFrameBytes`.
+  static constexpr uint64_t kDefaultMaxFrameBytes = uint64_t{1} << 32;
 
-class Socket {
-public:
-    int Connect(std::string name) {
-        socket_name_ = std::move(name);
-        
-        unlink(socket_name_.c_str());
-        int serverFD = socket(AF_UNIX, SOCK_STREAM, 0);
-        if (serverFD == -1) {
-            return -1;
-        }
-        sockaddr_un serverAddr;
-        serverAddr.sun_family = AF_UNIX;
-        strncpy(serverAddr.sun_path, socket_name_.c_str(), sizeof(serverAddr.sun_path) - 1);
-        if (bind(serverFD, (sockaddr*)&serverAddr, sizeof(serverAddr)) == -1) {
-            return -1;
-        }
-        
-        if (listen(serverFD, 1) == -1) {
-            return -1;
-        };
-        
-        sockaddr_un client;
-        socklen_t clientSize = sizeof(client);
-        clientFD_ = accept(serverFD, (sockaddr*)&client, &clientSize);
-        return 0;
-    }
-
-    ~Socket() {
-        unlink(socket_name_.c_str());
-    }
-
-    int SendBytes(std::vector<char>& bytes) {
-        // First send the size
-        uint64_t size = bytes.size();
-        int n = send(clientFD_, &size, 8, 0);
-        if (n != 8) {
-            std::cerr << "Error reading size" << std::endl;
-            return -1;
-        }
-
-        // Now write the message
-        n = send(clientFD_, bytes.data(), bytes.size(), 0);
-        if (n != bytes.size()) {
-            std::cerr << "Error writing bytes" << std::endl;
-            return -1;
-        }
-        return 0;
-    }
-
-    int SendUints(std::vector<uint32_t>& data) {
-        vector<char> bytes;
-        bytes.insert(bytes.end(), (char*)&(*data.begin()), (char*)&(*data.end()));
-        return this->SendBytes(bytes);
-    }
-
-    std::vector<char> RecvBytes() {
-        std::vector<char> result;
-
-        // First receive the size of the message
-        char buf[4096];
-        int n = recv(clientFD_, buf, 8, 0);
-        if (n != 8) {
-            std::cerr << "Error reading size" << std::endl;
-            return result;
-        }
-        uint64_t size = *(uint64_t*)(buf);
-        result.reserve(size);
-        std::cout << "Receiving " << size << " bytes" << std::endl;
-
-        // Then receive all of the bytes
-        while (size > 0) {
-            n = recv(clientFD_, buf, min((int)size, 4096), 0);
-            if (n == 0 || n == -1) {
-                std::cerr << "Error reading msg" << std::endl;
-                return result;
-            }
-            result.insert(result.end(), buf, buf + n);
-            size -= n;
-        }
-
-        return result;
-    }
-
-    std::vector<uint32_t> RecvUints() {
-        std::vector<uint32_t> result;
-        
-        auto result_bytes = this->RecvBytes();
-        if (result_bytes.size() % 4 != 0) {
-            std::cerr << "Invalid array size" << std::endl;
-            return result;
-        }
-
-        result.insert(result.end(), (uint32_t*)&(*result_bytes.begin()), (uint32_t*)&(*result_bytes.end()));
-        return result;
-    }
-
-
-private:
-    int clientFD_;
-    std::string socket_name_;
+  // A socket that is not connected.
+  Socket() = default;
+
+  // A socket to the peer connected on `fd`, which it takes ownership of, e.g.
+  // one end of a `socketpair`.
+  explicit Socket(int fd);
+
+  Socket(Socket&& other);
+  Socket& operator=(Socket&& other);
+  Socket(const Socket&) = delete;
+  Socket& operator=(const Socket&) = delete;
+
+  ~Socket();
+
+  // Listens on the Unix domain socket at `path`, replacing any file there, and
+  // waits until a peer connects. The socket file is removed on destruction.
+  absl::Status Connect(absl::string_view path);
+
+  // Sends `bytes` as one frame.
+  absl::Status SendBytes(absl::Span<const char> bytes);
+
+  // Sends `values` as one frame of their native-endian bytes.
+  absl::Status SendUints(absl::Span<const uint32_t> values);
+
+  // Sends the concatenation of `segments` as one frame, gathering them in
+  // place, e.g. the `Segments()` of a `WireWriter`. The segments must stay
+  // alive until the call returns.
+  absl::Status SendSegments(absl::Span<const absl::string_view> segments);
+
+  // Receives the next frame.
+  absl::StatusOr<std::vector<char>> RecvBytes();
+
+  // Receives the next frame into `buffer`, reusing its capacity.
+  absl::Status RecvBytes(std::vector<char>& buffer);
+
+  // Receives the next frame as uint32 values; its size must be a multiple of
+  // 4 bytes.
+  absl::StatusOr<std::vector<uint32_t>> RecvUints();
+
+  // Sets the largest frame accepted; receiving a larger frame fails with
+  // DataLossError.
+  void SetMaxFrameBytes(uint64_t max_frame_bytes) {
+    max_frame_bytes_ = max_frame_bytes;
+  }
+
+  bool IsConnected() const { return fd_ >= 0; }
+
+ private:
+  // Writes the frame header for `size` bytes followed by `data`.
+  absl::Status SendFrame(const void* data, size_t size);
+
+  // Writes all of `parts`, advancing them past the bytes already written.
+  absl::Status SendParts(absl::Span<iovec> parts);
+
+  // Reads a frame header and returns the size of the payload.
+  absl::StatusOr<uint64_t> RecvFrameSize();
+
+  // Reads a payload of `size` bytes into `buffer`, growing it as the bytes
+  // arrive unless its capacity already suffices.
+  template <typename T>
+  absl::Status RecvPayload(uint64_t size, std::vector<T>& buffer);
+
+  // Reads exactly `size` bytes into `data`.
+  absl::Status RecvFully(void* data, size_t size);
+
+  // Closes the connection and removes the socket file, if any.
+  void Close();
+
+  // The connection to the peer, or -1 if not connected.
+  int fd_ = -1;
+
+  // The path of the socket file created by `Connect`, if any.
+  std::string socket_path_;
+
+  uint64_t max_frame_bytes_ = kDefaultMaxFrameBytes;
 };
+
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_DPIR_SOCKET_H_
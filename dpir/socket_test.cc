@@ -0,0 +1,179 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "dpir/socket.h"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+
+std::pair<Socket, Socket> CreateSocketPair() {
+  int fds[2];
+  EXPECT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  return {Socket(fds[0]), Socket(fds[1])};
+}
+
+TEST(SocketTest, SendAndReceiveLargeFrames) {
+  auto [sender, receiver] = CreateSocketPair();
+  // Larger than the socket buffers, so that the frames are sent in pieces.
+  std::vector<char> bytes(3 * Socket::kSocketBufferBytes + 5);
+  for (int i = 0; i < bytes.size(); ++i) {
+    bytes[i] = static_cast<char>(i * 31);
+  }
+  std::vector<uint32_t> values(1 << 20);
+  std::iota(values.begin(), values.end(), 7);
+
+  std::thread thread([&sender, &bytes, &values] {
+    EXPECT_OK(sender.SendBytes(bytes));
+    EXPECT_OK(sender.SendUints(values));
+  });
+  ASSERT_OK_AND_ASSIGN(std::vector<char> received_bytes, receiver.RecvBytes());
+  ASSERT_OK_AND_ASSIGN(std::vector<uint32_t> received_values,
+                       receiver.RecvUints());
+  thread.join();
+  EXPECT_EQ(received_bytes, bytes);
+  EXPECT_EQ(received_values, values);
+}
+
+TEST(SocketTest, SendAndReceiveEmptyFrames) {
+  auto [sender, receiver] = CreateSocketPair();
+  ASSERT_OK(sender.SendBytes({}));
+  ASSERT_OK(sender.SendUints({}));
+  ASSERT_OK_AND_ASSIGN(std::vector<char> bytes, receiver.RecvBytes());
+  EXPECT_TRUE(bytes.empty());
+  ASSERT_OK_AND_ASSIGN(std::vector<uint32_t> values, receiver.RecvUints());
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(SocketTest, SendSegmentsSendsOneFrame) {
+  auto [sender, receiver] = CreateSocketPair();
+  // More segments than a single sendmsg call takes, and larger in total than
+  // the socket buffers.
+  std::vector<std::string> pieces;
+  std::vector<absl::string_view> segments;
+  std::string expected;
+  for (int i = 0; i < 3000; ++i) {
+    pieces.push_back(std::string(i % 7 == 0 ? 0 : 10000 + i, 'a' + i % 26));
+  }
+  for (const std::string& piece : pieces) {
+    segments.push_back(piece);
+    expected += piece;
+  }
+
+  std::thread thread([&sender, &segments] {
+    EXPECT_OK(sender.SendSegments(segments));
+    EXPECT_OK(sender.SendSegments({}));
+  });
+  ASSERT_OK_AND_ASSIGN(std::vector<char> received, receiver.RecvBytes());
+  ASSERT_OK_AND_ASSIGN(std::vector<char> empty, receiver.RecvBytes());
+  thread.join();
+  EXPECT_EQ(absl::string_view(received.data(), received.size()), expected);
+  EXPECT_TRUE(empty.empty());
+}
+
+TEST(SocketTest, RecvBytesReusesBuffer) {
+  auto [sender, receiver] = CreateSocketPair();
+  std::vector<char> long_message(1000, 'a');
+  std::vector<char> short_message = {'b', 'c', 'd'};
+  ASSERT_OK(sender.SendBytes(long_message));
+  ASSERT_OK(sender.SendBytes(short_message));
+
+  std::vector<char> buffer;
+  ASSERT_OK(receiver.RecvBytes(buffer));
+  EXPECT_EQ(buffer, long_message);
+  const char* data = buffer.data();
+  ASSERT_OK(receiver.RecvBytes(buffer));
+  EXPECT_EQ(buffer, short_message);
+  EXPECT_EQ(buffer.data(), data);
+}
+
+TEST(SocketTest, RecvUintsFailsIfFrameIsNotWholeUints) {
+  auto [sender, receiver] = CreateSocketPair();
+  ASSERT_OK(sender.SendBytes(std::vector<char>(6)));
+  ASSERT_OK(sender.SendUints(std::vector<uint32_t>{1, 2}));
+  EXPECT_THAT(receiver.RecvUints(),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // The malformed frame is consumed, so the next one is intact.
+  ASSERT_OK_AND_ASSIGN(std::vector<uint32_t> values, receiver.RecvUints());
+  EXPECT_EQ(values, (std::vector<uint32_t>{1, 2}));
+}
+
+TEST(SocketTest, RecvFailsIfPeerIsClosed) {
+  auto [sender, receiver] = CreateSocketPair();
+  ASSERT_OK(sender.SendBytes(std::vector<char>(4)));
+  sender = Socket();
+  ASSERT_OK(receiver.RecvBytes().status());
+  EXPECT_THAT(receiver.RecvBytes(),
+              StatusIs(absl::StatusCode::kUnavailable));
+  EXPECT_FALSE(receiver.SendBytes(std::vector<char>(4)).ok());
+}
+
+TEST(SocketTest, RecvFailsIfFrameExceedsMaximum) {
+  auto [sender, receiver] = CreateSocketPair();
+  receiver.SetMaxFrameBytes(8);
+  ASSERT_OK(sender.SendBytes(std::vector<char>(9)));
+  EXPECT_THAT(receiver.RecvBytes(), StatusIs(absl::StatusCode::kDataLoss));
+}
+
+TEST(SocketTest, RecvFailsIfPayloadIsShorterThanHeader) {
+  int fds[2];
+  ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  Socket receiver(fds[1]);
+  // A header announcing a frame of 4 GiB, followed by a few bytes only. The
+  // receiver must not allocate the announced size up front.
+  uint64_t header = Socket::kDefaultMaxFrameBytes;
+  char payload[3] = {1, 2, 3};
+  ASSERT_EQ(write(fds[0], &header, sizeof(header)), sizeof(header));
+  ASSERT_EQ(write(fds[0], payload, sizeof(payload)), sizeof(payload));
+  close(fds[0]);
+  EXPECT_THAT(receiver.RecvBytes(),
+              StatusIs(absl::StatusCode::kUnavailable));
+}
+
+TEST(SocketTest, FailsIfNotConnected) {
+  Socket socket;
+  EXPECT_FALSE(socket.IsConnected());
+  EXPECT_THAT(socket.SendBytes(std::vector<char>(4)),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(socket.RecvUints(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(SocketTest, ConnectFailsIfPathIsInvalid) {
+  Socket socket;
+  EXPECT_THAT(socket.Connect(""),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(socket.Connect(std::string(200, 'a')),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace hintless_pir
@@ -16,6 +16,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,11 +27,18 @@
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/types/span.h"
+#include "hintless_simplepir/crt_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/serialization.pb.h"
 #include "hintless_simplepir/utils.h"
+#include "hintless_simplepir/wire_format.h"
+#include "linpir/query_pad_prng.h"
+#include "lwe/counter_prng.h"
 #include "lwe/encode.h"
 #include "lwe/lwe_symmetric_encryption.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 #include "shell_encryption/int256.h"
 #include "shell_encryption/prng/prng.h"
@@ -42,6 +50,87 @@
 namespace hintless_pir {
 namespace hintless_simplepir {
 
+namespace {
+
+absl::StatusOr<std::string> GeneratePrngSeed(rlwe::PrngType prng_type) {
+  if (prng_type == rlwe::PRNG_TYPE_HKDF) {
+    return rlwe::SingleThreadHkdfPrng::GenerateSeed();
+  }
+  return rlwe::SingleThreadChaChaPrng::GenerateSeed();
+}
+
+// Checks that an LWE ciphertext in the server response has one coefficient
+// per database row, and that its coefficients, if rounded, are packed with a
+// valid bit size.
+absl::Status CheckLweRecord(int64_t num_coeffs, bool is_packed,
+                            int packed_bit_size, int64_t num_packed_bytes,
+                            const Parameters& params) {
+  if (num_coeffs != params.db_rows) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The server response has incorrect dimension; got ", num_coeffs,
+        " but expecting ", params.db_rows, "."));
+  }
+  if (is_packed &&
+      (packed_bit_size <= params.lwe_plaintext_bit_size ||
+       packed_bit_size > params.lwe_modulus_bit_size ||
+       num_packed_bytes <
+           DivAndRoundUp<int64_t>(num_coeffs * packed_bit_size, 8))) {
+    return absl::InvalidArgumentError(
+        "The server response has invalid packed coefficients.");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status CheckLweRecord(const SerializedLweCiphertext& ct_record,
+                            const Parameters& params) {
+  return CheckLweRecord(LweCiphertextSize(ct_record),
+                        ct_record.has_packed_bit_size(),
+                        ct_record.packed_bit_size(),
+                        ct_record.packed_b_coeffs().size(), params);
+}
+
+absl::Status CheckLweRecord(const LweCiphertextView& ct_record,
+                            const Parameters& params) {
+  return CheckLweRecord(LweCiphertextSize(ct_record),
+                        ct_record.packed_bit_size > 0,
+                        ct_record.packed_bit_size,
+                        ct_record.packed_b_coeffs.size(), params);
+}
+
+// Returns the LWE plaintexts at `row_idx` of the server response ciphertexts
+// `ct_records`, either `SerializedLweCiphertext`s or `LweCiphertextView`s,
+// after removing `decryption_parts`.
+template <typename CtRecords>
+absl::StatusOr<std::vector<lwe::Integer>> DecryptLweRecords(
+    const CtRecords& ct_records,
+    absl::Span<const lwe::Integer> decryption_parts, int64_t row_idx,
+    const Parameters& params) {
+  std::vector<lwe::Integer> values;
+  values.reserve(ct_records.size());
+  for (int i = 0; i < ct_records.size(); ++i) {
+    RLWE_RETURN_IF_ERROR(CheckLweRecord(ct_records[i], params));
+
+    // Remove hint * s from the server response, which gives us \Delta * m + e.
+    // Only the coefficient at `row_idx` is needed; if the server rounded the
+    // answer, it is lifted back to the LWE modulus and the rounding error is
+    // removed together with e.
+    lwe::Vector noisy_plaintext{{LweCiphertextCoeff(ct_records[i], row_idx)}};
+    noisy_plaintext[0] -= decryption_parts[i];
+
+    // Remove the error e.
+    int log_scaling_factor =
+        params.lwe_modulus_bit_size - params.lwe_plaintext_bit_size;
+    RLWE_RETURN_IF_ERROR(
+        lwe::RemoveErrorInPlace(noisy_plaintext, log_scaling_factor));
+
+    // Extracting the coefficient from the 1 x 1 matrix noisy_plaintext.
+    values.push_back(noisy_plaintext.eval()(0));
+  }
+  return values;
+}
+
+}  // namespace
+
 absl::StatusOr<std::unique_ptr<Client>> Client::Create(
     const Parameters& params,
     const HintlessPirServerPublicParams& public_params) {
@@ -84,163 +173,332 @@ absl::StatusOr<std::unique_ptr<Client>> Client::Create(
       RlweRnsContext crt_context,
       RlweRnsContext::Create(rlwe_params.log_n, rlwe_params.ts, /*ps=*/{}, 2));
 
-  return absl::WrapUnique(
-      new Client(params, public_params.prng_seed_lwe_query_pad(),
-                 std::move(rlwe_contexts), std::move(rlwe_moduli),
-                 std::move(linpir_clients), std::move(crt_context)));
+  // The common case of two small plaintext moduli avoids big integers.
+  std::optional<internal::TwoPrimeCrtParams> two_prime_crt_params;
+  if (num_linpir_instances == 2) {
+    auto crt_params = internal::TwoPrimeCrtParams::Create(
+        rlwe_params.ts[0], rlwe_params.ts[1], params.lwe_modulus_bit_size);
+    if (crt_params.ok()) {
+      two_prime_crt_params = *std::move(crt_params);
+    }
+  }
+
+  std::optional<lwe::RingPad> lwe_ring_pad;
+  if (params.ring_lwe_query_pad) {
+    RLWE_ASSIGN_OR_RETURN(
+        lwe_ring_pad,
+        ExpandLweRingPad(params, public_params.prng_seed_lwe_query_pad()));
+  }
+
+  return absl::WrapUnique(new Client(
+      params, public_params.prng_seed_lwe_query_pad(), std::move(lwe_ring_pad),
+      std::move(rlwe_contexts), std::move(rlwe_moduli),
+      std::move(linpir_clients), std::move(crt_context),
+      std::move(two_prime_crt_params)));
 }
 
-absl::StatusOr<HintlessPirRequest> Client::GenerateRequest(int64_t index) {
+absl::StatusOr<Client::PendingRequest> Client::GeneratePendingRequest(
+    int64_t index) const {
   if (index < 0 || index >= params_.db_rows * params_.db_cols) {
     return absl::InvalidArgumentError("`index` out of range.");
   }
 
-  // Step 1. Encrypting the selection vector under LWE.
-  lwe::Matrix lwe_pad;
+  // Take the oldest precomputed template made in the current session, or
+  // generate one now if there is none.
+  std::optional<RequestTemplate> request_template;
+  {
+    absl::MutexLock lock(&precomputed_requests_mutex_);
+    while (!precomputed_requests_.empty() && !request_template.has_value()) {
+      if (precomputed_requests_.front().session_id == session_id_) {
+        request_template = std::move(precomputed_requests_.front());
+      }
+      precomputed_requests_.pop_front();
+    }
+  }
+  if (!request_template.has_value()) {
+    RLWE_ASSIGN_OR_RETURN(request_template, GenerateRequestTemplate());
+  }
+
+  // Turn the LWE encryption of zero into that of the selection vector for
+  // col_idx, by adding the scaling factor at col_idx.
+  int64_t row_idx = index / params_.db_cols;
+  int64_t col_idx = index % params_.db_cols;
+  int log_scaling_factor =
+      params_.lwe_modulus_bit_size - params_.lwe_plaintext_bit_size;
+  lwe::Vector& query_vector = request_template->ct_query_zero;
+  query_vector[col_idx] += lwe::Integer{1} << log_scaling_factor;
+
+  PendingRequest pending_request{
+      .request = std::move(request_template->request),
+      .state = RequestState{.row_idx = row_idx,
+                            .col_idx = col_idx,
+                            .prng_seed_linpir_sk = std::move(
+                                request_template->prng_seed_linpir_sk)}};
+  *pending_request.request.mutable_ct_query_vector() =
+      SerializeLweCiphertext(query_vector);
+  return pending_request;
+}
+
+absl::StatusOr<HintlessPirRequest> Client::GenerateRequest(int64_t index) {
+  RLWE_ASSIGN_OR_RETURN(PendingRequest pending_request,
+                        GeneratePendingRequest(index));
+
+  // Cache the per request state.
+  state_ = std::move(pending_request.state);
+  return std::move(pending_request.request);
+}
+
+absl::Status Client::PrecomputeRequests(int num_requests) const {
+  if (num_requests < 0) {
+    return absl::InvalidArgumentError("`num_requests` must be non-negative.");
+  }
+  std::vector<RequestTemplate> request_templates;
+  request_templates.reserve(num_requests);
+  for (int i = 0; i < num_requests; ++i) {
+    RLWE_ASSIGN_OR_RETURN(RequestTemplate request_template,
+                          GenerateRequestTemplate());
+    request_templates.push_back(std::move(request_template));
+  }
+
+  absl::MutexLock lock(&precomputed_requests_mutex_);
+  for (auto& request_template : request_templates) {
+    precomputed_requests_.push_back(std::move(request_template));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Client::RequestTemplate> Client::GenerateRequestTemplate()
+    const {
+  // Step 1. Encrypting zero under LWE. The pad is streamed from its seed while
+  // encrypting, so it is never held in memory, unless it is a ring pad.
+  bool stream_lwe_pad =
+      !params_.counter_mode_lwe_query_pad && !params_.ring_lwe_query_pad;
+  std::unique_ptr<rlwe::SecurePrng> lwe_pad_prng;
   std::unique_ptr<rlwe::SecurePrng> lwe_enc_prng;
-  std::string prng_seed_linpir_sk;
   if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
-    RLWE_ASSIGN_OR_RETURN(auto pad_prng, rlwe::SingleThreadHkdfPrng::Create(
-                                             prng_seed_lwe_query_pad_));
-    RLWE_ASSIGN_OR_RETURN(
-        lwe_pad, lwe::ExpandPad(params_.db_cols, params_.lwe_secret_dim,
-                                pad_prng.get()));
+    if (stream_lwe_pad) {
+      RLWE_ASSIGN_OR_RETURN(lwe_pad_prng, rlwe::SingleThreadHkdfPrng::Create(
+                                              prng_seed_lwe_query_pad_));
+    }
     RLWE_ASSIGN_OR_RETURN(std::string prng_seed_enc,
                           rlwe::SingleThreadHkdfPrng::GenerateSeed());
     RLWE_ASSIGN_OR_RETURN(lwe_enc_prng,
                           rlwe::SingleThreadHkdfPrng::Create(prng_seed_enc));
-    RLWE_ASSIGN_OR_RETURN(prng_seed_linpir_sk,
-                          rlwe::SingleThreadHkdfPrng::GenerateSeed());
-
   } else {
-    RLWE_ASSIGN_OR_RETURN(auto pad_prng, rlwe::SingleThreadChaChaPrng::Create(
-                                             prng_seed_lwe_query_pad_));
-    RLWE_ASSIGN_OR_RETURN(
-        lwe_pad, lwe::ExpandPad(params_.db_cols, params_.lwe_secret_dim,
-                                pad_prng.get()));
+    if (stream_lwe_pad) {
+      RLWE_ASSIGN_OR_RETURN(lwe_pad_prng, rlwe::SingleThreadChaChaPrng::Create(
+                                              prng_seed_lwe_query_pad_));
+    }
     RLWE_ASSIGN_OR_RETURN(std::string prng_seed_enc,
                           rlwe::SingleThreadChaChaPrng::GenerateSeed());
     RLWE_ASSIGN_OR_RETURN(lwe_enc_prng,
                           rlwe::SingleThreadChaChaPrng::Create(prng_seed_enc));
-    RLWE_ASSIGN_OR_RETURN(prng_seed_linpir_sk,
-                          rlwe::SingleThreadChaChaPrng::GenerateSeed());
   }
   RLWE_ASSIGN_OR_RETURN(
       lwe::SymmetricLweKey lwe_secret_key,
       lwe::SymmetricLweKey::Sample(params_.lwe_secret_dim, lwe_enc_prng.get()));
 
-  // Choosing the largest scaling factor that supports our plaintext space
   int log_scaling_factor =
       params_.lwe_modulus_bit_size - params_.lwe_plaintext_bit_size;
+  RequestTemplate request_template;
+  request_template.ct_query_zero = lwe::Vector::Zero(params_.db_cols);
+  if (lwe_ring_pad_.has_value()) {
+    // The product of the ring pad with the key is computed with NTTs.
+    RLWE_RETURN_IF_ERROR(lwe_secret_key.EncryptFromRingPadInPlace(
+        request_template.ct_query_zero, *lwe_ring_pad_, log_scaling_factor,
+        lwe_enc_prng.get()));
+  } else if (params_.counter_mode_lwe_query_pad) {
+    // The counter-mode PRNG expands each row of the pad in bulk.
+    RLWE_ASSIGN_OR_RETURN(
+        std::unique_ptr<lwe::CounterPrng> lwe_counter_prng,
+        lwe::CounterPrng::Create(prng_seed_lwe_query_pad_,
+                                 params_.counter_prng_cipher));
+    RLWE_RETURN_IF_ERROR(lwe_secret_key.EncryptFromPadPrngInPlace(
+        request_template.ct_query_zero, lwe_counter_prng.get(),
+        log_scaling_factor, lwe_enc_prng.get()));
+  } else {
+    RLWE_RETURN_IF_ERROR(lwe_secret_key.EncryptFromPadPrngInPlace(
+        request_template.ct_query_zero, lwe_pad_prng.get(),
+        log_scaling_factor, lwe_enc_prng.get()));
+  }
 
-  // Plaintext is a selection vector for col_idx
-  int64_t row_idx = index / params_.db_cols;
-  int64_t col_idx = index % params_.db_cols;
-  lwe::Vector query_vector = lwe::Vector::Zero(params_.db_cols);
-  query_vector[col_idx] = 1;
-
-  RLWE_RETURN_IF_ERROR(lwe_secret_key.EncryptFromPadInPlace(
-      query_vector, lwe_pad, log_scaling_factor, lwe_enc_prng.get()));
-
-  // Cache the per request state.
-  state_ = ClientState{.row_idx = row_idx,
-                       .col_idx = col_idx,
-                       .prng_seed_linpir_sk = std::move(prng_seed_linpir_sk)};
-
-  HintlessPirRequest request;
-  *request.mutable_ct_query_vector() = SerializeLweCiphertext(query_vector);
+  // In a session, the LinPir secret key is fixed by the session.
+  if (HasSession()) {
+    request_template.prng_seed_linpir_sk = session_prng_seed_linpir_sk_;
+  } else {
+    RLWE_ASSIGN_OR_RETURN(request_template.prng_seed_linpir_sk,
+                          GeneratePrngSeed(params_.prng_type));
+  }
+  request_template.session_id = session_id_;
 
   // Step 2. Encrypting the LWE secret using LinPir.
-  RLWE_RETURN_IF_ERROR(
-      GenerateLinPirRequestInPlace(request, lwe_secret_key.Key()));
-  return request;
+  RLWE_RETURN_IF_ERROR(GenerateLinPirRequestInPlace(
+      request_template.request, lwe_secret_key.Key(),
+      request_template.prng_seed_linpir_sk));
+  return request_template;
 }
 
 absl::Status Client::GenerateLinPirRequestInPlace(
-    HintlessPirRequest& request, const lwe::Vector& lwe_secret) const {
+    HintlessPirRequest& request, const lwe::Vector& lwe_secret,
+    absl::string_view prng_seed_linpir_sk) const {
   if (linpir_clients_.empty()) {
     return absl::InvalidArgumentError("No LinPir client available.");
   }
 
   // Encode the LWE secret vector using LinPir plaintext moduli, and also
   // generate a GaloisKey which is shared by all LinPir requests.
-  RlweInteger lwe_modulus = RlweInteger{1} << params_.lwe_modulus_bit_size;
+  // In a session, the secret key is reused across requests, so every LinPir
+  // ciphertext must use a fresh "a" component instead of the server's one,
+  // and the Galois key is already held by the server.
   for (int k = 0; k < linpir_clients_.size(); ++k) {
     RlweInteger plaintext_modulus = rlwe_contexts_[k]->PlaintextModulus();
     std::vector<RlweInteger> lwe_secret_mod_t =
-        EncodeLweVector(lwe_secret, lwe_modulus, plaintext_modulus);
-    RLWE_ASSIGN_OR_RETURN(
-        auto ct, linpir_clients_[k]->EncryptQuery(lwe_secret_mod_t,
-                                                  state_.prng_seed_linpir_sk));
-    RLWE_ASSIGN_OR_RETURN(auto ct_b, ct.Component(0));
+        EncodeLweVector(lwe_secret, params_.lwe_modulus_bit_size,
+                        plaintext_modulus);
+    std::vector<LinPirClient::RnsCiphertext> ct;
+    if (HasSession()) {
+      RLWE_ASSIGN_OR_RETURN(
+          std::string prng_seed_ct_pad,
+          linpir::GenerateQueryPadPrngSeed(params_.linpir_params));
+      RLWE_ASSIGN_OR_RETURN(
+          ct, linpir_clients_[k]->EncryptQueryWithoutCachingKey(
+                  {lwe_secret_mod_t}, prng_seed_linpir_sk, prng_seed_ct_pad));
+      request.add_prng_seed_linpir_ct_pads(std::move(prng_seed_ct_pad));
+    } else {
+      RLWE_ASSIGN_OR_RETURN(
+          ct, linpir_clients_[k]->EncryptQueryWithoutCachingKey(
+                  {lwe_secret_mod_t}, prng_seed_linpir_sk,
+                  linpir_clients_[k]->PrngSeedForCiphertextRandomPads()));
+    }
+    RLWE_ASSIGN_OR_RETURN(auto ct_b, ct[0].Component(0));
     RLWE_ASSIGN_OR_RETURN(*request.add_linpir_ct_bs(),
                           ct_b.Serialize(rlwe_moduli_));
   }
-  RLWE_ASSIGN_OR_RETURN(auto gk, linpir_clients_[0]->GenerateGaloisKey(
-                                     state_.prng_seed_linpir_sk));
+  if (HasSession()) {
+    request.set_session_id(session_id_);
+    return absl::OkStatus();
+  }
+  RLWE_ASSIGN_OR_RETURN(
+      auto gk, linpir_clients_[0]->GenerateGaloisKey(prng_seed_linpir_sk));
+  for (auto const& gk_b : gk.GetKeyB()) {
+    RLWE_ASSIGN_OR_RETURN(*request.add_linpir_gk_bs(),
+                          gk_b.Serialize(rlwe_moduli_));
+  }
+  if (params_.linpir_params.baby_step_size > 0) {
+    RLWE_ASSIGN_OR_RETURN(auto gk_giant_step,
+                          linpir_clients_[0]->GenerateGiantStepGaloisKey(
+                              prng_seed_linpir_sk));
+    for (auto const& gk_b : gk_giant_step.GetKeyB()) {
+      RLWE_ASSIGN_OR_RETURN(*request.add_linpir_gk_giant_step_bs(),
+                            gk_b.Serialize(rlwe_moduli_));
+    }
+  }
+  if (params_.linpir_params.fold_blocks) {
+    RLWE_ASSIGN_OR_RETURN(auto gk_fold,
+                          linpir_clients_[0]->GenerateFoldGaloisKey(
+                              prng_seed_linpir_sk));
+    for (auto const& gk_b : gk_fold.GetKeyB()) {
+      RLWE_ASSIGN_OR_RETURN(*request.add_linpir_gk_fold_bs(),
+                            gk_b.Serialize(rlwe_moduli_));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<HintlessPirSessionRequest> Client::StartSession() {
+  if (linpir_clients_.empty()) {
+    return absl::InvalidArgumentError("No LinPir client available.");
+  }
+  EndSession();
+  RLWE_ASSIGN_OR_RETURN(std::string prng_seed_linpir_sk,
+                        GeneratePrngSeed(params_.prng_type));
+  RLWE_ASSIGN_OR_RETURN(
+      auto gk, linpir_clients_[0]->GenerateGaloisKey(prng_seed_linpir_sk));
+  HintlessPirSessionRequest request;
   for (auto const& gk_b : gk.GetKeyB()) {
     RLWE_ASSIGN_OR_RETURN(*request.add_linpir_gk_bs(),
                           gk_b.Serialize(rlwe_moduli_));
   }
+  session_prng_seed_linpir_sk_ = std::move(prng_seed_linpir_sk);
+  return request;
+}
+
+absl::Status Client::SetSessionId(const HintlessPirSessionResponse& response) {
+  if (session_prng_seed_linpir_sk_.empty()) {
+    return absl::FailedPreconditionError("No session has been started.");
+  }
+  if (response.session_id().empty()) {
+    return absl::InvalidArgumentError("`response` has an empty session id.");
+  }
+  session_id_ = response.session_id();
   return absl::OkStatus();
 }
 
 std::vector<Client::RlweInteger> Client::EncodeLweVector(
-    const lwe::Vector& lwe_vector, RlweInteger lwe_modulus,
+    const lwe::Vector& lwe_vector, int log_lwe_modulus,
     RlweInteger encode_modulus) {
-  RlweInteger lwe_modulus_half = lwe_modulus >> 1;
   std::vector<RlweInteger> lwe_vector_mod_t(lwe_vector.size(), 0);
   for (int i = 0; i < lwe_vector.size(); ++i) {
     RlweInteger x = lwe_vector[i];
     lwe_vector_mod_t[i] =
-        ConvertModulus(x, lwe_modulus, encode_modulus, lwe_modulus_half);
+        ConvertPowerOfTwoModulus(x, log_lwe_modulus, encode_modulus);
   }
   return lwe_vector_mod_t;
 }
 
 absl::StatusOr<std::string> Client::RecoverRecord(
-    const HintlessPirResponse& response) {
+    const HintlessPirResponse& response, const RequestState& state) const {
+  if (state.prng_seed_linpir_sk.empty()) {
+    return absl::InvalidArgumentError("`state` is not of any request.");
+  }
   int num_shards =
       DivAndRoundUp(params_.db_record_bit_size, params_.lwe_plaintext_bit_size);
   if (response.ct_records_size() != num_shards) {
     return absl::InvalidArgumentError("`response` has incorrect size.");
   }
 
-  // Recover decryption_parts = Hint * LWE secret = Database * A * LWE secret.
-  RLWE_ASSIGN_OR_RETURN(std::vector<lwe::Vector> decryption_parts,
-                        RecoverLweDecryptionParts(response));
+  // Recover decryption_parts = Hint[row_idx] * LWE secret
+  //                          = Database[row_idx] * A * LWE secret.
+  RLWE_ASSIGN_OR_RETURN(std::vector<lwe::Integer> decryption_parts,
+                        RecoverLweDecryptionParts(response, state));
 
   // Decrypt the LWE ciphertexts in response.
-  std::vector<lwe::Integer> values;
-  values.reserve(response.ct_records_size());
-  for (int i = 0; i < response.ct_records_size(); ++i) {
-    std::vector<lwe::Integer> ct_records =
-        DeserializeLweCiphertext(response.ct_records(i));
-    if (ct_records.size() != params_.db_rows) {
-      return absl::InvalidArgumentError(absl::StrCat(
-          "The server response has incorrect dimension; got ",
-          ct_records.size(), " but expecting ", params_.db_rows, "."));
-    }
-
-    // Remove hint * s from the server response, which gives us \Delta * m + e.
-    lwe::Vector noisy_plaintext{{ct_records[state_.row_idx]}};
-    noisy_plaintext[0] -= decryption_parts[i][state_.row_idx];
-
-    // Remove the error e.
-    int log_scaling_factor =
-        params_.lwe_modulus_bit_size - params_.lwe_plaintext_bit_size;
-    RLWE_RETURN_IF_ERROR(
-        lwe::RemoveErrorInPlace(noisy_plaintext, log_scaling_factor));
+  RLWE_ASSIGN_OR_RETURN(
+      std::vector<lwe::Integer> values,
+      DecryptLweRecords(response.ct_records(), decryption_parts,
+                        state.row_idx, params_));
+  return ReconstructRecord(values, params_);
+}
 
-    // Extracting the coefficient from the 1 x 1 matrix noisy_plaintext.
-    values.push_back(noisy_plaintext.eval()(0));
+absl::StatusOr<std::string> Client::RecoverRecord(
+    const HintlessPirResponseView& response, const RequestState& state) const {
+  if (state.prng_seed_linpir_sk.empty()) {
+    return absl::InvalidArgumentError("`state` is not of any request.");
+  }
+  int num_shards =
+      DivAndRoundUp(params_.db_record_bit_size, params_.lwe_plaintext_bit_size);
+  if (response.ct_records.size() != num_shards) {
+    return absl::InvalidArgumentError("`response` has incorrect size.");
   }
 
+  // The LinPir responses hold a few RLWE ciphertexts, which are decrypted from
+  // protos; the LWE ciphertexts, one coefficient per database row, are not.
+  HintlessPirResponseView linpir_responses;
+  linpir_responses.linpir_responses = response.linpir_responses;
+  RLWE_ASSIGN_OR_RETURN(
+      std::vector<lwe::Integer> decryption_parts,
+      RecoverLweDecryptionParts(ToProto(linpir_responses), state));
+
+  // Decrypt the LWE ciphertexts in response, in place.
+  RLWE_ASSIGN_OR_RETURN(
+      std::vector<lwe::Integer> values,
+      DecryptLweRecords(response.ct_records, decryption_parts, state.row_idx,
+                        params_));
   return ReconstructRecord(values, params_);
 }
 
-absl::StatusOr<std::vector<lwe::Vector>> Client::RecoverLweDecryptionParts(
-    const HintlessPirResponse& response) const {
+absl::StatusOr<std::vector<lwe::Integer>> Client::RecoverLweDecryptionParts(
+    const HintlessPirResponse& response, const RequestState& state) const {
   using BigInteger = rlwe::uint256;
 
   auto plaintext_moduli = crt_context_.MainPrimeModuli();
@@ -252,36 +510,66 @@ absl::StatusOr<std::vector<lwe::Vector>> Client::RecoverLweDecryptionParts(
 
   int num_shards =
       DivAndRoundUp(params_.db_record_bit_size, params_.lwe_plaintext_bit_size);
-  if (num_shards != response.linpir_responses(0).ct_inner_products_size()) {
+  int num_linpir_databases = params_.pack_linpir_shards ? 1 : num_shards;
+  if (num_linpir_databases !=
+      response.linpir_responses(0).ct_inner_products_size()) {
     return absl::InvalidArgumentError(
         "`response` contains an expected number of shards.");
   }
 
-  // CRT decomposed values of Hint * LWE secrets, where the first dimension
-  // is per database shard, then per CRT modulus, and then per block in the
-  // shard.
+  // CRT decomposed values of Hint[row_idx] * LWE secrets, where the first
+  // dimension is per CRT modulus, then per database shard. Packed shards are
+  // stacked one after another in a single database.
+  std::vector<std::vector<RlweInteger>> hint_values(
+      num_linpir_plaintext_moduli);
+  for (int k = 0; k < num_linpir_plaintext_moduli; ++k) {
+    if (params_.pack_linpir_shards) {
+      std::vector<int> rows(num_shards);
+      for (int i = 0; i < num_shards; ++i) {
+        rows[i] = i * params_.db_rows + state.row_idx;
+      }
+      RLWE_ASSIGN_OR_RETURN(hint_values[k],
+                            linpir_clients_[k]->RecoverRows(
+                                response.linpir_responses(k), 0, rows,
+                                state.prng_seed_linpir_sk));
+    } else {
+      for (int i = 0; i < num_shards; ++i) {
+        RLWE_ASSIGN_OR_RETURN(
+            std::vector<RlweInteger> shard_hint_values,
+            linpir_clients_[k]->RecoverRows(response.linpir_responses(k), i,
+                                            {static_cast<int>(state.row_idx)},
+                                            state.prng_seed_linpir_sk));
+        hint_values[k].push_back(shard_hint_values[0]);
+      }
+    }
+  }
+
+  std::vector<lwe::Integer> decryption_parts(num_shards);
+  if (two_prime_crt_params_.has_value()) {
+    RLWE_RETURN_IF_ERROR(internal::TwoPrimeCrtLift(
+        *two_prime_crt_params_, hint_values[0], hint_values[1],
+        absl::MakeSpan(decryption_parts)));
+    return decryption_parts;
+  }
+
   std::vector<std::vector<std::vector<RlweModularInt>>> hint_crt_values(
       num_shards);
   for (auto& h : hint_crt_values) {
     h.resize(num_linpir_plaintext_moduli);
   }
   for (int k = 0; k < num_linpir_plaintext_moduli; ++k) {
-    RLWE_ASSIGN_OR_RETURN(
-        auto hint_values_mod_tk,
-        linpir_clients_[k]->Recover(response.linpir_responses(k)));
     auto mod_params_tk = plaintext_moduli[k]->ModParams();
     for (int i = 0; i < num_shards; ++i) {
-      hint_crt_values[i][k].reserve(hint_values_mod_tk[i].size());
-      for (auto const& hint_value : hint_values_mod_tk[i]) {
-        RLWE_ASSIGN_OR_RETURN(auto hint_mod_tk, RlweModularInt::ImportInt(
-                                                    hint_value, mod_params_tk));
-        hint_crt_values[i][k].push_back(std::move(hint_mod_tk));
-      }
+      RLWE_ASSIGN_OR_RETURN(
+          auto hint_mod_tk,
+          RlweModularInt::ImportInt(hint_values[k][i], mod_params_tk));
+      hint_crt_values[i][k].push_back(std::move(hint_mod_tk));
     }
   }
 
-  // CRT interpolates to get Hint * LWE secrets as balanced mod-t values, where
-  // t is the product of plaintext moduli. Then convert them wrt LWE modulus.
+  // CRT interpolates to get Hint[row_idx] * LWE secrets as balanced mod-t
+  // values, where t is the product of plaintext moduli. Then convert them wrt
+  // LWE modulus.
   BigInteger p = 1;
   for (auto pi : plaintext_moduli) {
     p *= rlwe::ConvertToBigInteger<RlweInteger, BigInteger>(pi->Modulus());
@@ -294,24 +582,17 @@ absl::StatusOr<std::vector<lwe::Vector>> Client::RecoverLweDecryptionParts(
       std::vector<RlweModularInt> p_hat_invs,
       crt_context_.MainPrimeModulusCrtFactors(num_linpir_plaintext_moduli - 1));
 
-  std::vector<lwe::Vector> hint_vectors;
-  hint_vectors.reserve(num_shards);
   for (int j = 0; j < num_shards; ++j) {
     RLWE_ASSIGN_OR_RETURN(
-        std::vector<BigInteger> hint_values,
+        std::vector<BigInteger> hint_big_values,
         (rlwe::CrtInterpolation<RlweModularInt, BigInteger>(
             hint_crt_values[j], plaintext_moduli, p_hats, p_hat_invs)));
-
-    lwe::Vector hint = lwe::Vector::Zero(hint_values.size());
-    for (int i = 0; i < hint_values.size(); ++i) {
-      BigInteger x = hint_values[i] % p;
-      hint[i] =
-          static_cast<RlweInteger>(ConvertModulus(x, p, lwe_modulus, p_half));
-    }
-    hint_vectors.push_back(std::move(hint));
+    BigInteger x = hint_big_values[0] % p;
+    decryption_parts[j] =
+        static_cast<lwe::Integer>(ConvertModulus(x, p, lwe_modulus, p_half));
   }
 
-  return hint_vectors;
+  return decryption_parts;
 }
 
 }  // namespace hintless_simplepir
@@ -17,17 +17,24 @@
 #define HINTLESS_PIR_HINTLESS_SIMPLEPIR_CLIENT_H_
 
 #include <cstdint>
+#include <deque>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "hintless_simplepir/crt_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/serialization.pb.h"
+#include "hintless_simplepir/wire_format.h"
 #include "linpir/client.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/rns/rns_context.h"
@@ -45,12 +52,95 @@ class Client {
       const Parameters& params,
       const HintlessPirServerPublicParams& public_params);
 
-  // Returns the request for accessing database[index].
+  // HintlessPir client state of a request, which is needed to recover the
+  // record from the corresponding response:
+  //
+  // 1) as in SimplePIR, a pair of indices (row_idx, col_idx) representing the
+  // client's desired query index i = (row_idx * cols) + col_idx.
+  //
+  // 2) a PRNG seed expanding to the LinPir secret key for encrypting the LWE
+  // secret used by the request.
+  struct RequestState {
+    int64_t row_idx;
+    int64_t col_idx;
+    std::string prng_seed_linpir_sk;
+  };
+
+  // A request together with its state.
+  struct PendingRequest {
+    HintlessPirRequest request;
+    RequestState state;
+  };
+
+  // Returns the request for accessing database[index] together with its
+  // state, which must be passed to `RecoverRecord` with the response. The
+  // client is not modified, so any number of requests can be outstanding, and
+  // requests can be generated and recovered concurrently from multiple
+  // threads. If there are precomputed request templates, the oldest one made
+  // for the current session is used, and only the selection of `index` is
+  // added to it.
+  absl::StatusOr<PendingRequest> GeneratePendingRequest(int64_t index) const;
+
+  // Returns the request for accessing database[index], whose state is cached
+  // for the following call to `RecoverRecord` without a state. Generating
+  // another request this way invalidates the cached state.
   absl::StatusOr<HintlessPirRequest> GenerateRequest(int64_t index);
 
-  // Returns the retrieved record from the server response.
+  // Precomputes `num_requests` request templates, each holding everything in a
+  // request that does not depend on the index: the LWE encryption of zero, the
+  // LinPir encryptions of its LWE secret, and the Galois keys. This can run in
+  // a background thread concurrently with `GeneratePendingRequest` and
+  // `RecoverRecord`, but not with starting or ending a session; templates made
+  // outside the current session are discarded when requests are generated.
+  absl::Status PrecomputeRequests(int num_requests) const;
+
+  // Returns the number of precomputed request templates not yet used.
+  int NumPrecomputedRequests() const {
+    absl::MutexLock lock(&precomputed_requests_mutex_);
+    return precomputed_requests_.size();
+  }
+
+  // Returns the retrieved record from the server response to the request with
+  // the given state.
+  absl::StatusOr<std::string> RecoverRecord(const HintlessPirResponse& response,
+                                            const RequestState& state) const;
+
+  // Returns the retrieved record from the server response to the last request
+  // returned by `GenerateRequest`.
+  absl::StatusOr<std::string> RecoverRecord(
+      const HintlessPirResponse& response) const {
+    return RecoverRecord(response, state_);
+  }
+
+  // Returns the retrieved record from a server response parsed by
+  // `ParseResponse`, reading the LWE ciphertexts directly from the receive
+  // buffer. Only the few LinPir ciphertexts are converted to protos.
+  absl::StatusOr<std::string> RecoverRecord(
+      const HintlessPirResponseView& response,
+      const RequestState& state) const;
+
   absl::StatusOr<std::string> RecoverRecord(
-      const HintlessPirResponse& response);
+      const HintlessPirResponseView& response) const {
+    return RecoverRecord(response, state_);
+  }
+
+  // Starts a session, in which all requests reuse the same LinPir secret key
+  // and hence the same Galois key. Returns the request that uploads the Galois
+  // key to the server; the server's response must be passed to
+  // `SetSessionId()` before the following requests refer to the session.
+  absl::StatusOr<HintlessPirSessionRequest> StartSession();
+
+  // Sets the id of the session started by `StartSession()`.
+  absl::Status SetSessionId(const HintlessPirSessionResponse& response);
+
+  // Ends the session, so that the following requests include a fresh Galois
+  // key. This should be called if the server no longer has the session.
+  void EndSession() {
+    session_id_.clear();
+    session_prng_seed_linpir_sk_.clear();
+  }
+
+  bool HasSession() const { return !session_id_.empty(); }
 
  private:
   using RlweInteger = Parameters::RlweInteger;
@@ -59,52 +149,63 @@ class Client {
   using RlwePrimeModulus = rlwe::PrimeModulus<RlweModularInt>;
   using LinPirClient = linpir::Client<RlweInteger>;
 
-  // HintlessPir client state, which is cached for each request until the
-  // corresponding response is received:
-  //
-  // 1) as in SimplePIR, a pair of indices (row_idx, col_idx) representing the
-  // client's desired query index i = (row_idx * cols) + col_idx.
-  //
-  // 2) a PRNG seed expanding to the LinPir secret key for encrypting the LWE
-  // secret used by the request.
-  struct ClientState {
-    int64_t row_idx;
-    int64_t col_idx;
+  // A request missing only the LWE encrypted selection vector, together with
+  // the LWE encryption of zero under the LWE secret of the request.
+  struct RequestTemplate {
+    HintlessPirRequest request;
+    lwe::Vector ct_query_zero;
     std::string prng_seed_linpir_sk;
+    // The session in which the request was made, or empty if none.
+    std::string session_id;
   };
 
   explicit Client(
       Parameters params, absl::string_view prng_seed_lwe_query_pad,
+      std::optional<lwe::RingPad> lwe_ring_pad,
       std::vector<std::unique_ptr<const RlweRnsContext>> rlwe_contexts,
       std::vector<const RlwePrimeModulus*> rlwe_moduli,
       std::vector<std::unique_ptr<LinPirClient>> linpir_clients,
-      RlweRnsContext crt_context)
+      RlweRnsContext crt_context,
+      std::optional<internal::TwoPrimeCrtParams> two_prime_crt_params)
       : params_(std::move(params)),
         prng_seed_lwe_query_pad_(std::string(prng_seed_lwe_query_pad)),
+        lwe_ring_pad_(std::move(lwe_ring_pad)),
         rlwe_contexts_(std::move(rlwe_contexts)),
         rlwe_moduli_(std::move(rlwe_moduli)),
         linpir_clients_(std::move(linpir_clients)),
-        crt_context_(std::move(crt_context)) {}
+        crt_context_(std::move(crt_context)),
+        two_prime_crt_params_(std::move(two_prime_crt_params)) {}
 
   static std::vector<RlweInteger> EncodeLweVector(const lwe::Vector& lwe_vector,
-                                                  RlweInteger lwe_modulus,
+                                                  int log_lwe_modulus,
                                                   RlweInteger encode_modulus);
 
-  // Encrypts the LWE secret vector using LinPir clients and update `request`
-  // with the LinPir requests.
+  // Returns a request template with a fresh LWE secret.
+  absl::StatusOr<RequestTemplate> GenerateRequestTemplate() const;
+
+  // Encrypts the LWE secret vector using LinPir clients under the LinPir secret
+  // key expanded from `prng_seed_linpir_sk`, and update `request` with the
+  // LinPir requests.
   absl::Status GenerateLinPirRequestInPlace(
-      HintlessPirRequest& request, const lwe::Vector& lwe_secret) const;
+      HintlessPirRequest& request, const lwe::Vector& lwe_secret,
+      absl::string_view prng_seed_linpir_sk) const;
 
-  // CRT interpolates the LinPir responses to recover the LWE decryption parts,
-  // which are the inner products hint * LWE secrets.
-  absl::StatusOr<std::vector<lwe::Vector>> RecoverLweDecryptionParts(
-      const HintlessPirResponse& response) const;
+  // CRT interpolates the LinPir responses to recover the LWE decryption parts
+  // at `state.row_idx`, which are the inner products of the row `row_idx` of
+  // the hint with the LWE secrets, one per database shard. Only the LinPir
+  // ciphertexts holding `row_idx` are decrypted.
+  absl::StatusOr<std::vector<lwe::Integer>> RecoverLweDecryptionParts(
+      const HintlessPirResponse& response, const RequestState& state) const;
 
   const Parameters params_;
 
   // PRNG seed for generating the "A" matrix for LWE query ciphertext.
   std::string prng_seed_lwe_query_pad_;
 
+  // The "A" matrix expanded from `prng_seed_lwe_query_pad_` once, if
+  // `params_.ring_lwe_query_pad` is set, as it only holds `db_cols` integers.
+  const std::optional<lwe::RingPad> lwe_ring_pad_;
+
   const std::vector<std::unique_ptr<const RlweRnsContext>> rlwe_contexts_;
 
   // The RLWE RNS moduli common to all LinPir clients.
@@ -114,8 +215,23 @@ class Client {
 
   const RlweRnsContext crt_context_;
 
-  // Per request state.
-  ClientState state_;
+  // Constants for interpolating with 64-bit arithmetic when there are two
+  // plaintext moduli, each less than 2^31. Otherwise the interpolation is
+  // computed over 256-bit integers with `crt_context_`.
+  const std::optional<internal::TwoPrimeCrtParams> two_prime_crt_params_;
+
+  // The state of the last request returned by `GenerateRequest`.
+  RequestState state_;
+
+  // The PRNG seed of the LinPir secret key shared by all requests in the
+  // current session, and the session id assigned by the server.
+  std::string session_prng_seed_linpir_sk_;
+  std::string session_id_;
+
+  // Precomputed request templates, oldest first.
+  mutable absl::Mutex precomputed_requests_mutex_;
+  mutable std::deque<RequestTemplate> precomputed_requests_
+      ABSL_GUARDED_BY(precomputed_requests_mutex_);
 };
 
 }  // namespace hintless_simplepir
@@ -46,7 +46,7 @@ const Parameters kParameters{
     .db_cols = 32,
     .db_record_bit_size = 8,
     .lwe_secret_dim = 32,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 8,
     .lwe_error_variance = 8,
     .linpir_params =
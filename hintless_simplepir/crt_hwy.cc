@@ -0,0 +1,210 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hintless_simplepir/crt_hwy.h"
+
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "hwy/detect_targets.h"
+#include "lwe/types.h"
+#include "shell_encryption/status_macros.h"
+
+// Highway implementations.
+// clang-format off
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "hintless_simplepir/crt_hwy.cc"
+#include "hwy/foreach_target.h"  // IWYU pragma: keep
+// clang-format on
+
+// Must come after foreach_target.h to avoid redefinition errors.
+#include "hwy/highway.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace hintless_pir::hintless_simplepir::internal {
+namespace HWY_NAMESPACE {
+
+#if HWY_TARGET == HWY_SCALAR
+
+absl::Status TwoPrimeCrtLiftHwy(const TwoPrimeCrtParams& params,
+                                absl::Span<const uint64_t> x0,
+                                absl::Span<const uint64_t> x1,
+                                absl::Span<lwe::Integer> result) {
+  return TwoPrimeCrtLiftNoHwy(params, x0, x1, result);
+}
+
+#else
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+absl::Status TwoPrimeCrtLiftHwy(const TwoPrimeCrtParams& params,
+                                absl::Span<const uint64_t> x0,
+                                absl::Span<const uint64_t> x1,
+                                absl::Span<lwe::Integer> result) {
+  if (x0.size() != result.size() || x1.size() != result.size()) {
+    return absl::InvalidArgumentError(
+        "`x0`, `x1`, and `result` must have the same length.");
+  }
+
+  const hn::ScalableTag<uint64_t> d64;
+  const hn::Repartition<uint32_t, decltype(d64)> d32;
+  const hn::Rebind<lwe::Integer, decltype(d64)> d_result;
+  const int N = hn::Lanes(d64);
+
+  // Returns the 64-bit products of the low halves of the 64-bit lanes, which
+  // hold integers less than 2^32.
+  auto mul = [&](auto x, auto y) {
+    return hn::MulEven(hn::BitCast(d32, x), hn::BitCast(d32, y));
+  };
+  // Returns x mod p1 for x in [0, 2 * p1).
+  const auto p1 = hn::Set(d64, params.p1);
+  auto reduce_once = [&](auto x) { return hn::Min(x, hn::Sub(x, p1)); };
+
+  const auto p0 = hn::Set(d64, params.p0);
+  const auto p0_inv = hn::Set(d64, params.p0_inv);
+  const auto p0_inv_shoup = hn::Set(d64, params.p0_inv_shoup);
+  const auto p1_barrett = hn::Set(d64, params.p1_barrett);
+  const auto p = hn::Set(d64, params.p);
+  const auto p_half = hn::Set(d64, params.p_half);
+  const auto mask = hn::Set(d64, params.lwe_modulus_mask);
+
+  // Stores the 64-bit lanes of x as LWE integers.
+  auto store = [&](auto x, lwe::Integer* output) {
+    if constexpr (sizeof(lwe::Integer) == sizeof(uint64_t)) {
+      hn::StoreU(x, d64, output);
+    } else {
+      hn::StoreU(hn::TruncateTo(d_result, x), d_result, output);
+    }
+  };
+
+  int num_values = result.size();
+  int i = 0;
+  for (; i + N <= num_values; i += N) {
+    auto a = hn::LoadU(d64, x0.data() + i);
+    auto b = hn::LoadU(d64, x1.data() + i);
+
+    // x0 mod p1 by Barrett reduction, as x0 < p0 may exceed p1.
+    auto q = hn::ShiftRight<32>(mul(a, p1_barrett));
+    auto a_mod_p1 = reduce_once(hn::Sub(a, mul(q, p1)));
+
+    // h = (x1 - x0) * p0^-1 mod p1 by Shoup's multiplication.
+    auto diff = reduce_once(hn::Sub(hn::Add(b, p1), a_mod_p1));
+    q = hn::ShiftRight<32>(mul(diff, p0_inv_shoup));
+    auto h = reduce_once(hn::Sub(mul(diff, p0_inv), mul(q, p1)));
+
+    // x = x0 + p0 * h < p0 * p1, and its balanced representative is x - p
+    // when x > p / 2, which wraps around modulo 2^64 and so modulo the LWE
+    // modulus.
+    auto x = hn::Add(a, mul(h, p0));
+    x = hn::IfThenElse(hn::Gt(x, p_half), hn::Sub(x, p), x);
+    store(hn::And(x, mask), result.data() + i);
+  }
+
+  // Handle the remaining values that didn't take a full lane.
+  for (; i < num_values; ++i) {
+    result[i] = TwoPrimeCrtLiftValue(params, x0[i], x1[i]);
+  }
+  return absl::OkStatus();
+}
+
+#endif  // HWY_TARGET == HWY_SCALAR
+
+}  // namespace HWY_NAMESPACE
+}  // namespace hintless_pir::hintless_simplepir::internal
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE || HWY_IDE
+namespace hintless_pir::hintless_simplepir::internal {
+
+namespace {
+
+// Returns x^-1 mod `modulus` by the extended Euclidean algorithm, or error if
+// x is not invertible.
+absl::StatusOr<uint64_t> InverseMod(uint64_t x, uint64_t modulus) {
+  int64_t r0 = modulus, r1 = x % modulus;
+  int64_t s0 = 0, s1 = 1;
+  while (r1 != 0) {
+    int64_t quotient = r0 / r1;
+    int64_t r2 = r0 - quotient * r1;
+    int64_t s2 = s0 - quotient * s1;
+    r0 = r1;
+    r1 = r2;
+    s0 = s1;
+    s1 = s2;
+  }
+  if (r0 != 1) {
+    return absl::InvalidArgumentError("The moduli must be coprime.");
+  }
+  return static_cast<uint64_t>(s0 < 0 ? s0 + static_cast<int64_t>(modulus)
+                                      : s0);
+}
+
+}  // namespace
+
+absl::StatusOr<TwoPrimeCrtParams> TwoPrimeCrtParams::Create(
+    uint64_t p0, uint64_t p1, int lwe_modulus_bit_size) {
+  constexpr uint64_t kMaxModulus = uint64_t{1} << 31;
+  if (p0 < 2 || p1 < 2 || p0 >= kMaxModulus || p1 >= kMaxModulus) {
+    return absl::InvalidArgumentError(
+        "The moduli must be in the range [2, 2^31).");
+  }
+  if (lwe_modulus_bit_size <= 0 || lwe_modulus_bit_size > lwe::kIntBitwidth) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("`lwe_modulus_bit_size` must be in the range [1, ",
+                     lwe::kIntBitwidth, "]."));
+  }
+  RLWE_ASSIGN_OR_RETURN(uint64_t p0_inv, InverseMod(p0, p1));
+  uint64_t p = p0 * p1;
+  return TwoPrimeCrtParams{
+      .p0 = p0,
+      .p1 = p1,
+      .p0_inv = p0_inv,
+      .p0_inv_shoup = (p0_inv << 32) / p1,
+      .p1_barrett = (uint64_t{1} << 32) / p1,
+      .p = p,
+      .p_half = p / 2,
+      .lwe_modulus_mask = lwe_modulus_bit_size == 64
+                              ? ~uint64_t{0}
+                              : (uint64_t{1} << lwe_modulus_bit_size) - 1,
+  };
+}
+
+absl::Status TwoPrimeCrtLiftNoHwy(const TwoPrimeCrtParams& params,
+                                  absl::Span<const uint64_t> x0,
+                                  absl::Span<const uint64_t> x1,
+                                  absl::Span<lwe::Integer> result) {
+  if (x0.size() != result.size() || x1.size() != result.size()) {
+    return absl::InvalidArgumentError(
+        "`x0`, `x1`, and `result` must have the same length.");
+  }
+  for (int i = 0; i < result.size(); ++i) {
+    result[i] = TwoPrimeCrtLiftValue(params, x0[i], x1[i]);
+  }
+  return absl::OkStatus();
+}
+
+HWY_EXPORT(TwoPrimeCrtLiftHwy);
+
+absl::Status TwoPrimeCrtLift(const TwoPrimeCrtParams& params,
+                             absl::Span<const uint64_t> x0,
+                             absl::Span<const uint64_t> x1,
+                             absl::Span<lwe::Integer> result) {
+  return HWY_DYNAMIC_DISPATCH(TwoPrimeCrtLiftHwy)(params, x0, x1, result);
+}
+
+}  // namespace hintless_pir::hintless_simplepir::internal
+#endif  // HWY_ONCE || HWY_IDE
@@ -0,0 +1,81 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HINTLESS_PIR_HINTLESS_SIMPLEPIR_CRT_HWY_H_
+#define HINTLESS_PIR_HINTLESS_SIMPLEPIR_CRT_HWY_H_
+
+#include <stdint.h>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "lwe/types.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+namespace internal {
+
+// Constants to interpolate integers from their residues modulo two coprime
+// moduli p0, p1 < 2^31 by Garner's formula
+//   x = x0 + p0 * ((x1 - x0) * (p0^-1 mod p1) mod p1),
+// and to lift the balanced representative of x mod p0 * p1 to the LWE modulus
+// 2^lwe_modulus_bit_size, using only 64-bit arithmetic. The LWE modulus may be
+// up to 2^64 when lwe::Integer has 64 bits.
+struct TwoPrimeCrtParams {
+  uint64_t p0;
+  uint64_t p1;
+  uint64_t p0_inv;            // p0^-1 mod p1
+  uint64_t p0_inv_shoup;      // floor(p0_inv * 2^32 / p1)
+  uint64_t p1_barrett;        // floor(2^32 / p1)
+  uint64_t p;                 // p0 * p1
+  uint64_t p_half;            // floor(p / 2)
+  uint64_t lwe_modulus_mask;  // 2^lwe_modulus_bit_size - 1
+
+  static absl::StatusOr<TwoPrimeCrtParams> Create(uint64_t p0, uint64_t p1,
+                                                  int lwe_modulus_bit_size);
+};
+
+// Returns the interpolation of x0 mod p0 and x1 mod p1 lifted to the LWE
+// modulus, where x0 < p0 and x1 < p1.
+inline lwe::Integer TwoPrimeCrtLiftValue(const TwoPrimeCrtParams& params,
+                                         uint64_t x0, uint64_t x1) {
+  uint64_t d = (x1 + params.p1 - x0 % params.p1) % params.p1;
+  uint64_t x = x0 + params.p0 * (d * params.p0_inv % params.p1);
+  if (x > params.p_half) {
+    x -= params.p;  // wraps around to -x mod 2^64
+  }
+  return static_cast<lwe::Integer>(x & params.lwe_modulus_mask);
+}
+
+// Sets result[i] to the interpolation of x0[i] mod p0 and x1[i] mod p1 lifted
+// to the LWE modulus for 0 <= i < result.size(), where x0[i] < p0 and
+// x1[i] < p1. This replaces a generic CRT interpolation over 256-bit integers
+// followed by a modulus switching when there are two plaintext moduli.
+// This version is implemented using SIMD instructions via the highway library.
+absl::Status TwoPrimeCrtLift(const TwoPrimeCrtParams& params,
+                             absl::Span<const uint64_t> x0,
+                             absl::Span<const uint64_t> x1,
+                             absl::Span<lwe::Integer> result);
+
+// Two-prime CRT lifting implemented without using highway SIMD intrinsics.
+absl::Status TwoPrimeCrtLiftNoHwy(const TwoPrimeCrtParams& params,
+                                  absl::Span<const uint64_t> x0,
+                                  absl::Span<const uint64_t> x1,
+                                  absl::Span<lwe::Integer> result);
+
+}  // namespace internal
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_HINTLESS_SIMPLEPIR_CRT_HWY_H_
@@ -0,0 +1,144 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hintless_simplepir/crt_hwy.h"
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lwe/types.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+namespace internal {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+
+// Number of values that is not a multiple of the number of lanes.
+constexpr int kNumValues = 1027;
+
+// The plaintext moduli used by the LinPir instances in the default parameters,
+// and the largest primes allowed.
+constexpr uint64_t kT0 = 2056193;
+constexpr uint64_t kT1 = 1990657;
+constexpr uint64_t kLargeT0 = 2147483647;
+constexpr uint64_t kLargeT1 = 2147483629;
+
+// Returns x^e mod `modulus` over 128-bit integers.
+absl::uint128 PowMod(absl::uint128 x, uint64_t e, absl::uint128 modulus) {
+  absl::uint128 result = 1;
+  for (x %= modulus; e > 0; e >>= 1) {
+    if (e & 1) {
+      result = result * x % modulus;
+    }
+    x = x * x % modulus;
+  }
+  return result;
+}
+
+// Returns the interpolation of x0 mod p0 and x1 mod p1 for primes p0 and p1 by
+// the textbook CRT formula over 128-bit integers, lifted to the balanced
+// representative modulo 2^lwe_modulus_bit_size.
+lwe::Integer ExpectedLift(uint64_t p0, uint64_t p1, int lwe_modulus_bit_size,
+                          uint64_t x0, uint64_t x1) {
+  absl::uint128 p = absl::uint128{p0} * p1;
+  absl::uint128 p1_inv = PowMod(p1, p0 - 2, p0);  // p1^-1 mod p0
+  absl::uint128 p0_inv = PowMod(p0, p1 - 2, p1);  // p0^-1 mod p1
+  absl::uint128 x = (x0 * p1_inv % p0 * p1 + x1 * p0_inv % p1 * p0) % p;
+  absl::uint128 lwe_modulus = absl::uint128{1} << lwe_modulus_bit_size;
+  if (x > p / 2) {
+    // -(p - x) mod 2^lwe_modulus_bit_size
+    return static_cast<lwe::Integer>((lwe_modulus - (p - x) % lwe_modulus) %
+                                     lwe_modulus);
+  }
+  return static_cast<lwe::Integer>(x % lwe_modulus);
+}
+
+TEST(TwoPrimeCrtTest, CreateFailsIfModuliAreInvalid) {
+  EXPECT_THAT(TwoPrimeCrtParams::Create(1, kT1, 32),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TwoPrimeCrtParams::Create(kT0, uint64_t{1} << 31, 32),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TwoPrimeCrtParams::Create(kT0, kT0, 32),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TwoPrimeCrtParams::Create(6, 9, 32),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TwoPrimeCrtParams::Create(kT0, kT1, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TwoPrimeCrtParams::Create(kT0, kT1, lwe::kIntBitwidth + 1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(TwoPrimeCrtTest, FailsIfLengthsMismatch) {
+  ASSERT_OK_AND_ASSIGN(auto params, TwoPrimeCrtParams::Create(kT0, kT1, 32));
+  std::vector<uint64_t> x0(kNumValues, 0), x1(kNumValues - 1, 0);
+  std::vector<lwe::Integer> result(kNumValues);
+  EXPECT_THAT(TwoPrimeCrtLift(params, x0, x1, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TwoPrimeCrtLiftNoHwy(params, x0, x1, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+class TwoPrimeCrtLiftTest
+    : public ::testing::TestWithParam<std::tuple<uint64_t, uint64_t, int>> {};
+
+TEST_P(TwoPrimeCrtLiftTest, MatchesTextbookInterpolation) {
+  auto [p0, p1, lwe_modulus_bit_size] = GetParam();
+  ASSERT_OK_AND_ASSIGN(auto params,
+                       TwoPrimeCrtParams::Create(p0, p1, lwe_modulus_bit_size));
+
+  // Include the extreme residues around the balanced range.
+  absl::BitGen bitgen;
+  std::vector<uint64_t> x0 = {0, 0, p0 - 1, p0 - 1};
+  std::vector<uint64_t> x1 = {0, p1 - 1, 0, p1 - 1};
+  while (x0.size() < kNumValues) {
+    x0.push_back(absl::Uniform<uint64_t>(bitgen, 0, p0));
+    x1.push_back(absl::Uniform<uint64_t>(bitgen, 0, p1));
+  }
+
+  std::vector<lwe::Integer> result(kNumValues);
+  ASSERT_OK(TwoPrimeCrtLift(params, x0, x1, absl::MakeSpan(result)));
+  std::vector<lwe::Integer> expected(kNumValues);
+  ASSERT_OK(TwoPrimeCrtLiftNoHwy(params, x0, x1, absl::MakeSpan(expected)));
+  EXPECT_EQ(result, expected);
+
+  for (int i = 0; i < kNumValues; ++i) {
+    EXPECT_EQ(result[i],
+              ExpectedLift(p0, p1, lwe_modulus_bit_size, x0[i], x1[i]));
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(
+    TwoPrimeCrtLift, TwoPrimeCrtLiftTest,
+    testing::Values(std::make_tuple(kT0, kT1, lwe::kIntBitwidth),
+                    std::make_tuple(kT1, kT0, lwe::kIntBitwidth),
+                    std::make_tuple(kT0, kT1, 20),
+                    std::make_tuple(kT0, kT1, 32),
+                    std::make_tuple(kLargeT0, kLargeT1, lwe::kIntBitwidth),
+                    std::make_tuple(uint64_t{3}, uint64_t{2},
+                                    lwe::kIntBitwidth)));
+
+}  // namespace
+}  // namespace internal
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
@@ -38,7 +38,7 @@ const Parameters kParameters{
     .db_cols = 1024,
     .db_record_bit_size = 8,
     .lwe_secret_dim = 1400,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 8,
     .lwe_error_variance = 8,
     .prng_type = rlwe::PRNG_TYPE_HKDF,
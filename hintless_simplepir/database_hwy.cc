@@ -14,6 +14,7 @@
 
 #include "hintless_simplepir/database_hwy.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <cstdlib>
 #include <memory>
@@ -26,9 +27,11 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "hintless_simplepir/inner_product_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/utils.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 #include "shell_encryption/status_macros.h"
 
@@ -149,6 +152,14 @@ absl::Status Database::UpdateLweQueryPad(const lwe::Matrix* lwe_query_pad) {
   return absl::OkStatus();
 }
 
+absl::Status Database::UpdateLweRingPad(const lwe::RingPad* lwe_ring_pad) {
+  if (lwe_ring_pad == nullptr) {
+    return absl::InvalidArgumentError("`lwe_ring_pad` must not be null.");
+  }
+  lwe_ring_pad_ = lwe_ring_pad;
+  return absl::OkStatus();
+}
+
 absl::Status Database::Append(absl::string_view record) {
   if (record.size() * 8 >= params_.db_record_bit_size + 8 ||
       record.size() * 8 < params_.db_record_bit_size) {
@@ -174,6 +185,9 @@ absl::Status Database::Append(absl::string_view record) {
 }
 
 absl::Status Database::UpdateHints() {
+  if (params_.ring_lwe_query_pad) {
+    return UpdateHintsFromRingPad();
+  }
   if (lwe_query_pad_ == nullptr) {
     return absl::FailedPreconditionError("LWE query pad not set.");
   }
@@ -186,6 +200,52 @@ absl::Status Database::UpdateHints() {
   return absl::OkStatus();
 }
 
+absl::Status Database::UpdateHintsFromRingPad() {
+  if (lwe_ring_pad_ == nullptr) {
+    return absl::FailedPreconditionError("LWE ring pad not set.");
+  }
+  lwe::TransposedRingPad transposed_pad =
+      lwe::TransposedRingPad::Create(*lwe_ring_pad_);
+  int64_t num_values_per_block = sizeof(BlockType) / sizeof(lwe::PlainInteger);
+  int64_t num_blocks = DivAndRoundUp(params_.db_rows, num_values_per_block);
+  BlockType mask = (BlockType{1} << params_.lwe_plaintext_bit_size) - 1;
+  for (int i = 0; i < data_matrices_.size(); ++i) {
+    const RawMatrix& data_matrix = data_matrices_[i];
+    LweMatrix& hint_matrix = hint_matrices_[i];
+    // Each iteration unpacks the rows of the data matrix held in one block of
+    // every column, and computes their hint rows independently.
+    std::vector<absl::Status> statuses(num_blocks);
+#pragma omp parallel for
+    for (int64_t block_idx = 0; block_idx < num_blocks; ++block_idx) {
+      int64_t first_row = block_idx * num_values_per_block;
+      int64_t num_rows =
+          std::min(num_values_per_block, params_.db_rows - first_row);
+      std::vector<LweVector> rows(num_rows, LweVector(params_.db_cols));
+      for (int64_t col_idx = 0; col_idx < params_.db_cols; ++col_idx) {
+        BlockType block = data_matrix[col_idx][block_idx];
+        for (int64_t k = 0; k < num_rows; ++k) {
+          int64_t base_bits = k * 8 * sizeof(lwe::PlainInteger);
+          rows[k][col_idx] =
+              static_cast<lwe::Integer>((block >> base_bits) & mask);
+        }
+      }
+      for (int64_t k = 0; k < num_rows; ++k) {
+        LweVector& hint_row = hint_matrix[first_row + k];
+        std::fill(hint_row.begin(), hint_row.end(), 0);
+        statuses[block_idx] =
+            transposed_pad.AddProductInPlace(rows[k], absl::MakeSpan(hint_row));
+        if (!statuses[block_idx].ok()) {
+          break;
+        }
+      }
+    }
+    for (const absl::Status& status : statuses) {
+      RLWE_RETURN_IF_ERROR(status);
+    }
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<std::vector<Database::LweVector>> Database::InnerProductWith(
     const LweVector& query) const {
   std::vector<LweVector> results;
@@ -28,6 +28,7 @@
 #include "absl/types/span.h"
 #include "hintless_simplepir/inner_product_hwy.h"
 #include "hintless_simplepir/parameters.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 
 namespace hintless_pir {
@@ -55,6 +56,10 @@ class Database {
   // Sets the LWE "A" matrix used by the SimplePIR protocol.
   absl::Status UpdateLweQueryPad(const lwe::Matrix* lwe_query_pad);
 
+  // Sets the ring-structured LWE "A" matrix, from which the hints are computed
+  // when `ring_lwe_query_pad` is set in the parameters.
+  absl::Status UpdateLweRingPad(const lwe::RingPad* lwe_ring_pad);
+
   // Appends a record at the current end of the database.
   absl::Status Append(absl::string_view record);
 
@@ -86,6 +91,10 @@ class Database {
         data_matrices_(std::move(data_matrices)),
         hint_matrices_(std::move(hint_matrices)) {}
 
+  // Computes the hint matrices as the products of the transpose of the ring
+  // pad with the rows of the data matrices, using NTTs.
+  absl::Status UpdateHintsFromRingPad();
+
   // Returns the row and the column indices of the given database index to store
   // a record in the data matrices.
   std::pair<int64_t, int64_t> MatrixCoordinate(int64_t index) const {
@@ -101,6 +110,10 @@ class Database {
   // Does not own the object.
   const lwe::Matrix* lwe_query_pad_;
 
+  // The ring-structured "A" component of LWE query ciphertexts, if any.
+  // Does not own the object.
+  const lwe::RingPad* lwe_ring_pad_ = nullptr;
+
   // The number of records currently in the database.
   int64_t num_records_;
 
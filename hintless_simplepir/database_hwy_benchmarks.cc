@@ -24,10 +24,16 @@
 #include "hintless_simplepir/database_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/testing.h"
+#include "lwe/lwe_symmetric_encryption.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+#include "shell_encryption/testing/status_testing.h"
 
 ABSL_FLAG(int, num_rows, 1024, "Number of rows");
 ABSL_FLAG(int, num_cols, 1024, "Number of cols");
+ABSL_FLAG(int, lwe_secret_dim, 1024,
+          "LWE secret dimension, a power of two for the ring pad");
 
 namespace hintless_pir {
 namespace hintless_simplepir {
@@ -40,7 +46,7 @@ const Parameters kParameters{
     .db_cols = 1024,
     .db_record_bit_size = 8,
     .lwe_secret_dim = 1400,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 8,
     .lwe_error_variance = 8,
     .prng_type = rlwe::PRNG_TYPE_HKDF,
@@ -66,6 +72,48 @@ void BM_InnerProductWith(benchmark::State& state) {
 }
 BENCHMARK(BM_InnerProductWith);
 
+// Returns a random database of the dimensions given by the flags.
+std::unique_ptr<Database> CreateRandomDatabase(bool ring_lwe_query_pad) {
+  Parameters params = kParameters;
+  params.db_rows = absl::GetFlag(FLAGS_num_rows);
+  params.db_cols = absl::GetFlag(FLAGS_num_cols);
+  params.lwe_secret_dim = absl::GetFlag(FLAGS_lwe_secret_dim);
+  params.ring_lwe_query_pad = ring_lwe_query_pad;
+  return Database::CreateRandom(params).value();
+}
+
+void BM_UpdateHints(benchmark::State& state) {
+  const auto database = CreateRandomDatabase(/*ring_lwe_query_pad=*/false);
+  std::string prng_seed = rlwe::SingleThreadHkdfPrng::GenerateSeed().value();
+  auto prng = rlwe::SingleThreadHkdfPrng::Create(prng_seed).value();
+  lwe::Matrix pad = lwe::ExpandPad(absl::GetFlag(FLAGS_num_cols),
+                                   absl::GetFlag(FLAGS_lwe_secret_dim),
+                                   prng.get())
+                        .value();
+  ASSERT_OK(database->UpdateLweQueryPad(&pad));
+
+  for (auto _ : state) {
+    ASSERT_OK(database->UpdateHints());
+  }
+}
+BENCHMARK(BM_UpdateHints);
+
+void BM_UpdateHintsRingPad(benchmark::State& state) {
+  const auto database = CreateRandomDatabase(/*ring_lwe_query_pad=*/true);
+  std::string prng_seed = rlwe::SingleThreadHkdfPrng::GenerateSeed().value();
+  auto prng = rlwe::SingleThreadHkdfPrng::Create(prng_seed).value();
+  lwe::RingPad pad = lwe::RingPad::Expand(absl::GetFlag(FLAGS_num_cols),
+                                          absl::GetFlag(FLAGS_lwe_secret_dim),
+                                          prng.get())
+                         .value();
+  ASSERT_OK(database->UpdateLweRingPad(&pad));
+
+  for (auto _ : state) {
+    ASSERT_OK(database->UpdateHints());
+  }
+}
+BENCHMARK(BM_UpdateHintsRingPad);
+
 }  // namespace
 }  // namespace hintless_simplepir
 }  // namespace hintless_pir
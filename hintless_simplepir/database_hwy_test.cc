@@ -29,6 +29,7 @@
 #include "hintless_simplepir/testing.h"
 #include "hintless_simplepir/utils.h"
 #include "lwe/lwe_symmetric_encryption.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 #include "shell_encryption/testing/status_matchers.h"
 #include "shell_encryption/testing/status_testing.h"
@@ -47,7 +48,7 @@ const Parameters kParameters{
     .db_cols = 32,
     .db_record_bit_size = 16,
     .lwe_secret_dim = 32,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 7,
     .lwe_error_variance = 8,
 };
@@ -82,6 +83,13 @@ TEST(Database, SetLweQueryPadFailsWithNullPointer) {
                        HasSubstr("`lwe_query_pad` must not be null")));
 }
 
+TEST(Database, SetLweRingPadFailsWithNullPointer) {
+  ASSERT_OK_AND_ASSIGN(auto database, Database::Create(kParameters));
+  EXPECT_THAT(database->UpdateLweRingPad(/*lwe_ring_pad=*/nullptr),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("`lwe_ring_pad` must not be null")));
+}
+
 TEST_F(DatabaseTest, AppendFailsIfRecordHasIncorrectSize) {
   ASSERT_OK_AND_ASSIGN(auto database, Database::Create(kParameters));
   ASSERT_OK(database->UpdateLweQueryPad(this->lwe_query_pad_.get()));
@@ -103,7 +111,7 @@ TEST_F(DatabaseTest, AppendFailsIfDatabaseIsFull) {
       .db_cols = 2,
       .db_record_bit_size = 8,
       .lwe_secret_dim = 2,
-      .lwe_modulus_bit_size = 32,
+      .lwe_modulus_bit_size = lwe::kIntBitwidth,
       .lwe_plaintext_bit_size = 8,
       .lwe_error_variance = 8,
   };
@@ -179,6 +187,43 @@ TEST_F(DatabaseTest, UpdateHints) {
   }
 }
 
+TEST_F(DatabaseTest, UpdateHintsFailsIfLweRingPadIsNotSet) {
+  Parameters params = kParameters;
+  params.ring_lwe_query_pad = true;
+  ASSERT_OK_AND_ASSIGN(auto database, Database::Create(params));
+  ASSERT_OK(database->UpdateLweQueryPad(this->lwe_query_pad_.get()));
+  EXPECT_THAT(database->UpdateHints(),
+              StatusIs(absl::StatusCode::kFailedPrecondition,
+                       HasSubstr("LWE ring pad not set")));
+}
+
+// Checks the NTT-based hints against the dense products, with a number of
+// columns that is not a multiple of the ring dimension.
+TEST_F(DatabaseTest, UpdateHintsWithRingPad) {
+  Parameters params = kParameters;
+  params.db_cols = 80;
+  params.ring_lwe_query_pad = true;
+  ASSERT_OK_AND_ASSIGN(auto database, Database::CreateRandom(params));
+  ASSERT_OK_AND_ASSIGN(
+      lwe::RingPad ring_pad,
+      lwe::RingPad::Expand(params.db_cols, params.lwe_secret_dim,
+                           prng_.get()));
+  ASSERT_OK(database->UpdateLweRingPad(&ring_pad));
+
+  ASSERT_OK(database->UpdateHints());
+  lwe::Matrix lwe_query_pad = ring_pad.ToMatrix();
+  absl::Span<const Database::RawMatrix> data_matrices = database->Data();
+  absl::Span<const Database::LweMatrix> hint_matrices = database->Hints();
+  ASSERT_EQ(data_matrices.size(), hint_matrices.size());
+  for (int i = 0; i < data_matrices.size(); ++i) {
+    lwe::Matrix data_matrix = ExportRawMatrix(
+        data_matrices[i], params.db_rows, params.lwe_plaintext_bit_size);
+    lwe::Matrix hint_matrix = ExportLweMatrix(hint_matrices[i]).transpose();
+    lwe::Matrix expected_hint = data_matrix * lwe_query_pad;
+    EXPECT_EQ(hint_matrix, expected_hint);
+  }
+}
+
 TEST_F(DatabaseTest, AccessRecordWithInvalidIndex) {
   ASSERT_OK_AND_ASSIGN(auto database, Database::Create(kParameters));
   ASSERT_OK(database->UpdateLweQueryPad(this->lwe_query_pad_.get()));
@@ -47,7 +47,7 @@ const Parameters kParameters{
     .db_cols = 32,
     .db_record_bit_size = 16,
     .lwe_secret_dim = 32,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 7,
     .lwe_error_variance = 8,
 };
@@ -103,7 +103,7 @@ TEST_F(DatabaseTest, AppendFailsIfDatabaseIsFull) {
       .db_cols = 2,
       .db_record_bit_size = 8,
       .lwe_secret_dim = 2,
-      .lwe_modulus_bit_size = 32,
+      .lwe_modulus_bit_size = lwe::kIntBitwidth,
       .lwe_plaintext_bit_size = 8,
       .lwe_error_variance = 8,
   };
@@ -26,6 +26,7 @@
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/server.h"
 #include "linpir/parameters.h"
+#include "lwe/types.h"
 #include "shell_encryption/testing/status_testing.h"
 
 ABSL_FLAG(int, num_rows, 1024, "Number of rows");
@@ -42,7 +43,7 @@ const Parameters kParameters{
     .db_cols = 4096,
     .db_record_bit_size = 8,
     .lwe_secret_dim = 1400,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 8,
     .lwe_error_variance = 8,
     .linpir_params =
@@ -12,16 +12,27 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/time/time.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "hintless_simplepir/client.h"
 #include "hintless_simplepir/database_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/server.h"
+#include "hintless_simplepir/session_cache.h"
+#include "hintless_simplepir/utils.h"
 #include "linpir/parameters.h"
+#include "lwe/counter_prng.h"
+#include "lwe/types.h"
 #include "shell_encryption/testing/status_testing.h"
 
 namespace hintless_pir {
@@ -29,13 +40,14 @@ namespace hintless_simplepir {
 namespace {
 
 using RlweInteger = Parameters::RlweInteger;
+using rlwe::testing::StatusIs;
 
 const Parameters kParameters{
     .db_rows = 8,
     .db_cols = 8,
     .db_record_bit_size = 16,
     .lwe_secret_dim = 1400,
-    .lwe_modulus_bit_size = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
     .lwe_plaintext_bit_size = 8,
     .lwe_error_variance = 8,
     .linpir_params =
@@ -100,6 +112,401 @@ TEST(HintlessSimplePir, EndToEndTestWithChaChaPrng) {
   EXPECT_EQ(record, expected);
 }
 
+TEST(HintlessSimplePir, EndToEndTestWithRoundedAnswers) {
+  // Let the server round and bit-pack the LWE answer vectors.
+  Parameters params = kParameters;
+  ASSERT_OK_AND_ASSIGN(params.lwe_answer_bit_size,
+                       ChooseLweAnswerBitSize(params));
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and issue request.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+
+  // Handle the request, and check that the answers are compressed.
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  for (auto const& ct_record : response.ct_records()) {
+    EXPECT_EQ(LweCiphertextCoeffs(ct_record).size(), 0);
+    EXPECT_EQ(ct_record.packed_bit_size(), params.lwe_answer_bit_size);
+  }
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithBabyStepGiantStep) {
+  // Let the LinPIR servers rotate the query with baby-step giant-step.
+  Parameters params = kParameters;
+  params.linpir_params.baby_step_size = 32;
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and issue request, which includes the giant-step key.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+  EXPECT_EQ(request.linpir_gk_giant_step_bs_size(),
+            request.linpir_gk_bs_size());
+
+  // Handle the request
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithFoldedBlocks) {
+  // Let the LinPIR servers fold their blocks into fewer ciphertexts.
+  Parameters params = kParameters;
+  params.linpir_params.fold_blocks = true;
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and issue request, which includes the fold key.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+  EXPECT_EQ(request.linpir_gk_fold_bs_size(), request.linpir_gk_bs_size());
+
+  // Handle the request
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, HandleRequestFailsIfGiantStepOrFoldKeyIsMissing) {
+  Parameters params = kParameters;
+  params.linpir_params.baby_step_size = 32;
+  params.linpir_params.fold_blocks = true;
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+
+  // The server must reject the request rather than abort.
+  HintlessPirRequest request_without_giant_step_key = request;
+  request_without_giant_step_key.clear_linpir_gk_giant_step_bs();
+  EXPECT_THAT(server->HandleRequest(request_without_giant_step_key),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  HintlessPirRequest request_without_fold_key = request;
+  request_without_fold_key.clear_linpir_gk_fold_bs();
+  EXPECT_THAT(server->HandleRequest(request_without_fold_key),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_OK(server->HandleRequest(request).status());
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithPackedShards) {
+  // Stack the hints of all shards into one LinPIR database.
+  Parameters params = kParameters;
+  params.pack_linpir_shards = true;
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and issue request.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+
+  // Handle the request, which has one LinPIR result per plaintext modulus.
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  for (auto const& linpir_response : response.linpir_responses()) {
+    EXPECT_EQ(linpir_response.ct_inner_products_size(), 1);
+  }
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithCounterModeLweQueryPad) {
+  // Expand the LWE query pad in counter mode.
+  Parameters params = kParameters;
+  params.counter_mode_lwe_query_pad = true;
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and issue request.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+
+  // Handle the request
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithRingLweQueryPad) {
+  // Use a ring-structured LWE query pad, whose dimension is a power of two.
+  Parameters params = kParameters;
+  params.lwe_secret_dim = 1024;
+  params.ring_lwe_query_pad = true;
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and issue request.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+
+  // Handle the request
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EmptySessionIdIsHandledWithoutSession) {
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(kParameters));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // An explicitly empty session id is treated as a request with Galois keys,
+  // as it is by the wire format.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(kParameters, public_params));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+  request.set_session_id("");
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithAesCtrQueryPads) {
+  // Expand both the LWE and the LinPir query pads by AES-CTR.
+  Parameters params = kParameters;
+  params.counter_mode_lwe_query_pad = true;
+  params.counter_prng_cipher = lwe::CounterPrngCipher::kAes256Ctr;
+  params.linpir_params.counter_mode_query_pads = true;
+  params.linpir_params.counter_prng_cipher =
+      lwe::CounterPrngCipher::kAes256Ctr;
+
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(params));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // A request with the server's LinPir query pads.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(params, public_params));
+  const Database* database = server->GetDatabase();
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(1));
+  EXPECT_EQ(record, expected);
+
+  // A request in a session, with fresh LinPir query pads.
+  ASSERT_OK_AND_ASSIGN(auto session_request, client->StartSession());
+  ASSERT_OK_AND_ASSIGN(auto session_response,
+                       server->CreateSession(session_request));
+  ASSERT_OK(client->SetSessionId(session_response));
+  ASSERT_OK_AND_ASSIGN(request, client->GenerateRequest(5));
+  ASSERT_OK_AND_ASSIGN(response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(record, client->RecoverRecord(response));
+  ASSERT_OK_AND_ASSIGN(expected, database->Record(5));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithSession) {
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(kParameters));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and register its Galois key with the server.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(kParameters, public_params));
+  ASSERT_OK_AND_ASSIGN(auto session_request, client->StartSession());
+  ASSERT_OK_AND_ASSIGN(auto session_response,
+                       server->CreateSession(session_request));
+  ASSERT_OK(client->SetSessionId(session_response));
+
+  // Multiple requests in the same session without Galois keys.
+  const Database* database = server->GetDatabase();
+  for (int64_t index : {1, 5, 1}) {
+    ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(index));
+    EXPECT_EQ(request.linpir_gk_bs_size(), 0);
+    ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+    ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+    ASSERT_OK_AND_ASSIGN(auto expected, database->Record(index));
+    EXPECT_EQ(record, expected);
+  }
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithPrecomputedRequests) {
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(kParameters));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // Create a client and precompute two request templates.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(kParameters, public_params));
+  EXPECT_THAT(client->PrecomputeRequests(-1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  ASSERT_OK(client->PrecomputeRequests(2));
+  EXPECT_EQ(client->NumPrecomputedRequests(), 2);
+
+  // The last request is generated after the templates have been used up.
+  const Database* database = server->GetDatabase();
+  int num_precomputed_requests = 2;
+  for (int64_t index : {1, 63, 5}) {
+    ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(index));
+    num_precomputed_requests = std::max(num_precomputed_requests - 1, 0);
+    EXPECT_EQ(client->NumPrecomputedRequests(), num_precomputed_requests);
+    ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+    ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+    ASSERT_OK_AND_ASSIGN(auto expected, database->Record(index));
+    EXPECT_EQ(record, expected);
+  }
+
+  // Templates made before a session started are not used in the session.
+  ASSERT_OK(client->PrecomputeRequests(1));
+  ASSERT_OK_AND_ASSIGN(auto session_request, client->StartSession());
+  ASSERT_OK_AND_ASSIGN(auto session_response,
+                       server->CreateSession(session_request));
+  ASSERT_OK(client->SetSessionId(session_response));
+  ASSERT_OK(client->PrecomputeRequests(1));
+  EXPECT_EQ(client->NumPrecomputedRequests(), 2);
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(7));
+  EXPECT_EQ(client->NumPrecomputedRequests(), 0);
+  EXPECT_EQ(request.linpir_gk_bs_size(), 0);
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+  ASSERT_OK_AND_ASSIGN(auto expected, database->Record(7));
+  EXPECT_EQ(record, expected);
+}
+
+TEST(HintlessSimplePir, EndToEndTestWithOutstandingRequests) {
+  // Create server and fill in random database records.
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(kParameters));
+
+  // Preprocess the server and get public parameters.
+  ASSERT_OK(server->Preprocess());
+  auto public_params = server->GetPublicParams();
+
+  // A single client with several requests in flight, generated concurrently.
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(kParameters, public_params));
+  const std::vector<int64_t> indices = {1, 63, 5, 1};
+  std::vector<absl::StatusOr<Client::PendingRequest>> pending_requests(
+      indices.size());
+  std::vector<std::thread> threads;
+  for (int i = 0; i < indices.size(); ++i) {
+    threads.emplace_back([&, i]() {
+      pending_requests[i] = client->GeneratePendingRequest(indices[i]);
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  std::vector<HintlessPirResponse> responses;
+  for (auto const& pending_request : pending_requests) {
+    ASSERT_OK(pending_request);
+    ASSERT_OK_AND_ASSIGN(responses.emplace_back(),
+                         server->HandleRequest(pending_request->request));
+  }
+
+  // Recover the records in reverse order.
+  const Database* database = server->GetDatabase();
+  for (int i = indices.size() - 1; i >= 0; --i) {
+    ASSERT_OK_AND_ASSIGN(
+        auto record,
+        client->RecoverRecord(responses[i], pending_requests[i]->state));
+    ASSERT_OK_AND_ASSIGN(auto expected, database->Record(indices[i]));
+    EXPECT_EQ(record, expected);
+  }
+
+  // A response cannot be recovered without the state of its request.
+  EXPECT_THAT(client->RecoverRecord(responses[0], Client::RequestState{}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(HintlessSimplePir, RequestFailsIfSessionExpired) {
+  ASSERT_OK_AND_ASSIGN(auto server,
+                       Server::CreateWithRandomDatabaseRecords(kParameters));
+  ASSERT_OK(server->Preprocess());
+  server->SetSessionOptions(SessionOptions{.ttl = absl::ZeroDuration()});
+  auto public_params = server->GetPublicParams();
+
+  ASSERT_OK_AND_ASSIGN(auto client, Client::Create(kParameters, public_params));
+  ASSERT_OK_AND_ASSIGN(auto session_request, client->StartSession());
+  ASSERT_OK_AND_ASSIGN(auto session_response,
+                       server->CreateSession(session_request));
+  ASSERT_OK(client->SetSessionId(session_response));
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(1));
+  EXPECT_THAT(server->HandleRequest(request),
+              StatusIs(absl::StatusCode::kNotFound));
+
+  // Without the session the client falls back to sending its Galois key.
+  client->EndSession();
+  ASSERT_OK_AND_ASSIGN(request, client->GenerateRequest(1));
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  ASSERT_OK_AND_ASSIGN(auto record, client->RecoverRecord(response));
+  ASSERT_OK_AND_ASSIGN(auto expected, server->GetDatabase()->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
 }  // namespace
 }  // namespace hintless_simplepir
 }  // namespace hintless_pir
@@ -61,15 +61,17 @@ absl::StatusOr<std::vector<lwe::Integer>> InnerProductHwy(
   }
 
   // Vector type used throughout this function: Largest byte vector
-  // available.
-  const hn::ScalableTag<lwe::Integer> d32;
+  // available. The products are accumulated in lanes of lwe::Integer, i.e. in
+  // 64-bit lanes when the LWE modulus is 2^64.
+  const hn::ScalableTag<lwe::Integer> d_lwe;
   const hn::Rebind<PlainInteger, hn::ScalableTag<lwe::Integer>> d_plain;
-  const int N = hn::Lanes(d32);
+  const int N = hn::Lanes(d_lwe);
+  const int num_bytes = N * sizeof(lwe::Integer);
 
   // Do not run the highway version if
   // - the number of bytes in a hwy vector is less than 16, or
   // - the number of bytes in a hwy vector is not a multiple of 16.
-  if (ABSL_PREDICT_FALSE(N < 4 || N % 4 != 0)) {
+  if (ABSL_PREDICT_FALSE(num_bytes < 16 || num_bytes % 16 != 0)) {
     return InnerProductNoHwy<PlainInteger>(matrix, vec);
   }
 
@@ -86,74 +88,67 @@ absl::StatusOr<std::vector<lwe::Integer>> InnerProductHwy(
 
   for (int j = 0; j < vec.size(); ++j) {
     int row_idx = 0;
-    const PlainInteger* value_ptr = 0;
+    // The blocks of a column are contiguous, so the values of its rows are
+    // stored one after another. A 4x step may end in the middle of a block
+    // when the vectors hold fewer than 16 values.
+    const PlainInteger* column =
+        reinterpret_cast<const PlainInteger*>(matrix[j].data());
+    const PlainInteger* value_ptr = nullptr;
     // First, run 4x SIMD multiplication in each iteration.
     for (; row_idx + N * 4 <= num_rows; row_idx += N * 4) {
-      if (row_idx % num_values_per_block == 0) {
-        int block_idx = row_idx / num_values_per_block;
-        value_ptr =
-            reinterpret_cast<const PlainInteger*>(&matrix[j][block_idx]);
-      } else {
-        value_ptr += N;
-      }
+      value_ptr = column + row_idx;
       lwe::Integer* result_ptr = &aligned_results[row_idx];
-      auto add32_0 = hn::Load(d32, result_ptr);
-      auto add32_1 = hn::Load(d32, result_ptr + N);
-      auto add32_2 = hn::Load(d32, result_ptr + 2 * N);
-      auto add32_3 = hn::Load(d32, result_ptr + 3 * N);
+      auto add_lwe_0 = hn::Load(d_lwe, result_ptr);
+      auto add_lwe_1 = hn::Load(d_lwe, result_ptr + N);
+      auto add_lwe_2 = hn::Load(d_lwe, result_ptr + 2 * N);
+      auto add_lwe_3 = hn::Load(d_lwe, result_ptr + 3 * N);
 
       auto left0 = hn::LoadU(d_plain, value_ptr);
       auto left1 = hn::LoadU(d_plain, value_ptr + N);
       auto left2 = hn::LoadU(d_plain, value_ptr + 2 * N);
       auto left3 = hn::LoadU(d_plain, value_ptr + 3 * N);
 
-      auto left32_0 = hn::PromoteTo(d32, left0);
-      auto left32_1 = hn::PromoteTo(d32, left1);
-      auto left32_2 = hn::PromoteTo(d32, left2);
-      auto left32_3 = hn::PromoteTo(d32, left3);
+      auto left_lwe_0 = hn::PromoteTo(d_lwe, left0);
+      auto left_lwe_1 = hn::PromoteTo(d_lwe, left1);
+      auto left_lwe_2 = hn::PromoteTo(d_lwe, left2);
+      auto left_lwe_3 = hn::PromoteTo(d_lwe, left3);
 
-      auto right32 = hn::Set(d32, vec[j]);
+      auto right_lwe = hn::Set(d_lwe, vec[j]);
 
-      auto mul32_0 = hn::MulAdd(left32_0, right32, add32_0);
-      auto mul32_1 = hn::MulAdd(left32_1, right32, add32_1);
-      auto mul32_2 = hn::MulAdd(left32_2, right32, add32_2);
-      auto mul32_3 = hn::MulAdd(left32_3, right32, add32_3);
+      auto mul_lwe_0 = hn::MulAdd(left_lwe_0, right_lwe, add_lwe_0);
+      auto mul_lwe_1 = hn::MulAdd(left_lwe_1, right_lwe, add_lwe_1);
+      auto mul_lwe_2 = hn::MulAdd(left_lwe_2, right_lwe, add_lwe_2);
+      auto mul_lwe_3 = hn::MulAdd(left_lwe_3, right_lwe, add_lwe_3);
 
-      hn::Store(mul32_0, d32, result_ptr);
-      hn::Store(mul32_1, d32, result_ptr + N);
-      hn::Store(mul32_2, d32, result_ptr + 2 * N);
-      hn::Store(mul32_3, d32, result_ptr + 3 * N);
+      hn::Store(mul_lwe_0, d_lwe, result_ptr);
+      hn::Store(mul_lwe_1, d_lwe, result_ptr + N);
+      hn::Store(mul_lwe_2, d_lwe, result_ptr + 2 * N);
+      hn::Store(mul_lwe_3, d_lwe, result_ptr + 3 * N);
     }
 
     // Next, run 1x per iteration.
     for (; row_idx + N <= num_rows; row_idx += N) {
-      if (row_idx % num_values_per_block == 0) {
-        int block_idx = row_idx / num_values_per_block;
-        value_ptr =
-            reinterpret_cast<const PlainInteger*>(&matrix[j][block_idx]);
-      } else {
-        value_ptr += N;
-      }
+      value_ptr = column + row_idx;
       lwe::Integer* result_ptr = &aligned_results[row_idx];
-      auto add32 = hn::Load(d32, result_ptr);
+      auto add_lwe = hn::Load(d_lwe, result_ptr);
       auto left = hn::LoadU(d_plain, value_ptr);
-      auto left32 = hn::PromoteTo(d32, left);
-      auto right32 = hn::Set(d32, vec[j]);
-      auto mul32 = hn::MulAdd(left32, right32, add32);
-      hn::Store(mul32, d32, result_ptr);
+      auto left_lwe = hn::PromoteTo(d_lwe, left);
+      auto right_lwe = hn::Set(d_lwe, vec[j]);
+      auto mul_lwe = hn::MulAdd(left_lwe, right_lwe, add_lwe);
+      hn::Store(mul_lwe, d_lwe, result_ptr);
     }
 
     // Handle the remaining rows that didn't take a full lane.
     if (row_idx < num_rows) {
       int block_idx = row_idx / num_values_per_block;
-      const lwe::PlainInteger* block_as_values =
-          reinterpret_cast<const lwe::PlainInteger*>(&matrix[j][block_idx]);
+      const PlainInteger* block_as_values =
+          reinterpret_cast<const PlainInteger*>(&matrix[j][block_idx]);
       for (; row_idx < num_rows; ++row_idx) {
         if (row_idx % num_values_per_block == 0) {
           // update the block pointer, which should be rate
           block_idx = row_idx / num_values_per_block;
           block_as_values =
-              reinterpret_cast<const lwe::PlainInteger*>(&matrix[j][block_idx]);
+              reinterpret_cast<const PlainInteger*>(&matrix[j][block_idx]);
         }
         int block_pos = row_idx % num_values_per_block;
         aligned_results.get()[row_idx] +=
@@ -183,20 +178,19 @@ absl::StatusOr<std::vector<lwe::Integer>> InnerProductNoHwy(
         "`matrix` and `vec` must have matching dimensions.");
   }
 
-  constexpr int num_values_per_block =
-      sizeof(BlockType) / sizeof(lwe::PlainInteger);
+  constexpr int num_values_per_block = sizeof(BlockType) / sizeof(PlainInteger);
 
   // Assume all columns have the same size.
   int num_blocks = matrix[0].size();
-  int num_rows = num_blocks * sizeof(BlockType);
+  int num_rows = num_blocks * num_values_per_block;
 
   std::vector<lwe::Integer> result(num_rows, 0);
   for (int j = 0; j < vec.size(); ++j) {
     int i = 0;
     for (int block_idx = 0; block_idx < num_blocks; ++block_idx) {
       BlockType block = matrix[j][block_idx];
-      const lwe::PlainInteger* block_as_values =
-          reinterpret_cast<const lwe::PlainInteger*>(&block);
+      const PlainInteger* block_as_values =
+          reinterpret_cast<const PlainInteger*>(&block);
       for (int block_pos = 0; block_pos < num_values_per_block && i < num_rows;
            ++block_pos, ++i) {
         result[i] +=
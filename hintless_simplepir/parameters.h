@@ -19,6 +19,7 @@
 #include <cstdint>
 
 #include "linpir/parameters.h"
+#include "lwe/counter_prng.h"
 #include "lwe/types.h"
 #include "shell_encryption/serialization.pb.h"
 
@@ -35,13 +36,52 @@ struct Parameters {
   int db_record_bit_size;
 
   int lwe_secret_dim;
-  int lwe_modulus_bit_size;  // 32 or 64
+  // The LWE modulus is 2^lwe_modulus_bit_size, which must be equal to
+  // lwe::kIntBitwidth, i.e. 32, or 64 when built with `--config=lwe64`.
+  // Note that this breaks existing parameters: other values, which used to be
+  // accepted, are now rejected by `Server::Create()`.
+  int lwe_modulus_bit_size;
   int lwe_plaintext_bit_size;
   double lwe_error_variance;
 
   linpir::RlweParameters<RlweInteger> linpir_params;
 
   rlwe::PrngType prng_type;
+
+  // If positive, the server rounds the LWE answer vectors from the LWE modulus
+  // to the modulus 2^lwe_answer_bit_size before bit-packing them in the
+  // response. Must be larger than `lwe_plaintext_bit_size`; see
+  // `ChooseLweAnswerBitSize()` in utils.h for a safe choice. 0 disables it.
+  int lwe_answer_bit_size = 0;
+
+  // If true, the hints of all shards are stacked into a single LinPIR database
+  // per plaintext modulus, instead of one database per shard. The shards then
+  // share blocks, so only the last block of the stacked hints is padded with
+  // zero rows, which saves up to one block of inner products and response
+  // ciphertexts per shard when `db_rows` is not a multiple of
+  // `linpir_params.rows_per_block`.
+  bool pack_linpir_shards = false;
+
+  // If true, the LWE query pad "A" is expanded from its seed by
+  // `lwe::CounterPrng` instead of the PRNG selected by `prng_type`. Its rows
+  // can then be expanded independently, so the server expands the pad in
+  // parallel, and the client expands each row in bulk while encrypting.
+  bool counter_mode_lwe_query_pad = false;
+
+  // The stream cipher of the counter-mode PRNG expanding the LWE query pad.
+  // `lwe::CounterPrngCipher::kAes256Ctr` runs on the AES instructions of the
+  // CPU when available. The LinPIR query pads are configured separately in
+  // `linpir_params`.
+  lwe::CounterPrngCipher counter_prng_cipher =
+      lwe::CounterPrngCipher::kChaCha20;
+
+  // If true, the LWE query pad "A" is a `lwe::RingPad`: its blocks of
+  // `lwe_secret_dim` rows are negacyclic matrices of polynomials expanded from
+  // the seed, so the server computes the hints with NTTs in
+  // O(db_rows * db_cols * log(lwe_secret_dim)) instead of
+  // O(db_rows * db_cols * lwe_secret_dim). Security then relies on Ring-LWE,
+  // and `lwe_secret_dim` must be a power of two.
+  bool ring_lwe_query_pad = false;
 };
 
 }  // namespace hintless_simplepir
@@ -26,12 +26,17 @@
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/string_view.h"
 #include "hintless_simplepir/database_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/serialization.pb.h"
 #include "hintless_simplepir/utils.h"
+#include "hintless_simplepir/wire_format.h"
+#include "linpir/query_pad_prng.h"
+#include "lwe/counter_prng.h"
 #include "lwe/lwe_symmetric_encryption.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 #include "shell_encryption/prng/single_thread_chacha_prng.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
@@ -51,11 +56,35 @@ inline absl::Status CheckForValidPrngType(const Parameters& params) {
   return absl::OkStatus();
 }
 
+// Returns an error if the LWE modulus in `params` is not 2^lwe::kIntBitwidth,
+// which is the modulus of the arithmetic over LWE integers.
+inline absl::Status CheckForValidLweModulus(const Parameters& params) {
+  if (params.lwe_modulus_bit_size != lwe::kIntBitwidth) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("`lwe_modulus_bit_size` must be ", lwe::kIntBitwidth,
+                     " for the LWE integer type of this build."));
+  }
+  return absl::OkStatus();
+}
+
+// Returns an error if `params` sets an invalid bit size for LWE answers.
+inline absl::Status CheckForValidAnswerBitSize(const Parameters& params) {
+  if (params.lwe_answer_bit_size != 0 &&
+      (params.lwe_answer_bit_size <= params.lwe_plaintext_bit_size ||
+       params.lwe_answer_bit_size > params.lwe_modulus_bit_size)) {
+    return absl::InvalidArgumentError(
+        "Invalid `lwe_answer_bit_size` in `params`.");
+  }
+  return absl::OkStatus();
+}
+
 }  // namespace
 
 absl::StatusOr<std::unique_ptr<Server>> Server::Create(
     const Parameters& params) {
   RLWE_RETURN_IF_ERROR(CheckForValidPrngType(params));
+  RLWE_RETURN_IF_ERROR(CheckForValidLweModulus(params));
+  RLWE_RETURN_IF_ERROR(CheckForValidAnswerBitSize(params));
 
   // Create RLWE contexts, one per plaintext modulus in `ts`.
   auto const& rlwe_params = params.linpir_params;
@@ -81,6 +110,8 @@ absl::StatusOr<std::unique_ptr<Server>> Server::Create(
 absl::StatusOr<std::unique_ptr<Server>> Server::CreateWithRandomDatabaseRecords(
     const Parameters& params) {
   RLWE_RETURN_IF_ERROR(CheckForValidPrngType(params));
+  RLWE_RETURN_IF_ERROR(CheckForValidLweModulus(params));
+  RLWE_RETURN_IF_ERROR(CheckForValidAnswerBitSize(params));
 
   // Create RLWE contexts, one per plaintext modulus in `ts`.
   auto const& rlwe_params = params.linpir_params;
@@ -117,13 +148,6 @@ absl::Status Server::GeneratePublicParams() {
     }
     RLWE_ASSIGN_OR_RETURN(prng_seed_linpir_gk_pad_,
                           rlwe::SingleThreadHkdfPrng::GenerateSeed());
-    // Generate the LWE "A" matrix.
-    RLWE_ASSIGN_OR_RETURN(auto prng, rlwe::SingleThreadHkdfPrng::Create(
-                                         prng_seed_lwe_query_pad_));
-    RLWE_ASSIGN_OR_RETURN(
-        auto pad,
-        lwe::ExpandPad(params_.db_cols, params_.lwe_secret_dim, prng.get()));
-    lwe_query_pad_ = std::make_unique<const lwe::Matrix>(std::move(pad));
   } else {
     RLWE_ASSIGN_OR_RETURN(prng_seed_lwe_query_pad_,
                           rlwe::SingleThreadChaChaPrng::GenerateSeed());
@@ -135,25 +159,59 @@ absl::Status Server::GeneratePublicParams() {
     }
     RLWE_ASSIGN_OR_RETURN(prng_seed_linpir_gk_pad_,
                           rlwe::SingleThreadChaChaPrng::GenerateSeed());
+  }
+
+  if (params_.linpir_params.counter_mode_query_pads) {
+    for (std::string& prng_seed : prng_seed_linpir_ct_pads_) {
+      RLWE_ASSIGN_OR_RETURN(
+          prng_seed, linpir::GenerateQueryPadPrngSeed(params_.linpir_params));
+    }
+  }
+
+  if (params_.counter_mode_lwe_query_pad) {
+    RLWE_ASSIGN_OR_RETURN(prng_seed_lwe_query_pad_,
+                          lwe::CounterPrng::GenerateSeed());
+  }
 
+  // Generate the LWE "A" matrix.
+  lwe::Matrix pad;
+  lwe_ring_pad_.reset();
+  if (params_.ring_lwe_query_pad) {
+    RLWE_ASSIGN_OR_RETURN(lwe::RingPad ring_pad,
+                          ExpandLweRingPad(params_, prng_seed_lwe_query_pad_));
+    pad = ring_pad.ToMatrix();
+    lwe_ring_pad_ = std::make_unique<const lwe::RingPad>(std::move(ring_pad));
+  } else if (params_.counter_mode_lwe_query_pad) {
+    RLWE_ASSIGN_OR_RETURN(
+        auto prng, lwe::CounterPrng::Create(prng_seed_lwe_query_pad_,
+                                            params_.counter_prng_cipher));
+    RLWE_ASSIGN_OR_RETURN(pad, lwe::ExpandPadInParallel(
+                                   params_.db_cols, params_.lwe_secret_dim,
+                                   *prng));
+  } else if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(auto prng, rlwe::SingleThreadHkdfPrng::Create(
+                                         prng_seed_lwe_query_pad_));
+    RLWE_ASSIGN_OR_RETURN(
+        pad,
+        lwe::ExpandPad(params_.db_cols, params_.lwe_secret_dim, prng.get()));
+  } else {
     RLWE_ASSIGN_OR_RETURN(auto prng, rlwe::SingleThreadChaChaPrng::Create(
                                          prng_seed_lwe_query_pad_));
     RLWE_ASSIGN_OR_RETURN(
-        auto pad,
+        pad,
         lwe::ExpandPad(params_.db_cols, params_.lwe_secret_dim, prng.get()));
-    lwe_query_pad_ = std::make_unique<const lwe::Matrix>(std::move(pad));
   }
+  lwe_query_pad_ = std::make_unique<const lwe::Matrix>(std::move(pad));
   return absl::OkStatus();
 }
 
 namespace {
 
-// Given `matrix` with mod-q entries, returns `matrix` mod p, where modular
-// numbers are in balanced representation.
+// Given `matrix` with mod-q entries for q = 2^`log_q`, returns `matrix` mod p,
+// where modular numbers are in balanced representation.
 template <typename Integer>
 std::vector<std::vector<Integer>> EncodeLweMatrix(
-    const Database::LweMatrix& matrix, Integer q, Integer p) {
-  Integer q_half = q >> 1;
+    const Database::LweMatrix& matrix, int log_q, Integer p) {
   int num_rows = matrix.size();
   int num_cols = matrix[0].size();
   std::vector<std::vector<Integer>> matrix_mod_p(num_rows);
@@ -161,7 +219,7 @@ std::vector<std::vector<Integer>> EncodeLweMatrix(
     matrix_mod_p[i].reserve(num_cols);
     for (int j = 0; j < num_cols; ++j) {
       Integer x = static_cast<Integer>(matrix[i][j]);
-      matrix_mod_p[i].push_back(ConvertModulus(x, q, p, q_half));
+      matrix_mod_p[i].push_back(ConvertPowerOfTwoModulus(x, log_q, p));
     }
   }
   return matrix_mod_p;
@@ -170,14 +228,17 @@ std::vector<std::vector<Integer>> EncodeLweMatrix(
 }  // namespace
 
 absl::Status Server::Preprocess() {
-  // Refresh the PRNG seeds.
+  // Refresh the PRNG seeds, which invalidates the Galois keys of all sessions.
   RLWE_RETURN_IF_ERROR(GeneratePublicParams());
+  sessions_.Clear();
 
   // Make sure the hint is up to date.
   RLWE_RETURN_IF_ERROR(database_->UpdateLweQueryPad(lwe_query_pad_.get()));
+  if (lwe_ring_pad_ != nullptr) {
+    RLWE_RETURN_IF_ERROR(database_->UpdateLweRingPad(lwe_ring_pad_.get()));
+  }
   RLWE_RETURN_IF_ERROR(database_->UpdateHints());
 
-  RlweInteger lwe_modulus = RlweInteger{1} << params_.lwe_modulus_bit_size;
   size_t num_shards = database_->NumShards();
 
   // Create LinPir databases (holding the preprocessed hints) and servers.
@@ -188,18 +249,33 @@ absl::Status Server::Preprocess() {
   for (int k = 0; k < rlwe_contexts_.size(); ++k) {
     RlweInteger plaintext_modulus = rlwe_contexts_[k]->PlaintextModulus();
 
-    // One LinPir database per shard, for the current plaintext modulus.
+    // One LinPir database per shard, for the current plaintext modulus, or a
+    // single one holding the hints of all shards one after another.
     std::vector<std::unique_ptr<LinPirDatabase>> linpir_databases_mod_tk;
     linpir_databases_mod_tk.reserve(num_shards);
+    std::vector<std::vector<RlweInteger>> packed_hints_mod_tk;
     for (const Database::LweMatrix& hint : database_->Hints()) {
       std::vector<std::vector<RlweInteger>> hint_mod_tk =
-          EncodeLweMatrix(hint, lwe_modulus, plaintext_modulus);
+          EncodeLweMatrix(hint, params_.lwe_modulus_bit_size,
+                          plaintext_modulus);
+      if (params_.pack_linpir_shards) {
+        std::move(hint_mod_tk.begin(), hint_mod_tk.end(),
+                  std::back_inserter(packed_hints_mod_tk));
+        continue;
+      }
       RLWE_ASSIGN_OR_RETURN(
           auto linpir_database,
           LinPirDatabase::Create(params_.linpir_params, rlwe_contexts_[k].get(),
                                  hint_mod_tk));
       linpir_databases_mod_tk.push_back(std::move(linpir_database));
     }
+    if (params_.pack_linpir_shards) {
+      RLWE_ASSIGN_OR_RETURN(
+          auto linpir_database,
+          LinPirDatabase::Create(params_.linpir_params, rlwe_contexts_[k].get(),
+                                 packed_hints_mod_tk));
+      linpir_databases_mod_tk.push_back(std::move(linpir_database));
+    }
     std::vector<LinPirDatabase*> linpir_databases_ptrs;
     std::transform(linpir_databases_mod_tk.begin(),
                    linpir_databases_mod_tk.end(),
@@ -228,13 +304,8 @@ absl::StatusOr<HintlessPirResponse> Server::HandleRequest(
 
   HintlessPirResponse response;
   // Handle the LWE part of the request.
-  Database::LweVector ct_query_vector =
-      DeserializeLweCiphertext(request.ct_query_vector());
-  RLWE_ASSIGN_OR_RETURN(std::vector<Database::LweVector> ct_records,
-                        database_->InnerProductWith(ct_query_vector));
-  for (auto& ct_record : ct_records) {
-    *response.add_ct_records() = SerializeLweCiphertext(ct_record);
-  }
+  RLWE_RETURN_IF_ERROR(AnswerLweQuery(
+      DeserializeLweCiphertext(request.ct_query_vector()), response));
 
   // Handle the LinPIR requests.
   int num_linpir_requests = request.linpir_ct_bs_size();
@@ -243,17 +314,156 @@ absl::StatusOr<HintlessPirResponse> Server::HandleRequest(
         "`request` contains unexpected number of LinPir requests.");
   }
 
+  std::shared_ptr<const std::vector<LinPirGaloisKey>> gks;
+  if (!request.session_id().empty()) {
+    if (request.prng_seed_linpir_ct_pads_size() != num_linpir_requests) {
+      return absl::InvalidArgumentError(
+          "`request` contains incorrect number of PRNG seeds.");
+    }
+    RLWE_ASSIGN_OR_RETURN(gks, sessions_.Lookup(request.session_id()));
+  }
+
+  std::vector<absl::StatusOr<LinPirResponse>> answers(num_linpir_requests);
+#pragma omp parallel for
+  for (int k = 0; k < num_linpir_requests; ++k) {
+    answers[k] = HandleLinPirRequest(k, request, gks.get());
+  }
+  for (auto& answer : answers) {
+    RLWE_ASSIGN_OR_RETURN(*response.add_linpir_responses(), std::move(answer));
+  }
+  return response;
+}
+
+absl::StatusOr<HintlessPirResponse> Server::HandleRequest(
+    const HintlessPirRequestView& request) {
+  if (!IsPreprocessed()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
+
+  HintlessPirResponse response;
+  // Handle the LWE part of the request.
+  RLWE_RETURN_IF_ERROR(AnswerLweQuery(
+      DeserializeLweCiphertext(request.ct_query_vector), response));
+
+  // Handle the LinPIR requests.
+  int num_linpir_requests = request.linpir_ct_bs.size();
+  if (num_linpir_requests != linpir_servers_.size()) {
+    return absl::InvalidArgumentError(
+        "`request` contains unexpected number of LinPir requests.");
+  }
+
+  std::shared_ptr<const std::vector<LinPirGaloisKey>> gks;
+  if (!request.session_id.empty()) {
+    if (request.prng_seed_linpir_ct_pads.size() != num_linpir_requests) {
+      return absl::InvalidArgumentError(
+          "`request` contains incorrect number of PRNG seeds.");
+    }
+    RLWE_ASSIGN_OR_RETURN(gks, sessions_.Lookup(request.session_id));
+  }
 
-  std::vector<LinPirResponse> answers(num_linpir_requests);
-  #pragma omp parallel for
+  std::vector<absl::StatusOr<LinPirResponse>> answers(num_linpir_requests);
+#pragma omp parallel for
   for (int k = 0; k < num_linpir_requests; ++k) {
-    answers[k] = linpir_servers_[k]->HandleRequest(
-        request.linpir_ct_bs(k),
-        request.linpir_gk_bs()
-    ).value();
+    answers[k] = HandleLinPirRequest(k, request, gks.get());
+  }
+  for (auto& answer : answers) {
+    RLWE_ASSIGN_OR_RETURN(*response.add_linpir_responses(), std::move(answer));
+  }
+  return response;
+}
+
+absl::Status Server::AnswerLweQuery(const Database::LweVector& ct_query_vector,
+                                    HintlessPirResponse& response) const {
+  RLWE_ASSIGN_OR_RETURN(std::vector<Database::LweVector> ct_records,
+                        database_->InnerProductWith(ct_query_vector));
+  for (auto& ct_record : ct_records) {
+    if (params_.lwe_answer_bit_size > 0) {
+      *response.add_ct_records() =
+          SerializeLweCiphertext(ct_record, params_.lwe_answer_bit_size);
+    } else {
+      *response.add_ct_records() = SerializeLweCiphertext(ct_record);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<LinPirResponse> Server::HandleLinPirRequest(
+    int k, const HintlessPirRequest& request,
+    const std::vector<LinPirGaloisKey>* gks) const {
+  if (gks != nullptr) {
+    return linpir_servers_[k]->HandleRequest(
+        request.linpir_ct_bs(k), request.prng_seed_linpir_ct_pads(k),
+        (*gks)[k]);
+  }
+  return linpir_servers_[k]->HandleRequest(
+      request.linpir_ct_bs(k), request.linpir_gk_bs(),
+      request.linpir_gk_giant_step_bs(), request.linpir_gk_fold_bs());
+}
+
+absl::StatusOr<LinPirResponse> Server::HandleLinPirRequest(
+    int k, const HintlessPirRequestView& request,
+    const std::vector<LinPirGaloisKey>* gks) const {
+  auto moduli = rlwe_contexts_[k]->MainPrimeModuli();
+  RLWE_ASSIGN_OR_RETURN(auto ct_query_b,
+                        DeserializeRnsPolynomial<RlweModularInt>(
+                            request.linpir_ct_bs[k], moduli));
+  if (gks != nullptr) {
+    return linpir_servers_[k]->HandleRequest(
+        std::move(ct_query_b), request.prng_seed_linpir_ct_pads[k],
+        (*gks)[k]);
+  }
+
+  // Otherwise the request carries the "b" components of the Galois keys.
+  RLWE_ASSIGN_OR_RETURN(auto gk_key_bs,
+                        DeserializeRnsPolynomials<RlweModularInt>(
+                            request.linpir_gk_bs, moduli));
+  RLWE_ASSIGN_OR_RETURN(auto gk_giant_step_key_bs,
+                        DeserializeRnsPolynomials<RlweModularInt>(
+                            request.linpir_gk_giant_step_bs, moduli));
+  RLWE_ASSIGN_OR_RETURN(auto gk_fold_key_bs,
+                        DeserializeRnsPolynomials<RlweModularInt>(
+                            request.linpir_gk_fold_bs, moduli));
+  return linpir_servers_[k]->HandleRequest(
+      std::move(ct_query_b), std::move(gk_key_bs),
+      std::move(gk_giant_step_key_bs), std::move(gk_fold_key_bs));
+}
+
+absl::StatusOr<HintlessPirSessionResponse> Server::CreateSession(
+    const HintlessPirSessionRequest& request) {
+  if (!IsPreprocessed()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
+  if (params_.linpir_params.baby_step_size > 0) {
+    return absl::UnimplementedError(
+        "Sessions do not support baby-step giant-step rotations.");
+  }
+  if (params_.linpir_params.fold_blocks) {
+    return absl::UnimplementedError("Sessions do not support folding blocks.");
+  }
+
+  // Deserialize the Galois key once for every LinPir server.
+  auto gks = std::make_shared<std::vector<LinPirGaloisKey>>();
+  gks->reserve(linpir_servers_.size());
+  for (auto const& linpir_server : linpir_servers_) {
+    RLWE_ASSIGN_OR_RETURN(
+        LinPirGaloisKey gk,
+        linpir_server->DeserializeGaloisKey(request.linpir_gk_bs()));
+    gks->push_back(std::move(gk));
+  }
+
+  // Session ids are sampled as fresh PRNG seeds, which are unpredictable.
+  std::string session_id;
+  if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(session_id,
+                          rlwe::SingleThreadHkdfPrng::GenerateSeed());
+  } else {
+    RLWE_ASSIGN_OR_RETURN(session_id,
+                          rlwe::SingleThreadChaChaPrng::GenerateSeed());
   }
-  *response.mutable_linpir_responses() = {answers.begin(), answers.end()};
+  sessions_.Insert(session_id, std::move(gks));
 
+  HintlessPirSessionResponse response;
+  response.set_session_id(std::move(session_id));
   return response;
 }
 
@@ -27,8 +27,11 @@
 #include "hintless_simplepir/database_hwy.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/serialization.pb.h"
+#include "hintless_simplepir/session_cache.h"
+#include "hintless_simplepir/wire_format.h"
 #include "linpir/database.h"
 #include "linpir/server.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/rns/rns_context.h"
@@ -52,9 +55,29 @@ class Server {
   // be called before accepting client requests.
   absl::Status Preprocess();
 
+  // Handles a request, which either carries the client's Galois key or refers
+  // to a session created by `CreateSession()`. Returns NotFoundError if the
+  // session does not exist or has expired, in which case the client should
+  // create a new session.
   absl::StatusOr<HintlessPirResponse> HandleRequest(
       const HintlessPirRequest& request);
 
+  // Handles a request parsed by `ParseRequest`, decoding its LWE ciphertext
+  // and LinPir polynomials directly from the receive buffer.
+  absl::StatusOr<HintlessPirResponse> HandleRequest(
+      const HintlessPirRequestView& request);
+
+  // Creates a session caching the client's Galois key, so that the following
+  // requests from the client do not need to include it. Sessions are dropped
+  // when the server is preprocessed again.
+  absl::StatusOr<HintlessPirSessionResponse> CreateSession(
+      const HintlessPirSessionRequest& request);
+
+  // Sets the limits on the number of sessions and their lifetime.
+  void SetSessionOptions(SessionOptions options) {
+    sessions_.SetOptions(std::move(options));
+  }
+
   // Returns the server's public parameters that are sent to the client.
   HintlessPirServerPublicParams GetPublicParams() const;
 
@@ -68,6 +91,7 @@ class Server {
   using RlweRnsContext = rlwe::RnsContext<RlweModularInt>;
   using LinPirServer = linpir::Server<RlweInteger>;
   using LinPirDatabase = linpir::Database<RlweInteger>;
+  using LinPirGaloisKey = LinPirServer::RnsGaloisKey;
 
   explicit Server(
       Parameters params, std::unique_ptr<Database> database,
@@ -80,6 +104,19 @@ class Server {
   // This is part of the preprocess steps.
   absl::Status GeneratePublicParams();
 
+  // Adds the LWE answer to `ct_query_vector` to `response`.
+  absl::Status AnswerLweQuery(const Database::LweVector& ct_query_vector,
+                              HintlessPirResponse& response) const;
+
+  // Returns the response of the k'th LinPir server to `request`, using the
+  // Galois keys `gks` of the request's session if it refers to one.
+  absl::StatusOr<LinPirResponse> HandleLinPirRequest(
+      int k, const HintlessPirRequest& request,
+      const std::vector<LinPirGaloisKey>* gks) const;
+  absl::StatusOr<LinPirResponse> HandleLinPirRequest(
+      int k, const HintlessPirRequestView& request,
+      const std::vector<LinPirGaloisKey>* gks) const;
+
   // Returns if the server has been preprocessed to accept requests.
   bool IsPreprocessed() const { return lwe_query_pad_ != nullptr; }
 
@@ -94,11 +131,19 @@ class Server {
   std::string prng_seed_lwe_query_pad_;
   std::unique_ptr<const lwe::Matrix> lwe_query_pad_;
 
+  // The LWE query pad as a `lwe::RingPad` if `params_.ring_lwe_query_pad` is
+  // set, from which the hints are computed; `lwe_query_pad_` holds its dense
+  // matrix.
+  std::unique_ptr<const lwe::RingPad> lwe_ring_pad_;
+
   std::vector<std::string> prng_seed_linpir_ct_pads_;
   std::string prng_seed_linpir_gk_pad_;
 
   std::vector<std::vector<std::unique_ptr<LinPirDatabase>>> linpir_databases_;
   std::vector<std::unique_ptr<LinPirServer>> linpir_servers_;
+
+  // The Galois keys of each session, deserialized for every LinPir server.
+  SessionCache<std::vector<LinPirGaloisKey>> sessions_;
 };
 
 }  // namespace hintless_simplepir
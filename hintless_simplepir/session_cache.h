@@ -0,0 +1,135 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_HINTLESS_SIMPLEPIR_SESSION_CACHE_H_
+#define HINTLESS_PIR_HINTLESS_SIMPLEPIR_SESSION_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/synchronization/mutex.h"
+#include "absl/time/clock.h"
+#include "absl/time/time.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+
+// Server-side settings of the session mode, where a client uploads its LinPir
+// Galois key once and refers to it by a session id in later requests.
+struct SessionOptions {
+  // The maximum number of sessions held by the server; the least recently used
+  // session is evicted when a new session would exceed this limit.
+  size_t max_sessions = 1024;
+
+  // A session expires if it is not used for this long.
+  absl::Duration ttl = absl::Minutes(10);
+};
+
+// A thread-safe map from session ids to immutable values, with LRU eviction
+// and a time-to-live that is refreshed whenever a session is used.
+template <typename Value>
+class SessionCache {
+ public:
+  explicit SessionCache(SessionOptions options = SessionOptions())
+      : options_(std::move(options)) {}
+
+  // Inserts `value` under `session_id`, replacing any existing session with the
+  // same id and evicting the least recently used sessions if needed.
+  void Insert(absl::string_view session_id,
+              std::shared_ptr<const Value> value) {
+    absl::MutexLock lock(&mutex_);
+    Erase(session_id);
+    lru_.push_front(std::string(session_id));
+    sessions_[session_id] =
+        Entry{std::move(value), absl::Now() + options_.ttl, lru_.begin()};
+    while (sessions_.size() > options_.max_sessions) {
+      sessions_.erase(lru_.back());
+      lru_.pop_back();
+    }
+  }
+
+  // Returns the value of the session `session_id` and refreshes its expiry
+  // time, or returns NotFoundError if the session does not exist or expired.
+  absl::StatusOr<std::shared_ptr<const Value>> Lookup(
+      absl::string_view session_id) {
+    absl::MutexLock lock(&mutex_);
+    auto it = sessions_.find(session_id);
+    if (it == sessions_.end()) {
+      return absl::NotFoundError("Session does not exist.");
+    }
+    absl::Time now = absl::Now();
+    if (it->second.expiry <= now) {
+      Erase(session_id);
+      return absl::NotFoundError("Session has expired.");
+    }
+    it->second.expiry = now + options_.ttl;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_position);
+    return it->second.value;
+  }
+
+  // Removes all sessions.
+  void Clear() {
+    absl::MutexLock lock(&mutex_);
+    sessions_.clear();
+    lru_.clear();
+  }
+
+  // Updates the options, which applies to sessions inserted or used from now
+  // on.
+  void SetOptions(SessionOptions options) {
+    absl::MutexLock lock(&mutex_);
+    options_ = std::move(options);
+  }
+
+  size_t Size() const {
+    absl::MutexLock lock(&mutex_);
+    return sessions_.size();
+  }
+
+ private:
+  struct Entry {
+    std::shared_ptr<const Value> value;
+    absl::Time expiry;
+    std::list<std::string>::iterator lru_position;
+  };
+
+  // Removes `session_id` if it exists. Requires holding `mutex_`.
+  void Erase(absl::string_view session_id) {
+    auto it = sessions_.find(session_id);
+    if (it != sessions_.end()) {
+      lru_.erase(it->second.lru_position);
+      sessions_.erase(it);
+    }
+  }
+
+  mutable absl::Mutex mutex_;
+  SessionOptions options_;
+
+  // Session ids ordered from the most recently used to the least.
+  std::list<std::string> lru_;
+  absl::flat_hash_map<std::string, Entry> sessions_;
+};
+
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_HINTLESS_SIMPLEPIR_SESSION_CACHE_H_
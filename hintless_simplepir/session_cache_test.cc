@@ -0,0 +1,64 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hintless_simplepir/session_cache.h"
+
+#include <memory>
+
+#include "absl/status/status.h"
+#include "absl/time/time.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+namespace {
+
+using rlwe::testing::StatusIs;
+
+TEST(SessionCacheTest, LookupReturnsInsertedValue) {
+  SessionCache<int> cache;
+  cache.Insert("a", std::make_shared<const int>(1));
+  cache.Insert("b", std::make_shared<const int>(2));
+  ASSERT_OK_AND_ASSIGN(auto a, cache.Lookup("a"));
+  ASSERT_OK_AND_ASSIGN(auto b, cache.Lookup("b"));
+  EXPECT_EQ(*a, 1);
+  EXPECT_EQ(*b, 2);
+  EXPECT_THAT(cache.Lookup("c"), StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(SessionCacheTest, EvictsLeastRecentlyUsed) {
+  SessionCache<int> cache(SessionOptions{.max_sessions = 2});
+  cache.Insert("a", std::make_shared<const int>(1));
+  cache.Insert("b", std::make_shared<const int>(2));
+  // Using "a" makes "b" the least recently used session.
+  ASSERT_OK(cache.Lookup("a").status());
+  cache.Insert("c", std::make_shared<const int>(3));
+  EXPECT_EQ(cache.Size(), 2);
+  EXPECT_OK(cache.Lookup("a").status());
+  EXPECT_OK(cache.Lookup("c").status());
+  EXPECT_THAT(cache.Lookup("b"), StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(SessionCacheTest, ExpiredSessionIsRemoved) {
+  SessionCache<int> cache(SessionOptions{.ttl = absl::ZeroDuration()});
+  cache.Insert("a", std::make_shared<const int>(1));
+  EXPECT_THAT(cache.Lookup("a"), StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_EQ(cache.Size(), 0);
+}
+
+}  // namespace
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
@@ -17,15 +17,27 @@
 #define HINTLESS_PIR_HINTLESS_SIMPLEPIR_UTILS_H_
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "Eigen/Core"
+#include "absl/numeric/int128.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/serialization.pb.h"
+#include "lwe/counter_prng.h"
+#include "lwe/ring_pad.h"
 #include "lwe/types.h"
+#include "shell_encryption/prng/prng.h"
+#include "shell_encryption/prng/single_thread_chacha_prng.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+#include "shell_encryption/status_macros.h"
 
 namespace hintless_pir {
 namespace hintless_simplepir {
@@ -120,12 +132,37 @@ inline std::string ReconstructRecord(absl::Span<const lwe::Integer> values,
   return record;
 }
 
+// Returns the field of `serialized` that holds the coefficients of an LWE
+// ciphertext that are not rounded, which is `b_coeffs` for 32-bit LWE integers
+// and `wide_b_coeffs` for 64-bit ones.
+#ifdef HINTLESS_PIR_LWE_INTEGER_64
+inline const google::protobuf::RepeatedField<lwe::Integer>&
+LweCiphertextCoeffs(const SerializedLweCiphertext& serialized) {
+  return serialized.wide_b_coeffs();
+}
+
+inline google::protobuf::RepeatedField<lwe::Integer>*
+MutableLweCiphertextCoeffs(SerializedLweCiphertext& serialized) {
+  return serialized.mutable_wide_b_coeffs();
+}
+#else
+inline const google::protobuf::RepeatedField<lwe::Integer>&
+LweCiphertextCoeffs(const SerializedLweCiphertext& serialized) {
+  return serialized.b_coeffs();
+}
+
+inline google::protobuf::RepeatedField<lwe::Integer>*
+MutableLweCiphertextCoeffs(SerializedLweCiphertext& serialized) {
+  return serialized.mutable_b_coeffs();
+}
+#endif  // HINTLESS_PIR_LWE_INTEGER_64
+
 inline SerializedLweCiphertext SerializeLweCiphertext(
     const lwe::Vector& ct_vector) {
   SerializedLweCiphertext serialized;
-  serialized.mutable_b_coeffs()->Resize(ct_vector.size(), 0);
-  Eigen::Map<lwe::Vector> map(serialized.mutable_b_coeffs()->mutable_data(),
-                              ct_vector.size());
+  auto* coeffs = MutableLweCiphertextCoeffs(serialized);
+  coeffs->Resize(ct_vector.size(), 0);
+  Eigen::Map<lwe::Vector> map(coeffs->mutable_data(), ct_vector.size());
   map = ct_vector;
   return serialized;
 }
@@ -133,18 +170,169 @@ inline SerializedLweCiphertext SerializeLweCiphertext(
 inline SerializedLweCiphertext SerializeLweCiphertext(
     const std::vector<lwe::Integer>& ct_vector) {
   SerializedLweCiphertext serialized;
-  serialized.mutable_b_coeffs()->Reserve(ct_vector.size());
-  serialized.mutable_b_coeffs()->Add(ct_vector.begin(), ct_vector.end());
+  auto* coeffs = MutableLweCiphertextCoeffs(serialized);
+  coeffs->Reserve(ct_vector.size());
+  coeffs->Add(ct_vector.begin(), ct_vector.end());
   return serialized;
 }
 
+// Returns the mask of the low `bit_size` bits, for 0 <= `bit_size` <= 64.
+inline uint64_t LowBitsMask(int bit_size) {
+  return bit_size == 64 ? ~uint64_t{0} : (uint64_t{1} << bit_size) - 1;
+}
+
+// Returns `x` mod 2^`log_modulus` rounded to the nearest multiple of
+// 2^(`log_modulus` - `bit_size`), and then scaled down to a `bit_size`-bit
+// value. Assumes 0 < `bit_size` <= `log_modulus` <= lwe::kIntBitwidth.
+inline lwe::Integer RoundToBitSize(lwe::Integer x, int log_modulus,
+                                   int bit_size) {
+  int shift = log_modulus - bit_size;
+  uint64_t mask = LowBitsMask(bit_size);
+  if (shift == 0) {
+    return static_cast<lwe::Integer>(x & mask);
+  }
+  // A carry out of 64 bits only affects bits above `bit_size`.
+  uint64_t rounded = (static_cast<uint64_t>(x) + (uint64_t{1} << (shift - 1)))
+                     >> shift;
+  return static_cast<lwe::Integer>(rounded & mask);
+}
+
+// Returns the coefficient at `index` of the values bit-packed in `packed`,
+// where each value has `bit_size` bits.
+inline lwe::Integer UnpackBits(absl::string_view packed, int64_t index,
+                               int bit_size) {
+  int64_t bit_offset = index * bit_size;
+  int64_t byte_idx = bit_offset / 8;
+  int shift = bit_offset % 8;
+  int num_bytes = DivAndRoundUp(shift + bit_size, 8);
+  absl::uint128 buffer = 0;
+  for (int i = 0; i < num_bytes; ++i) {
+    buffer |= absl::uint128{static_cast<uint8_t>(packed[byte_idx + i])}
+              << (8 * i);
+  }
+  return static_cast<lwe::Integer>(absl::Uint128Low64(buffer >> shift) &
+                                   LowBitsMask(bit_size));
+}
+
+// Returns the LWE ciphertext "b" part rounded to `bit_size` bits and
+// bit-packed, where the coefficients in `ct_vector` are mod 2^kIntBitwidth.
+inline SerializedLweCiphertext SerializeLweCiphertext(
+    const std::vector<lwe::Integer>& ct_vector, int bit_size) {
+  SerializedLweCiphertext serialized;
+  serialized.set_packed_bit_size(bit_size);
+  serialized.set_num_coeffs(ct_vector.size());
+  std::string* packed = serialized.mutable_packed_b_coeffs();
+  packed->resize(DivAndRoundUp<int64_t>(ct_vector.size() * bit_size, 8), 0);
+  absl::uint128 buffer = 0;
+  int num_buffered_bits = 0;
+  auto curr_byte = packed->begin();
+  for (lwe::Integer x : ct_vector) {
+    buffer |= absl::uint128{RoundToBitSize(x, lwe::kIntBitwidth, bit_size)}
+              << num_buffered_bits;
+    num_buffered_bits += bit_size;
+    while (num_buffered_bits >= 8) {
+      *curr_byte++ = static_cast<char>(buffer & 0xFF);
+      buffer >>= 8;
+      num_buffered_bits -= 8;
+    }
+  }
+  if (num_buffered_bits > 0) {
+    *curr_byte = static_cast<char>(buffer & 0xFF);
+  }
+  return serialized;
+}
+
+// Returns the number of coefficients in the serialized LWE ciphertext.
+inline int64_t LweCiphertextSize(const SerializedLweCiphertext& serialized) {
+  if (serialized.has_packed_bit_size()) {
+    return serialized.num_coeffs();
+  }
+  return LweCiphertextCoeffs(serialized).size();
+}
+
+// Returns the coefficient at `index` of the serialized LWE ciphertext, where
+// a rounded coefficient is lifted back to modulo 2^kIntBitwidth.
+inline lwe::Integer LweCiphertextCoeff(
+    const SerializedLweCiphertext& serialized, int64_t index) {
+  if (serialized.has_packed_bit_size()) {
+    int bit_size = serialized.packed_bit_size();
+    lwe::Integer x = UnpackBits(serialized.packed_b_coeffs(), index, bit_size);
+    return static_cast<lwe::Integer>(static_cast<uint64_t>(x)
+                                     << (lwe::kIntBitwidth - bit_size));
+  }
+  return LweCiphertextCoeffs(serialized).Get(index);
+}
+
 inline std::vector<lwe::Integer> DeserializeLweCiphertext(
     const SerializedLweCiphertext& serialized) {
-  std::vector<lwe::Integer> vec(serialized.b_coeffs().begin(),
-                                serialized.b_coeffs().end());
+  if (serialized.has_packed_bit_size()) {
+    std::vector<lwe::Integer> vec;
+    vec.reserve(serialized.num_coeffs());
+    for (int64_t i = 0; i < serialized.num_coeffs(); ++i) {
+      vec.push_back(LweCiphertextCoeff(serialized, i));
+    }
+    return vec;
+  }
+  const auto& coeffs = LweCiphertextCoeffs(serialized);
+  std::vector<lwe::Integer> vec(coeffs.begin(), coeffs.end());
   return vec;
 }
 
+// Returns the smallest bit size to which the server can round the LWE answer
+// vectors such that the client still decrypts correctly, except with
+// probability about 2^`log_failure_probability` per record.
+//
+// The answer noise is D * e, where D has entries of `lwe_plaintext_bit_size`
+// bits and e is the query error, which we bound with a Gaussian tail. Rounding
+// to b bits adds at most 2^(log q - b - 1), and the sum of the two must stay
+// below half of the plaintext scaling factor 2^(log q - log p).
+inline absl::StatusOr<int> ChooseLweAnswerBitSize(
+    const Parameters& params, double log_failure_probability = -40) {
+  if (log_failure_probability >= 0) {
+    return absl::InvalidArgumentError(
+        "`log_failure_probability` must be negative.");
+  }
+  int log_q = params.lwe_modulus_bit_size;
+  int log_p = params.lwe_plaintext_bit_size;
+  double max_plaintext = std::ldexp(1.0, log_p) - 1;
+  double noise_stddev =
+      std::sqrt(params.db_cols * params.lwe_error_variance) * max_plaintext;
+  double tail_factor =
+      std::sqrt(2 * std::log(2.0) * (1 - log_failure_probability));
+  double noise_bound = tail_factor * noise_stddev;
+  double half_scaling_factor = std::ldexp(1.0, log_q - log_p - 1);
+  for (int bit_size = log_p + 1; bit_size < log_q; ++bit_size) {
+    double rounding_error = std::ldexp(1.0, log_q - bit_size - 1);
+    if (rounding_error + noise_bound < half_scaling_factor) {
+      return bit_size;
+    }
+  }
+  if (noise_bound < half_scaling_factor) {
+    return log_q;
+  }
+  return absl::InvalidArgumentError(
+      "`params` does not support correct decryption of the LWE answers.");
+}
+
+// Returns the ring-structured LWE query pad of `params`, expanded from
+// `prng_seed` by an `lwe::CounterPrng` if `params.counter_mode_lwe_query_pad`
+// is set, and by the PRNG of `params.prng_type` otherwise.
+inline absl::StatusOr<lwe::RingPad> ExpandLweRingPad(
+    const Parameters& params, absl::string_view prng_seed) {
+  std::unique_ptr<rlwe::SecurePrng> prng;
+  if (params.counter_mode_lwe_query_pad) {
+    RLWE_ASSIGN_OR_RETURN(
+        prng, lwe::CounterPrng::Create(prng_seed, params.counter_prng_cipher));
+  } else if (params.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(prng, rlwe::SingleThreadHkdfPrng::Create(prng_seed));
+  } else {
+    RLWE_ASSIGN_OR_RETURN(prng,
+                          rlwe::SingleThreadChaChaPrng::Create(prng_seed));
+  }
+  return lwe::RingPad::Expand(params.db_cols, params.lwe_secret_dim,
+                              prng.get());
+}
+
 // Given an integer `x` representing a mod-q number, returns `x` mod p, where
 // modular numbers are in balanced representation.
 template <typename Integer>
@@ -158,6 +346,20 @@ inline Integer ConvertModulus(const Integer& x, const Integer& q,
   }
 }
 
+// Same as `ConvertModulus` for q = 2^`log_q`, where 0 < `log_q` <= 64 so that
+// q itself may not fit in a 64-bit `Integer`.
+template <typename Integer>
+inline Integer ConvertPowerOfTwoModulus(Integer x, int log_q, Integer p) {
+  Integer q_half = Integer{1} << (log_q - 1);
+  if (x > q_half) {
+    // q - x, computed modulo 2^64 and then reduced to the low `log_q` bits.
+    Integer diff = (Integer{0} - x) & ((q_half - 1) | q_half);
+    return p - diff % p;
+  } else {
+    return x % p;
+  }
+}
+
 }  // namespace hintless_simplepir
 }  // namespace hintless_pir
 
@@ -14,19 +14,25 @@
 
 #include "hintless_simplepir/utils.h"
 
+#include <cstdint>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#include "absl/status/status.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "hintless_simplepir/parameters.h"
 #include "hintless_simplepir/testing.h"
 #include "lwe/types.h"
+#include "shell_encryption/testing/status_testing.h"
 
 namespace hintless_pir {
 namespace hintless_simplepir {
 namespace {
 
+using rlwe::testing::StatusIs;
+
 const std::vector<Parameters> kTestParameters{
     Parameters{
         .db_record_bit_size = 8,
@@ -64,6 +70,89 @@ TEST(UtilsTest, SplitAndReconstruct) {
   }
 }
 
+TEST(UtilsTest, SerializeRoundedLweCiphertext) {
+  std::vector<lwe::Integer> ct_vector;
+  for (int i = 0; i < 100; ++i) {
+    ct_vector.push_back(static_cast<lwe::Integer>(i * 0x9E3779B9u));
+  }
+  for (int bit_size : {9, 13, 16, 20, 31, 32, 33, 47, 63, 64}) {
+    if (bit_size > lwe::kIntBitwidth) {
+      continue;
+    }
+    SerializedLweCiphertext serialized =
+        SerializeLweCiphertext(ct_vector, bit_size);
+    EXPECT_EQ(LweCiphertextSize(serialized), ct_vector.size());
+    EXPECT_EQ(serialized.packed_b_coeffs().size(),
+              DivAndRoundUp<int64_t>(ct_vector.size() * bit_size, 8));
+
+    // The lifted coefficients differ from the originals by at most half of
+    // the rounding step, modulo 2^kIntBitwidth.
+    std::vector<lwe::Integer> deserialized =
+        DeserializeLweCiphertext(serialized);
+    ASSERT_EQ(deserialized.size(), ct_vector.size());
+    int64_t half_step = (int64_t{1} << (lwe::kIntBitwidth - bit_size)) / 2;
+    for (int i = 0; i < ct_vector.size(); ++i) {
+      auto diff = static_cast<std::make_signed_t<lwe::Integer>>(
+          deserialized[i] - ct_vector[i]);
+      EXPECT_LE(diff, half_step);
+      EXPECT_GE(diff, -half_step);
+      EXPECT_EQ(LweCiphertextCoeff(serialized, i), deserialized[i]);
+    }
+  }
+}
+
+TEST(UtilsTest, ConvertPowerOfTwoModulus) {
+  constexpr uint64_t kP = 2056193;
+  for (int log_q : {24, 32, 63}) {
+    uint64_t q = uint64_t{1} << log_q;
+    for (uint64_t x : {uint64_t{0}, uint64_t{1}, q / 2 - 1, q / 2, q / 2 + 1,
+                       q - kP, q - 1}) {
+      EXPECT_EQ(ConvertPowerOfTwoModulus(x, log_q, kP),
+                ConvertModulus(x, q, kP, q / 2));
+    }
+  }
+
+  // For q = 2^64, x is the balanced representative x - 2^64 when x > 2^63.
+  EXPECT_EQ(ConvertPowerOfTwoModulus(~uint64_t{0}, 64, kP), kP - 1);
+  EXPECT_EQ(ConvertPowerOfTwoModulus(uint64_t{1} << 63, 64, kP),
+            (uint64_t{1} << 63) % kP);
+  EXPECT_EQ(ConvertPowerOfTwoModulus(~uint64_t{0} - kP, 64, kP),
+            kP - 1);
+}
+
+TEST(UtilsTest, ChooseLweAnswerBitSize) {
+  Parameters params{
+      .db_cols = 1024,
+      .lwe_modulus_bit_size = lwe::kIntBitwidth,
+      .lwe_plaintext_bit_size = 8,
+      .lwe_error_variance = 8,
+  };
+  ASSERT_OK_AND_ASSIGN(int bit_size, ChooseLweAnswerBitSize(params));
+  EXPECT_GT(bit_size, params.lwe_plaintext_bit_size);
+  EXPECT_LT(bit_size, params.lwe_modulus_bit_size);
+
+  // A smaller failure probability never allows a smaller bit size.
+  ASSERT_OK_AND_ASSIGN(int bit_size_more_secure,
+                       ChooseLweAnswerBitSize(params, -80));
+  EXPECT_GE(bit_size_more_secure, bit_size);
+}
+
+TEST(UtilsTest, ChooseLweAnswerBitSizeFailsWithInvalidArguments) {
+  Parameters params{
+      .db_cols = 1024,
+      .lwe_modulus_bit_size = 32,
+      .lwe_plaintext_bit_size = 8,
+      .lwe_error_variance = 8,
+  };
+  EXPECT_THAT(ChooseLweAnswerBitSize(params, 1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  // The answer noise alone exceeds the decryption bound.
+  params.lwe_plaintext_bit_size = 20;
+  EXPECT_THAT(ChooseLweAnswerBitSize(params),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 }  // namespace
 }  // namespace hintless_simplepir
 }  // namespace hintless_pir
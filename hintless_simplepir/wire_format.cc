@@ -0,0 +1,444 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hintless_simplepir/wire_format.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "hintless_simplepir/serialization.pb.h"
+#include "hintless_simplepir/utils.h"
+#include "linpir/serialization.pb.h"
+#include "lwe/types.h"
+#include "shell_encryption/rns/serialization.pb.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+
+namespace {
+
+constexpr char kZeroPadding[kWireFormatAlignment] = {0};
+
+// The largest ring dimension we accept when parsing, as log2.
+constexpr int kMaxLogN = 20;
+
+// Each field layout below has a size that is a multiple of 8 bytes.
+constexpr size_t kLweCiphertextMinSize = 24;
+constexpr size_t kRnsPolynomialMinSize = 16;
+constexpr size_t kRnsCiphertextMinSize = 16;
+constexpr size_t kCountSize = 8;
+constexpr size_t kBytesMinSize = 8;
+
+absl::string_view BytesOf(absl::Span<const lwe::Integer> values) {
+  return absl::string_view(reinterpret_cast<const char*>(values.data()),
+                           values.size() * sizeof(lwe::Integer));
+}
+
+// LWE ciphertext: packed_bit_size (u32), reserved (u32), num_coeffs (u64),
+// then the coefficients as lwe::Integer values or bit-packed.
+void WriteLweCiphertext(const SerializedLweCiphertext& ct, WireWriter& writer) {
+  if (ct.has_packed_bit_size()) {
+    writer.AppendUint32(ct.packed_bit_size());
+    writer.AppendUint32(0);
+    writer.AppendUint64(ct.num_coeffs());
+    writer.AppendBytes(ct.packed_b_coeffs());
+  } else {
+    writer.AppendUint32(0);
+    writer.AppendUint32(0);
+    const auto& coeffs = LweCiphertextCoeffs(ct);
+    writer.AppendUint64(coeffs.size());
+    writer.AppendBytes(BytesOf(coeffs));
+  }
+}
+
+// RNS polynomial: log_n (u32), is_ntt (u32), the number of coefficient
+// vectors (u64), then one byte array per prime modulus.
+void WriteRnsPolynomial(const rlwe::SerializedRnsPolynomial& poly,
+                        WireWriter& writer) {
+  writer.AppendUint32(poly.log_n());
+  writer.AppendUint32(poly.is_ntt() ? 1 : 0);
+  writer.AppendUint64(poly.coeff_vectors_size());
+  for (auto const& coeff_vector : poly.coeff_vectors()) {
+    writer.AppendBytes(coeff_vector);
+  }
+}
+
+// RNS ciphertext: power_of_s (u32), the number of components (u32), error
+// (f64), then the components.
+void WriteRnsCiphertext(const rlwe::SerializedRnsRlweCiphertext& ct,
+                        WireWriter& writer) {
+  writer.AppendUint32(ct.power_of_s());
+  writer.AppendUint32(ct.components_size());
+  writer.AppendDouble(ct.error());
+  for (auto const& component : ct.components()) {
+    WriteRnsPolynomial(component, writer);
+  }
+}
+
+absl::Status ReadHeader(WireReader& reader, WireMessageType type) {
+  RLWE_ASSIGN_OR_RETURN(uint32_t magic, reader.ReadUint32());
+  RLWE_ASSIGN_OR_RETURN(uint32_t message_type, reader.ReadUint32());
+  if (magic != kWireFormatMagic) {
+    return absl::InvalidArgumentError("Not a HintlessPir wire message.");
+  }
+  if (message_type != static_cast<uint32_t>(type)) {
+    return absl::InvalidArgumentError("Unexpected wire message type.");
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<LweCiphertextView> ReadLweCiphertext(WireReader& reader) {
+  LweCiphertextView view;
+  RLWE_ASSIGN_OR_RETURN(uint32_t packed_bit_size, reader.ReadUint32());
+  RLWE_RETURN_IF_ERROR(reader.ReadUint32().status());
+  RLWE_ASSIGN_OR_RETURN(uint64_t num_coeffs, reader.ReadUint64());
+  RLWE_ASSIGN_OR_RETURN(absl::string_view coeffs, reader.ReadBytes());
+  if (packed_bit_size > lwe::kIntBitwidth) {
+    return absl::InvalidArgumentError("Invalid LWE ciphertext bit size.");
+  }
+  view.packed_bit_size = packed_bit_size;
+  view.num_coeffs = num_coeffs;
+  if (packed_bit_size > 0) {
+    if (num_coeffs > coeffs.size() * 8 ||
+        coeffs.size() < (num_coeffs * packed_bit_size + 7) / 8) {
+      return absl::InvalidArgumentError(
+          "LWE ciphertext has too few packed coefficients.");
+    }
+    view.packed_b_coeffs = coeffs;
+  } else {
+    if (coeffs.size() % sizeof(lwe::Integer) != 0 ||
+        coeffs.size() / sizeof(lwe::Integer) != num_coeffs) {
+      return absl::InvalidArgumentError(
+          "LWE ciphertext has incorrect number of coefficients.");
+    }
+    if (reinterpret_cast<uintptr_t>(coeffs.data()) % alignof(lwe::Integer) !=
+        0) {
+      return absl::InvalidArgumentError("Wire message is not aligned.");
+    }
+    view.b_coeffs = absl::MakeConstSpan(
+        reinterpret_cast<const lwe::Integer*>(coeffs.data()), num_coeffs);
+  }
+  return view;
+}
+
+absl::StatusOr<RnsPolynomialView> ReadRnsPolynomial(WireReader& reader) {
+  RnsPolynomialView view;
+  RLWE_ASSIGN_OR_RETURN(uint32_t log_n, reader.ReadUint32());
+  RLWE_ASSIGN_OR_RETURN(uint32_t is_ntt, reader.ReadUint32());
+  if (log_n > kMaxLogN) {
+    return absl::InvalidArgumentError("Invalid RNS polynomial dimension.");
+  }
+  view.log_n = log_n;
+  view.is_ntt = is_ntt != 0;
+  RLWE_ASSIGN_OR_RETURN(size_t num_coeff_vectors,
+                        reader.ReadCount(kBytesMinSize));
+  view.coeff_vectors.reserve(num_coeff_vectors);
+  for (size_t i = 0; i < num_coeff_vectors; ++i) {
+    RLWE_ASSIGN_OR_RETURN(absl::string_view coeff_vector, reader.ReadBytes());
+    view.coeff_vectors.push_back(coeff_vector);
+  }
+  return view;
+}
+
+absl::StatusOr<RnsCiphertextView> ReadRnsCiphertext(WireReader& reader) {
+  RnsCiphertextView view;
+  RLWE_ASSIGN_OR_RETURN(uint32_t power_of_s, reader.ReadUint32());
+  RLWE_ASSIGN_OR_RETURN(uint32_t num_components, reader.ReadUint32());
+  RLWE_ASSIGN_OR_RETURN(view.error, reader.ReadDouble());
+  view.power_of_s = power_of_s;
+  for (uint32_t i = 0; i < num_components; ++i) {
+    RLWE_ASSIGN_OR_RETURN(RnsPolynomialView component,
+                          ReadRnsPolynomial(reader));
+    view.components.push_back(std::move(component));
+  }
+  return view;
+}
+
+absl::StatusOr<std::vector<RnsPolynomialView>> ReadRnsPolynomials(
+    WireReader& reader) {
+  RLWE_ASSIGN_OR_RETURN(size_t num_polys,
+                        reader.ReadCount(kRnsPolynomialMinSize));
+  std::vector<RnsPolynomialView> polys;
+  polys.reserve(num_polys);
+  for (size_t i = 0; i < num_polys; ++i) {
+    RLWE_ASSIGN_OR_RETURN(RnsPolynomialView poly, ReadRnsPolynomial(reader));
+    polys.push_back(std::move(poly));
+  }
+  return polys;
+}
+
+SerializedLweCiphertext LweCiphertextToProto(const LweCiphertextView& view) {
+  SerializedLweCiphertext ct;
+  if (view.packed_bit_size > 0) {
+    ct.set_packed_bit_size(view.packed_bit_size);
+    ct.set_num_coeffs(view.num_coeffs);
+    ct.set_packed_b_coeffs(std::string(view.packed_b_coeffs));
+  } else {
+    MutableLweCiphertextCoeffs(ct)->Add(view.b_coeffs.begin(),
+                                        view.b_coeffs.end());
+  }
+  return ct;
+}
+
+rlwe::SerializedRnsPolynomial RnsPolynomialToProto(
+    const RnsPolynomialView& view) {
+  rlwe::SerializedRnsPolynomial poly;
+  poly.set_log_n(view.log_n);
+  poly.set_is_ntt(view.is_ntt);
+  for (absl::string_view coeff_vector : view.coeff_vectors) {
+    poly.add_coeff_vectors(std::string(coeff_vector));
+  }
+  return poly;
+}
+
+}  // namespace
+
+void WireWriter::AppendScalar(const void* data, size_t size) {
+  segments_.push_back(
+      Segment{.is_scalar = true, .offset = scalars_.size(), .size = size});
+  scalars_.append(static_cast<const char*>(data), size);
+  byte_size_ += size;
+}
+
+void WireWriter::AppendBytes(absl::string_view bytes) {
+  AppendUint64(bytes.size());
+  if (!bytes.empty()) {
+    segments_.push_back(Segment{.is_scalar = false, .external = bytes});
+  }
+  size_t num_padding_bytes =
+      (kWireFormatAlignment - bytes.size() % kWireFormatAlignment) %
+      kWireFormatAlignment;
+  if (num_padding_bytes > 0) {
+    segments_.push_back(Segment{
+        .is_scalar = false,
+        .external = absl::string_view(kZeroPadding, num_padding_bytes)});
+  }
+  byte_size_ += bytes.size() + num_padding_bytes;
+}
+
+std::vector<absl::string_view> WireWriter::Segments() const {
+  std::vector<absl::string_view> output;
+  output.reserve(segments_.size());
+  bool prev_is_scalar = false;
+  for (auto const& segment : segments_) {
+    if (!segment.is_scalar) {
+      output.push_back(segment.external);
+    } else if (prev_is_scalar) {
+      // Consecutive scalars are contiguous in `scalars_`, so merge them.
+      output.back() = absl::string_view(output.back().data(),
+                                        output.back().size() + segment.size);
+    } else {
+      output.push_back(
+          absl::string_view(scalars_).substr(segment.offset, segment.size));
+    }
+    prev_is_scalar = segment.is_scalar;
+  }
+  return output;
+}
+
+std::string WireWriter::Flatten() const {
+  std::string output;
+  output.reserve(byte_size_);
+  for (absl::string_view segment : Segments()) {
+    output.append(segment.data(), segment.size());
+  }
+  return output;
+}
+
+absl::StatusOr<absl::string_view> WireReader::ReadBytes() {
+  RLWE_ASSIGN_OR_RETURN(uint64_t size, ReadUint64());
+  uint64_t padded_size =
+      (size + kWireFormatAlignment - 1) / kWireFormatAlignment *
+      kWireFormatAlignment;
+  if (size > buffer_.size() - position_ ||
+      padded_size > buffer_.size() - position_) {
+    return absl::InvalidArgumentError("Wire message is truncated.");
+  }
+  absl::string_view bytes = buffer_.substr(position_, size);
+  position_ += padded_size;
+  return bytes;
+}
+
+absl::StatusOr<size_t> WireReader::ReadCount(size_t min_item_size) {
+  RLWE_ASSIGN_OR_RETURN(uint64_t count, ReadUint64());
+  if (count > (buffer_.size() - position_) / min_item_size) {
+    return absl::InvalidArgumentError("Wire message has an invalid count.");
+  }
+  return static_cast<size_t>(count);
+}
+
+void WriteRequest(const HintlessPirRequest& request, WireWriter& writer) {
+  writer.AppendUint32(kWireFormatMagic);
+  writer.AppendUint32(static_cast<uint32_t>(WireMessageType::kRequest));
+  WriteLweCiphertext(request.ct_query_vector(), writer);
+  writer.AppendUint64(request.linpir_ct_bs_size());
+  for (auto const& ct_b : request.linpir_ct_bs()) {
+    WriteRnsPolynomial(ct_b, writer);
+  }
+  writer.AppendUint64(request.linpir_gk_bs_size());
+  for (auto const& gk_b : request.linpir_gk_bs()) {
+    WriteRnsPolynomial(gk_b, writer);
+  }
+  writer.AppendBytes(request.session_id());
+  writer.AppendUint64(request.prng_seed_linpir_ct_pads_size());
+  for (auto const& prng_seed : request.prng_seed_linpir_ct_pads()) {
+    writer.AppendBytes(prng_seed);
+  }
+  writer.AppendUint64(request.linpir_gk_giant_step_bs_size());
+  for (auto const& gk_b : request.linpir_gk_giant_step_bs()) {
+    WriteRnsPolynomial(gk_b, writer);
+  }
+  writer.AppendUint64(request.linpir_gk_fold_bs_size());
+  for (auto const& gk_b : request.linpir_gk_fold_bs()) {
+    WriteRnsPolynomial(gk_b, writer);
+  }
+}
+
+void WriteResponse(const HintlessPirResponse& response, WireWriter& writer) {
+  writer.AppendUint32(kWireFormatMagic);
+  writer.AppendUint32(static_cast<uint32_t>(WireMessageType::kResponse));
+  writer.AppendUint64(response.ct_records_size());
+  for (auto const& ct_record : response.ct_records()) {
+    WriteLweCiphertext(ct_record, writer);
+  }
+  writer.AppendUint64(response.linpir_responses_size());
+  for (auto const& linpir_response : response.linpir_responses()) {
+    writer.AppendUint64(linpir_response.ct_inner_products_size());
+    for (auto const& inner_product : linpir_response.ct_inner_products()) {
+      writer.AppendUint64(inner_product.ct_blocks_size());
+      for (auto const& ct_block : inner_product.ct_blocks()) {
+        WriteRnsCiphertext(ct_block, writer);
+      }
+    }
+  }
+}
+
+absl::StatusOr<HintlessPirRequestView> ParseRequest(absl::string_view buffer) {
+  WireReader reader(buffer);
+  RLWE_RETURN_IF_ERROR(ReadHeader(reader, WireMessageType::kRequest));
+  HintlessPirRequestView view;
+  RLWE_ASSIGN_OR_RETURN(view.ct_query_vector, ReadLweCiphertext(reader));
+  RLWE_ASSIGN_OR_RETURN(view.linpir_ct_bs, ReadRnsPolynomials(reader));
+  RLWE_ASSIGN_OR_RETURN(view.linpir_gk_bs, ReadRnsPolynomials(reader));
+  RLWE_ASSIGN_OR_RETURN(view.session_id, reader.ReadBytes());
+  RLWE_ASSIGN_OR_RETURN(size_t num_prng_seeds, reader.ReadCount(kBytesMinSize));
+  view.prng_seed_linpir_ct_pads.reserve(num_prng_seeds);
+  for (size_t i = 0; i < num_prng_seeds; ++i) {
+    RLWE_ASSIGN_OR_RETURN(absl::string_view prng_seed, reader.ReadBytes());
+    view.prng_seed_linpir_ct_pads.push_back(prng_seed);
+  }
+  RLWE_ASSIGN_OR_RETURN(view.linpir_gk_giant_step_bs,
+                        ReadRnsPolynomials(reader));
+  RLWE_ASSIGN_OR_RETURN(view.linpir_gk_fold_bs, ReadRnsPolynomials(reader));
+  if (!reader.AtEnd()) {
+    return absl::InvalidArgumentError("Wire message has trailing bytes.");
+  }
+  return view;
+}
+
+absl::StatusOr<HintlessPirResponseView> ParseResponse(
+    absl::string_view buffer) {
+  WireReader reader(buffer);
+  RLWE_RETURN_IF_ERROR(ReadHeader(reader, WireMessageType::kResponse));
+  HintlessPirResponseView view;
+  RLWE_ASSIGN_OR_RETURN(size_t num_ct_records,
+                        reader.ReadCount(kLweCiphertextMinSize));
+  view.ct_records.reserve(num_ct_records);
+  for (size_t i = 0; i < num_ct_records; ++i) {
+    RLWE_ASSIGN_OR_RETURN(LweCiphertextView ct_record,
+                          ReadLweCiphertext(reader));
+    view.ct_records.push_back(ct_record);
+  }
+  RLWE_ASSIGN_OR_RETURN(size_t num_linpir_responses,
+                        reader.ReadCount(kCountSize));
+  view.linpir_responses.resize(num_linpir_responses);
+  for (auto& linpir_response : view.linpir_responses) {
+    RLWE_ASSIGN_OR_RETURN(size_t num_inner_products,
+                          reader.ReadCount(kCountSize));
+    linpir_response.resize(num_inner_products);
+    for (auto& inner_product : linpir_response) {
+      RLWE_ASSIGN_OR_RETURN(size_t num_blocks,
+                            reader.ReadCount(kRnsCiphertextMinSize));
+      inner_product.reserve(num_blocks);
+      for (size_t i = 0; i < num_blocks; ++i) {
+        RLWE_ASSIGN_OR_RETURN(RnsCiphertextView ct_block,
+                              ReadRnsCiphertext(reader));
+        inner_product.push_back(std::move(ct_block));
+      }
+    }
+  }
+  if (!reader.AtEnd()) {
+    return absl::InvalidArgumentError("Wire message has trailing bytes.");
+  }
+  return view;
+}
+
+HintlessPirRequest ToProto(const HintlessPirRequestView& view) {
+  HintlessPirRequest request;
+  *request.mutable_ct_query_vector() =
+      LweCiphertextToProto(view.ct_query_vector);
+  for (auto const& ct_b : view.linpir_ct_bs) {
+    *request.add_linpir_ct_bs() = RnsPolynomialToProto(ct_b);
+  }
+  for (auto const& gk_b : view.linpir_gk_bs) {
+    *request.add_linpir_gk_bs() = RnsPolynomialToProto(gk_b);
+  }
+  if (!view.session_id.empty()) {
+    request.set_session_id(std::string(view.session_id));
+  }
+  for (absl::string_view prng_seed : view.prng_seed_linpir_ct_pads) {
+    request.add_prng_seed_linpir_ct_pads(std::string(prng_seed));
+  }
+  for (auto const& gk_b : view.linpir_gk_giant_step_bs) {
+    *request.add_linpir_gk_giant_step_bs() = RnsPolynomialToProto(gk_b);
+  }
+  for (auto const& gk_b : view.linpir_gk_fold_bs) {
+    *request.add_linpir_gk_fold_bs() = RnsPolynomialToProto(gk_b);
+  }
+  return request;
+}
+
+HintlessPirResponse ToProto(const HintlessPirResponseView& view) {
+  HintlessPirResponse response;
+  for (auto const& ct_record : view.ct_records) {
+    *response.add_ct_records() = LweCiphertextToProto(ct_record);
+  }
+  for (auto const& linpir_response_view : view.linpir_responses) {
+    LinPirResponse* linpir_response = response.add_linpir_responses();
+    for (auto const& inner_product_view : linpir_response_view) {
+      auto* inner_product = linpir_response->add_ct_inner_products();
+      for (auto const& ct_view : inner_product_view) {
+        rlwe::SerializedRnsRlweCiphertext* ct = inner_product->add_ct_blocks();
+        for (auto const& component : ct_view.components) {
+          *ct->add_components() = RnsPolynomialToProto(component);
+        }
+        ct->set_power_of_s(ct_view.power_of_s);
+        ct->set_error(ct_view.error);
+      }
+    }
+  }
+  return response;
+}
+
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
@@ -0,0 +1,287 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_HINTLESS_SIMPLEPIR_WIRE_FORMAT_H_
+#define HINTLESS_PIR_HINTLESS_SIMPLEPIR_WIRE_FORMAT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/config.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "hintless_simplepir/serialization.pb.h"
+#include "hintless_simplepir/utils.h"
+#include "lwe/types.h"
+#include "shell_encryption/rns/rns_modulus.h"
+#include "shell_encryption/rns/rns_polynomial.h"
+#include "shell_encryption/status_macros.h"
+
+#ifndef ABSL_IS_LITTLE_ENDIAN
+#error "The HintlessPir wire format requires a little-endian platform."
+#endif
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+
+// A flat binary encoding of HintlessPir requests and responses, as an
+// alternative to the protobuf encoding.
+//
+// All integers are little-endian. A message starts with an 8-byte header
+// holding a magic number and the message type, followed by its fields in a
+// fixed order. Scalars are 4 or 8 bytes, and every byte array is prefixed by
+// its 8-byte length and zero-padded to a multiple of 8 bytes. So every
+// coefficient array is 8-byte aligned relative to the start of the message,
+// and a receiver can read it in place from an aligned receive buffer. The
+// coefficients of RNS polynomials use the same packed encoding as
+// `rlwe::SerializedRnsPolynomial`, so converting to and from the protobuf
+// messages does not re-encode any coefficients.
+//
+// A server answers a parsed request with `Server::HandleRequest`, which
+// decodes the polynomials straight from the receive buffer, and a client
+// recovers the record from a parsed response with `Client::RecoverRecord`.
+// The segments of a `WireWriter` can be sent as one frame by
+// `Socket::SendSegments` without flattening them first.
+inline constexpr uint32_t kWireFormatMagic = 0x31575048;  // "HPW1"
+inline constexpr size_t kWireFormatAlignment = 8;
+
+enum class WireMessageType : uint32_t {
+  kRequest = 1,
+  kResponse = 2,
+};
+
+// Builds a message as a list of segments suitable for scatter/gather output,
+// e.g. via writev(). Scalars and padding are held by the writer, whereas byte
+// arrays are referenced without copying and must outlive the segments.
+class WireWriter {
+ public:
+  WireWriter() = default;
+
+  // Not copyable, since segments may point into `scalars_`.
+  WireWriter(const WireWriter&) = delete;
+  WireWriter& operator=(const WireWriter&) = delete;
+
+  void AppendUint32(uint32_t value) { AppendScalar(&value, sizeof(value)); }
+  void AppendUint64(uint64_t value) { AppendScalar(&value, sizeof(value)); }
+  void AppendDouble(double value) { AppendScalar(&value, sizeof(value)); }
+
+  // Appends the length of `bytes`, then `bytes` by reference, then padding.
+  void AppendBytes(absl::string_view bytes);
+
+  // Returns the segments of the message, in order.
+  std::vector<absl::string_view> Segments() const;
+
+  // Returns the total size of the message in bytes.
+  size_t ByteSize() const { return byte_size_; }
+
+  // Returns the message copied into a single buffer.
+  std::string Flatten() const;
+
+ private:
+  // A segment is either a range in `scalars_`, which may be reallocated while
+  // writing, or an external byte array.
+  struct Segment {
+    bool is_scalar;
+    size_t offset;
+    size_t size;
+    absl::string_view external;
+  };
+
+  void AppendScalar(const void* data, size_t size);
+
+  std::string scalars_;
+  std::vector<Segment> segments_;
+  size_t byte_size_ = 0;
+};
+
+// A bounds-checked cursor over a message held in a receive buffer.
+class WireReader {
+ public:
+  explicit WireReader(absl::string_view buffer) : buffer_(buffer) {}
+
+  absl::StatusOr<uint32_t> ReadUint32() { return ReadScalar<uint32_t>(); }
+  absl::StatusOr<uint64_t> ReadUint64() { return ReadScalar<uint64_t>(); }
+  absl::StatusOr<double> ReadDouble() { return ReadScalar<double>(); }
+
+  // Returns a view of the next byte array in the buffer.
+  absl::StatusOr<absl::string_view> ReadBytes();
+
+  // Returns a count that is checked against the remaining buffer size, where
+  // each counted item takes at least `min_item_size` bytes.
+  absl::StatusOr<size_t> ReadCount(size_t min_item_size);
+
+  bool AtEnd() const { return position_ == buffer_.size(); }
+
+ private:
+  template <typename T>
+  absl::StatusOr<T> ReadScalar() {
+    if (buffer_.size() - position_ < sizeof(T)) {
+      return absl::InvalidArgumentError("Wire message is truncated.");
+    }
+    T value;
+    std::memcpy(&value, buffer_.data() + position_, sizeof(T));
+    position_ += sizeof(T);
+    return value;
+  }
+
+  absl::string_view buffer_;
+  size_t position_ = 0;
+};
+
+// Views of the serialized objects, pointing into the receive buffer.
+struct RnsPolynomialView {
+  int log_n;
+  bool is_ntt;
+  std::vector<absl::string_view> coeff_vectors;
+};
+
+struct RnsCiphertextView {
+  std::vector<RnsPolynomialView> components;
+  int power_of_s;
+  double error;
+};
+
+struct LweCiphertextView {
+  // 0 if the coefficients are not rounded, in which case they are stored in
+  // `b_coeffs`; otherwise they are bit-packed in `packed_b_coeffs`.
+  int packed_bit_size;
+  int64_t num_coeffs;
+  absl::Span<const lwe::Integer> b_coeffs;
+  absl::string_view packed_b_coeffs;
+};
+
+struct HintlessPirRequestView {
+  LweCiphertextView ct_query_vector;
+  std::vector<RnsPolynomialView> linpir_ct_bs;
+  std::vector<RnsPolynomialView> linpir_gk_bs;
+  absl::string_view session_id;
+  std::vector<absl::string_view> prng_seed_linpir_ct_pads;
+  std::vector<RnsPolynomialView> linpir_gk_giant_step_bs;
+  std::vector<RnsPolynomialView> linpir_gk_fold_bs;
+};
+
+struct HintlessPirResponseView {
+  std::vector<LweCiphertextView> ct_records;
+  // Indexed by the LinPir instance, then the database, then the block.
+  std::vector<std::vector<std::vector<RnsCiphertextView>>> linpir_responses;
+};
+
+// Returns the number of coefficients of the LWE ciphertext in `view`.
+inline int64_t LweCiphertextSize(const LweCiphertextView& view) {
+  if (view.packed_bit_size > 0) {
+    return view.num_coeffs;
+  }
+  return view.b_coeffs.size();
+}
+
+// Returns the coefficient at `index` of the LWE ciphertext in `view`, where a
+// rounded coefficient is lifted back to modulo 2^kIntBitwidth.
+inline lwe::Integer LweCiphertextCoeff(const LweCiphertextView& view,
+                                       int64_t index) {
+  if (view.packed_bit_size > 0) {
+    int bit_size = view.packed_bit_size;
+    lwe::Integer x = UnpackBits(view.packed_b_coeffs, index, bit_size);
+    return static_cast<lwe::Integer>(static_cast<uint64_t>(x)
+                                     << (lwe::kIntBitwidth - bit_size));
+  }
+  return view.b_coeffs[index];
+}
+
+inline std::vector<lwe::Integer> DeserializeLweCiphertext(
+    const LweCiphertextView& view) {
+  if (view.packed_bit_size > 0) {
+    std::vector<lwe::Integer> vec;
+    vec.reserve(view.num_coeffs);
+    for (int64_t i = 0; i < view.num_coeffs; ++i) {
+      vec.push_back(LweCiphertextCoeff(view, i));
+    }
+    return vec;
+  }
+  return std::vector<lwe::Integer>(view.b_coeffs.begin(), view.b_coeffs.end());
+}
+
+// Writes `request` to `writer`, referencing the coefficient data held by
+// `request`, which must outlive the writer's segments.
+void WriteRequest(const HintlessPirRequest& request, WireWriter& writer);
+
+// Writes `response` to `writer`, referencing the coefficient data held by
+// `response`, which must outlive the writer's segments.
+void WriteResponse(const HintlessPirResponse& response, WireWriter& writer);
+
+// Parses a request from `buffer`, which must be 8-byte aligned and outlive
+// the returned view.
+absl::StatusOr<HintlessPirRequestView> ParseRequest(absl::string_view buffer);
+
+// Parses a response from `buffer`, which must be 8-byte aligned and outlive
+// the returned view.
+absl::StatusOr<HintlessPirResponseView> ParseResponse(
+    absl::string_view buffer);
+
+// Conversions to the protobuf messages, which copy the coefficient data.
+HintlessPirRequest ToProto(const HintlessPirRequestView& view);
+HintlessPirResponse ToProto(const HintlessPirResponseView& view);
+
+// Returns the polynomial in `view` modulo `moduli`, reading the coefficients
+// directly from the receive buffer.
+template <typename ModularInt>
+absl::StatusOr<rlwe::RnsPolynomial<ModularInt>> DeserializeRnsPolynomial(
+    const RnsPolynomialView& view,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli) {
+  if (view.coeff_vectors.size() != moduli.size()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Number of coefficient vectors, ", view.coeff_vectors.size(),
+        ", must be equal to the number of moduli, ", moduli.size(), "."));
+  }
+  int num_coeffs = 1 << view.log_n;
+  std::vector<std::vector<ModularInt>> coeff_vectors;
+  coeff_vectors.reserve(moduli.size());
+  for (int i = 0; i < moduli.size(); ++i) {
+    RLWE_ASSIGN_OR_RETURN(
+        std::vector<ModularInt> coeffs,
+        ModularInt::DeserializeVector(num_coeffs, view.coeff_vectors[i],
+                                      moduli[i]->ModParams()));
+    coeff_vectors.push_back(std::move(coeffs));
+  }
+  return rlwe::RnsPolynomial<ModularInt>::Create(std::move(coeff_vectors),
+                                                 view.is_ntt);
+}
+
+// Returns the polynomials in `views` modulo `moduli`.
+template <typename ModularInt>
+absl::StatusOr<std::vector<rlwe::RnsPolynomial<ModularInt>>>
+DeserializeRnsPolynomials(
+    absl::Span<const RnsPolynomialView> views,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli) {
+  std::vector<rlwe::RnsPolynomial<ModularInt>> polys;
+  polys.reserve(views.size());
+  for (auto const& view : views) {
+    RLWE_ASSIGN_OR_RETURN(rlwe::RnsPolynomial<ModularInt> poly,
+                          DeserializeRnsPolynomial<ModularInt>(view, moduli));
+    polys.push_back(std::move(poly));
+  }
+  return polys;
+}
+
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_HINTLESS_SIMPLEPIR_WIRE_FORMAT_H_
@@ -0,0 +1,189 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <string>
+
+#include "absl/flags/parse.h"
+#include "absl/log/check.h"
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "hintless_simplepir/client.h"
+#include "hintless_simplepir/parameters.h"
+#include "hintless_simplepir/serialization.pb.h"
+#include "hintless_simplepir/server.h"
+#include "hintless_simplepir/wire_format.h"
+#include "linpir/parameters.h"
+#include "lwe/types.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+namespace {
+
+using RlweInteger = Parameters::RlweInteger;
+
+const Parameters kParameters{
+    .db_rows = 1024,
+    .db_cols = 1024,
+    .db_record_bit_size = 8,
+    .lwe_secret_dim = 1408,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
+    .lwe_plaintext_bit_size = 8,
+    .lwe_error_variance = 8,
+    .linpir_params =
+        linpir::RlweParameters<RlweInteger>{
+            .log_n = 12,
+            .qs = {35184371884033ULL, 35184371703809ULL},  // 90 bits
+            .ts = {2056193, 1990657},                      // 42 bits
+            .gadget_log_bs = {16, 16},
+            .error_variance = 8,
+            .prng_type = rlwe::PRNG_TYPE_HKDF,
+            .rows_per_block = 1024,
+        },
+    .prng_type = rlwe::PRNG_TYPE_HKDF,
+};
+
+// A request and a response generated once for all benchmarks.
+struct Messages {
+  HintlessPirRequest request;
+  HintlessPirResponse response;
+};
+
+const Messages& GetMessages() {
+  static const Messages* messages = [] {
+    auto server = Server::CreateWithRandomDatabaseRecords(kParameters).value();
+    CHECK_OK(server->Preprocess());
+    auto client =
+        Client::Create(kParameters, server->GetPublicParams()).value();
+    auto* messages = new Messages;
+    messages->request = client->GenerateRequest(1).value();
+    messages->response = server->HandleRequest(messages->request).value();
+    return messages;
+  }();
+  return *messages;
+}
+
+void BM_ProtoSerializeRequest(benchmark::State& state) {
+  const HintlessPirRequest& request = GetMessages().request;
+  for (auto _ : state) {
+    std::string buffer = request.SerializeAsString();
+    benchmark::DoNotOptimize(buffer);
+  }
+}
+BENCHMARK(BM_ProtoSerializeRequest);
+
+void BM_ProtoParseRequest(benchmark::State& state) {
+  std::string buffer = GetMessages().request.SerializeAsString();
+  for (auto _ : state) {
+    HintlessPirRequest request;
+    benchmark::DoNotOptimize(request.ParseFromString(buffer));
+  }
+}
+BENCHMARK(BM_ProtoParseRequest);
+
+void BM_WireWriteRequest(benchmark::State& state) {
+  const HintlessPirRequest& request = GetMessages().request;
+  for (auto _ : state) {
+    WireWriter writer;
+    WriteRequest(request, writer);
+    auto segments = writer.Segments();
+    benchmark::DoNotOptimize(segments);
+  }
+}
+BENCHMARK(BM_WireWriteRequest);
+
+void BM_WireParseRequest(benchmark::State& state) {
+  WireWriter writer;
+  WriteRequest(GetMessages().request, writer);
+  std::string buffer = writer.Flatten();
+  for (auto _ : state) {
+    auto view = ParseRequest(buffer);
+    benchmark::DoNotOptimize(view);
+  }
+}
+BENCHMARK(BM_WireParseRequest);
+
+void BM_ProtoSerializeResponse(benchmark::State& state) {
+  const HintlessPirResponse& response = GetMessages().response;
+  for (auto _ : state) {
+    std::string buffer = response.SerializeAsString();
+    benchmark::DoNotOptimize(buffer);
+  }
+}
+BENCHMARK(BM_ProtoSerializeResponse);
+
+void BM_ProtoParseResponse(benchmark::State& state) {
+  std::string buffer = GetMessages().response.SerializeAsString();
+  for (auto _ : state) {
+    HintlessPirResponse response;
+    benchmark::DoNotOptimize(response.ParseFromString(buffer));
+  }
+}
+BENCHMARK(BM_ProtoParseResponse);
+
+void BM_WireWriteResponse(benchmark::State& state) {
+  const HintlessPirResponse& response = GetMessages().response;
+  for (auto _ : state) {
+    WireWriter writer;
+    WriteResponse(response, writer);
+    auto segments = writer.Segments();
+    benchmark::DoNotOptimize(segments);
+  }
+}
+BENCHMARK(BM_WireWriteResponse);
+
+void BM_WireFlattenResponse(benchmark::State& state) {
+  const HintlessPirResponse& response = GetMessages().response;
+  for (auto _ : state) {
+    WireWriter writer;
+    WriteResponse(response, writer);
+    std::string buffer = writer.Flatten();
+    benchmark::DoNotOptimize(buffer);
+  }
+}
+BENCHMARK(BM_WireFlattenResponse);
+
+void BM_WireParseResponse(benchmark::State& state) {
+  WireWriter writer;
+  WriteResponse(GetMessages().response, writer);
+  std::string buffer = writer.Flatten();
+  for (auto _ : state) {
+    auto view = ParseResponse(buffer);
+    benchmark::DoNotOptimize(view);
+  }
+}
+BENCHMARK(BM_WireParseResponse);
+
+}  // namespace
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
+
+// Declare benchmark_filter flag, which will be defined by benchmark library.
+// Use it to check if any benchmarks were specified explicitly.
+//
+namespace benchmark {
+extern std::string FLAGS_benchmark_filter;
+}
+using benchmark::FLAGS_benchmark_filter;
+
+int main(int argc, char* argv[]) {
+  FLAGS_benchmark_filter = "";
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  if (!FLAGS_benchmark_filter.empty()) {
+    benchmark::RunSpecifiedBenchmarks();
+  }
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,221 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "hintless_simplepir/wire_format.h"
+
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/strings/string_view.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "hintless_simplepir/client.h"
+#include "hintless_simplepir/parameters.h"
+#include "hintless_simplepir/serialization.pb.h"
+#include "hintless_simplepir/server.h"
+#include "hintless_simplepir/utils.h"
+#include "linpir/parameters.h"
+#include "lwe/types.h"
+#include "shell_encryption/montgomery.h"
+#include "shell_encryption/rns/rns_context.h"
+#include "shell_encryption/rns/rns_polynomial.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace hintless_simplepir {
+namespace {
+
+using rlwe::testing::StatusIs;
+using RlweInteger = Parameters::RlweInteger;
+using RlweModularInt = rlwe::MontgomeryInt<RlweInteger>;
+using RlweRnsContext = rlwe::RnsContext<RlweModularInt>;
+using RlwePolynomial = rlwe::RnsPolynomial<RlweModularInt>;
+
+const Parameters kParameters{
+    .db_rows = 128,
+    .db_cols = 32,
+    .db_record_bit_size = 8,
+    .lwe_secret_dim = 32,
+    .lwe_modulus_bit_size = lwe::kIntBitwidth,
+    .lwe_plaintext_bit_size = 8,
+    .lwe_error_variance = 8,
+    .linpir_params =
+        linpir::RlweParameters<RlweInteger>{
+            .log_n = 10,
+            .qs = {536813569ULL},
+            .ts = {12289, 65537},
+            .gadget_log_bs = {8},
+            .error_variance = 8,
+            .prng_type = rlwe::PRNG_TYPE_HKDF,
+            .rows_per_block = 512,
+        },
+    .prng_type = rlwe::PRNG_TYPE_HKDF,
+};
+
+class WireFormatTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    ASSERT_OK_AND_ASSIGN(server_,
+                         Server::CreateWithRandomDatabaseRecords(kParameters));
+    ASSERT_OK(server_->Preprocess());
+    ASSERT_OK_AND_ASSIGN(
+        client_, Client::Create(kParameters, server_->GetPublicParams()));
+    ASSERT_OK_AND_ASSIGN(request_, client_->GenerateRequest(1));
+    ASSERT_OK_AND_ASSIGN(response_, server_->HandleRequest(request_));
+  }
+
+  std::unique_ptr<Server> server_;
+  std::unique_ptr<Client> client_;
+  HintlessPirRequest request_;
+  HintlessPirResponse response_;
+};
+
+TEST_F(WireFormatTest, RequestRoundTrip) {
+  WireWriter writer;
+  WriteRequest(request_, writer);
+  std::string buffer = writer.Flatten();
+  EXPECT_EQ(buffer.size(), writer.ByteSize());
+  EXPECT_EQ(buffer.size() % kWireFormatAlignment, 0);
+
+  ASSERT_OK_AND_ASSIGN(HintlessPirRequestView view, ParseRequest(buffer));
+  EXPECT_EQ(view.linpir_ct_bs.size(), request_.linpir_ct_bs_size());
+  EXPECT_EQ(view.linpir_gk_bs.size(), request_.linpir_gk_bs_size());
+  EXPECT_EQ(ToProto(view).SerializeAsString(), request_.SerializeAsString());
+}
+
+TEST_F(WireFormatTest, ResponseRoundTrip) {
+  WireWriter writer;
+  WriteResponse(response_, writer);
+  std::string buffer = writer.Flatten();
+  EXPECT_EQ(buffer.size(), writer.ByteSize());
+
+  ASSERT_OK_AND_ASSIGN(HintlessPirResponseView view, ParseResponse(buffer));
+  EXPECT_EQ(ToProto(view).SerializeAsString(), response_.SerializeAsString());
+
+  // The client recovers the record from the converted response.
+  ASSERT_OK_AND_ASSIGN(auto record, client_->RecoverRecord(ToProto(view)));
+  ASSERT_OK_AND_ASSIGN(auto expected, server_->GetDatabase()->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST_F(WireFormatTest, ServerHandlesParsedRequest) {
+  WireWriter writer;
+  WriteRequest(request_, writer);
+  std::string buffer = writer.Flatten();
+  ASSERT_OK_AND_ASSIGN(HintlessPirRequestView view, ParseRequest(buffer));
+
+  ASSERT_OK_AND_ASSIGN(HintlessPirResponse response,
+                       server_->HandleRequest(view));
+  ASSERT_OK_AND_ASSIGN(auto record, client_->RecoverRecord(response));
+  ASSERT_OK_AND_ASSIGN(auto expected, server_->GetDatabase()->Record(1));
+  EXPECT_EQ(record, expected);
+}
+
+TEST_F(WireFormatTest, ServerHandlesParsedSessionRequest) {
+  ASSERT_OK_AND_ASSIGN(auto session_request, client_->StartSession());
+  ASSERT_OK_AND_ASSIGN(auto session_response,
+                       server_->CreateSession(session_request));
+  ASSERT_OK(client_->SetSessionId(session_response));
+  ASSERT_OK_AND_ASSIGN(HintlessPirRequest request,
+                       client_->GenerateRequest(5));
+
+  WireWriter writer;
+  WriteRequest(request, writer);
+  std::string buffer = writer.Flatten();
+  ASSERT_OK_AND_ASSIGN(HintlessPirRequestView view, ParseRequest(buffer));
+  EXPECT_FALSE(view.session_id.empty());
+  EXPECT_TRUE(view.linpir_gk_bs.empty());
+
+  ASSERT_OK_AND_ASSIGN(HintlessPirResponse response,
+                       server_->HandleRequest(view));
+  ASSERT_OK_AND_ASSIGN(auto record, client_->RecoverRecord(response));
+  ASSERT_OK_AND_ASSIGN(auto expected, server_->GetDatabase()->Record(5));
+  EXPECT_EQ(record, expected);
+}
+
+TEST_F(WireFormatTest, ClientRecoversRecordFromParsedResponse) {
+  WireWriter writer;
+  WriteResponse(response_, writer);
+  std::string buffer = writer.Flatten();
+  ASSERT_OK_AND_ASSIGN(HintlessPirResponseView view, ParseResponse(buffer));
+
+  ASSERT_OK_AND_ASSIGN(auto record, client_->RecoverRecord(view));
+  ASSERT_OK_AND_ASSIGN(auto expected, server_->GetDatabase()->Record(1));
+  EXPECT_EQ(record, expected);
+
+  // The LWE ciphertexts are checked as for protos.
+  view.ct_records.pop_back();
+  EXPECT_THAT(client_->RecoverRecord(view),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(WireFormatTest, SegmentsConcatenateToMessage) {
+  WireWriter writer;
+  WriteResponse(response_, writer);
+  std::string concatenated;
+  for (absl::string_view segment : writer.Segments()) {
+    concatenated.append(segment.data(), segment.size());
+  }
+  EXPECT_EQ(concatenated, writer.Flatten());
+}
+
+TEST_F(WireFormatTest, DeserializeRnsPolynomialInPlace) {
+  auto const& rlwe_params = kParameters.linpir_params;
+  ASSERT_OK_AND_ASSIGN(auto rns_context,
+                       RlweRnsContext::CreateForBfvFiniteFieldEncoding(
+                           rlwe_params.log_n, rlwe_params.qs, /*ps=*/{},
+                           rlwe_params.ts[0]));
+  auto moduli = rns_context.MainPrimeModuli();
+
+  WireWriter writer;
+  WriteRequest(request_, writer);
+  std::string buffer = writer.Flatten();
+  ASSERT_OK_AND_ASSIGN(HintlessPirRequestView view, ParseRequest(buffer));
+  for (int i = 0; i < request_.linpir_ct_bs_size(); ++i) {
+    ASSERT_OK_AND_ASSIGN(
+        auto expected,
+        RlwePolynomial::Deserialize(request_.linpir_ct_bs(i), moduli));
+    ASSERT_OK_AND_ASSIGN(
+        auto poly, DeserializeRnsPolynomial<RlweModularInt>(
+                       view.linpir_ct_bs[i], moduli));
+    EXPECT_EQ(poly, expected);
+  }
+}
+
+TEST_F(WireFormatTest, ParseFailsOnMalformedBuffer) {
+  WireWriter writer;
+  WriteRequest(request_, writer);
+  std::string buffer = writer.Flatten();
+
+  // Truncated messages.
+  EXPECT_THAT(ParseRequest(absl::string_view(buffer).substr(0, 4)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      ParseRequest(absl::string_view(buffer).substr(0, buffer.size() - 8)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+
+  // Wrong message type.
+  EXPECT_THAT(ParseResponse(buffer),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  // Wrong magic number.
+  buffer[0] ^= 1;
+  EXPECT_THAT(ParseRequest(buffer),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace hintless_simplepir
+}  // namespace hintless_pir
@@ -21,6 +21,7 @@
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
@@ -28,6 +29,8 @@
 #include "absl/strings/string_view.h"
 #include "absl/types/span.h"
 #include "linpir/parameters.h"
+#include "linpir/query_pad_prng.h"
+#include "linpir/rotations.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/prng/prng.h"
 #include "shell_encryption/prng/single_thread_chacha_prng.h"
@@ -52,6 +55,7 @@ Client<RlweInteger>::Create(const RlweParameters<RlweInteger>& parameters,
   if (rns_context == nullptr) {
     return absl::InvalidArgumentError("`rns_context` must not be null.");
   }
+  RLWE_RETURN_IF_ERROR(CheckFoldBlocks(parameters));
 
   auto rns_moduli = rns_context->MainPrimeModuli();
   RLWE_ASSIGN_OR_RETURN(Encoder encoder, Encoder::Create(rns_context));
@@ -80,6 +84,57 @@ template <typename RlweInteger>
 absl::StatusOr<std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
 Client<RlweInteger>::EncryptQuery(std::vector<std::vector<RlweInteger>> query_vectors,
                                   absl::string_view prng_seed_sk) {
+  return EncryptQuery(std::move(query_vectors), prng_seed_sk,
+                      prng_seed_ct_pad_);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
+Client<RlweInteger>::EncryptQuery(std::vector<std::vector<RlweInteger>> query_vectors,
+                                  absl::string_view prng_seed_sk,
+                                  absl::string_view prng_seed_ct_pad) {
+  RLWE_ASSIGN_OR_RETURN(RnsSecretKey secret_key, SampleSecretKey(prng_seed_sk));
+  RLWE_ASSIGN_OR_RETURN(
+      std::vector<RnsCiphertext> ct_queries,
+      EncryptQueryUnderKey(std::move(query_vectors), secret_key,
+                           prng_seed_ct_pad));
+
+  // Store the secret key
+  secret_key_ = std::make_unique<RnsSecretKey>(std::move(secret_key));
+
+  return ct_queries;
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
+Client<RlweInteger>::EncryptQueryWithoutCachingKey(
+    std::vector<std::vector<RlweInteger>> query_vectors,
+    absl::string_view prng_seed_sk, absl::string_view prng_seed_ct_pad) const {
+  RLWE_ASSIGN_OR_RETURN(RnsSecretKey secret_key, SampleSecretKey(prng_seed_sk));
+  return EncryptQueryUnderKey(std::move(query_vectors), secret_key,
+                              prng_seed_ct_pad);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsRlweSecretKey<rlwe::MontgomeryInt<RlweInteger>>>
+Client<RlweInteger>::SampleSecretKey(absl::string_view prng_seed_sk) const {
+  std::unique_ptr<rlwe::SecurePrng> prng_sk;
+  if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(prng_sk,
+                          rlwe::SingleThreadHkdfPrng::Create(prng_seed_sk));
+  } else {
+    RLWE_ASSIGN_OR_RETURN(prng_sk,
+                          rlwe::SingleThreadChaChaPrng::Create(prng_seed_sk));
+  }
+  return RnsSecretKey::Sample(params_.log_n, params_.error_variance,
+                              rns_moduli_, prng_sk.get());
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
+Client<RlweInteger>::EncryptQueryUnderKey(
+    std::vector<std::vector<RlweInteger>> query_vectors,
+    const RnsSecretKey& secret_key, absl::string_view prng_seed_ct_pad) const {
   int num_slots_per_group = 1 << (params_.log_n - 1);
   if (query_vectors[0].size() > num_slots_per_group) {
     return absl::InvalidArgumentError(
@@ -103,33 +158,21 @@ Client<RlweInteger>::EncryptQuery(std::vector<std::vector<RlweInteger>> query_ve
       }
   }
 
-  // Create PRNGs for sampling RLWE secret key and encryption.
-  std::unique_ptr<rlwe::SecurePrng> prng_sk, prng_enc, prng_pad;
+  // Create PRNGs for encryption.
+  std::unique_ptr<rlwe::SecurePrng> prng_enc;
   if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
-    RLWE_ASSIGN_OR_RETURN(prng_sk,
-                          rlwe::SingleThreadHkdfPrng::Create(prng_seed_sk));
     RLWE_ASSIGN_OR_RETURN(std::string prng_seed_enc,
                           rlwe::SingleThreadHkdfPrng::GenerateSeed());
     RLWE_ASSIGN_OR_RETURN(prng_enc,
                           rlwe::SingleThreadHkdfPrng::Create(prng_seed_enc));
-    RLWE_ASSIGN_OR_RETURN(
-        prng_pad, rlwe::SingleThreadHkdfPrng::Create(prng_seed_ct_pad_));
   } else {
-    RLWE_ASSIGN_OR_RETURN(prng_sk,
-                          rlwe::SingleThreadChaChaPrng::Create(prng_seed_sk));
     RLWE_ASSIGN_OR_RETURN(std::string prng_seed_enc,
                           rlwe::SingleThreadChaChaPrng::GenerateSeed());
     RLWE_ASSIGN_OR_RETURN(prng_enc,
                           rlwe::SingleThreadChaChaPrng::Create(prng_seed_enc));
-    RLWE_ASSIGN_OR_RETURN(
-        prng_pad, rlwe::SingleThreadChaChaPrng::Create(prng_seed_ct_pad_));
   }
-
-  // Sample RLWE secret key
-  RLWE_ASSIGN_OR_RETURN(
-      RnsSecretKey secret_key,
-      RnsSecretKey::Sample(params_.log_n, params_.error_variance, rns_moduli_,
-                           prng_sk.get()));
+  RLWE_ASSIGN_OR_RETURN(std::unique_ptr<rlwe::SecurePrng> prng_pad,
+                        CreateQueryPadPrng(params_, prng_seed_ct_pad));
 
   // Encrypt each the query vector
   std::vector<RnsCiphertext> ct_queries;
@@ -142,10 +185,6 @@ Client<RlweInteger>::EncryptQuery(std::vector<std::vector<RlweInteger>> query_ve
     
     ct_queries.push_back(std::move(query));
   }
-
-  // Store the secret key
-  secret_key_ = std::make_unique<RnsSecretKey>(std::move(secret_key));
-
   return ct_queries;
 }
 
@@ -216,46 +255,184 @@ Client<RlweInteger>::GenerateGaloisKey() const {
   return gk;
 }
 
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsGaloisKey<rlwe::MontgomeryInt<RlweInteger>>>
+Client<RlweInteger>::GenerateGiantStepGaloisKey(
+    absl::string_view prng_seed_sk) const {
+  if (params_.baby_step_size <= 0) {
+    return absl::FailedPreconditionError(
+        "Baby-step giant-step rotations are disabled.");
+  }
+  RLWE_ASSIGN_OR_RETURN(
+      std::string prng_seed_gk_giant_step_pad,
+      DeriveGiantStepGaloisKeyPadSeed(prng_seed_gk_pad_, params_.prng_type));
+  return GenerateRotationGaloisKey(prng_seed_sk, params_.baby_step_size,
+                                   prng_seed_gk_giant_step_pad);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsGaloisKey<rlwe::MontgomeryInt<RlweInteger>>>
+Client<RlweInteger>::GenerateFoldGaloisKey(
+    absl::string_view prng_seed_sk) const {
+  if (!params_.fold_blocks) {
+    return absl::FailedPreconditionError("Folding blocks is disabled.");
+  }
+  RLWE_ASSIGN_OR_RETURN(
+      std::string prng_seed_gk_fold_pad,
+      DeriveFoldGaloisKeyPadSeed(prng_seed_gk_pad_, params_.prng_type));
+  return GenerateRotationGaloisKey(prng_seed_sk, params_.rows_per_block,
+                                   prng_seed_gk_fold_pad);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsGaloisKey<rlwe::MontgomeryInt<RlweInteger>>>
+Client<RlweInteger>::GenerateRotationGaloisKey(
+    absl::string_view prng_seed_sk, int rotation,
+    absl::string_view prng_seed_gk_pad) const {
+  // Sample RLWE secret key
+  std::unique_ptr<rlwe::SecurePrng> prng_sk;
+  if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(prng_sk,
+                          rlwe::SingleThreadHkdfPrng::Create(prng_seed_sk));
+  } else {
+    RLWE_ASSIGN_OR_RETURN(prng_sk,
+                          rlwe::SingleThreadChaChaPrng::Create(prng_seed_sk));
+  }
+  RLWE_ASSIGN_OR_RETURN(
+      RnsSecretKey secret_key,
+      RnsSecretKey::Sample(params_.log_n, params_.error_variance, rns_moduli_,
+                           prng_sk.get()));
+
+  // Create a Galois key rotating by `rotation` slots, with random pads
+  // derived from the server's PRNG seed.
+  RLWE_ASSIGN_OR_RETURN(std::vector<RnsPolynomial> gk_pads,
+                        RnsGaloisKey::SampleRandomPad(
+                            rns_gadget_.Dimension(), params_.log_n, rns_moduli_,
+                            prng_seed_gk_pad, params_.prng_type));
+  return RnsGaloisKey::CreateWithRandomPadForBfv(
+      std::move(gk_pads), secret_key,
+      RotationGaloisPower(rotation, params_.log_n), params_.error_variance,
+      &rns_gadget_, prng_seed_gk_pad, params_.prng_type);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<RlweInteger>> Client<RlweInteger>::DecryptBlock(
+    const rlwe::SerializedRnsRlweCiphertext& ct_block,
+    const RnsSecretKey& secret_key) const {
+  RLWE_ASSIGN_OR_RETURN(
+      auto ct_deserialized,
+      RnsCiphertext::Deserialize(ct_block, rns_moduli_, &rns_error_params_));
+  RnsCiphertext ct(std::move(ct_deserialized));
+  RLWE_ASSIGN_OR_RETURN(
+      auto slots, secret_key.template DecryptBfv<Encoder>(ct, &encoder_));
+
+  // When folding blocks, the w'th window of rows_per_block slots holds the
+  // rows of the w'th block in the fold, and otherwise the windows hold
+  // partial sums of the same rows.
+  int num_slots_per_group = 1 << (params_.log_n - 1);
+  std::vector<RlweInteger> values(
+      NumBlocksPerFold(params_) * params_.rows_per_block, 0);
+  int num_values = values.size();
+  // First half of the block
+  for (int k = 0; k < num_slots_per_group; ++k) {
+    values[k % num_values] += slots[k];
+  }
+  // Second half of the block
+  for (int k = 0; k < num_slots_per_group; ++k) {
+    values[k % num_values] += slots[num_slots_per_group + k];
+  }
+  RlweInteger plaintext_modulus = rns_context_->PlaintextModulus();
+  for (auto& value : values) {
+    value %= plaintext_modulus;
+  }
+  return values;
+}
+
 template <typename RlweInteger>
 absl::StatusOr<std::vector<std::vector<RlweInteger>>>
 Client<RlweInteger>::Recover(const LinPirResponse& response) {
   if (secret_key_ == nullptr) {
     return absl::InvalidArgumentError("Secret key not found.");
   }
+  return RecoverUnderKey(response, *secret_key_);
+}
 
-  RlweInteger plaintext_modulus = rns_context_->PlaintextModulus();
+template <typename RlweInteger>
+absl::StatusOr<std::vector<std::vector<RlweInteger>>>
+Client<RlweInteger>::Recover(const LinPirResponse& response,
+                             absl::string_view prng_seed_sk) const {
+  RLWE_ASSIGN_OR_RETURN(RnsSecretKey secret_key, SampleSecretKey(prng_seed_sk));
+  return RecoverUnderKey(response, secret_key);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<std::vector<RlweInteger>>>
+Client<RlweInteger>::RecoverUnderKey(const LinPirResponse& response,
+                                     const RnsSecretKey& secret_key) const {
   std::vector<std::vector<RlweInteger>> results(
       response.ct_inner_products_size());
   for (int i = 0; i < response.ct_inner_products_size(); ++i) {
     const auto& ct_inner_products = response.ct_inner_products(i);
-    int num_slots_per_group = 1 << (params_.log_n - 1);
-    int num_blocks = ct_inner_products.ct_blocks_size();
-    results[i].reserve(num_blocks * params_.rows_per_block);
+    int num_cts = ct_inner_products.ct_blocks_size();
+    results[i].reserve(num_cts * NumBlocksPerFold(params_) *
+                       params_.rows_per_block);
+    for (int j = 0; j < num_cts; ++j) {
+      RLWE_ASSIGN_OR_RETURN(std::vector<RlweInteger> values,
+                            DecryptBlock(ct_inner_products.ct_blocks(j),
+                                         secret_key));
+      results[i].insert(results[i].end(), values.begin(), values.end());
+    }
+  }
 
-    for (int j = 0; j < num_blocks; ++j) {
-      RLWE_ASSIGN_OR_RETURN(
-          auto ct_deserialized,
-          RnsCiphertext::Deserialize(ct_inner_products.ct_blocks(j),
-                                     rns_moduli_, &rns_error_params_));
-      RnsCiphertext ct_block(std::move(ct_deserialized));
+  return results;
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<RlweInteger>> Client<RlweInteger>::RecoverRows(
+    const LinPirResponse& response, int index, absl::Span<const int> rows) {
+  if (secret_key_ == nullptr) {
+    return absl::InvalidArgumentError("Secret key not found.");
+  }
+  return RecoverRowsUnderKey(response, index, rows, *secret_key_);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<RlweInteger>> Client<RlweInteger>::RecoverRows(
+    const LinPirResponse& response, int index, absl::Span<const int> rows,
+    absl::string_view prng_seed_sk) const {
+  RLWE_ASSIGN_OR_RETURN(RnsSecretKey secret_key, SampleSecretKey(prng_seed_sk));
+  return RecoverRowsUnderKey(response, index, rows, secret_key);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<RlweInteger>>
+Client<RlweInteger>::RecoverRowsUnderKey(const LinPirResponse& response,
+                                         int index, absl::Span<const int> rows,
+                                         const RnsSecretKey& secret_key) const {
+  if (index < 0 || index >= response.ct_inner_products_size()) {
+    return absl::InvalidArgumentError("`index` is out of range.");
+  }
+
+  const auto& ct_inner_products = response.ct_inner_products(index);
+  int num_rows_per_ct = NumBlocksPerFold(params_) * params_.rows_per_block;
+  absl::flat_hash_map<int, std::vector<RlweInteger>> ct_values;
+  std::vector<RlweInteger> results;
+  results.reserve(rows.size());
+  for (int row : rows) {
+    int ct_index = row / num_rows_per_ct;
+    if (row < 0 || ct_index >= ct_inner_products.ct_blocks_size()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("`rows` contains ", row, ", which is out of range."));
+    }
+    auto it = ct_values.find(ct_index);
+    if (it == ct_values.end()) {
       RLWE_ASSIGN_OR_RETURN(
-          auto slots,
-          secret_key_->template DecryptBfv<Encoder>(ct_block, &encoder_));
-      std::vector<RlweInteger> values(params_.rows_per_block, 0);
-      // First half of the block
-      for (int k = 0; k < num_slots_per_group; ++k) {
-        values[k % params_.rows_per_block] += slots[k];
-      }
-      // Second half of the block
-      for (int k = 0; k < num_slots_per_group; ++k) {
-        values[k % params_.rows_per_block] += slots[num_slots_per_group + k];
-      }
-      for (auto const& value : values) {
-        results[i].push_back(value % plaintext_modulus);
-      }
+          std::vector<RlweInteger> values,
+          DecryptBlock(ct_inner_products.ct_blocks(ct_index), secret_key));
+      it = ct_values.emplace(ct_index, std::move(values)).first;
     }
+    results.push_back(it->second[row % num_rows_per_ct]);
   }
-
   return results;
 }
 
@@ -75,6 +75,20 @@ class Client {
       std::vector<std::vector<RlweInteger>> query_vectors,
       absl::string_view prng_seed_sk);
 
+  // This variant also samples the "a" components using the given PRNG seed
+  // instead of the server's seed. A fresh `prng_seed_ct_pad` must be used for
+  // each query encrypted under the same secret key.
+  absl::StatusOr<std::vector<RnsCiphertext>> EncryptQuery(
+      std::vector<std::vector<RlweInteger>> query_vectors,
+      absl::string_view prng_seed_sk, absl::string_view prng_seed_ct_pad);
+
+  // Like the variant above, but does not cache the secret key, so that
+  // queries can be encrypted concurrently. The responses must be recovered by
+  // the variant of `RecoverRows` taking the same `prng_seed_sk`.
+  absl::StatusOr<std::vector<RnsCiphertext>> EncryptQueryWithoutCachingKey(
+      std::vector<std::vector<RlweInteger>> query_vectors,
+      absl::string_view prng_seed_sk, absl::string_view prng_seed_ct_pad) const;
+
   // Returns a Galois key based on the secret key that is sampled using the
   // given PRNG seed.
   absl::StatusOr<RnsGaloisKey> GenerateGaloisKey(
@@ -83,6 +97,18 @@ class Client {
   // Returns a Galois key based on the cached `secret_key_`.
   absl::StatusOr<RnsGaloisKey> GenerateGaloisKey() const;
 
+  // Returns the Galois key for the giant-step rotations, based on the secret
+  // key that is sampled using the given PRNG seed. Only needed when
+  // `baby_step_size` is positive.
+  absl::StatusOr<RnsGaloisKey> GenerateGiantStepGaloisKey(
+      absl::string_view prng_seed_sk) const;
+
+  // Returns the Galois key rotating by `rows_per_block` slots to fold blocks,
+  // based on the secret key that is sampled using the given PRNG seed. Only
+  // needed when `fold_blocks` is set.
+  absl::StatusOr<RnsGaloisKey> GenerateFoldGaloisKey(
+      absl::string_view prng_seed_sk) const;
+
 //  // Returns a LinPIR request including the given ciphertext and Galois key.
 //  absl::StatusOr<LinPirRequest> GenerateRequest(const RnsCiphertext& ct_query,
 //                                                const RnsGaloisKey& gk) const {
@@ -110,6 +136,25 @@ class Client {
   absl::StatusOr<std::vector<std::vector<RlweInteger>>> Recover(
       const LinPirResponse& response);
 
+  // This variant decrypts under the secret key that is sampled using the given
+  // PRNG seed instead of the cached one, so that responses to queries
+  // encrypted by `EncryptQueryWithoutCachingKey` can be recovered in any order
+  // and concurrently.
+  absl::StatusOr<std::vector<std::vector<RlweInteger>>> Recover(
+      const LinPirResponse& response, absl::string_view prng_seed_sk) const;
+
+  // Recovers only the entries at `rows` of the inner product with the
+  // `index`'th database matrix in `response`. Only the ciphertexts holding
+  // these rows are deserialized and decrypted, each at most once.
+  absl::StatusOr<std::vector<RlweInteger>> RecoverRows(
+      const LinPirResponse& response, int index, absl::Span<const int> rows);
+
+  // This variant decrypts under the secret key that is sampled using the given
+  // PRNG seed instead of the cached one.
+  absl::StatusOr<std::vector<RlweInteger>> RecoverRows(
+      const LinPirResponse& response, int index, absl::Span<const int> rows,
+      absl::string_view prng_seed_sk) const;
+
   absl::string_view PrngSeedForCiphertextRandomPads() const {
     return prng_seed_ct_pad_;
   }
@@ -133,6 +178,38 @@ class Client {
         rns_error_params_(std::move(rns_error_params)),
         encoder_(std::move(encoder)) {}
 
+  // Returns the RLWE secret key sampled using the given PRNG seed.
+  absl::StatusOr<RnsSecretKey> SampleSecretKey(
+      absl::string_view prng_seed_sk) const;
+
+  // Encrypts the query vectors under `secret_key`, with the "a" components
+  // sampled using `prng_seed_ct_pad`.
+  absl::StatusOr<std::vector<RnsCiphertext>> EncryptQueryUnderKey(
+      std::vector<std::vector<RlweInteger>> query_vectors,
+      const RnsSecretKey& secret_key, absl::string_view prng_seed_ct_pad) const;
+
+  // Returns the rows held by the response ciphertext `ct_block`, i.e. the
+  // rows of NumBlocksPerFold() consecutive database blocks.
+  absl::StatusOr<std::vector<RlweInteger>> DecryptBlock(
+      const rlwe::SerializedRnsRlweCiphertext& ct_block,
+      const RnsSecretKey& secret_key) const;
+
+  // Implements `Recover` under the given secret key.
+  absl::StatusOr<std::vector<std::vector<RlweInteger>>> RecoverUnderKey(
+      const LinPirResponse& response, const RnsSecretKey& secret_key) const;
+
+  // Implements `RecoverRows` under the given secret key.
+  absl::StatusOr<std::vector<RlweInteger>> RecoverRowsUnderKey(
+      const LinPirResponse& response, int index, absl::Span<const int> rows,
+      const RnsSecretKey& secret_key) const;
+
+  // Returns a Galois key rotating by `rotation` slots, based on the secret key
+  // that is sampled using `prng_seed_sk`, with the random pads sampled using
+  // `prng_seed_gk_pad`.
+  absl::StatusOr<RnsGaloisKey> GenerateRotationGaloisKey(
+      absl::string_view prng_seed_sk, int rotation,
+      absl::string_view prng_seed_gk_pad) const;
+
   const RlweParameters<RlweInteger> params_;
 
   // PRNG seeds generated by the server to sample the "a" polynomials.
@@ -14,17 +14,27 @@
 
 #include "linpir/database.h"
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"
+#include "absl/container/inlined_vector.h"
 #include "absl/memory/memory.h"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "linpir/diagonal_storage.h"
 #include "linpir/parameters.h"
+#include "linpir/residues.h"
+#include "linpir/rotations.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/rns/rns_bfv_ciphertext.h"
+#include "shell_encryption/rns/rns_error_params.h"
+#include "shell_encryption/rns/rns_polynomial.h"
 #include "shell_encryption/status_macros.h"
 
 namespace hintless_pir {
@@ -34,6 +44,9 @@ namespace {
 
 inline int DivAndRoundUp(int x, int y) { return (x + y - 1) / y; }
 
+// The number of rotations absorbed at once without allocating memory.
+constexpr int kMaxInlinedRotations = 16;
+
 }  // namespace
 
 template <typename RlweInteger>
@@ -48,6 +61,8 @@ Database<RlweInteger>::Create(
   if (data.empty()) {
     return absl::InvalidArgumentError("`data` must not be empty.");
   }
+  RLWE_RETURN_IF_ERROR(CheckBabyStepSize(rlwe_params));
+  RLWE_RETURN_IF_ERROR(CheckFoldBlocks(rlwe_params));
 
   std::vector<const PrimeModulus*> moduli = rns_context->MainPrimeModuli();
   RLWE_ASSIGN_OR_RETURN(Encoder encoder, Encoder::Create(rns_context));
@@ -62,11 +77,31 @@ Database<RlweInteger>::Create(
 
   int num_slots = num_slots_per_group * 2;
   int num_polynomials_per_block = rlwe_params.rows_per_block / 2;
-  int num_blocks = DivAndRoundUp(num_rows, rlwe_params.rows_per_block);
-  std::vector<std::vector<RnsPolynomial>> diagonals(num_blocks);
-  for (int i = 0; i < num_blocks; ++i) {
-    diagonals[i].reserve(num_polynomials_per_block);
-
+  int num_baby_steps = EffectiveBabyStepSize(rlwe_params);
+  int num_blocks_per_fold = NumBlocksPerFold(rlwe_params);
+  int num_blocks =
+      DivAndRoundUp(DivAndRoundUp(num_rows, rlwe_params.rows_per_block),
+                    num_blocks_per_fold) *
+      num_blocks_per_fold;
+  RlweInteger plaintext_modulus = rns_context->PlaintextModulus();
+  DiagonalStorage<RlweInteger> diagonals;
+  DiagonalStorage<Uint32> compact_diagonals;
+  if (rlwe_params.compact_diagonals) {
+    RLWE_ASSIGN_OR_RETURN(
+        compact_diagonals,
+        DiagonalStorage<Uint32>::Create(num_blocks, num_polynomials_per_block,
+                                        num_slots));
+  } else {
+    RLWE_ASSIGN_OR_RETURN(
+        diagonals, DiagonalStorage<RlweInteger>::Create(
+                       num_blocks, num_polynomials_per_block,
+                       moduli.size() * num_slots));
+  }
+  // Encodes the j'th and rows_per_block/2 + j'th diagonals of block i, using
+  // `diag_values` as scratch space for the slot values.
+  auto encode_diagonal = [&](int i, int j,
+                             std::vector<RlweInteger>& diag_values)
+      -> absl::Status {
     // Each block is a rectangle matrix divided into square submatrices of
     // dimension rows_per_block * rows_per_block, and there are rows_per_block
     // many diagonals. Since we assume data has number of columns < number of
@@ -78,97 +113,218 @@ Database<RlweInteger>::Create(
     // --*--@--*--.    positions when extending the block into multiple square
     // @--*--@--*-.    matrices.
     // -@--*--@--*.
-    int row_idx_begin = i * rlwe_params.rows_per_block;
-    // The j'th and rows_per_block/2 + j'th diagonals.
-    for (int j = 0; j < num_polynomials_per_block; ++j) {
-      std::vector<RlweInteger> diag_values(num_slots, 0);
-      // first group of slots
-      for (int k = 0; k < num_slots_per_group; ++k) {
-        int row_idx = row_idx_begin + (k % rlwe_params.rows_per_block);
-        int col_idx = (k + j) % num_slots_per_group;
-        if (row_idx < num_rows && col_idx < num_cols) {  // valid indices
-          diag_values[k] = data[row_idx][col_idx];
-        }
+    //
+    // When folding blocks, block i = f * R + j of the R blocks in fold f holds
+    // the rows of block f * R + (w - j mod R) in the w'th window of
+    // rows_per_block slots of every group, so that summing up the results of
+    // block f * R + j rotated by j * rows_per_block leaves the rows of block
+    // f * R + w in window w.
+    auto row_idx_begin = [&](int k) {
+      int window = k / rlwe_params.rows_per_block;
+      int fold_idx = i % num_blocks_per_fold;
+      int block_idx =
+          i - fold_idx +
+          (window - fold_idx + num_blocks_per_fold) % num_blocks_per_fold;
+      return block_idx * rlwe_params.rows_per_block;
+    };
+    std::fill(diag_values.begin(), diag_values.end(), 0);
+    // first group of slots
+    for (int k = 0; k < num_slots_per_group; ++k) {
+      int row_idx = row_idx_begin(k) + (k % rlwe_params.rows_per_block);
+      int col_idx = (k + j) % num_slots_per_group;
+      if (row_idx < num_rows && col_idx < num_cols) {  // valid indices
+        diag_values[k] = data[row_idx][col_idx];
       }
-      // second group of slots
-      for (int k = 0; k < num_slots_per_group; ++k) {
-        int row_idx = row_idx_begin + (k % rlwe_params.rows_per_block);
-        int col_idx =
-            (rlwe_params.rows_per_block / 2 + k + j) % num_slots_per_group;
-        if (row_idx < num_rows && col_idx < num_cols) {  // valid indices
-          diag_values[num_slots_per_group + k] = data[row_idx][col_idx];
-        }
+    }
+    // second group of slots
+    for (int k = 0; k < num_slots_per_group; ++k) {
+      int row_idx = row_idx_begin(k) + (k % rlwe_params.rows_per_block);
+      int col_idx =
+          (rlwe_params.rows_per_block / 2 + k + j) % num_slots_per_group;
+      if (row_idx < num_rows && col_idx < num_cols) {  // valid indices
+        diag_values[num_slots_per_group + k] = data[row_idx][col_idx];
       }
+    }
+    RLWE_ASSIGN_OR_RETURN(
+        RnsPolynomial diagonal,
+        encoder.EncodeBfv(diag_values, moduli, /*is_scaled=*/false));
+    // With baby-step giant-step rotations, the diagonal j = a * g + b is
+    // rotated by -a * g, so that the sum over b of the products with the
+    // query rotated by b only needs to be rotated by a * g afterwards.
+    int giant_step_rotation = j - j % num_baby_steps;
+    if (giant_step_rotation > 0) {
       RLWE_ASSIGN_OR_RETURN(
-          RnsPolynomial diagonal,
-          encoder.EncodeBfv(diag_values, moduli, /*is_scaled=*/false));
-      diagonals[i].push_back(std::move(diagonal));
+          diagonal,
+          diagonal.Substitute(InverseRotationGaloisPower(giant_step_rotation,
+                                                         rlwe_params.log_n),
+                              moduli));
     }
+    if (rlwe_params.compact_diagonals) {
+      RLWE_ASSIGN_OR_RETURN(std::vector<Uint32> diagonal_coeffs,
+                            ExportSmallCoeffs<ModularInt>(
+                                diagonal, plaintext_modulus, moduli));
+      absl::c_copy(diagonal_coeffs,
+                   compact_diagonals.MutableDiagonal(i, j).begin());
+    } else {
+      RLWE_ASSIGN_OR_RETURN(std::vector<RlweInteger> diagonal_residues,
+                            ExportResidues<ModularInt>(diagonal, moduli));
+      absl::c_copy(diagonal_residues, diagonals.MutableDiagonal(i, j).begin());
+    }
+    return absl::OkStatus();
+  };
+
+  // The diagonals are encoded independently into disjoint parts of the
+  // storage, so they are spread over all threads.
+  int num_diagonals = num_blocks * num_polynomials_per_block;
+  std::vector<absl::Status> statuses(num_diagonals);
+#pragma omp parallel
+  {
+    std::vector<RlweInteger> diag_values(num_slots, 0);
+#pragma omp for schedule(dynamic)
+    for (int d = 0; d < num_diagonals; ++d) {
+      statuses[d] = encode_diagonal(d / num_polynomials_per_block,
+                                    d % num_polynomials_per_block, diag_values);
+    }
+  }
+  for (auto const& status : statuses) {
+    RLWE_RETURN_IF_ERROR(status);
+  }
+  return CreateWithDiagonals(rlwe_params, rns_context, std::move(diagonals),
+                             std::move(compact_diagonals));
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::unique_ptr<Database<RlweInteger>>>
+Database<RlweInteger>::CreateFromFile(
+    const RlweParameters<RlweInteger>& rlwe_params,
+    const RnsContext* rns_context, absl::string_view path) {
+  if (rns_context == nullptr) {
+    return absl::InvalidArgumentError("`rns_context` must not be null.");
+  }
+  DiagonalStorage<RlweInteger> diagonals;
+  DiagonalStorage<Uint32> compact_diagonals;
+  if (rlwe_params.compact_diagonals) {
+    RLWE_ASSIGN_OR_RETURN(compact_diagonals,
+                          DiagonalStorage<Uint32>::MapFromFile(path));
+  } else {
+    RLWE_ASSIGN_OR_RETURN(diagonals,
+                          DiagonalStorage<RlweInteger>::MapFromFile(path));
+  }
+  return CreateWithDiagonals(rlwe_params, rns_context, std::move(diagonals),
+                             std::move(compact_diagonals));
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::unique_ptr<Database<RlweInteger>>>
+Database<RlweInteger>::CreateWithDiagonals(
+    const RlweParameters<RlweInteger>& rlwe_params,
+    const RnsContext* rns_context, DiagonalStorage<RlweInteger> diagonals,
+    DiagonalStorage<Uint32> compact_diagonals) {
+  RLWE_RETURN_IF_ERROR(CheckBabyStepSize(rlwe_params));
+  RLWE_RETURN_IF_ERROR(CheckFoldBlocks(rlwe_params));
+  std::vector<const PrimeModulus*> moduli = rns_context->MainPrimeModuli();
+  int num_slots = 1 << rlwe_params.log_n;
+  int num_diagonals_per_block = rlwe_params.rows_per_block / 2;
+  int num_blocks_per_fold = NumBlocksPerFold(rlwe_params);
+  bool is_valid = rns_context->LogN() == rlwe_params.log_n;
+  if (rlwe_params.compact_diagonals) {
+    is_valid = is_valid && diagonals.IsEmpty() &&
+               compact_diagonals.NumBlocks() % num_blocks_per_fold == 0 &&
+               compact_diagonals.NumDiagonalsPerBlock() ==
+                   num_diagonals_per_block &&
+               compact_diagonals.NumValuesPerDiagonal() == num_slots;
+  } else {
+    is_valid = is_valid && compact_diagonals.IsEmpty() &&
+               diagonals.NumBlocks() % num_blocks_per_fold == 0 &&
+               diagonals.NumDiagonalsPerBlock() == num_diagonals_per_block &&
+               diagonals.NumValuesPerDiagonal() == moduli.size() * num_slots;
+  }
+  if (!is_valid) {
+    return absl::InvalidArgumentError(
+        "`diagonals` do not match the RLWE parameters.");
   }
+  RLWE_ASSIGN_OR_RETURN(Encoder encoder, Encoder::Create(rns_context));
+  int num_baby_steps = EffectiveBabyStepSize(rlwe_params);
 
-  std::vector<RnsCiphertext> ct_inner_products_;
-  ct_inner_products_.reserve(diagonals.size());
   RLWE_ASSIGN_OR_RETURN(
-      auto rns_error_params,
-      rlwe::RnsErrorParams<ModularInt>::Create(
+      RnsErrorParams error_params,
+      RnsErrorParams::Create(
           rlwe_params.log_n, moduli, /*aux_moduli=*/{},
           std::log2(static_cast<double>(rns_context->PlaintextModulus())),
           std::sqrt(rlwe_params.error_variance)));
-
-  auto empty = rlwe::RnsRlweCiphertext<rlwe::MontgomeryInt<RlweInteger>>::CreateZero(
-    moduli,
-    &rns_error_params
-  );
-  for (int i = 0; i < diagonals.size(); ++i)
-	ct_inner_products_.push_back(RnsCiphertext(empty));
- 
-  return absl::WrapUnique(
-      new Database<RlweInteger>(rns_context, std::move(moduli),
-                                std::move(encoder), std::move(diagonals), std::move(ct_inner_products_)));
+  return absl::WrapUnique(new Database<RlweInteger>(
+      rns_context, std::move(moduli), std::move(encoder),
+      std::move(error_params), num_baby_steps, std::move(diagonals),
+      std::move(compact_diagonals)));
 }
 
 template <typename RlweInteger>
 absl::StatusOr<
     std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
 Database<RlweInteger>::InnerProductWith(
-    absl::Span<const RnsCiphertext> ct_rotated_queries) {
-  if (ct_rotated_queries.size() != diagonals_[0].size()) {
-    return absl::InvalidArgumentError(
-        "`ct_rotated_queries` does not contain correct number of ciphertexts.");
-  }
-
-  #pragma omp parallel for
-  for (int i = 0; i < diagonals_.size(); ++i) {
-    RnsCiphertext ct_inner_product = ct_rotated_queries[0].AbsorbSimple(diagonals_[i][0]).value();
-    for (int j = 1; j < ct_rotated_queries.size(); ++j) {
-      ct_inner_product.FusedAbsorbAddInPlace(ct_rotated_queries[j], diagonals_[i][j]);
-    }
-    ct_inner_products_[i] = std::move(ct_inner_product);
-  }
-  return ct_inner_products_;
+    absl::Span<const RnsCiphertext> ct_rotated_queries) const {
+  return InnerProduct(ct_rotated_queries, /*with_pads=*/true);
 }
 
 template <typename RlweInteger>
 absl::Status Database<RlweInteger>::Preprocess(
     absl::Span<const RnsPolynomial> pad_rotated_queries) {
-  if (pad_rotated_queries.size() != diagonals_[0].size()) {
+  if (pad_rotated_queries.size() != num_baby_steps_) {
     return absl::InvalidArgumentError(
         "`pad_rotated_queries` does not contain correct number of "
         "polynomials.");
   }
 
-  pad_inner_products_.clear();
-  pad_inner_products_.reserve(diagonals_.size());
-  for (int i = 0; i < diagonals_.size(); ++i) {
-    RLWE_ASSIGN_OR_RETURN(
-        RnsPolynomial pad_inner_product,
-        pad_rotated_queries[0].Mul(diagonals_[i][0], moduli_));
-    for (int j = 1; j < pad_rotated_queries.size(); ++j) {
-      RLWE_RETURN_IF_ERROR(pad_inner_product.FusedMulAddInPlace(
-          pad_rotated_queries[j], diagonals_[i][j], moduli_));
+  std::vector<absl::StatusOr<std::vector<RlweInteger>>> pad_results(
+      num_baby_steps_);
+#pragma omp parallel for
+  for (int j = 0; j < num_baby_steps_; ++j) {
+    pad_results[j] =
+        ExportResidues<ModularInt>(pad_rotated_queries[j], moduli_);
+  }
+  std::vector<std::vector<RlweInteger>> pad_residues;
+  pad_residues.reserve(num_baby_steps_);
+  for (auto& pad_result : pad_results) {
+    RLWE_ASSIGN_OR_RETURN(auto residues, std::move(pad_result));
+    pad_residues.push_back(std::move(residues));
+  }
+  std::vector<const RlweInteger*> pads(num_baby_steps_);
+  for (int j = 0; j < num_baby_steps_; ++j) {
+    pads[j] = pad_residues[j].data();
+  }
+
+  // Returns the pad inner product k, using `diagonals` and `scratch` as
+  // scratch space.
+  int num_coeffs = 1 << rns_context_->LogN();
+  auto pad_inner_product =
+      [&](int k, std::vector<const RlweInteger*>& diagonals,
+          GatherScratch& scratch) -> absl::StatusOr<RnsPolynomial> {
+    RLWE_RETURN_IF_ERROR(GatherDiagonals(k, /*first_rotation=*/0,
+                                         absl::MakeSpan(diagonals), scratch));
+    auto acc = LazyAccumulator::CreateZero(num_coeffs, moduli_);
+    RLWE_RETURN_IF_ERROR(acc.FusedMulAddInPlace(diagonals, pads, moduli_));
+    return acc.Export(moduli_);
+  };
+
+  int num_accumulators = NumAccumulators();
+  std::vector<absl::StatusOr<RnsPolynomial>> results(num_accumulators);
+#pragma omp parallel
+  {
+    std::vector<const RlweInteger*> diagonals(num_baby_steps_);
+    GatherScratch scratch;
+#pragma omp for schedule(dynamic)
+    for (int k = 0; k < num_accumulators; ++k) {
+      results[k] = pad_inner_product(k, diagonals, scratch);
     }
-    pad_inner_products_.push_back(std::move(pad_inner_product));
   }
+
+  std::vector<RnsPolynomial> pad_inner_products;
+  pad_inner_products.reserve(num_accumulators);
+  for (auto& result : results) {
+    RLWE_ASSIGN_OR_RETURN(RnsPolynomial pad_inner_product, std::move(result));
+    pad_inner_products.push_back(std::move(pad_inner_product));
+  }
+  pad_inner_products_ = std::move(pad_inner_products);
   return absl::OkStatus();
 }
 
@@ -176,30 +332,226 @@ template <typename RlweInteger>
 absl::StatusOr<
     std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
 Database<RlweInteger>::InnerProductWithPreprocessedPads(
-    absl::Span<const RnsCiphertext> ct_rotated_queries) {
-  if (pad_inner_products_.size() != diagonals_.size()) {
+    absl::Span<const RnsCiphertext> ct_rotated_queries) const {
+  if (!IsPreprocessed()) {
     return absl::FailedPreconditionError("There is no preprocessed data.");
   }
-  if (ct_rotated_queries.size() != diagonals_[0].size()) {
+  return InnerProduct(ct_rotated_queries, /*with_pads=*/false);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<
+    std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
+Database<RlweInteger>::InnerProduct(
+    absl::Span<const RnsCiphertext> ct_rotated_queries, bool with_pads) const {
+  if (ct_rotated_queries.size() != num_baby_steps_) {
     return absl::InvalidArgumentError(
         "`ct_rotated_queries` does not contain correct number of ciphertexts.");
   }
-  
-//  #pragma omp parallel for
-  
-  std::vector<RnsCiphertext> ct_inner_products;
-  ct_inner_products.reserve(diagonals_.size());
-  for (int i = 0; i < diagonals_.size(); ++i) {
-    RnsCiphertext ct_inner_product = ct_rotated_queries[0].AbsorbSimple(diagonals_[i][0]).value();
-    for (int j = 1; j < ct_rotated_queries.size(); ++j) {
-      ct_inner_product.FusedAbsorbAddInPlaceWithoutPad(ct_rotated_queries[j], diagonals_[i][j]);
+
+  std::vector<QueryResidues> rotated_queries;
+  rotated_queries.reserve(num_baby_steps_);
+  for (auto const& ct_rotated_query : ct_rotated_queries) {
+    RLWE_ASSIGN_OR_RETURN(
+        auto residues,
+        ExportCiphertextResidues<ModularInt>(ct_rotated_query, with_pads,
+                                             moduli_));
+    rotated_queries.push_back(std::move(residues));
+  }
+
+  int num_accumulators = NumAccumulators();
+  std::vector<Accumulator> accumulators(num_accumulators,
+                                        CreateZeroAccumulator(with_pads));
+  std::vector<absl::Status> statuses(num_accumulators);
+#pragma omp parallel
+  {
+    absl::StatusOr<GatherScratch> scratch =
+        CreateGatherScratch(num_baby_steps_);
+#pragma omp for
+    for (int k = 0; k < num_accumulators; ++k) {
+      statuses[k] = scratch.ok() ? AccumulateRotatedQueries(
+                                       k, /*first_rotation=*/0,
+                                       rotated_queries, with_pads,
+                                       accumulators[k], *scratch)
+                                 : scratch.status();
+    }
+  }
+  for (auto const& status : statuses) {
+    RLWE_RETURN_IF_ERROR(status);
+  }
+  return ExportAccumulators(accumulators, with_pads);
+}
+
+template <typename RlweInteger>
+typename Database<RlweInteger>::Accumulator
+Database<RlweInteger>::CreateZeroAccumulator(bool with_pads) const {
+  int num_coeffs = 1 << rns_context_->LogN();
+  Accumulator accumulator;
+  accumulator.b = LazyAccumulator::CreateZero(num_coeffs, moduli_);
+  if (with_pads) {
+    accumulator.a = LazyAccumulator::CreateZero(num_coeffs, moduli_);
+  }
+  return accumulator;
+}
+
+template <typename RlweInteger>
+absl::StatusOr<typename Database<RlweInteger>::GatherScratch>
+Database<RlweInteger>::CreateGatherScratch(int num_rotations) const {
+  GatherScratch scratch;
+  if (!HasCompactDiagonals()) {
+    return scratch;
+  }
+  int num_values = moduli_.size() * compact_diagonals_.NumValuesPerDiagonal();
+  scratch.residues.resize(std::max(num_rotations, 1) * num_values);
+  RLWE_ASSIGN_OR_RETURN(
+      scratch.poly,
+      RnsPolynomial::CreateZero(rns_context_->LogN(), moduli_,
+                                /*is_ntt=*/false));
+  return scratch;
+}
+
+template <typename RlweInteger>
+absl::Status Database<RlweInteger>::AccumulateRotatedQuery(
+    int rotation, const RnsCiphertext& ct_rotated_query, bool with_pads,
+    std::vector<Accumulator>& accumulators) const {
+  if (rotation < 0 || rotation >= num_baby_steps_) {
+    return absl::InvalidArgumentError("`rotation` is out of range.");
+  }
+
+  int num_accumulators = NumAccumulators();
+  if (rotation == 0) {
+    accumulators.assign(num_accumulators, CreateZeroAccumulator(with_pads));
+  } else if (accumulators.size() != num_accumulators) {
+    return absl::InvalidArgumentError(
+        "`accumulators` must be initialized by absorbing rotation 0.");
+  }
+
+  RLWE_ASSIGN_OR_RETURN(
+      QueryResidues rotated_query,
+      ExportCiphertextResidues<ModularInt>(ct_rotated_query, with_pads,
+                                           moduli_));
+  RLWE_ASSIGN_OR_RETURN(GatherScratch scratch,
+                        CreateGatherScratch(/*num_rotations=*/1));
+  for (int k = 0; k < num_accumulators; ++k) {
+    RLWE_RETURN_IF_ERROR(AccumulateRotatedQueries(
+        k, rotation, absl::MakeConstSpan(&rotated_query, 1), with_pads,
+        accumulators[k], scratch));
+  }
+  return absl::OkStatus();
+}
+
+template <typename RlweInteger>
+absl::Status Database<RlweInteger>::AccumulateRotatedQueries(
+    int k, int first_rotation,
+    absl::Span<const QueryResidues> rotated_queries, bool with_pads,
+    Accumulator& accumulator, GatherScratch& scratch) const {
+  if (k < 0 || k >= NumAccumulators()) {
+    return absl::InvalidArgumentError("`k` is out of range.");
+  }
+  if (first_rotation < 0 ||
+      first_rotation + rotated_queries.size() > num_baby_steps_) {
+    return absl::InvalidArgumentError("`first_rotation` is out of range.");
+  }
+  if (with_pads && accumulator.a.IsEmpty()) {
+    return absl::InvalidArgumentError(
+        "`accumulator` must have an \"a\" component.");
+  }
+
+  // Gather the operands of the lazy inner products, which are multiplied and
+  // summed up over all rotations at once.
+  absl::InlinedVector<const RlweInteger*, kMaxInlinedRotations> diagonals(
+      rotated_queries.size());
+  absl::InlinedVector<const RlweInteger*, kMaxInlinedRotations> query_bs;
+  absl::InlinedVector<const RlweInteger*, kMaxInlinedRotations> query_as;
+  int num_values = moduli_.size() * (1 << rns_context_->LogN());
+  for (int j = 0; j < rotated_queries.size(); ++j) {
+    if (rotated_queries[j].b.size() != num_values ||
+        (with_pads && rotated_queries[j].a.size() != num_values)) {
+      return absl::InvalidArgumentError(
+          "`rotated_queries` must hold residues modulo the RNS moduli.");
+    }
+    query_bs.push_back(rotated_queries[j].b.data());
+    if (with_pads) {
+      query_as.push_back(rotated_queries[j].a.data());
+    }
+  }
+  RLWE_RETURN_IF_ERROR(GatherDiagonals(k, first_rotation,
+                                       absl::MakeSpan(diagonals), scratch));
+  RLWE_RETURN_IF_ERROR(
+      accumulator.b.FusedMulAddInPlace(diagonals, query_bs, moduli_));
+  if (with_pads) {
+    RLWE_RETURN_IF_ERROR(
+        accumulator.a.FusedMulAddInPlace(diagonals, query_as, moduli_));
+  }
+  return absl::OkStatus();
+}
+
+template <typename RlweInteger>
+absl::Status Database<RlweInteger>::GatherDiagonals(
+    int k, int first_rotation, absl::Span<const RlweInteger*> diagonals,
+    GatherScratch& scratch) const {
+  int num_giant_steps = NumGiantSteps();
+  int block = k / num_giant_steps;
+  int first_diagonal = (k % num_giant_steps) * num_baby_steps_ + first_rotation;
+  if (!HasCompactDiagonals()) {
+    for (int j = 0; j < diagonals.size(); ++j) {
+      diagonals[j] = diagonals_.Diagonal(block, first_diagonal + j);
     }
-    ct_inner_product.SetPadComponent(pad_inner_products_[i]);
-    ct_inner_products.push_back(std::move(ct_inner_product));
-//    ct_inner_products_[i] = std::move(ct_inner_product);
+    return absl::OkStatus();
+  }
+
+  // Convert the compact diagonals to NTT form modulo the RNS moduli.
+  int num_coeffs = compact_diagonals_.NumValuesPerDiagonal();
+  int num_values = moduli_.size() * num_coeffs;
+  if (!scratch.poly.has_value() ||
+      scratch.residues.size() < diagonals.size() * num_values) {
+    RLWE_ASSIGN_OR_RETURN(scratch, CreateGatherScratch(diagonals.size()));
+  }
+  for (int j = 0; j < diagonals.size(); ++j) {
+    absl::Span<RlweInteger> residues =
+        absl::MakeSpan(scratch.residues).subspan(j * num_values, num_values);
+    RLWE_RETURN_IF_ERROR(ImportSmallCoeffs<ModularInt>(
+        absl::MakeConstSpan(
+            compact_diagonals_.Diagonal(block, first_diagonal + j),
+            num_coeffs),
+        rns_context_->PlaintextModulus(), moduli_, *scratch.poly, residues));
+    diagonals[j] = residues.data();
+  }
+  return absl::OkStatus();
+}
+
+template <typename RlweInteger>
+absl::StatusOr<
+    std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>
+Database<RlweInteger>::ExportAccumulators(
+    absl::Span<const Accumulator> accumulators, bool with_pads) const {
+  if (!with_pads && !IsPreprocessed()) {
+    return absl::FailedPreconditionError("There is no preprocessed data.");
+  }
+  if (accumulators.size() != NumAccumulators()) {
+    return absl::InvalidArgumentError(
+        "`accumulators` does not contain correct number of accumulators.");
   }
 
-//  return ct_inner_products_;
+  std::vector<RnsCiphertext> ct_inner_products;
+  ct_inner_products.reserve(accumulators.size());
+  for (int k = 0; k < accumulators.size(); ++k) {
+    std::vector<RnsPolynomial> components;
+    components.reserve(2);
+    RLWE_ASSIGN_OR_RETURN(RnsPolynomial ct_b,
+                          accumulators[k].b.Export(moduli_));
+    components.push_back(std::move(ct_b));
+    if (with_pads) {
+      RLWE_ASSIGN_OR_RETURN(RnsPolynomial ct_a,
+                            accumulators[k].a.Export(moduli_));
+      components.push_back(std::move(ct_a));
+    } else {
+      components.push_back(pad_inner_products_[k]);
+    }
+    ct_inner_products.push_back(RnsCiphertext(
+        std::move(components), moduli_, /*power_of_s=*/1, /*error=*/0,
+        &error_params_, rns_context_));
+  }
   return ct_inner_products;
 }
 
@@ -16,17 +16,23 @@
 #ifndef HINTLESS_PIR_LINPIR_DATABASE_H_
 #define HINTLESS_PIR_LINPIR_DATABASE_H_
 
+#include <cstddef>
 #include <memory>
+#include <optional>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "absl/types/span.h"
+#include "linpir/diagonal_storage.h"
 #include "linpir/parameters.h"
+#include "linpir/residues.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/rns/finite_field_encoder.h"
 #include "shell_encryption/rns/rns_bfv_ciphertext.h"
 #include "shell_encryption/rns/rns_context.h"
+#include "shell_encryption/rns/rns_error_params.h"
 #include "shell_encryption/rns/rns_modulus.h"
 #include "shell_encryption/rns/rns_polynomial.h"
 
@@ -44,43 +50,164 @@ class Database {
   using RnsContext = rlwe::RnsContext<ModularInt>;
   using RnsPolynomial = rlwe::RnsPolynomial<ModularInt>;
   using RnsCiphertext = rlwe::RnsBfvCiphertext<ModularInt>;
+  using RnsErrorParams = rlwe::RnsErrorParams<ModularInt>;
   using PrimeModulus = rlwe::PrimeModulus<ModularInt>;
   using Encoder = rlwe::FiniteFieldEncoder<ModularInt>;
+  using QueryResidues = CiphertextResidues<RlweInteger>;
+  using LazyAccumulator = LazyRnsAccumulator<ModularInt>;
+
+  // The partial result of an inner product with a query, holding the lazy sums
+  // of the "b" and, unless the pads are preprocessed, "a" components.
+  struct Accumulator {
+    LazyAccumulator b;
+    LazyAccumulator a;
+  };
+
+  // Scratch space for converting compact diagonals to NTT form, so that a
+  // task absorbing rotations does not allocate. It is empty if the diagonals
+  // are not compact.
+  struct GatherScratch {
+    std::vector<RlweInteger> residues;
+    std::optional<RnsPolynomial> poly;
+  };
 
   static absl::StatusOr<std::unique_ptr<Database>> Create(
       const RlweParameters<RlweInteger>& rlwe_params,
       const RnsContext* rns_context,
       const std::vector<std::vector<RlweInteger>>& data);
 
+  // Returns a database whose diagonals are mapped from the file at `path`,
+  // which must have been written by `WriteDiagonalsToFile` for the same
+  // parameters. The diagonals are paged in from the file on demand.
+  static absl::StatusOr<std::unique_ptr<Database>> CreateFromFile(
+      const RlweParameters<RlweInteger>& rlwe_params,
+      const RnsContext* rns_context, absl::string_view path);
+
+  // Writes the encoded diagonals to the file at `path`, so that the database
+  // can be loaded with `CreateFromFile` without encoding it again.
+  absl::Status WriteDiagonalsToFile(absl::string_view path) const {
+    return HasCompactDiagonals() ? compact_diagonals_.WriteToFile(path)
+                                 : diagonals_.WriteToFile(path);
+  }
+
   // Preprocess the database with the given random pads to speedup inner product
   // computation when query is available.
   absl::Status Preprocess(absl::Span<const RnsPolynomial> pad_rotated_queries);
 
   // Compute the matrix-vector product with the encrypted query vector.
+  // `ct_rotated_queries` holds the first `NumBabySteps()` rotations of the
+  // query vector, and the result holds `NumGiantSteps()` ciphertexts per block,
+  // where the one at index block * NumGiantSteps() + a must be rotated by
+  // a * NumBabySteps() before summing them up. Without baby-step giant-step
+  // rotations, there is one giant step and so one ciphertext per block.
   absl::StatusOr<std::vector<RnsCiphertext>> InnerProductWith(
-      absl::Span<const RnsCiphertext> ct_rotated_queries);
+      absl::Span<const RnsCiphertext> ct_rotated_queries) const;
 
   // Compute the matrix-vector product with the encrypted query vector when the
-  // database has been preprocessed.
+  // database has been preprocessed. The result is arranged as above.
   // Returns error if `Preprocess` has not been called.
   absl::StatusOr<std::vector<RnsCiphertext>> InnerProductWithPreprocessedPads(
-      absl::Span<const RnsCiphertext> ct_rotated_queries);
+      absl::Span<const RnsCiphertext> ct_rotated_queries) const;
+
+  // Returns an accumulator holding zero, with an "a" component if `with_pads`.
+  Accumulator CreateZeroAccumulator(bool with_pads) const;
+
+  // Returns the scratch space for absorbing up to `num_rotations` rotations at
+  // once with `AccumulateRotatedQueries`.
+  absl::StatusOr<GatherScratch> CreateGatherScratch(int num_rotations) const;
+
+  // Absorbs the query vector rotated by `rotation` < `NumBabySteps()` into
+  // `accumulators`, which hold the partial results arranged as in
+  // `InnerProductWith`. The rotations must be absorbed in order, and
+  // `accumulators` is (re)initialized by rotation 0. If `with_pads` is false,
+  // the "a" components are not accumulated, and `ExportAccumulators` sets them
+  // to the preprocessed pads.
+  // This lets the caller drop every rotation once it has been absorbed.
+  absl::Status AccumulateRotatedQuery(
+      int rotation, const RnsCiphertext& ct_rotated_query, bool with_pads,
+      std::vector<Accumulator>& accumulators) const;
+
+  // Absorbs the query vector rotated by `first_rotation`, `first_rotation` + 1,
+  // ..., as given by the residues in `rotated_queries`, into the single partial
+  // result `k` arranged as in `InnerProductWith`. `accumulator` must be
+  // created by `CreateZeroAccumulator`, and no memory is allocated if
+  // `scratch` is created by `CreateGatherScratch` for at least as many
+  // rotations, so that tasks over disjoint ranges of rotations can run
+  // concurrently on their own accumulators and scratch spaces and be summed up
+  // afterwards. The products are summed up lazily, so `accumulator` is only
+  // reduced by `ExportAccumulators`.
+  absl::Status AccumulateRotatedQueries(
+      int k, int first_rotation,
+      absl::Span<const QueryResidues> rotated_queries, bool with_pads,
+      Accumulator& accumulator, GatherScratch& scratch) const;
+
+  // Returns the ciphertexts holding the partial results in `accumulators`,
+  // where the "a" components are the preprocessed pads unless `with_pads`.
+  // Returns error if `with_pads` is false and `Preprocess` has not been called.
+  absl::StatusOr<std::vector<RnsCiphertext>> ExportAccumulators(
+      absl::Span<const Accumulator> accumulators, bool with_pads) const;
 
   // Accessors
-  int NumBlocks() const { return diagonals_.size(); }
-  int NumDiagonalsPerBlock() const { return diagonals_[0].size(); }
+  int NumBlocks() const {
+    return HasCompactDiagonals() ? compact_diagonals_.NumBlocks()
+                                 : diagonals_.NumBlocks();
+  }
+  int NumDiagonalsPerBlock() const {
+    return HasCompactDiagonals() ? compact_diagonals_.NumDiagonalsPerBlock()
+                                 : diagonals_.NumDiagonalsPerBlock();
+  }
+  int NumBabySteps() const { return num_baby_steps_; }
+  int NumGiantSteps() const { return NumDiagonalsPerBlock() / num_baby_steps_; }
+  int NumAccumulators() const { return NumBlocks() * NumGiantSteps(); }
   bool IsPreprocessed() const { return !pad_inner_products_.empty(); }
+  bool HasCompactDiagonals() const { return !compact_diagonals_.IsEmpty(); }
+
+  // Returns the number of bytes taken by the encoded diagonals.
+  size_t NumDiagonalBytes() const {
+    return diagonals_.NumBytes() + compact_diagonals_.NumBytes();
+  }
+
+  // Returns the "a" components of the results of
+  // `InnerProductWithPreprocessedPads`, arranged in the same order.
+  absl::Span<const RnsPolynomial> PadInnerProducts() const {
+    return pad_inner_products_;
+  }
 
  private:
   explicit Database(const RnsContext* rns_context,
                     std::vector<const PrimeModulus*> moduli, Encoder encoder,
-                    std::vector<std::vector<RnsPolynomial>> diagonals,
-                    std::vector<RnsCiphertext> ct_inner_products)
+                    RnsErrorParams error_params, int num_baby_steps,
+                    DiagonalStorage<RlweInteger> diagonals,
+                    DiagonalStorage<Uint32> compact_diagonals)
       : rns_context_(rns_context),
         moduli_(std::move(moduli)),
         encoder_(std::move(encoder)),
+        error_params_(std::move(error_params)),
+        num_baby_steps_(num_baby_steps),
         diagonals_(std::move(diagonals)),
-        ct_inner_products_(std::move(ct_inner_products)) {}
+        compact_diagonals_(std::move(compact_diagonals)) {}
+
+  // Returns a database with the given encoded diagonals, exactly one of which
+  // is non-empty as selected by `rlwe_params.compact_diagonals`, after
+  // checking that they match the parameters.
+  static absl::StatusOr<std::unique_ptr<Database>> CreateWithDiagonals(
+      const RlweParameters<RlweInteger>& rlwe_params,
+      const RnsContext* rns_context, DiagonalStorage<RlweInteger> diagonals,
+      DiagonalStorage<Uint32> compact_diagonals);
+
+  // Sets `diagonals` to the residues of the diagonals multiplied with the
+  // query rotated by `first_rotation`, `first_rotation` + 1, ... in the partial
+  // result `k`, arranged as in `InnerProductWith`. The diagonals for
+  // consecutive rotations are adjacent in memory. Compact diagonals are
+  // converted to NTT form in `scratch`, which is grown as needed.
+  absl::Status GatherDiagonals(int k, int first_rotation,
+                               absl::Span<const RlweInteger*> diagonals,
+                               GatherScratch& scratch) const;
+
+  // Computes all partial results of the inner product with the rotated queries.
+  absl::StatusOr<std::vector<RnsCiphertext>> InnerProduct(
+      absl::Span<const RnsCiphertext> ct_rotated_queries,
+      bool with_pads) const;
 
   const RnsContext* rns_context_;
 
@@ -88,16 +215,28 @@ class Database {
 
   const Encoder encoder_;
 
+  const RnsErrorParams error_params_;
+
+  // The number of query rotations that the diagonals are multiplied with.
+  const int num_baby_steps_;
+
   // Database matrix arranged into blocks of sub-matrices, where each sub-matrix
-  // is stored as a vector of diagonals packed in RnsPolynomial.
-  std::vector<std::vector<RnsPolynomial>> diagonals_;
+  // is stored as a vector of diagonals packed in RNS polynomials in NTT form,
+  // as residues arranged as in `ExportResidues`. With baby-step giant-step
+  // rotations, the diagonal a * NumBabySteps() + b is stored rotated by
+  // -a * NumBabySteps(). With `fold_blocks`, the blocks are grouped into folds
+  // of `NumBlocksPerFold()` blocks whose windows of rows_per_block slots hold
+  // the rows of permuted blocks in the fold, as explained in `Create`.
+  DiagonalStorage<RlweInteger> diagonals_;
+
+  // If `compact_diagonals` is set in the parameters, the diagonals above are
+  // empty and instead stored as coefficients modulo the plaintext modulus, as
+  // given by `ExportSmallCoeffs`.
+  DiagonalStorage<Uint32> compact_diagonals_;
 
   // The random pads, i.e. the "a" parts, of the ciphertexts encrypting the
   // matrix-vector products between the blocks of diagonals and the query vector
   std::vector<RnsPolynomial> pad_inner_products_;
-
-  // TODO
-  std::vector<RnsCiphertext> ct_inner_products_;
 };
 
 }  // namespace linpir
@@ -16,6 +16,7 @@
 
 #include <cmath>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -24,6 +25,7 @@
 #include "absl/strings/string_view.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "linpir/inner_product_hwy.h"
 #include "linpir/parameters.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
@@ -157,6 +159,66 @@ TEST_F(DatabaseTest, CreateDatabase) {
   EXPECT_EQ(database->NumDiagonalsPerBlock(), expected_num_diags_per_block);
 }
 
+TEST_F(DatabaseTest, CreateFromFileFailsIfParametersMismatch) {
+  auto data = SampleMatrix(kNumRows, kNumCols, 16);
+  ASSERT_OK_AND_ASSIGN(
+      auto database,
+      Database<Integer>::Create(this->params_, this->rns_context_.get(), data));
+  std::string path = ::testing::TempDir() + "/mismatched_diagonals";
+  ASSERT_OK(database->WriteDiagonalsToFile(path));
+
+  RlweParameters<Integer> params = this->params_;
+  params.rows_per_block /= 2;
+  EXPECT_THAT(Database<Integer>::CreateFromFile(params,
+                                                this->rns_context_.get(), path),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("do not match the RLWE parameters")));
+}
+
+TEST_F(DatabaseTest, CreateFromFileMatchesCreate) {
+  auto data = SampleMatrix(2 * this->params_.rows_per_block + 1, kNumCols, 16);
+  ASSERT_OK_AND_ASSIGN(
+      auto database,
+      Database<Integer>::Create(this->params_, this->rns_context_.get(), data));
+  std::string path = ::testing::TempDir() + "/diagonals";
+  ASSERT_OK(database->WriteDiagonalsToFile(path));
+  ASSERT_OK_AND_ASSIGN(auto mapped_database,
+                       Database<Integer>::CreateFromFile(
+                           this->params_, this->rns_context_.get(), path));
+  EXPECT_EQ(mapped_database->NumBlocks(), database->NumBlocks());
+  EXPECT_EQ(mapped_database->NumDiagonalsPerBlock(),
+            database->NumDiagonalsPerBlock());
+
+  // Both databases compute the same inner products.
+  ASSERT_OK_AND_ASSIGN(auto prng, Prng::Create(kPrngSeed));
+  ASSERT_OK_AND_ASSIGN(
+      RnsSecretKey secret_key,
+      RnsSecretKey::Sample(this->params_.log_n, this->params_.error_variance,
+                           this->moduli_, prng.get()));
+  int num_slots = 1 << this->params_.log_n;
+  std::vector<RnsCiphertext> ct_rotated_queries;
+  for (int i = 0; i < database->NumBabySteps(); ++i) {
+    ASSERT_OK_AND_ASSIGN(RnsCiphertext ct_query,
+                         secret_key.template EncryptBfv<Encoder>(
+                             SampleValues(num_slots, 16), this->encoder_.get(),
+                             this->error_params_.get(), prng.get()));
+    ct_rotated_queries.push_back(std::move(ct_query));
+  }
+  ASSERT_OK_AND_ASSIGN(auto expected,
+                       database->InnerProductWith(ct_rotated_queries));
+  ASSERT_OK_AND_ASSIGN(auto actual,
+                       mapped_database->InnerProductWith(ct_rotated_queries));
+  ASSERT_EQ(actual.size(), expected.size());
+  for (int i = 0; i < actual.size(); ++i) {
+    ASSERT_OK_AND_ASSIGN(auto actual_b, actual[i].Component(0));
+    ASSERT_OK_AND_ASSIGN(auto expected_b, expected[i].Component(0));
+    ASSERT_OK_AND_ASSIGN(auto actual_a, actual[i].Component(1));
+    ASSERT_OK_AND_ASSIGN(auto expected_a, expected[i].Component(1));
+    EXPECT_EQ(actual_b, expected_b);
+    EXPECT_EQ(actual_a, expected_a);
+  }
+}
+
 TEST_F(DatabaseTest, InnerProductFailsIfIncorrectNumberOfQueryCiphertexts) {
   std::vector<Integer> row(1, 0);
   ASSERT_OK_AND_ASSIGN(auto database,
@@ -219,6 +281,128 @@ TEST_F(DatabaseTest, InnerProduct) {
   }
 }
 
+TEST_F(DatabaseTest, InnerProductWithLargeModuli) {
+  // With 60-bit moduli only 256 products can be summed up lazily, which is
+  // fewer than the baby steps of a block, so the sums are reduced midway.
+  RlweParameters<Integer> params = this->params_;
+  params.qs = {1152921504606830593ULL, 1152921504606748673ULL};  // 120 bits
+  int num_rotations = params.rows_per_block / 2;
+  for (Integer q : params.qs) {
+    ASSERT_LT(internal::MaxNumLazyTerms<Integer>(q), num_rotations);
+  }
+  ASSERT_OK_AND_ASSIGN(auto rns_context,
+                       RnsContext::CreateForBfvFiniteFieldEncoding(
+                           params.log_n, params.qs, /*ps=*/{}, params.ts[0]));
+  auto moduli = rns_context.MainPrimeModuli();
+  ASSERT_OK_AND_ASSIGN(
+      auto error_params,
+      RnsErrorParams::Create(
+          params.log_n, moduli, {},
+          std::log2(static_cast<double>(rns_context.PlaintextModulus())),
+          std::sqrt(params.error_variance)));
+  ASSERT_OK_AND_ASSIGN(auto encoder, Encoder::Create(&rns_context));
+
+  auto data = SampleMatrix(kNumRows, kNumCols, 16);
+  ASSERT_OK_AND_ASSIGN(auto database,
+                       Database<Integer>::Create(params, &rns_context, data));
+  ASSERT_OK_AND_ASSIGN(auto prng, Prng::Create(kPrngSeed));
+  ASSERT_OK_AND_ASSIGN(RnsSecretKey secret_key,
+                       RnsSecretKey::Sample(params.log_n, params.error_variance,
+                                            moduli, prng.get()));
+
+  // Encrypt rotations of a unit vector "u" selecting the third column, as in
+  // the `InnerProduct` test.
+  constexpr int index = 2;
+  int num_slots_per_group = 1 << (params.log_n - 1);
+  std::vector<RnsCiphertext> ct_rotated_queries;
+  for (int i = 0; i < num_rotations; ++i) {
+    std::vector<Integer> slots(num_slots_per_group * 2, 0);
+    int fst_idx = (num_slots_per_group + index - i) % num_slots_per_group;
+    int snd_idx =
+        (num_slots_per_group - num_rotations + index - i) % num_slots_per_group;
+    slots[fst_idx] = 1;
+    slots[snd_idx + num_slots_per_group] = 1;
+    ASSERT_OK_AND_ASSIGN(RnsCiphertext ct_query,
+                         secret_key.template EncryptBfv<Encoder>(
+                             slots, &encoder, &error_params, prng.get()));
+    ct_rotated_queries.push_back(std::move(ct_query));
+  }
+  ASSERT_OK_AND_ASSIGN(auto ct_inner_products,
+                       database->InnerProductWith(ct_rotated_queries));
+  ASSERT_EQ(ct_inner_products.size(), 1);
+  ASSERT_OK_AND_ASSIGN(auto decrypted,
+                       secret_key.template DecryptBfv<Encoder>(
+                           ct_inner_products[0], &encoder));
+  ASSERT_EQ(decrypted.size(), num_slots_per_group * 2);
+
+  std::vector<Integer> results(params.rows_per_block, 0);
+  for (int i = 0; i < num_slots_per_group; ++i) {
+    results[i % params.rows_per_block] += decrypted[i];
+    results[i % params.rows_per_block] += decrypted[num_slots_per_group + i];
+  }
+  for (int i = 0; i < kNumRows; ++i) {
+    EXPECT_EQ(results[i] % rns_context.PlaintextModulus(), data[i][index]);
+  }
+}
+
+TEST_F(DatabaseTest, CompactDiagonalsMatchFullDiagonals) {
+  auto data = SampleMatrix(kNumRows, kNumCols,
+                           this->rns_context_->PlaintextModulus());
+  ASSERT_OK_AND_ASSIGN(
+      auto database,
+      Database<Integer>::Create(this->params_, this->rns_context_.get(), data));
+  RlweParameters<Integer> compact_params = this->params_;
+  compact_params.compact_diagonals = true;
+  ASSERT_OK_AND_ASSIGN(auto compact_database,
+                       Database<Integer>::Create(
+                           compact_params, this->rns_context_.get(), data));
+  EXPECT_FALSE(database->HasCompactDiagonals());
+  EXPECT_TRUE(compact_database->HasCompactDiagonals());
+  EXPECT_EQ(compact_database->NumDiagonalBytes() * 2 * this->moduli_.size(),
+            database->NumDiagonalBytes());
+
+  // Both databases compute inner products decrypting to the same values.
+  ASSERT_OK_AND_ASSIGN(auto prng, Prng::Create(kPrngSeed));
+  ASSERT_OK_AND_ASSIGN(
+      RnsSecretKey secret_key,
+      RnsSecretKey::Sample(this->params_.log_n, this->params_.error_variance,
+                           this->moduli_, prng.get()));
+  int num_slots = 1 << this->params_.log_n;
+  std::vector<RnsCiphertext> ct_rotated_queries;
+  for (int i = 0; i < database->NumBabySteps(); ++i) {
+    ASSERT_OK_AND_ASSIGN(RnsCiphertext ct_query,
+                         secret_key.template EncryptBfv<Encoder>(
+                             SampleValues(num_slots, 2), this->encoder_.get(),
+                             this->error_params_.get(), prng.get()));
+    ct_rotated_queries.push_back(std::move(ct_query));
+  }
+  ASSERT_OK_AND_ASSIGN(auto expected,
+                       database->InnerProductWith(ct_rotated_queries));
+  ASSERT_OK_AND_ASSIGN(auto actual,
+                       compact_database->InnerProductWith(ct_rotated_queries));
+  ASSERT_EQ(actual.size(), expected.size());
+  for (int i = 0; i < actual.size(); ++i) {
+    ASSERT_OK_AND_ASSIGN(auto expected_values,
+                         secret_key.template DecryptBfv<Encoder>(
+                             expected[i], this->encoder_.get()));
+    ASSERT_OK_AND_ASSIGN(auto actual_values,
+                         secret_key.template DecryptBfv<Encoder>(
+                             actual[i], this->encoder_.get()));
+    EXPECT_EQ(actual_values, expected_values);
+  }
+
+  // Compact diagonals are written to and mapped from files as well.
+  std::string path = ::testing::TempDir() + "/compact_diagonals";
+  ASSERT_OK(compact_database->WriteDiagonalsToFile(path));
+  EXPECT_THAT(Database<Integer>::CreateFromFile(this->params_,
+                                                this->rns_context_.get(), path),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  ASSERT_OK_AND_ASSIGN(auto mapped_database,
+                       Database<Integer>::CreateFromFile(
+                           compact_params, this->rns_context_.get(), path));
+  EXPECT_TRUE(mapped_database->HasCompactDiagonals());
+}
+
 TEST_F(DatabaseTest, PreprocessFailsIfIncorrectNumberOfRandomPads) {
   std::vector<Integer> row(1, 0);
   ASSERT_OK_AND_ASSIGN(auto database,
@@ -274,6 +458,39 @@ TEST_F(DatabaseTest,
                HasSubstr("ct_rotated_queries")));
 }
 
+TEST_F(DatabaseTest, AccumulateRotatedQueryFailsIfNotStartedWithRotationZero) {
+  std::vector<Integer> row(1, 0);
+  ASSERT_OK_AND_ASSIGN(auto database,
+                       Database<Integer>::Create(
+                           this->params_, this->rns_context_.get(), {row}));
+
+  ASSERT_OK_AND_ASSIGN(auto prng, Prng::Create(kPrngSeed));
+  ASSERT_OK_AND_ASSIGN(
+      RnsSecretKey secret_key,
+      RnsSecretKey::Sample(this->params_.log_n, this->params_.error_variance,
+                           this->moduli_, prng.get()));
+  int num_slots = 1 << this->params_.log_n;
+  std::vector<Integer> slots(num_slots, 0);
+  ASSERT_OK_AND_ASSIGN(
+      RnsCiphertext ct_query,
+      secret_key.template EncryptBfv<Encoder>(
+          slots, this->encoder_.get(), this->error_params_.get(), prng.get()));
+
+  std::vector<Database<Integer>::Accumulator> accumulators;
+  EXPECT_THAT(database->AccumulateRotatedQuery(1, ct_query, /*with_pads=*/true,
+                                               accumulators),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("rotation 0")));
+  EXPECT_THAT(database->AccumulateRotatedQuery(database->NumBabySteps(),
+                                               ct_query, /*with_pads=*/true,
+                                               accumulators),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("out of range")));
+  ASSERT_OK(database->AccumulateRotatedQuery(0, ct_query, /*with_pads=*/true,
+                                             accumulators));
+  EXPECT_EQ(accumulators.size(), database->NumBlocks());
+}
+
 TEST_F(DatabaseTest, InnerProductWithPreprocessing) {
   auto data = SampleMatrix(kNumRows, kNumCols, 16);
   ASSERT_OK_AND_ASSIGN(
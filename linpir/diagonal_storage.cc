@@ -0,0 +1,260 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "linpir/diagonal_storage.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "linpir/parameters.h"
+
+namespace hintless_pir {
+namespace linpir {
+
+namespace {
+
+// The file starts with a header of `kHeaderSize` bytes, so that the residues
+// following it are aligned as in memory when the file is mapped.
+constexpr uint64_t kMagic = 0x4741524f54534744ULL;  // "DGSTORAG"
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = 64;
+
+struct FileHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t int_size;
+  uint64_t num_blocks;
+  uint64_t num_diagonals_per_block;
+  uint64_t num_values_per_diagonal;
+};
+static_assert(sizeof(FileHeader) <= kHeaderSize);
+
+inline size_t RoundUp(size_t x, size_t y) { return (x + y - 1) / y * y; }
+
+// Returns whether `num_bytes` is the size of the residues described by
+// `header`, whose dimensions must be positive. The size is divided by each
+// dimension rather than compared with their product, which a corrupt header
+// could make wrap around.
+bool IsPayloadSize(uint64_t num_bytes, const FileHeader& header) {
+  for (uint64_t factor : {uint64_t{header.int_size}, header.num_blocks,
+                          header.num_diagonals_per_block}) {
+    if (num_bytes % factor != 0) {
+      return false;
+    }
+    num_bytes /= factor;
+  }
+  return num_bytes == header.num_values_per_diagonal;
+}
+
+// Writes all `size` bytes at `data` to the file descriptor `fd`.
+absl::Status WriteFully(int fd, const char* data, size_t size) {
+  while (size > 0) {
+    ssize_t num_written = write(fd, data, size);
+    if (num_written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return absl::ErrnoToStatus(errno, "Failed to write diagonals");
+    }
+    data += num_written;
+    size -= num_written;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+template <typename Int>
+absl::StatusOr<DiagonalStorage<Int>> DiagonalStorage<Int>::Create(
+    int num_blocks, int num_diagonals_per_block, int num_values_per_diagonal) {
+  if (num_blocks <= 0 || num_diagonals_per_block <= 0 ||
+      num_values_per_diagonal <= 0) {
+    return absl::InvalidArgumentError(
+        "The number of blocks, diagonals, and values must be positive.");
+  }
+  size_t num_bytes = sizeof(Int) * num_blocks * num_diagonals_per_block *
+                     static_cast<size_t>(num_values_per_diagonal);
+  size_t region_size = RoundUp(num_bytes, kAlignment);
+  void* region = std::aligned_alloc(kAlignment, region_size);
+  if (region == nullptr) {
+    return absl::ResourceExhaustedError(
+        absl::StrCat("Failed to allocate ", region_size, " bytes."));
+  }
+  std::memset(region, 0, region_size);
+  return DiagonalStorage(region, region_size, /*is_mapped=*/false,
+                         static_cast<Int*>(region), num_blocks,
+                         num_diagonals_per_block, num_values_per_diagonal);
+}
+
+template <typename Int>
+absl::StatusOr<DiagonalStorage<Int>> DiagonalStorage<Int>::MapFromFile(
+    absl::string_view path) {
+  std::string filename(path);
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to open ", path));
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    int error = errno;
+    close(fd);
+    return absl::ErrnoToStatus(error, absl::StrCat("Failed to stat ", path));
+  }
+  size_t file_size = file_stat.st_size;
+  if (file_size < kHeaderSize) {
+    close(fd);
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " is too small to hold diagonals."));
+  }
+
+  // A private mapping lets the caller write to the residues without changing
+  // the file.
+  void* region = mmap(nullptr, file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                      fd, /*offset=*/0);
+  int error = errno;
+  close(fd);
+  if (region == MAP_FAILED) {
+    return absl::ErrnoToStatus(error, absl::StrCat("Failed to map ", path));
+  }
+
+  FileHeader header;
+  std::memcpy(&header, region, sizeof(header));
+  absl::Status status = absl::OkStatus();
+  if (header.magic != kMagic || header.version != kVersion) {
+    status = absl::InvalidArgumentError(
+        absl::StrCat(path, " does not hold diagonals."));
+  } else if (header.int_size != sizeof(Int)) {
+    status = absl::InvalidArgumentError(
+        absl::StrCat(path, " holds diagonals of a different integer type."));
+  } else if (header.num_blocks == 0 || header.num_diagonals_per_block == 0 ||
+             header.num_values_per_diagonal == 0 ||
+             header.num_blocks > std::numeric_limits<int>::max() ||
+             header.num_diagonals_per_block > std::numeric_limits<int>::max() ||
+             header.num_values_per_diagonal >
+                 std::numeric_limits<int>::max()) {
+    status = absl::InvalidArgumentError(
+        absl::StrCat(path, " has an invalid header."));
+  } else if (!IsPayloadSize(file_size - kHeaderSize, header)) {
+    status = absl::InvalidArgumentError(
+        absl::StrCat(path, " does not match the size in its header."));
+  }
+  if (!status.ok()) {
+    munmap(region, file_size);
+    return status;
+  }
+
+  Int* data = reinterpret_cast<Int*>(static_cast<char*>(region) + kHeaderSize);
+  return DiagonalStorage(region, file_size, /*is_mapped=*/true, data,
+                         header.num_blocks, header.num_diagonals_per_block,
+                         header.num_values_per_diagonal);
+}
+
+template <typename Int>
+absl::Status DiagonalStorage<Int>::WriteToFile(absl::string_view path) const {
+  if (IsEmpty()) {
+    return absl::FailedPreconditionError("There are no diagonals to write.");
+  }
+
+  char header_bytes[kHeaderSize] = {0};
+  FileHeader header{.magic = kMagic,
+                    .version = kVersion,
+                    .int_size = sizeof(Int),
+                    .num_blocks = static_cast<uint64_t>(num_blocks_),
+                    .num_diagonals_per_block =
+                        static_cast<uint64_t>(num_diagonals_per_block_),
+                    .num_values_per_diagonal =
+                        static_cast<uint64_t>(num_values_per_diagonal_)};
+  std::memcpy(header_bytes, &header, sizeof(header));
+
+  std::string filename(path);
+  int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return absl::ErrnoToStatus(errno, absl::StrCat("Failed to open ", path));
+  }
+  absl::Status status = WriteFully(fd, header_bytes, kHeaderSize);
+  if (status.ok()) {
+    status = WriteFully(fd, reinterpret_cast<const char*>(data_), NumBytes());
+  }
+  if (close(fd) != 0 && status.ok()) {
+    status = absl::ErrnoToStatus(errno, absl::StrCat("Failed to close ", path));
+  }
+  return status;
+}
+
+template <typename Int>
+DiagonalStorage<Int>::DiagonalStorage(DiagonalStorage&& other)
+    : region_(std::exchange(other.region_, nullptr)),
+      region_size_(std::exchange(other.region_size_, 0)),
+      is_mapped_(std::exchange(other.is_mapped_, false)),
+      data_(std::exchange(other.data_, nullptr)),
+      num_blocks_(std::exchange(other.num_blocks_, 0)),
+      num_diagonals_per_block_(
+          std::exchange(other.num_diagonals_per_block_, 0)),
+      num_values_per_diagonal_(
+          std::exchange(other.num_values_per_diagonal_, 0)) {}
+
+template <typename Int>
+DiagonalStorage<Int>& DiagonalStorage<Int>::operator=(DiagonalStorage&& other) {
+  if (this != &other) {
+    Release();
+    region_ = std::exchange(other.region_, nullptr);
+    region_size_ = std::exchange(other.region_size_, 0);
+    is_mapped_ = std::exchange(other.is_mapped_, false);
+    data_ = std::exchange(other.data_, nullptr);
+    num_blocks_ = std::exchange(other.num_blocks_, 0);
+    num_diagonals_per_block_ = std::exchange(other.num_diagonals_per_block_, 0);
+    num_values_per_diagonal_ = std::exchange(other.num_values_per_diagonal_, 0);
+  }
+  return *this;
+}
+
+template <typename Int>
+DiagonalStorage<Int>::~DiagonalStorage() {
+  Release();
+}
+
+template <typename Int>
+void DiagonalStorage<Int>::Release() {
+  if (region_ != nullptr) {
+    if (is_mapped_) {
+      munmap(region_, region_size_);
+    } else {
+      std::free(region_);
+    }
+  }
+  region_ = nullptr;
+  region_size_ = 0;
+  data_ = nullptr;
+}
+
+template class DiagonalStorage<Uint32>;
+template class DiagonalStorage<Uint64>;
+
+}  // namespace linpir
+}  // namespace hintless_pir
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LINPIR_DIAGONAL_STORAGE_H_
+#define HINTLESS_PIR_LINPIR_DIAGONAL_STORAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+
+namespace hintless_pir {
+namespace linpir {
+
+// Packed storage of the residues of the database diagonals in a single
+// contiguous buffer, aligned to a cache line. The diagonals of a block are
+// stored one after the other, and blocks one after the other, which is the
+// order in which the inner product sweeps over them: the diagonals multiplied
+// with the baby-step rotations of the query for one partial result are
+// adjacent in memory.
+//
+// The buffer can be written to a file and mapped back into memory, so that a
+// server can load a preprocessed database without re-encoding it. The file
+// holds a small header followed by the raw residues in host byte order, so it
+// is only meant to be read on the machine type that wrote it.
+template <typename Int>
+class DiagonalStorage {
+ public:
+  // The alignment of the buffer, in bytes.
+  static constexpr size_t kAlignment = 64;
+
+  // An empty storage, which holds no diagonals.
+  DiagonalStorage() = default;
+
+  // Returns a storage holding `num_blocks` blocks of `num_diagonals_per_block`
+  // diagonals of `num_values_per_diagonal` residues each, all set to zero.
+  static absl::StatusOr<DiagonalStorage> Create(int num_blocks,
+                                                int num_diagonals_per_block,
+                                                int num_values_per_diagonal);
+
+  // Returns a storage backed by a private memory mapping of the file at
+  // `path`, which must have been written by `WriteToFile`. The residues are
+  // paged in on demand, and writes to the storage are not written back.
+  static absl::StatusOr<DiagonalStorage> MapFromFile(absl::string_view path);
+
+  // Writes the storage to the file at `path`, replacing it if it exists.
+  absl::Status WriteToFile(absl::string_view path) const;
+
+  DiagonalStorage(DiagonalStorage&& other);
+  DiagonalStorage& operator=(DiagonalStorage&& other);
+  DiagonalStorage(const DiagonalStorage&) = delete;
+  DiagonalStorage& operator=(const DiagonalStorage&) = delete;
+  ~DiagonalStorage();
+
+  // Returns the residues of the `diagonal`'th diagonal in block `block`.
+  const Int* Diagonal(int block, int diagonal) const {
+    return data_ + Offset(block, diagonal);
+  }
+  absl::Span<Int> MutableDiagonal(int block, int diagonal) {
+    return absl::MakeSpan(data_ + Offset(block, diagonal),
+                          num_values_per_diagonal_);
+  }
+
+  // Accessors
+  int NumBlocks() const { return num_blocks_; }
+  int NumDiagonalsPerBlock() const { return num_diagonals_per_block_; }
+  int NumValuesPerDiagonal() const { return num_values_per_diagonal_; }
+  bool IsEmpty() const { return data_ == nullptr; }
+  bool IsMapped() const { return is_mapped_; }
+
+  // Returns the number of bytes taken by the residues.
+  size_t NumBytes() const {
+    return sizeof(Int) * num_blocks_ * num_diagonals_per_block_ *
+           num_values_per_diagonal_;
+  }
+
+ private:
+  DiagonalStorage(void* region, size_t region_size, bool is_mapped,
+                  Int* data, int num_blocks, int num_diagonals_per_block,
+                  int num_values_per_diagonal)
+      : region_(region),
+        region_size_(region_size),
+        is_mapped_(is_mapped),
+        data_(data),
+        num_blocks_(num_blocks),
+        num_diagonals_per_block_(num_diagonals_per_block),
+        num_values_per_diagonal_(num_values_per_diagonal) {}
+
+  size_t Offset(int block, int diagonal) const {
+    return (static_cast<size_t>(block) * num_diagonals_per_block_ + diagonal) *
+           num_values_per_diagonal_;
+  }
+
+  // Releases the buffer, either by freeing or unmapping it.
+  void Release();
+
+  // The allocated or mapped memory region, which contains the residues.
+  void* region_ = nullptr;
+  size_t region_size_ = 0;
+  bool is_mapped_ = false;
+
+  Int* data_ = nullptr;
+  int num_blocks_ = 0;
+  int num_diagonals_per_block_ = 0;
+  int num_values_per_diagonal_ = 0;
+};
+
+}  // namespace linpir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LINPIR_DIAGONAL_STORAGE_H_
@@ -0,0 +1,159 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "linpir/diagonal_storage.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "linpir/parameters.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace linpir {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+using ::testing::HasSubstr;
+
+constexpr int kNumBlocks = 3;
+constexpr int kNumDiagonalsPerBlock = 4;
+constexpr int kNumValuesPerDiagonal = 10;
+
+// Returns a storage where each value encodes its position.
+DiagonalStorage<Uint64> CreateStorage() {
+  auto storage = DiagonalStorage<Uint64>::Create(
+                     kNumBlocks, kNumDiagonalsPerBlock, kNumValuesPerDiagonal)
+                     .value();
+  for (int i = 0; i < kNumBlocks; ++i) {
+    for (int j = 0; j < kNumDiagonalsPerBlock; ++j) {
+      auto diagonal = storage.MutableDiagonal(i, j);
+      for (int k = 0; k < kNumValuesPerDiagonal; ++k) {
+        diagonal[k] = (i * kNumDiagonalsPerBlock + j) * 1000 + k;
+      }
+    }
+  }
+  return storage;
+}
+
+TEST(DiagonalStorageTest, CreateFailsIfDimensionIsNotPositive) {
+  EXPECT_THAT(DiagonalStorage<Uint64>::Create(0, 1, 1),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must be positive")));
+  EXPECT_THAT(DiagonalStorage<Uint64>::Create(1, 0, 1),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must be positive")));
+  EXPECT_THAT(DiagonalStorage<Uint64>::Create(1, 1, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("must be positive")));
+}
+
+TEST(DiagonalStorageTest, DiagonalsAreContiguousAndAligned) {
+  DiagonalStorage<Uint64> storage = CreateStorage();
+  EXPECT_FALSE(storage.IsMapped());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(storage.Diagonal(0, 0)) %
+                DiagonalStorage<Uint64>::kAlignment,
+            0);
+  for (int i = 0; i < kNumBlocks; ++i) {
+    for (int j = 0; j < kNumDiagonalsPerBlock; ++j) {
+      EXPECT_EQ(storage.Diagonal(i, j),
+                storage.Diagonal(0, 0) +
+                    (i * kNumDiagonalsPerBlock + j) * kNumValuesPerDiagonal);
+    }
+  }
+}
+
+TEST(DiagonalStorageTest, WriteAndMapFromFile) {
+  DiagonalStorage<Uint64> storage = CreateStorage();
+  std::string path = ::testing::TempDir() + "/diagonal_storage";
+  ASSERT_OK(storage.WriteToFile(path));
+
+  ASSERT_OK_AND_ASSIGN(auto mapped, DiagonalStorage<Uint64>::MapFromFile(path));
+  EXPECT_TRUE(mapped.IsMapped());
+  EXPECT_EQ(mapped.NumBlocks(), kNumBlocks);
+  EXPECT_EQ(mapped.NumDiagonalsPerBlock(), kNumDiagonalsPerBlock);
+  EXPECT_EQ(mapped.NumValuesPerDiagonal(), kNumValuesPerDiagonal);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(mapped.Diagonal(0, 0)) %
+                DiagonalStorage<Uint64>::kAlignment,
+            0);
+  for (int i = 0; i < kNumBlocks; ++i) {
+    for (int j = 0; j < kNumDiagonalsPerBlock; ++j) {
+      for (int k = 0; k < kNumValuesPerDiagonal; ++k) {
+        EXPECT_EQ(mapped.Diagonal(i, j)[k], storage.Diagonal(i, j)[k]);
+      }
+    }
+  }
+
+  // Moving the storage keeps the mapping alive.
+  DiagonalStorage<Uint64> moved = std::move(mapped);
+  EXPECT_TRUE(moved.IsMapped());
+  EXPECT_EQ(moved.Diagonal(kNumBlocks - 1, 0)[1],
+            storage.Diagonal(kNumBlocks - 1, 0)[1]);
+}
+
+TEST(DiagonalStorageTest, MapFromFileFailsIfIntegerTypeMismatch) {
+  DiagonalStorage<Uint64> storage = CreateStorage();
+  std::string path = ::testing::TempDir() + "/diagonal_storage_uint64";
+  ASSERT_OK(storage.WriteToFile(path));
+  EXPECT_THAT(DiagonalStorage<Uint32>::MapFromFile(path),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("different integer type")));
+}
+
+TEST(DiagonalStorageTest, MapFromFileFailsIfHeaderSizeOverflows) {
+  DiagonalStorage<Uint64> storage = CreateStorage();
+  std::string path = ::testing::TempDir() + "/diagonal_storage_overflow";
+  ASSERT_OK(storage.WriteToFile(path));
+
+  // Keep only the 64-byte header, with dimensions of 2^21 each, so that the
+  // size of the residues, 8 * 2^63 bytes, wraps around to 0.
+  char header[64];
+  {
+    std::ifstream file(path, std::ios::binary);
+    ASSERT_TRUE(file.read(header, sizeof(header)));
+  }
+  uint64_t dimension = uint64_t{1} << 21;
+  for (int offset : {16, 24, 32}) {
+    std::memcpy(header + offset, &dimension, sizeof(dimension));
+  }
+  {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    ASSERT_TRUE(file.write(header, sizeof(header)));
+  }
+  EXPECT_THAT(DiagonalStorage<Uint64>::MapFromFile(path),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       HasSubstr("does not match the size")));
+}
+
+TEST(DiagonalStorageTest, MapFromFileFailsIfFileDoesNotExist) {
+  EXPECT_THAT(DiagonalStorage<Uint64>::MapFromFile(::testing::TempDir() +
+                                                   "/does_not_exist"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(DiagonalStorageTest, WriteToFileFailsIfEmpty) {
+  DiagonalStorage<Uint64> storage;
+  EXPECT_THAT(storage.WriteToFile(::testing::TempDir() + "/empty"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+}  // namespace
+}  // namespace linpir
+}  // namespace hintless_pir
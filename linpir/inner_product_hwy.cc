@@ -0,0 +1,214 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "linpir/inner_product_hwy.h"
+
+#include <cstdint>
+#include <limits>
+
+#include "absl/base/optimization.h"
+#include "absl/numeric/int128.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "hwy/detect_targets.h"
+
+// Highway implementations.
+// clang-format off
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "linpir/inner_product_hwy.cc"
+#include "hwy/foreach_target.h"  // IWYU pragma: keep
+// clang-format on
+
+// Must come after foreach_target.h to avoid redefinition errors.
+#include "hwy/highway.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace hintless_pir::linpir::internal {
+namespace HWY_NAMESPACE {
+
+#if HWY_TARGET == HWY_SCALAR
+
+absl::Status LazyFusedMulAddHwy(absl::Span<const uint64_t* const> lhs,
+                                absl::Span<const uint64_t* const> rhs,
+                                absl::Span<uint64_t> lo,
+                                absl::Span<uint64_t> hi) {
+  return LazyFusedMulAddNoHwy<uint64_t>(lhs, rhs, lo, hi);
+}
+
+#else
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+absl::Status LazyFusedMulAddHwy(absl::Span<const uint64_t* const> lhs,
+                                absl::Span<const uint64_t* const> rhs,
+                                absl::Span<uint64_t> lo,
+                                absl::Span<uint64_t> hi) {
+  if (lhs.size() != rhs.size()) {
+    return absl::InvalidArgumentError(
+        "`lhs` and `rhs` must have the same number of terms.");
+  }
+  if (lo.size() != hi.size()) {
+    return absl::InvalidArgumentError(
+        "`lo` and `hi` must have the same length.");
+  }
+
+  const hn::ScalableTag<uint64_t> d64;
+  const int N = hn::Lanes(d64);
+
+  // The 128-bit products are computed for pairs of lanes, so do not run the
+  // highway version if there are fewer than two lanes.
+  if (ABSL_PREDICT_FALSE(N < 2 || N % 2 != 0)) {
+    return LazyFusedMulAddNoHwy<uint64_t>(lhs, rhs, lo, hi);
+  }
+
+  int num_values = lo.size();
+  int num_terms = lhs.size();
+  int i = 0;
+  for (; i + N <= num_values; i += N) {
+    // Keep the accumulators in registers across all terms.
+    auto acc_lo = hn::LoadU(d64, lo.data() + i);
+    auto acc_hi = hn::LoadU(d64, hi.data() + i);
+    for (int j = 0; j < num_terms; ++j) {
+      auto x = hn::LoadU(d64, lhs[j] + i);
+      auto y = hn::LoadU(d64, rhs[j] + i);
+      // MulEven (MulOdd) returns the 128-bit products of the even (odd) lanes
+      // as pairs of (low, high) lanes, which are rearranged into the low and
+      // high halves of the products of all lanes.
+      auto prod_even = hn::MulEven(x, y);
+      auto prod_odd = hn::MulOdd(x, y);
+      auto prod_lo = hn::OddEven(hn::DupEven(prod_odd), prod_even);
+      auto prod_hi = hn::OddEven(prod_odd, hn::DupOdd(prod_even));
+      acc_lo = hn::Add(acc_lo, prod_lo);
+      // The carry mask is all ones, i.e. -1, in the lanes that overflowed.
+      auto carry = hn::VecFromMask(d64, hn::Lt(acc_lo, prod_lo));
+      acc_hi = hn::Sub(hn::Add(acc_hi, prod_hi), carry);
+    }
+    hn::StoreU(acc_lo, d64, lo.data() + i);
+    hn::StoreU(acc_hi, d64, hi.data() + i);
+  }
+
+  // Handle the remaining values that didn't take a full lane.
+  for (; i < num_values; ++i) {
+    absl::uint128 acc = absl::MakeUint128(hi[i], lo[i]);
+    for (int j = 0; j < num_terms; ++j) {
+      acc += absl::uint128{lhs[j][i]} * rhs[j][i];
+    }
+    lo[i] = absl::Uint128Low64(acc);
+    hi[i] = absl::Uint128High64(acc);
+  }
+  return absl::OkStatus();
+}
+
+#endif  // HWY_TARGET == HWY_SCALAR
+
+}  // namespace HWY_NAMESPACE
+}  // namespace hintless_pir::linpir::internal
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE || HWY_IDE
+namespace hintless_pir::linpir::internal {
+
+template <typename Int>
+int64_t MaxNumLazyTerms(Int modulus) {
+  if (modulus <= 2) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  absl::uint128 max_product = absl::uint128{modulus - 1} * (modulus - 1);
+  absl::uint128 num_terms = absl::Uint128Max() / max_product;
+  if (num_terms > std::numeric_limits<int64_t>::max()) {
+    return std::numeric_limits<int64_t>::max();
+  }
+  return static_cast<int64_t>(num_terms);
+}
+
+template <typename Int>
+absl::Status LazyFusedMulAddNoHwy(absl::Span<const Int* const> lhs,
+                                  absl::Span<const Int* const> rhs,
+                                  absl::Span<uint64_t> lo,
+                                  absl::Span<uint64_t> hi) {
+  if (lhs.size() != rhs.size()) {
+    return absl::InvalidArgumentError(
+        "`lhs` and `rhs` must have the same number of terms.");
+  }
+  if (lo.size() != hi.size()) {
+    return absl::InvalidArgumentError(
+        "`lo` and `hi` must have the same length.");
+  }
+
+  int num_terms = lhs.size();
+  for (int i = 0; i < lo.size(); ++i) {
+    absl::uint128 acc = absl::MakeUint128(hi[i], lo[i]);
+    for (int j = 0; j < num_terms; ++j) {
+      acc += absl::uint128{lhs[j][i]} * rhs[j][i];
+    }
+    lo[i] = absl::Uint128Low64(acc);
+    hi[i] = absl::Uint128High64(acc);
+  }
+  return absl::OkStatus();
+}
+
+template <typename Int>
+absl::Status LazyReduce(absl::Span<const uint64_t> lo,
+                        absl::Span<const uint64_t> hi, Int modulus,
+                        absl::Span<Int> result) {
+  if (lo.size() != hi.size() || lo.size() != result.size()) {
+    return absl::InvalidArgumentError(
+        "`lo`, `hi`, and `result` must have the same length.");
+  }
+  for (int i = 0; i < lo.size(); ++i) {
+    result[i] =
+        static_cast<Int>(absl::MakeUint128(hi[i], lo[i]) % modulus);
+  }
+  return absl::OkStatus();
+}
+
+// Only the 64-bit version is vectorized, as the products of 32-bit integers
+// already fit in the 64-bit lanes of the scalar version.
+HWY_EXPORT(LazyFusedMulAddHwy);
+
+template <typename Int>
+absl::Status LazyFusedMulAdd(absl::Span<const Int* const> lhs,
+                             absl::Span<const Int* const> rhs,
+                             absl::Span<uint64_t> lo, absl::Span<uint64_t> hi) {
+  return LazyFusedMulAddNoHwy<Int>(lhs, rhs, lo, hi);
+}
+
+template <>
+absl::Status LazyFusedMulAdd<uint64_t>(absl::Span<const uint64_t* const> lhs,
+                                       absl::Span<const uint64_t* const> rhs,
+                                       absl::Span<uint64_t> lo,
+                                       absl::Span<uint64_t> hi) {
+  return HWY_DYNAMIC_DISPATCH(LazyFusedMulAddHwy)(lhs, rhs, lo, hi);
+}
+
+template int64_t MaxNumLazyTerms<uint32_t>(uint32_t);
+template int64_t MaxNumLazyTerms<uint64_t>(uint64_t);
+template absl::Status LazyFusedMulAdd<uint32_t>(
+    absl::Span<const uint32_t* const>, absl::Span<const uint32_t* const>,
+    absl::Span<uint64_t>, absl::Span<uint64_t>);
+template absl::Status LazyFusedMulAddNoHwy<uint32_t>(
+    absl::Span<const uint32_t* const>, absl::Span<const uint32_t* const>,
+    absl::Span<uint64_t>, absl::Span<uint64_t>);
+template absl::Status LazyFusedMulAddNoHwy<uint64_t>(
+    absl::Span<const uint64_t* const>, absl::Span<const uint64_t* const>,
+    absl::Span<uint64_t>, absl::Span<uint64_t>);
+template absl::Status LazyReduce<uint32_t>(absl::Span<const uint64_t>,
+                                           absl::Span<const uint64_t>,
+                                           uint32_t, absl::Span<uint32_t>);
+template absl::Status LazyReduce<uint64_t>(absl::Span<const uint64_t>,
+                                           absl::Span<const uint64_t>,
+                                           uint64_t, absl::Span<uint64_t>);
+
+}  // namespace hintless_pir::linpir::internal
+#endif  // HWY_ONCE || HWY_IDE
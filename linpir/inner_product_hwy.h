@@ -0,0 +1,60 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef HINTLESS_PIR_LINPIR_INNER_PRODUCT_HWY_H_
+#define HINTLESS_PIR_LINPIR_INNER_PRODUCT_HWY_H_
+
+#include <stdint.h>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+
+namespace hintless_pir {
+namespace linpir {
+namespace internal {
+
+// Returns the number of products of two integers in [0, `modulus`) that can be
+// summed up in a 128-bit integer without overflow.
+template <typename Int>
+int64_t MaxNumLazyTerms(Int modulus);
+
+// Adds sum_j lhs[j][i] * rhs[j][i] to the 128-bit integer hi[i] * 2^64 + lo[i]
+// for 0 <= i < lo.size(), where lhs[j] and rhs[j] point to lo.size() many
+// integers. No modular reduction is performed, so the caller must make sure
+// that the sums do not overflow, see `MaxNumLazyTerms`.
+// This version is implemented using SIMD instructions via the highway library
+// for 64-bit integers.
+template <typename Int>
+absl::Status LazyFusedMulAdd(absl::Span<const Int* const> lhs,
+                             absl::Span<const Int* const> rhs,
+                             absl::Span<uint64_t> lo, absl::Span<uint64_t> hi);
+
+// Lazy fused multiply-add implemented without using highway SIMD intrinsics.
+template <typename Int>
+absl::Status LazyFusedMulAddNoHwy(absl::Span<const Int* const> lhs,
+                                  absl::Span<const Int* const> rhs,
+                                  absl::Span<uint64_t> lo,
+                                  absl::Span<uint64_t> hi);
+
+// Sets result[i] = (hi[i] * 2^64 + lo[i]) mod `modulus` for 0 <= i < lo.size().
+template <typename Int>
+absl::Status LazyReduce(absl::Span<const uint64_t> lo,
+                        absl::Span<const uint64_t> hi, Int modulus,
+                        absl::Span<Int> result);
+
+}  // namespace internal
+}  // namespace linpir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LINPIR_INNER_PRODUCT_HWY_H_
@@ -0,0 +1,139 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "linpir/inner_product_hwy.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace linpir {
+namespace internal {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+
+// Number of values that is not a multiple of the number of lanes.
+constexpr int kNumValues = 1027;
+
+template <typename Int>
+class LazyInnerProductTest : public ::testing::Test {
+ protected:
+  // Returns `num_terms` many vectors of random integers in [0, modulus).
+  std::vector<std::vector<Int>> SampleVectors(int num_terms,
+                                              Int modulus) const {
+    absl::BitGen bitgen;
+    std::vector<std::vector<Int>> vectors(num_terms);
+    for (auto& vector : vectors) {
+      for (int i = 0; i < kNumValues; ++i) {
+        vector.push_back(absl::Uniform<Int>(bitgen, 0, modulus));
+      }
+    }
+    return vectors;
+  }
+
+  static std::vector<const Int*> Pointers(
+      const std::vector<std::vector<Int>>& vectors) {
+    std::vector<const Int*> pointers;
+    for (auto const& vector : vectors) {
+      pointers.push_back(vector.data());
+    }
+    return pointers;
+  }
+
+  // Returns the largest modulus of the type with room for a few lazy terms.
+  static Int LargeModulus() {
+    if constexpr (sizeof(Int) == 8) {
+      return (Int{1} << 62) - 57;
+    } else {
+      return 4294967291u;
+    }
+  }
+};
+
+using IntTypes = ::testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(LazyInnerProductTest, IntTypes);
+
+TYPED_TEST(LazyInnerProductTest, MaxNumLazyTermsDoesNotOverflow) {
+  TypeParam modulus = this->LargeModulus();
+  int64_t max_num_terms = MaxNumLazyTerms<TypeParam>(modulus);
+  EXPECT_GE(max_num_terms, 4);
+  absl::uint128 max_product = absl::uint128{modulus - 1} * (modulus - 1);
+  EXPECT_LE(absl::uint128(max_num_terms), absl::Uint128Max() / max_product);
+}
+
+TYPED_TEST(LazyInnerProductTest, FailsIfNumberOfTermsMismatch) {
+  auto lhs = this->SampleVectors(2, 17);
+  auto rhs = this->SampleVectors(3, 17);
+  std::vector<uint64_t> lo(kNumValues, 0), hi(kNumValues, 0);
+  EXPECT_THAT(LazyFusedMulAdd<TypeParam>(this->Pointers(lhs),
+                                         this->Pointers(rhs),
+                                         absl::MakeSpan(lo),
+                                         absl::MakeSpan(hi)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TYPED_TEST(LazyInnerProductTest, MatchesScalarVersion) {
+  TypeParam modulus = this->LargeModulus();
+  int num_terms = MaxNumLazyTerms<TypeParam>(modulus);
+  if (num_terms > 64) {
+    num_terms = 64;
+  }
+  auto lhs = this->SampleVectors(num_terms, modulus);
+  auto rhs = this->SampleVectors(num_terms, modulus);
+
+  // Accumulate in two calls to exercise the carries into the high halves.
+  std::vector<uint64_t> lo(kNumValues, 0), hi(kNumValues, 0);
+  auto lhs_ptrs = this->Pointers(lhs);
+  auto rhs_ptrs = this->Pointers(rhs);
+  int half = num_terms / 2;
+  ASSERT_OK(LazyFusedMulAdd<TypeParam>(
+      absl::MakeConstSpan(lhs_ptrs).subspan(0, half),
+      absl::MakeConstSpan(rhs_ptrs).subspan(0, half), absl::MakeSpan(lo),
+      absl::MakeSpan(hi)));
+  ASSERT_OK(LazyFusedMulAdd<TypeParam>(
+      absl::MakeConstSpan(lhs_ptrs).subspan(half),
+      absl::MakeConstSpan(rhs_ptrs).subspan(half), absl::MakeSpan(lo),
+      absl::MakeSpan(hi)));
+
+  std::vector<uint64_t> expected_lo(kNumValues, 0), expected_hi(kNumValues, 0);
+  ASSERT_OK(LazyFusedMulAddNoHwy<TypeParam>(lhs_ptrs, rhs_ptrs,
+                                            absl::MakeSpan(expected_lo),
+                                            absl::MakeSpan(expected_hi)));
+  EXPECT_EQ(lo, expected_lo);
+  EXPECT_EQ(hi, expected_hi);
+
+  // Reducing the lazy sums gives the inner products modulo `modulus`.
+  std::vector<TypeParam> result(kNumValues);
+  ASSERT_OK(LazyReduce<TypeParam>(lo, hi, modulus, absl::MakeSpan(result)));
+  for (int i = 0; i < kNumValues; ++i) {
+    absl::uint128 expected = 0;
+    for (int j = 0; j < num_terms; ++j) {
+      expected = (expected + absl::uint128{lhs[j][i]} * rhs[j][i]) % modulus;
+    }
+    EXPECT_EQ(result[i], static_cast<TypeParam>(expected));
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace linpir
+}  // namespace hintless_pir
@@ -15,6 +15,7 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/flags/flag.h"
@@ -80,6 +81,56 @@ inline std::vector<std::vector<Integer>> SampleMatrix(int num_rows,
   return matrix;
 }
 
+// Benchmark encoding the database matrix into diagonals, where the argument
+// selects compact diagonals.
+void BM_CreateDatabase(benchmark::State& state) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  RlweParameters<Integer> params = kRlweParameters;
+  params.compact_diagonals = state.range(0) != 0;
+  auto rns_context = RnsContext::CreateForBfvFiniteFieldEncoding(
+                         params.log_n, params.qs, /*ps=*/{}, params.ts[0])
+                         .value();
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+
+  for (auto _ : state) {
+    auto database = Database<Integer>::Create(params, &rns_context, data);
+    benchmark::DoNotOptimize(database);
+  }
+}
+BENCHMARK(BM_CreateDatabase)->Arg(0)->Arg(1);
+
+// Benchmark preprocessing the database with the random pads of the rotated
+// query vectors, where the argument selects compact diagonals.
+void BM_PreprocessDatabase(benchmark::State& state) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  RlweParameters<Integer> params = kRlweParameters;
+  params.compact_diagonals = state.range(0) != 0;
+  auto rns_context = RnsContext::CreateForBfvFiniteFieldEncoding(
+                         params.log_n, params.qs, /*ps=*/{}, params.ts[0])
+                         .value();
+  auto moduli = rns_context.MainPrimeModuli();
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(auto database,
+                       Database<Integer>::Create(params, &rns_context, data));
+
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(auto prng, Prng::Create(prng_seed));
+  std::vector<RnsPolynomial> pads;
+  for (int i = 0; i < database->NumBabySteps(); ++i) {
+    ASSERT_OK_AND_ASSIGN(auto pad, RnsPolynomial::SampleUniform(
+                                       params.log_n, prng.get(), moduli));
+    pads.push_back(std::move(pad));
+  }
+
+  for (auto _ : state) {
+    auto status = database->Preprocess(pads);
+    benchmark::DoNotOptimize(status);
+  }
+}
+BENCHMARK(BM_PreprocessDatabase)->Arg(0)->Arg(1);
+
 // Simple benchmark: There is a single database holding a matrix mod t, and
 // the LinPIR server homomorphically computes matrix * vector (mod t).
 void BM_SingleDatabase(benchmark::State& state) {
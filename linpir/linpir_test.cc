@@ -22,12 +22,18 @@
 #include "absl/flags/flag.h"
 #include "absl/flags/parse.h"
 #include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "linpir/client.h"
 #include "linpir/database.h"
 #include "linpir/parameters.h"
+#include "linpir/query_pad_prng.h"
+#include "linpir/serialization.pb.h"
 #include "linpir/server.h"
+#include "lwe/counter_prng.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
 #include "shell_encryption/rns/finite_field_encoder.h"
@@ -94,6 +100,50 @@ class LinPirTest : public ::testing::Test {
     return matrix;
   }
 
+  // Returns a request encrypting `query` under a secret key sampled from
+  // `prng_seed_sk`, with the Galois keys needed by `params`.
+  LinPirRequest GenerateRequest(Client<Integer>& client,
+                                const RlweParameters<Integer>& params,
+                                const std::vector<Integer>& query,
+                                absl::string_view prng_seed_sk) const {
+    LinPirRequest request;
+    auto ct_queries = client.EncryptQuery({query}, prng_seed_sk).value();
+    auto ct_query_b = ct_queries[0].Component(0).value();
+    *request.mutable_ct_query_b() = ct_query_b.Serialize(moduli_).value();
+    auto gk = client.GenerateGaloisKey(prng_seed_sk).value();
+    for (auto const& gk_key_b : gk.GetKeyB()) {
+      *request.add_gk_key_bs() = gk_key_b.Serialize(moduli_).value();
+    }
+    if (params.baby_step_size > 0) {
+      auto gk_giant_step =
+          client.GenerateGiantStepGaloisKey(prng_seed_sk).value();
+      for (auto const& gk_key_b : gk_giant_step.GetKeyB()) {
+        *request.add_gk_giant_step_key_bs() =
+            gk_key_b.Serialize(moduli_).value();
+      }
+    }
+    if (params.fold_blocks) {
+      auto gk_fold = client.GenerateFoldGaloisKey(prng_seed_sk).value();
+      for (auto const& gk_key_b : gk_fold.GetKeyB()) {
+        *request.add_gk_fold_key_bs() = gk_key_b.Serialize(moduli_).value();
+      }
+    }
+    return request;
+  }
+
+  // Returns the product between `data` and `query` modulo `t`.
+  std::vector<Integer> MatrixVectorProduct(
+      const std::vector<std::vector<Integer>>& data,
+      const std::vector<Integer>& query, Integer t) const {
+    std::vector<Integer> product(data.size(), 0);
+    for (int i = 0; i < data.size(); ++i) {
+      for (int j = 0; j < query.size(); ++j) {
+        product[i] = (product[i] + data[i][j] * query[j]) % t;
+      }
+    }
+    return product;
+  }
+
   std::unique_ptr<const RlweParameters<Integer>> params_;
   std::unique_ptr<const RnsContext> rns_context_;
   std::vector<const rlwe::PrimeModulus<ModularInt>*> moduli_;
@@ -146,6 +196,377 @@ TEST_F(LinPirTest, EndToEndTest) {
   for (int i = 0; i < num_rows; ++i) {
     EXPECT_EQ(results[0][i], expected[i]);
   }
+
+  // Recovering only some rows gives the same values.
+  std::vector<int> rows = {num_rows - 1, 0, num_rows / 2};
+  ASSERT_OK_AND_ASSIGN(auto row_values, client->RecoverRows(response, 0, rows));
+  ASSERT_EQ(row_values.size(), rows.size());
+  for (int i = 0; i < rows.size(); ++i) {
+    EXPECT_EQ(row_values[i], expected[rows[i]]);
+  }
+  EXPECT_THAT(client->RecoverRows(response, 1, rows),
+              rlwe::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(client->RecoverRows(response, 0, {num_blocks * 1024}),
+              rlwe::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(LinPirTest, EndToEndTestWithBabyStepGiantStep) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  RlweParameters<Integer> params = *this->params_;
+  params.baby_step_size = 16;
+
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_ct_pad, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_gk_pad, Prng::GenerateSeed());
+
+  // Create a database and a server
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(
+      auto database,
+      Database<Integer>::Create(params, this->rns_context_.get(), data));
+  EXPECT_EQ(database->NumBabySteps(), params.baby_step_size);
+  EXPECT_EQ(database->NumGiantSteps(),
+            params.rows_per_block / 2 / params.baby_step_size);
+  ASSERT_OK_AND_ASSIGN(
+      auto server,
+      Server<Integer>::Create(params, this->rns_context_.get(),
+                              {database.get()}, prng_seed_ct_pad,
+                              prng_seed_gk_pad));
+  ASSERT_OK(server->Preprocess());
+
+  // Create a client and a request with both Galois keys
+  ASSERT_OK_AND_ASSIGN(
+      auto client, Client<Integer>::Create(params, this->rns_context_.get(),
+                                           prng_seed_ct_pad, prng_seed_gk_pad));
+  std::vector<Integer> query = SampleValues(num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_sk, Prng::GenerateSeed());
+  LinPirRequest request =
+      this->GenerateRequest(*client, params, query, prng_seed_sk);
+
+  // A request without the giant-step key is rejected.
+  EXPECT_THAT(
+      server->HandleRequest(request.ct_query_b(), request.gk_key_bs()),
+      rlwe::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+  int num_blocks = ceil(num_rows * 1.0 / params.rows_per_block);
+  ASSERT_EQ(response.ct_inner_products_size(), 1);
+  ASSERT_EQ(response.ct_inner_products(0).ct_blocks_size(), num_blocks);
+
+  // Recover the results
+  ASSERT_OK_AND_ASSIGN(auto results, client->Recover(response));
+  ASSERT_GE(results.size(), 1);
+  ASSERT_GE(results[0].size(), num_rows);
+  auto expected = this->MatrixVectorProduct(data, query, params.ts[0]);
+  for (int i = 0; i < num_rows; ++i) {
+    EXPECT_EQ(results[0][i], expected[i]);
+  }
+}
+
+TEST_F(LinPirTest, EndToEndTestWithAesCtrQueryPads) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  RlweParameters<Integer> params = *this->params_;
+  params.counter_mode_query_pads = true;
+  params.counter_prng_cipher = lwe::CounterPrngCipher::kAes256Ctr;
+
+  // The query pads need a seed of the counter-mode PRNG.
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_ct_pad,
+                       GenerateQueryPadPrngSeed(params));
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_gk_pad, Prng::GenerateSeed());
+
+  // Create a database and a server
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(
+      auto database,
+      Database<Integer>::Create(params, this->rns_context_.get(), data));
+  ASSERT_OK_AND_ASSIGN(
+      auto server,
+      Server<Integer>::Create(params, this->rns_context_.get(),
+                              {database.get()}, prng_seed_ct_pad,
+                              prng_seed_gk_pad));
+  ASSERT_OK(server->Preprocess());
+
+  // Create a client and a request
+  ASSERT_OK_AND_ASSIGN(
+      auto client, Client<Integer>::Create(params, this->rns_context_.get(),
+                                           prng_seed_ct_pad, prng_seed_gk_pad));
+  std::vector<Integer> query = SampleValues(num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(auto request, client->GenerateRequest(query));
+  ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+
+  // Recover the results
+  ASSERT_OK_AND_ASSIGN(auto results, client->Recover(response));
+  ASSERT_GE(results.size(), 1);
+  ASSERT_GE(results[0].size(), num_rows);
+  auto expected = this->MatrixVectorProduct(data, query, params.ts[0]);
+  for (int i = 0; i < num_rows; ++i) {
+    EXPECT_EQ(results[0][i], expected[i]);
+  }
+}
+
+TEST_F(LinPirTest, EndToEndTestWithFoldedBlocks) {
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  RlweParameters<Integer> params = *this->params_;
+  params.rows_per_block = 256;
+  params.fold_blocks = true;
+  // 12 blocks, which are rounded up to two folds of 8 blocks.
+  int num_rows = 12 * params.rows_per_block - 100;
+  int num_blocks_per_fold = (1 << (params.log_n - 1)) / params.rows_per_block;
+
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_ct_pad, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_gk_pad, Prng::GenerateSeed());
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+  std::vector<Integer> query = SampleValues(num_cols, 8);
+  auto expected = this->MatrixVectorProduct(data, query, params.ts[0]);
+
+  // Folding also works on top of baby-step giant-step rotations.
+  for (int baby_step_size : {0, 16}) {
+    params.baby_step_size = baby_step_size;
+    ASSERT_OK_AND_ASSIGN(
+        auto database,
+        Database<Integer>::Create(params, this->rns_context_.get(), data));
+    EXPECT_EQ(database->NumBlocks(), 2 * num_blocks_per_fold);
+    ASSERT_OK_AND_ASSIGN(
+        auto server,
+        Server<Integer>::Create(params, this->rns_context_.get(),
+                                {database.get()}, prng_seed_ct_pad,
+                                prng_seed_gk_pad));
+    ASSERT_OK(server->Preprocess());
+    ASSERT_OK_AND_ASSIGN(
+        auto client,
+        Client<Integer>::Create(params, this->rns_context_.get(),
+                                prng_seed_ct_pad, prng_seed_gk_pad));
+    ASSERT_OK_AND_ASSIGN(std::string prng_seed_sk, Prng::GenerateSeed());
+    LinPirRequest request =
+        this->GenerateRequest(*client, params, query, prng_seed_sk);
+
+    // A request without the fold key is rejected.
+    LinPirRequest request_without_fold_key = request;
+    request_without_fold_key.clear_gk_fold_key_bs();
+    EXPECT_THAT(server->HandleRequest(request_without_fold_key),
+                rlwe::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+
+    ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+    ASSERT_EQ(response.ct_inner_products_size(), 1);
+    ASSERT_EQ(response.ct_inner_products(0).ct_blocks_size(), 2);
+
+    ASSERT_OK_AND_ASSIGN(auto results, client->Recover(response));
+    ASSERT_EQ(results.size(), 1);
+    ASSERT_EQ(results[0].size(),
+              2 * num_blocks_per_fold * params.rows_per_block);
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_EQ(results[0][i], expected[i]);
+    }
+
+    // Rows in both folds can be recovered on their own.
+    std::vector<int> rows = {num_rows - 1, 3 * params.rows_per_block + 5};
+    ASSERT_OK_AND_ASSIGN(auto row_values,
+                         client->RecoverRows(response, 0, rows));
+    EXPECT_EQ(row_values[0], expected[rows[0]]);
+    EXPECT_EQ(row_values[1], expected[rows[1]]);
+  }
+}
+
+TEST_F(LinPirTest, FoldBlocksFailsIfRowsPerBlockDoesNotDivideSlots) {
+  RlweParameters<Integer> params = *this->params_;
+  params.rows_per_block = 768;
+  params.fold_blocks = true;
+  auto data = SampleMatrix(10, 10, 8);
+  EXPECT_THAT(Database<Integer>::Create(params, this->rns_context_.get(), data),
+              rlwe::testing::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(LinPirTest, EndToEndTestWithMultipleThreadsAndDatabases) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_ct_pad, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_gk_pad, Prng::GenerateSeed());
+
+  // Create two databases served by the same server.
+  auto data0 = SampleMatrix(num_rows, num_cols, 8);
+  auto data1 = SampleMatrix(num_rows, num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(auto database0,
+                       Database<Integer>::Create(
+                           *this->params_, this->rns_context_.get(), data0));
+  ASSERT_OK_AND_ASSIGN(auto database1,
+                       Database<Integer>::Create(
+                           *this->params_, this->rns_context_.get(), data1));
+  ASSERT_OK_AND_ASSIGN(
+      auto server,
+      Server<Integer>::Create(*this->params_, this->rns_context_.get(),
+                              {database0.get(), database1.get()},
+                              prng_seed_ct_pad, prng_seed_gk_pad));
+  ASSERT_OK(server->Preprocess());
+  ASSERT_OK_AND_ASSIGN(
+      auto client,
+      Client<Integer>::Create(*this->params_, this->rns_context_.get(),
+                              prng_seed_ct_pad, prng_seed_gk_pad));
+  std::vector<Integer> query = SampleValues(num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_sk, Prng::GenerateSeed());
+  LinPirRequest request =
+      this->GenerateRequest(*client, *this->params_, query, prng_seed_sk);
+
+  // The results must not depend on how the work is split into tasks.
+  auto expected0 =
+      this->MatrixVectorProduct(data0, query, this->params_->ts[0]);
+  auto expected1 =
+      this->MatrixVectorProduct(data1, query, this->params_->ts[0]);
+  for (int num_threads : {1, 3, 8}) {
+    server->SetNumThreads(num_threads);
+    ASSERT_OK_AND_ASSIGN(auto response, server->HandleRequest(request));
+    ASSERT_OK_AND_ASSIGN(auto results, client->Recover(response));
+    ASSERT_EQ(results.size(), 2);
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_EQ(results[0][i], expected0[i]);
+      EXPECT_EQ(results[1][i], expected1[i]);
+    }
+  }
+}
+
+TEST_F(LinPirTest, PreparedRequestsCanBeProcessedConcurrently) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_ct_pad, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_gk_pad, Prng::GenerateSeed());
+
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(
+      auto database, Database<Integer>::Create(*this->params_,
+                                               this->rns_context_.get(), data));
+  ASSERT_OK_AND_ASSIGN(
+      auto server, Server<Integer>::Create(
+                       *this->params_, this->rns_context_.get(),
+                       {database.get()}, prng_seed_ct_pad, prng_seed_gk_pad));
+  ASSERT_OK(server->Preprocess());
+
+  // Two clients with different secret keys, each sending a batch of queries.
+  constexpr int kNumRequests = 2;
+  constexpr int kBatchSize = 2;
+  std::vector<std::unique_ptr<Client<Integer>>> clients;
+  std::vector<std::vector<std::vector<Integer>>> queries(kNumRequests);
+  std::vector<std::unique_ptr<const Server<Integer>::PreparedRequest>>
+      prepared_requests;
+  for (int r = 0; r < kNumRequests; ++r) {
+    ASSERT_OK_AND_ASSIGN(
+        auto client,
+        Client<Integer>::Create(*this->params_, this->rns_context_.get(),
+                                prng_seed_ct_pad, prng_seed_gk_pad));
+    for (int i = 0; i < kBatchSize; ++i) {
+      queries[r].push_back(SampleValues(num_cols, 8));
+    }
+    ASSERT_OK_AND_ASSIGN(std::string prng_seed_sk, Prng::GenerateSeed());
+    ASSERT_OK_AND_ASSIGN(auto ct_queries,
+                         client->EncryptQuery(queries[r], prng_seed_sk));
+    std::vector<rlwe::SerializedRnsPolynomial> ct_query_bs;
+    for (auto const& ct_query : ct_queries) {
+      ASSERT_OK_AND_ASSIGN(auto ct_query_b, ct_query.Component(0));
+      ASSERT_OK_AND_ASSIGN(ct_query_bs.emplace_back(),
+                           ct_query_b.Serialize(this->moduli_));
+    }
+    LinPirRequest request = this->GenerateRequest(
+        *client, *this->params_, queries[r][0], prng_seed_sk);
+    ASSERT_OK_AND_ASSIGN(auto prepared_request,
+                         server->PrepareRequest(ct_query_bs,
+                                                request.gk_key_bs()));
+    EXPECT_EQ(prepared_request->BatchSize(), kBatchSize);
+    prepared_requests.push_back(std::move(prepared_request));
+    clients.push_back(std::move(client));
+  }
+
+  // Process every query of every prepared request concurrently.
+  std::vector<absl::StatusOr<LinPirResponse>> responses(kNumRequests *
+                                                        kBatchSize);
+#pragma omp parallel for
+  for (int task = 0; task < kNumRequests * kBatchSize; ++task) {
+    responses[task] = server->ProcessPreparedRequest(
+        *prepared_requests[task / kBatchSize], task % kBatchSize);
+  }
+
+  for (int task = 0; task < kNumRequests * kBatchSize; ++task) {
+    ASSERT_OK(responses[task]);
+    int r = task / kBatchSize;
+    ASSERT_OK_AND_ASSIGN(auto results,
+                         clients[r]->Recover(*responses[task]));
+    ASSERT_GE(results.size(), 1);
+    auto expected = this->MatrixVectorProduct(
+        data, queries[r][task % kBatchSize], this->params_->ts[0]);
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_EQ(results[0][i], expected[i]);
+    }
+  }
+}
+
+TEST_F(LinPirTest, OutstandingQueriesCanBeRecoveredInAnyOrder) {
+  int num_rows = absl::GetFlag(FLAGS_num_rows);
+  int num_cols = absl::GetFlag(FLAGS_num_cols);
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_ct_pad, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(std::string prng_seed_gk_pad, Prng::GenerateSeed());
+
+  auto data = SampleMatrix(num_rows, num_cols, 8);
+  ASSERT_OK_AND_ASSIGN(
+      auto database, Database<Integer>::Create(*this->params_,
+                                               this->rns_context_.get(), data));
+  ASSERT_OK_AND_ASSIGN(
+      auto server, Server<Integer>::Create(
+                       *this->params_, this->rns_context_.get(),
+                       {database.get()}, prng_seed_ct_pad, prng_seed_gk_pad));
+  ASSERT_OK(server->Preprocess());
+  ASSERT_OK_AND_ASSIGN(
+      auto client,
+      Client<Integer>::Create(*this->params_, this->rns_context_.get(),
+                              prng_seed_ct_pad, prng_seed_gk_pad));
+
+  // A single client with several queries under their own secret keys.
+  constexpr int kNumQueries = 3;
+  std::vector<std::vector<Integer>> queries;
+  std::vector<std::string> prng_seed_sks;
+  std::vector<LinPirResponse> responses;
+  for (int r = 0; r < kNumQueries; ++r) {
+    queries.push_back(SampleValues(num_cols, 8));
+    ASSERT_OK_AND_ASSIGN(prng_seed_sks.emplace_back(), Prng::GenerateSeed());
+    ASSERT_OK_AND_ASSIGN(auto ct_queries,
+                         client->EncryptQueryWithoutCachingKey(
+                             {queries[r]}, prng_seed_sks[r],
+                             client->PrngSeedForCiphertextRandomPads()));
+    LinPirRequest request;
+    ASSERT_OK_AND_ASSIGN(auto ct_query_b, ct_queries[0].Component(0));
+    ASSERT_OK_AND_ASSIGN(*request.mutable_ct_query_b(),
+                         ct_query_b.Serialize(this->moduli_));
+    ASSERT_OK_AND_ASSIGN(auto gk, client->GenerateGaloisKey(prng_seed_sks[r]));
+    for (auto const& gk_key_b : gk.GetKeyB()) {
+      ASSERT_OK_AND_ASSIGN(*request.add_gk_key_bs(),
+                           gk_key_b.Serialize(this->moduli_));
+    }
+    ASSERT_OK_AND_ASSIGN(responses.emplace_back(),
+                         server->HandleRequest(request));
+  }
+
+  // Recover the responses in reverse order.
+  for (int r = kNumQueries - 1; r >= 0; --r) {
+    auto expected =
+        this->MatrixVectorProduct(data, queries[r], this->params_->ts[0]);
+    ASSERT_OK_AND_ASSIGN(auto results,
+                         client->Recover(responses[r], prng_seed_sks[r]));
+    ASSERT_GE(results.size(), 1);
+    for (int i = 0; i < num_rows; ++i) {
+      EXPECT_EQ(results[0][i], expected[i]);
+    }
+    std::vector<int> rows = {num_rows - 1, 0};
+    ASSERT_OK_AND_ASSIGN(
+        auto row_values,
+        client->RecoverRows(responses[r], 0, rows, prng_seed_sks[r]));
+    EXPECT_EQ(row_values[0], expected[num_rows - 1]);
+    EXPECT_EQ(row_values[1], expected[0]);
+  }
+}
+
+TEST_F(LinPirTest, CreateFailsIfBabyStepSizeDoesNotDivideRotations) {
+  RlweParameters<Integer> params = *this->params_;
+  params.baby_step_size = 3;
+  auto data = SampleMatrix(16, 16, 8);
+  EXPECT_THAT(Database<Integer>::Create(params, this->rns_context_.get(), data),
+              rlwe::testing::StatusIs(absl::StatusCode::kInvalidArgument));
 }
 
 }  // namespace
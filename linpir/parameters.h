@@ -19,6 +19,7 @@
 #include <cstddef>
 #include <vector>
 
+#include "lwe/counter_prng.h"
 #include "shell_encryption/integral_types.h"
 #include "shell_encryption/serialization.pb.h"
 
@@ -46,6 +47,36 @@ using Uint64 = rlwe::Uint64;
 // - prng_type: The type of PRNG to sample random polynomials.
 // - rows_per_block: the number of rows of the database matrix in every block
 //          of the database encoding.
+// - baby_step_size: if positive, the server computes the rotations of the
+//          query vector with the baby-step giant-step method, where the
+//          baby steps are the rotations 0..baby_step_size-1 and the giant
+//          steps are rotations by multiples of baby_step_size. It must divide
+//          rows_per_block / 2. This requires an additional Galois key for the
+//          giant steps, and each block of the database needs its own giant
+//          steps, so it pays off when there are few blocks. 0 disables it.
+// - compact_diagonals: if true, the database keeps the encoded diagonals as
+//          32-bit coefficients modulo the plaintext modulus, and converts them
+//          to NTT form modulo `qs` whenever a query is processed. This shrinks
+//          the database encoding by a factor of 2 * qs.size() for 64-bit
+//          moduli, at the cost of qs.size() NTTs per diagonal and query.
+//          It requires the plaintext moduli `ts` to fit in 32 bits.
+// - fold_blocks: if true, the server folds the results of R consecutive blocks
+//          into one response ciphertext, where R = 2^(log_n - 1) /
+//          rows_per_block is the number of windows of rows_per_block slots
+//          per slot group. The database stores every group of R blocks with
+//          their windows permuted, so the fold is a sum of the results
+//          rotated by multiples of rows_per_block without any masking. This
+//          cuts the response by a factor of R, at the cost of R - 1 key
+//          switches per response ciphertext and an additional Galois key
+//          rotating by rows_per_block. The number of blocks is rounded up to
+//          a multiple of R, so it pays off when there are at least R blocks.
+// - counter_mode_query_pads: if true, the random "a" components of the query
+//          ciphertexts are expanded from their seeds by an `lwe::CounterPrng`
+//          with `counter_prng_cipher`, instead of the PRNG of `prng_type`,
+//          which still samples the secret keys, the errors, and the Galois
+//          key pads. With `lwe::CounterPrngCipher::kAes256Ctr`, expanding the
+//          pads in `Server::Preprocess()` and in the client runs on the AES
+//          instructions of the CPU.
 template <typename RlweInteger>
 struct RlweParameters {
   int log_n;
@@ -57,6 +88,20 @@ struct RlweParameters {
 
   // Encoding a matrix into blocks.
   int rows_per_block;
+
+  // Baby-step giant-step rotations.
+  int baby_step_size = 0;
+
+  // Trade computation for memory in the database encoding.
+  bool compact_diagonals = false;
+
+  // Fold several blocks into one response ciphertext.
+  bool fold_blocks = false;
+
+  // The PRNG expanding the query ciphertext pads.
+  bool counter_mode_query_pads = false;
+  lwe::CounterPrngCipher counter_prng_cipher =
+      lwe::CounterPrngCipher::kChaCha20;
 };
 
 }  // namespace linpir
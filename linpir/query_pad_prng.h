@@ -0,0 +1,71 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LINPIR_QUERY_PAD_PRNG_H_
+#define HINTLESS_PIR_LINPIR_QUERY_PAD_PRNG_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "linpir/parameters.h"
+#include "lwe/counter_prng.h"
+#include "shell_encryption/prng/prng.h"
+#include "shell_encryption/prng/single_thread_chacha_prng.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace linpir {
+
+// Returns a fresh seed for the PRNG expanding the random "a" components of the
+// query ciphertexts under `params`.
+template <typename RlweInteger>
+absl::StatusOr<std::string> GenerateQueryPadPrngSeed(
+    const RlweParameters<RlweInteger>& params) {
+  if (params.counter_mode_query_pads) {
+    return lwe::CounterPrng::GenerateSeed();
+  }
+  if (params.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    return rlwe::SingleThreadHkdfPrng::GenerateSeed();
+  }
+  return rlwe::SingleThreadChaChaPrng::GenerateSeed();
+}
+
+// Returns the PRNG expanding the random "a" components of the query
+// ciphertexts under `params` from `prng_seed`, which is an `lwe::CounterPrng`
+// if `params.counter_mode_query_pads` is set, and the PRNG of
+// `params.prng_type` otherwise.
+template <typename RlweInteger>
+absl::StatusOr<std::unique_ptr<rlwe::SecurePrng>> CreateQueryPadPrng(
+    const RlweParameters<RlweInteger>& params, absl::string_view prng_seed) {
+  std::unique_ptr<rlwe::SecurePrng> prng;
+  if (params.counter_mode_query_pads) {
+    RLWE_ASSIGN_OR_RETURN(
+        prng, lwe::CounterPrng::Create(prng_seed, params.counter_prng_cipher));
+  } else if (params.prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(prng, rlwe::SingleThreadHkdfPrng::Create(prng_seed));
+  } else {
+    RLWE_ASSIGN_OR_RETURN(prng,
+                          rlwe::SingleThreadChaChaPrng::Create(prng_seed));
+  }
+  return prng;
+}
+
+}  // namespace linpir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LINPIR_QUERY_PAD_PRNG_H_
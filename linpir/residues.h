@@ -0,0 +1,372 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LINPIR_RESIDUES_H_
+#define HINTLESS_PIR_LINPIR_RESIDUES_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "linpir/inner_product_hwy.h"
+#include "shell_encryption/rns/rns_bfv_ciphertext.h"
+#include "shell_encryption/rns/rns_modulus.h"
+#include "shell_encryption/rns/rns_polynomial.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace linpir {
+
+// Returns the residues of `poly` in NTT form as integers in [0, q_i), stored
+// contiguously modulus by modulus, i.e. coefficient j modulo q_i is at index
+// i * N + j.
+template <typename ModularInt>
+absl::StatusOr<std::vector<typename ModularInt::Int>> ExportResidues(
+    const rlwe::RnsPolynomial<ModularInt>& poly,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli) {
+  if (!poly.IsNttForm()) {
+    rlwe::RnsPolynomial<ModularInt> poly_ntt = poly;
+    RLWE_RETURN_IF_ERROR(poly_ntt.ConvertToNttForm(moduli));
+    return ExportResidues(poly_ntt, moduli);
+  }
+  auto const& coeff_vectors = poly.Coeffs();
+  if (coeff_vectors.size() != moduli.size()) {
+    return absl::InvalidArgumentError(
+        "`poly` must be defined with respect to `moduli`.");
+  }
+  int num_coeffs = coeff_vectors[0].size();
+  std::vector<typename ModularInt::Int> residues(moduli.size() * num_coeffs);
+  for (int i = 0; i < moduli.size(); ++i) {
+    auto mod_params_qi = moduli[i]->ModParams();
+    for (int j = 0; j < num_coeffs; ++j) {
+      residues[i * num_coeffs + j] =
+          coeff_vectors[i][j].ExportInt(mod_params_qi);
+    }
+  }
+  return residues;
+}
+
+// Returns the RNS polynomial in NTT form with the given `residues`, arranged as
+// in `ExportResidues`.
+template <typename ModularInt>
+absl::StatusOr<rlwe::RnsPolynomial<ModularInt>> ImportResidues(
+    absl::Span<const typename ModularInt::Int> residues,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli) {
+  if (moduli.empty() || residues.size() % moduli.size() != 0) {
+    return absl::InvalidArgumentError(
+        "`residues` must contain the same number of values per modulus.");
+  }
+  int num_coeffs = residues.size() / moduli.size();
+  std::vector<std::vector<ModularInt>> coeff_vectors;
+  coeff_vectors.reserve(moduli.size());
+  for (int i = 0; i < moduli.size(); ++i) {
+    auto mod_params_qi = moduli[i]->ModParams();
+    std::vector<ModularInt> coeffs;
+    coeffs.reserve(num_coeffs);
+    for (int j = 0; j < num_coeffs; ++j) {
+      RLWE_ASSIGN_OR_RETURN(
+          auto coeff,
+          ModularInt::ImportInt(residues[i * num_coeffs + j], mod_params_qi));
+      coeffs.push_back(std::move(coeff));
+    }
+    coeff_vectors.push_back(std::move(coeffs));
+  }
+  return rlwe::RnsPolynomial<ModularInt>::Create(std::move(coeff_vectors),
+                                                 /*is_ntt=*/true);
+}
+
+// Returns the coefficients of `poly` modulo `plaintext_modulus` t as 32-bit
+// integers in [0, t). `poly` must have coefficients in (-t, t), e.g. be an
+// encoded plaintext, so that they are read off modulo the first of `moduli`.
+template <typename ModularInt>
+absl::StatusOr<std::vector<uint32_t>> ExportSmallCoeffs(
+    const rlwe::RnsPolynomial<ModularInt>& poly,
+    typename ModularInt::Int plaintext_modulus,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli) {
+  using Int = typename ModularInt::Int;
+  if (plaintext_modulus > std::numeric_limits<uint32_t>::max()) {
+    return absl::InvalidArgumentError(
+        "`plaintext_modulus` must fit in 32 bits.");
+  }
+  if (poly.IsNttForm()) {
+    rlwe::RnsPolynomial<ModularInt> poly_coeff = poly;
+    RLWE_RETURN_IF_ERROR(poly_coeff.ConvertToCoeffForm(moduli));
+    return ExportSmallCoeffs(poly_coeff, plaintext_modulus, moduli);
+  }
+  if (moduli.empty() || poly.Coeffs().size() != moduli.size()) {
+    return absl::InvalidArgumentError(
+        "`poly` must be defined with respect to `moduli`.");
+  }
+  auto const& coeffs_q0 = poly.Coeffs()[0];
+  auto mod_params_q0 = moduli[0]->ModParams();
+  Int q0 = moduli[0]->Modulus();
+  std::vector<uint32_t> coeffs(coeffs_q0.size());
+  for (int j = 0; j < coeffs_q0.size(); ++j) {
+    Int coeff = coeffs_q0[j].ExportInt(mod_params_q0);
+    if (coeff > q0 / 2) {
+      // A negative coefficient -(q0 - coeff).
+      coeffs[j] = (plaintext_modulus - (q0 - coeff) % plaintext_modulus) %
+                  plaintext_modulus;
+    } else {
+      coeffs[j] = coeff % plaintext_modulus;
+    }
+  }
+  return coeffs;
+}
+
+// Sets `residues`, arranged as in `ExportResidues`, to the polynomial in NTT
+// form whose coefficients are the representatives in (-t/2, t/2] of `coeffs`
+// modulo `plaintext_modulus` t. This reverses `ExportSmallCoeffs` up to
+// multiples of t in the coefficients, which is enough for plaintexts.
+// The polynomial is lifted and transformed in `scratch`, which must be defined
+// modulo `moduli` with as many coefficients as `coeffs`, e.g. as created by
+// `RnsPolynomial::CreateZero`, so that repeated calls do not allocate.
+template <typename ModularInt>
+absl::Status ImportSmallCoeffs(
+    absl::Span<const uint32_t> coeffs,
+    typename ModularInt::Int plaintext_modulus,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli,
+    rlwe::RnsPolynomial<ModularInt>& scratch,
+    absl::Span<typename ModularInt::Int> residues) {
+  int num_coeffs = coeffs.size();
+  if (residues.size() != moduli.size() * num_coeffs) {
+    return absl::InvalidArgumentError(
+        "`residues` must hold the coefficients modulo all of `moduli`.");
+  }
+  auto& coeff_vectors = scratch.Coeffs();
+  if (coeff_vectors.size() != moduli.size() ||
+      coeff_vectors[0].size() != num_coeffs) {
+    return absl::InvalidArgumentError(
+        "`scratch` must be defined with respect to `moduli`.");
+  }
+  for (int i = 0; i < moduli.size(); ++i) {
+    auto mod_params_qi = moduli[i]->ModParams();
+    for (int j = 0; j < num_coeffs; ++j) {
+      typename ModularInt::Int coeff = coeffs[j];
+      if (coeff > plaintext_modulus / 2) {
+        coeff = moduli[i]->Modulus() - (plaintext_modulus - coeff);
+      }
+      RLWE_ASSIGN_OR_RETURN(coeff_vectors[i][j],
+                            ModularInt::ImportInt(coeff, mod_params_qi));
+    }
+  }
+  scratch.SetIsNtt(false);
+  RLWE_RETURN_IF_ERROR(scratch.ConvertToNttForm(moduli));
+  for (int i = 0; i < moduli.size(); ++i) {
+    auto mod_params_qi = moduli[i]->ModParams();
+    for (int j = 0; j < num_coeffs; ++j) {
+      residues[i * num_coeffs + j] =
+          coeff_vectors[i][j].ExportInt(mod_params_qi);
+    }
+  }
+  return absl::OkStatus();
+}
+
+// The residues of the "b" and "a" components of a ciphertext, arranged as in
+// `ExportResidues`. The "a" component is empty if it is not needed, e.g. when
+// the server has preprocessed the random pads.
+template <typename Int>
+struct CiphertextResidues {
+  std::vector<Int> b;
+  std::vector<Int> a;
+};
+
+// Returns the residues of the components of `ct`, including the "a" component
+// only if `with_pad` is true.
+template <typename ModularInt>
+absl::StatusOr<CiphertextResidues<typename ModularInt::Int>>
+ExportCiphertextResidues(
+    const rlwe::RnsBfvCiphertext<ModularInt>& ct, bool with_pad,
+    absl::Span<const rlwe::PrimeModulus<ModularInt>* const> moduli) {
+  CiphertextResidues<typename ModularInt::Int> residues;
+  RLWE_ASSIGN_OR_RETURN(auto ct_b, ct.Component(0));
+  RLWE_ASSIGN_OR_RETURN(residues.b, ExportResidues(ct_b, moduli));
+  if (with_pad) {
+    RLWE_ASSIGN_OR_RETURN(auto ct_a, ct.Component(1));
+    RLWE_ASSIGN_OR_RETURN(residues.a, ExportResidues(ct_a, moduli));
+  }
+  return residues;
+}
+
+// Sums of products of residues arranged as in `ExportResidues`, kept as
+// unreduced 128-bit integers. The sums are only reduced modulo the RNS moduli
+// when they could overflow, e.g. after more than 2^28 products for moduli
+// below 2^50, so an inner product costs one modular reduction per coefficient
+// instead of one per term.
+template <typename ModularInt>
+class LazyRnsAccumulator {
+ public:
+  using Int = typename ModularInt::Int;
+  using PrimeModulus = rlwe::PrimeModulus<ModularInt>;
+
+  // An empty accumulator, which holds no residues.
+  LazyRnsAccumulator() = default;
+
+  // Returns an accumulator holding zero, for polynomials with `num_coeffs`
+  // coefficients modulo `moduli`.
+  static LazyRnsAccumulator CreateZero(
+      int num_coeffs, absl::Span<const PrimeModulus* const> moduli) {
+    int64_t max_num_terms = std::numeric_limits<int64_t>::max();
+    for (auto const* modulus : moduli) {
+      max_num_terms = std::min(
+          max_num_terms, internal::MaxNumLazyTerms<Int>(modulus->Modulus()));
+    }
+    return LazyRnsAccumulator(moduli.size() * num_coeffs, max_num_terms);
+  }
+
+  // Adds sum_j lhs[j] * rhs[j] coefficient-wise, where lhs[j] and rhs[j]
+  // point to residues arranged as in `ExportResidues`.
+  absl::Status FusedMulAddInPlace(
+      absl::Span<const Int* const> lhs, absl::Span<const Int* const> rhs,
+      absl::Span<const PrimeModulus* const> moduli) {
+    if (lhs.size() != rhs.size()) {
+      return absl::InvalidArgumentError(
+          "`lhs` and `rhs` must have the same number of terms.");
+    }
+    if (max_num_terms_ < 2) {
+      return absl::InvalidArgumentError(
+          "`moduli` are too large for lazy accumulation.");
+    }
+    for (int begin = 0; begin < lhs.size();) {
+      if (num_terms_ >= max_num_terms_) {
+        RLWE_RETURN_IF_ERROR(ReduceInPlace(moduli));
+      }
+      int64_t num_terms =
+          std::min<int64_t>(lhs.size() - begin, max_num_terms_ - num_terms_);
+      RLWE_RETURN_IF_ERROR(internal::LazyFusedMulAdd<Int>(
+          lhs.subspan(begin, num_terms), rhs.subspan(begin, num_terms),
+          absl::MakeSpan(lo_), absl::MakeSpan(hi_)));
+      num_terms_ += num_terms;
+      begin += num_terms;
+    }
+    return absl::OkStatus();
+  }
+
+  // Adds the sums in `other` coefficient-wise.
+  absl::Status AddInPlace(const LazyRnsAccumulator& other,
+                          absl::Span<const PrimeModulus* const> moduli) {
+    if (lo_.size() != other.lo_.size()) {
+      return absl::InvalidArgumentError(
+          "`other` must hold the same number of residues.");
+    }
+    if (other.num_terms_ <= max_num_terms_ - num_terms_) {
+      for (int i = 0; i < lo_.size(); ++i) {
+        absl::uint128 sum = absl::MakeUint128(hi_[i], lo_[i]) +
+                            absl::MakeUint128(other.hi_[i], other.lo_[i]);
+        lo_[i] = absl::Uint128Low64(sum);
+        hi_[i] = absl::Uint128High64(sum);
+      }
+      num_terms_ += other.num_terms_;
+      return absl::OkStatus();
+    }
+
+    // Reduce both sums before adding them up.
+    int num_coeffs = lo_.size() / moduli.size();
+    for (int i = 0; i < lo_.size(); ++i) {
+      Int modulus = moduli[i / num_coeffs]->Modulus();
+      absl::uint128 sum =
+          absl::MakeUint128(hi_[i], lo_[i]) % modulus +
+          absl::MakeUint128(other.hi_[i], other.lo_[i]) % modulus;
+      lo_[i] = absl::Uint128Low64(sum);
+      hi_[i] = absl::Uint128High64(sum);
+    }
+    num_terms_ = 2;
+    return absl::OkStatus();
+  }
+
+  // Returns the sums reduced modulo `moduli`, arranged as in `ExportResidues`.
+  absl::StatusOr<std::vector<Int>> Reduce(
+      absl::Span<const PrimeModulus* const> moduli) const {
+    if (moduli.empty() || lo_.size() % moduli.size() != 0) {
+      return absl::InvalidArgumentError(
+          "`moduli` does not match the number of residues.");
+    }
+    int num_coeffs = lo_.size() / moduli.size();
+    std::vector<Int> residues(lo_.size());
+    for (int i = 0; i < moduli.size(); ++i) {
+      RLWE_RETURN_IF_ERROR(internal::LazyReduce<Int>(
+          absl::MakeConstSpan(lo_).subspan(i * num_coeffs, num_coeffs),
+          absl::MakeConstSpan(hi_).subspan(i * num_coeffs, num_coeffs),
+          moduli[i]->Modulus(),
+          absl::MakeSpan(residues).subspan(i * num_coeffs, num_coeffs)));
+    }
+    return residues;
+  }
+
+  // Returns the sums as an RNS polynomial in NTT form.
+  absl::StatusOr<rlwe::RnsPolynomial<ModularInt>> Export(
+      absl::Span<const PrimeModulus* const> moduli) const {
+    RLWE_ASSIGN_OR_RETURN(std::vector<Int> residues, Reduce(moduli));
+    return ImportResidues<ModularInt>(residues, moduli);
+  }
+
+  bool IsEmpty() const { return lo_.empty(); }
+
+ private:
+  LazyRnsAccumulator(int num_values, int64_t max_num_terms)
+      : lo_(num_values, 0), hi_(num_values, 0), max_num_terms_(max_num_terms) {}
+
+  // Reduces the sums modulo `moduli`, after which they count as one term.
+  // This runs within the inner products, so it reduces the sums in place
+  // rather than allocating.
+  absl::Status ReduceInPlace(absl::Span<const PrimeModulus* const> moduli) {
+    if (moduli.empty() || lo_.size() % moduli.size() != 0) {
+      return absl::InvalidArgumentError(
+          "`moduli` does not match the number of residues.");
+    }
+    int num_coeffs = lo_.size() / moduli.size();
+    for (int i = 0; i < moduli.size(); ++i) {
+      absl::Span<uint64_t> lo =
+          absl::MakeSpan(lo_).subspan(i * num_coeffs, num_coeffs);
+      absl::Span<uint64_t> hi =
+          absl::MakeSpan(hi_).subspan(i * num_coeffs, num_coeffs);
+      Int modulus = moduli[i]->Modulus();
+      if constexpr (std::is_same_v<Int, uint64_t>) {
+        // Every residue only depends on the sum at the same position, so it
+        // can overwrite the low 64 bits of the sum.
+        RLWE_RETURN_IF_ERROR(internal::LazyReduce<Int>(lo, hi, modulus, lo));
+      } else {
+        for (int j = 0; j < num_coeffs; ++j) {
+          lo[j] = static_cast<uint64_t>(absl::MakeUint128(hi[j], lo[j]) %
+                                        modulus);
+        }
+      }
+      std::fill(hi.begin(), hi.end(), 0);
+    }
+    num_terms_ = 1;
+    return absl::OkStatus();
+  }
+
+  // The low and high 64 bits of the sums.
+  std::vector<uint64_t> lo_;
+  std::vector<uint64_t> hi_;
+
+  // An upper bound on the number of products in the sums, and the number of
+  // products that can be summed up without overflow.
+  int64_t num_terms_ = 0;
+  int64_t max_num_terms_ = 0;
+};
+
+}  // namespace linpir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LINPIR_RESIDUES_H_
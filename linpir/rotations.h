@@ -0,0 +1,142 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LINPIR_ROTATIONS_H_
+#define HINTLESS_PIR_LINPIR_ROTATIONS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "linpir/parameters.h"
+#include "shell_encryption/prng/prng.h"
+#include "shell_encryption/prng/single_thread_chacha_prng.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace linpir {
+
+// Returns the power 5^k mod 2N of the Galois automorphism X -> X^(5^k), which
+// rotates the slots of each group by k positions, where N = 2^log_n.
+inline int RotationGaloisPower(int k, int log_n) {
+  uint64_t cyclotomic_order = uint64_t{1} << (log_n + 1);
+  uint64_t power = 1;
+  for (int i = 0; i < k; ++i) {
+    power = (power * 5) % cyclotomic_order;
+  }
+  return static_cast<int>(power);
+}
+
+// Returns the power of the Galois automorphism that rotates the slots of each
+// group by -k positions, using that 5 has order N/2 modulo 2N.
+inline int InverseRotationGaloisPower(int k, int log_n) {
+  int order = 1 << (log_n - 1);
+  return RotationGaloisPower((order - k % order) % order, log_n);
+}
+
+// Returns the number of rotations computed by the server per giant step, which
+// is all rows_per_block / 2 rotations if baby-step giant-step is disabled.
+template <typename RlweInteger>
+int EffectiveBabyStepSize(const RlweParameters<RlweInteger>& params) {
+  return params.baby_step_size > 0 ? params.baby_step_size
+                                   : params.rows_per_block / 2;
+}
+
+// Returns an error if `params` has an invalid `baby_step_size`.
+template <typename RlweInteger>
+absl::Status CheckBabyStepSize(const RlweParameters<RlweInteger>& params) {
+  if (params.baby_step_size < 0 ||
+      (params.baby_step_size > 0 &&
+       (params.rows_per_block / 2) % params.baby_step_size != 0)) {
+    return absl::InvalidArgumentError(
+        "`baby_step_size` must divide `rows_per_block` / 2.");
+  }
+  return absl::OkStatus();
+}
+
+// Returns the number of blocks folded into every response ciphertext, which
+// is the number of windows of rows_per_block slots per slot group if
+// `fold_blocks` is set, and 1 otherwise.
+template <typename RlweInteger>
+int NumBlocksPerFold(const RlweParameters<RlweInteger>& params) {
+  if (!params.fold_blocks) {
+    return 1;
+  }
+  return (1 << (params.log_n - 1)) / params.rows_per_block;
+}
+
+// Returns an error if `params` sets `fold_blocks` but the slot groups are not
+// made of whole windows of rows_per_block slots.
+template <typename RlweInteger>
+absl::Status CheckFoldBlocks(const RlweParameters<RlweInteger>& params) {
+  int num_slots_per_group = 1 << (params.log_n - 1);
+  if (params.fold_blocks &&
+      (params.rows_per_block <= 0 ||
+       num_slots_per_group % params.rows_per_block != 0)) {
+    return absl::InvalidArgumentError(
+        "`fold_blocks` requires `rows_per_block` to divide 2^(log_n - 1).");
+  }
+  return absl::OkStatus();
+}
+
+// Returns the `index`'th PRNG seed derived from the PRNG seed of the Galois
+// key, so that no extra seed needs to be published for additional keys. The
+// keys must not share their random pads.
+inline absl::StatusOr<std::string> DeriveGaloisKeyPadSeed(
+    absl::string_view prng_seed_gk_pad, rlwe::PrngType prng_type, int index) {
+  std::unique_ptr<rlwe::SecurePrng> prng;
+  int seed_length;
+  if (prng_type == rlwe::PRNG_TYPE_HKDF) {
+    RLWE_ASSIGN_OR_RETURN(prng,
+                          rlwe::SingleThreadHkdfPrng::Create(prng_seed_gk_pad));
+    seed_length = rlwe::SingleThreadHkdfPrng::SeedLength();
+  } else if (prng_type == rlwe::PRNG_TYPE_CHACHA) {
+    RLWE_ASSIGN_OR_RETURN(
+        prng, rlwe::SingleThreadChaChaPrng::Create(prng_seed_gk_pad));
+    seed_length = rlwe::SingleThreadChaChaPrng::SeedLength();
+  } else {
+    return absl::InvalidArgumentError("Invalid `prng_type`.");
+  }
+  std::string seed(seed_length, 0);
+  for (int i = 0; i <= index; ++i) {
+    for (char& c : seed) {
+      RLWE_ASSIGN_OR_RETURN(uint8_t byte, prng->Rand8());
+      c = static_cast<char>(byte);
+    }
+  }
+  return seed;
+}
+
+// Returns the PRNG seed for the random pads of the giant-step Galois key.
+inline absl::StatusOr<std::string> DeriveGiantStepGaloisKeyPadSeed(
+    absl::string_view prng_seed_gk_pad, rlwe::PrngType prng_type) {
+  return DeriveGaloisKeyPadSeed(prng_seed_gk_pad, prng_type, /*index=*/0);
+}
+
+// Returns the PRNG seed for the random pads of the Galois key rotating by
+// rows_per_block slots, which folds the blocks of a response.
+inline absl::StatusOr<std::string> DeriveFoldGaloisKeyPadSeed(
+    absl::string_view prng_seed_gk_pad, rlwe::PrngType prng_type) {
+  return DeriveGaloisKeyPadSeed(prng_seed_gk_pad, prng_type, /*index=*/1);
+}
+
+}  // namespace linpir
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LINPIR_ROTATIONS_H_
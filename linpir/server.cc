@@ -15,6 +15,9 @@
 
 #include "linpir/server.h"
 
+#include <omp.h>
+
+#include <algorithm>
 #include <cmath>
 #include <memory>
 #include <string>
@@ -26,9 +29,13 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "google/protobuf/repeated_ptr_field.h"
 #include "linpir/database.h"
+#include "linpir/residues.h"
 #include "linpir/parameters.h"
+#include "linpir/query_pad_prng.h"
+#include "linpir/rotations.h"
 #include "shell_encryption/prng/prng.h"
 #include "shell_encryption/prng/single_thread_chacha_prng.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
@@ -37,6 +44,16 @@
 namespace hintless_pir {
 namespace linpir {
 
+namespace {
+
+// The number of query rotations that are computed before absorbing them into
+// the accumulators, which bounds the number of rotations alive per request.
+constexpr int kRotationsPerChunk = 16;
+
+inline int DivAndRoundUp(int x, int y) { return (x + y - 1) / y; }
+
+}  // namespace
+
 template <typename RlweInteger>
 absl::StatusOr<std::unique_ptr<Server<RlweInteger>>>
 Server<RlweInteger>::Create(
@@ -51,6 +68,8 @@ Server<RlweInteger>::Create(
   if (rns_context == nullptr) {
     return absl::InvalidArgumentError("`rns_context` must not be null.");
   }
+  RLWE_RETURN_IF_ERROR(CheckBabyStepSize(parameters));
+  RLWE_RETURN_IF_ERROR(CheckFoldBlocks(parameters));
 
   auto rns_moduli = rns_context->MainPrimeModuli();
   int level = rns_moduli.size() - 1;
@@ -84,18 +103,16 @@ Server<RlweInteger>::Create(
   // Sample PRNG seeds for the query vector and the Galois key.
   std::string prng_seed_ct_pad, prng_seed_gk_pad;
   if (parameters.prng_type == rlwe::PRNG_TYPE_HKDF) {
-    RLWE_ASSIGN_OR_RETURN(prng_seed_ct_pad,
-                          rlwe::SingleThreadHkdfPrng::GenerateSeed());
     RLWE_ASSIGN_OR_RETURN(prng_seed_gk_pad,
                           rlwe::SingleThreadHkdfPrng::GenerateSeed());
   } else if (parameters.prng_type == rlwe::PRNG_TYPE_CHACHA) {
-    RLWE_ASSIGN_OR_RETURN(prng_seed_ct_pad,
-                          rlwe::SingleThreadChaChaPrng::GenerateSeed());
     RLWE_ASSIGN_OR_RETURN(prng_seed_gk_pad,
                           rlwe::SingleThreadChaChaPrng::GenerateSeed());
   } else {
     return absl::InvalidArgumentError("Invalid `prng_type`.");
   }
+  RLWE_ASSIGN_OR_RETURN(prng_seed_ct_pad,
+                        GenerateQueryPadPrngSeed(parameters));
 
   return Server<RlweInteger>::Create(parameters, rns_context, databases,
                                      prng_seed_ct_pad, prng_seed_gk_pad);
@@ -106,20 +123,22 @@ absl::Status Server<RlweInteger>::Preprocess() {
   ct_pads_.clear();
   ct_sub_pad_digits_.clear();
   gk_pads_.clear();
+  gk_giant_step_pads_.clear();
+  giant_step_pads_.clear();
+  gk_fold_pads_.clear();
+  fold_pads_.clear();
 
   // Create PRNGs.
-  std::unique_ptr<rlwe::SecurePrng> prng_ct, prng_gk;
+  std::unique_ptr<rlwe::SecurePrng> prng_gk;
   if (params_.prng_type == rlwe::PRNG_TYPE_HKDF) {
-    RLWE_ASSIGN_OR_RETURN(
-        prng_ct, rlwe::SingleThreadHkdfPrng::Create(prng_seed_ct_pad_));
     RLWE_ASSIGN_OR_RETURN(
         prng_gk, rlwe::SingleThreadHkdfPrng::Create(prng_seed_gk_pad_));
   } else {
-    RLWE_ASSIGN_OR_RETURN(
-        prng_ct, rlwe::SingleThreadChaChaPrng::Create(prng_seed_ct_pad_));
     RLWE_ASSIGN_OR_RETURN(
         prng_gk, rlwe::SingleThreadChaChaPrng::Create(prng_seed_gk_pad_));
   }
+  RLWE_ASSIGN_OR_RETURN(std::unique_ptr<rlwe::SecurePrng> prng_ct,
+                        CreateQueryPadPrng(params_, prng_seed_ct_pad_));
 
   // Expand seed to the "a" part of Enc(query vector)
   int log_n = rns_context_->LogN();
@@ -134,8 +153,9 @@ absl::Status Server<RlweInteger>::Preprocess() {
                                       prng_seed_gk_pad_, params_.prng_type));
 
   // Precompute the "a" part of Enc(s << i) and the digits used to generate
-  // Enc(s << i).
-  int num_rotations = params_.rows_per_block / 2;
+  // Enc(s << i). With baby-step giant-step rotations, only the baby steps are
+  // needed.
+  int num_rotations = EffectiveBabyStepSize(params_);
   ct_pads_.reserve(num_rotations);
   ct_pads_.push_back(std::move(ct_pad));
   ct_sub_pad_digits_.reserve(num_rotations);
@@ -175,29 +195,346 @@ absl::Status Server<RlweInteger>::Preprocess() {
     RLWE_RETURN_IF_ERROR(database->Preprocess(ct_pads_));
   }
 
+  if (params_.baby_step_size > 0 || params_.fold_blocks) {
+    RLWE_RETURN_IF_ERROR(PreprocessResponses());
+  }
   return absl::OkStatus();
 }
 
+template <typename RlweInteger>
+absl::Status Server<RlweInteger>::PreprocessResponses() {
+  // Create the "a" parts of the Galois keys for the giant steps and the folds.
+  int log_n = rns_context_->LogN();
+  int giant_step_power = 0;
+  if (params_.baby_step_size > 0) {
+    RLWE_ASSIGN_OR_RETURN(
+        prng_seed_gk_giant_step_pad_,
+        DeriveGiantStepGaloisKeyPadSeed(prng_seed_gk_pad_, params_.prng_type));
+    RLWE_ASSIGN_OR_RETURN(
+        gk_giant_step_pads_,
+        RnsGaloisKey::SampleRandomPad(rns_gadget_.Dimension(), log_n,
+                                      rns_moduli_, prng_seed_gk_giant_step_pad_,
+                                      params_.prng_type));
+    giant_step_power = RotationGaloisPower(params_.baby_step_size, log_n);
+  }
+  int fold_power = 0;
+  if (params_.fold_blocks) {
+    RLWE_ASSIGN_OR_RETURN(
+        prng_seed_gk_fold_pad_,
+        DeriveFoldGaloisKeyPadSeed(prng_seed_gk_pad_, params_.prng_type));
+    RLWE_ASSIGN_OR_RETURN(
+        gk_fold_pads_,
+        RnsGaloisKey::SampleRandomPad(rns_gadget_.Dimension(), log_n,
+                                      rns_moduli_, prng_seed_gk_fold_pad_,
+                                      params_.prng_type));
+    fold_power = RotationGaloisPower(params_.rows_per_block, log_n);
+  }
+
+  // Follow the "a" parts through the giant steps of every block, and then
+  // through the folds of the blocks.
+  int num_blocks_per_fold = NumBlocksPerFold(params_);
+  for (auto const& database : databases_) {
+    int num_blocks = database->NumBlocks();
+    absl::Span<const RnsPolynomial> pads = database->PadInnerProducts();
+    std::vector<RnsPolynomial> block_pads;
+    if (params_.baby_step_size > 0) {
+      int num_giant_steps = database->NumGiantSteps();
+      std::vector<HornerPads> step_pads;
+      step_pads.reserve(num_blocks);
+      block_pads.reserve(num_blocks);
+      for (int i = 0; i < num_blocks; ++i) {
+        HornerPads horner_pads;
+        RLWE_ASSIGN_OR_RETURN(
+            RnsPolynomial block_pad,
+            PreprocessHorner(pads.subspan(i * num_giant_steps, num_giant_steps),
+                             giant_step_power, gk_giant_step_pads_,
+                             horner_pads));
+        step_pads.push_back(std::move(horner_pads));
+        block_pads.push_back(std::move(block_pad));
+      }
+      giant_step_pads_.push_back(std::move(step_pads));
+      pads = block_pads;
+    }
+    if (params_.fold_blocks) {
+      int num_folds = num_blocks / num_blocks_per_fold;
+      std::vector<HornerPads> block_fold_pads;
+      block_fold_pads.reserve(num_folds);
+      for (int f = 0; f < num_folds; ++f) {
+        HornerPads horner_pads;
+        RLWE_RETURN_IF_ERROR(
+            PreprocessHorner(
+                pads.subspan(f * num_blocks_per_fold, num_blocks_per_fold),
+                fold_power, gk_fold_pads_, horner_pads)
+                .status());
+        block_fold_pads.push_back(std::move(horner_pads));
+      }
+      fold_pads_.push_back(std::move(block_fold_pads));
+    }
+  }
+  return absl::OkStatus();
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsPolynomial<rlwe::MontgomeryInt<RlweInteger>>>
+Server<RlweInteger>::PreprocessHorner(absl::Span<const RnsPolynomial> pads,
+                                      int power,
+                                      absl::Span<const RnsPolynomial> gk_pads,
+                                      HornerPads& horner_pads) const {
+  // Follow the "a" parts through Horner's rule, i.e. acc = pad[m-1], then
+  // acc = Rot(acc) + pad[a] for a = m-2, ..., 0.
+  int log_n = rns_context_->LogN();
+  int num_terms = pads.size();
+  horner_pads.sub_pad_digits.clear();
+  horner_pads.pads.clear();
+  horner_pads.sub_pad_digits.reserve(num_terms - 1);
+  horner_pads.pads.reserve(num_terms - 1);
+  RnsPolynomial acc = pads[num_terms - 1];
+  for (int a = num_terms - 2; a >= 0; --a) {
+    // g^-1(acc(X^power))
+    RLWE_ASSIGN_OR_RETURN(RnsPolynomial sub_acc,
+                          acc.Substitute(power, rns_moduli_));
+    if (sub_acc.IsNttForm()) {
+      RLWE_RETURN_IF_ERROR(sub_acc.ConvertToCoeffForm(rns_moduli_));
+    }
+    RLWE_ASSIGN_OR_RETURN(auto sub_acc_digits,
+                          rns_gadget_.Decompose(sub_acc, rns_moduli_));
+    for (auto& digit : sub_acc_digits) {
+      RLWE_RETURN_IF_ERROR(digit.ConvertToNttForm(rns_moduli_));
+    }
+
+    // g^-1(acc(X^power))^T * gk.a
+    RLWE_ASSIGN_OR_RETURN(
+        acc, RnsPolynomial::CreateZero(log_n, rns_moduli_, /*is_ntt=*/true));
+    for (int k = 0; k < sub_acc_digits.size(); ++k) {
+      RLWE_RETURN_IF_ERROR(
+          acc.FusedMulAddInPlace(sub_acc_digits[k], gk_pads[k], rns_moduli_));
+    }
+    horner_pads.sub_pad_digits.push_back(std::move(sub_acc_digits));
+    horner_pads.pads.push_back(acc);
+    RLWE_RETURN_IF_ERROR(acc.AddInPlace(pads[a], rns_moduli_));
+  }
+  return acc;
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>
+Server<RlweInteger>::CombineByHorner(absl::Span<RnsCiphertext> cts, int power,
+                                     const RnsGaloisKey& gk,
+                                     const HornerPads& horner_pads) const {
+  int num_terms = cts.size();
+  RnsCiphertext ct_acc = std::move(cts[num_terms - 1]);
+  for (int t = 0; t < num_terms - 1; ++t) {
+    int a = num_terms - 2 - t;
+    RLWE_ASSIGN_OR_RETURN(RnsCiphertext ct_sub, ct_acc.Substitute(power));
+    RLWE_ASSIGN_OR_RETURN(
+        ct_acc, gk.ApplyToWithRandomPad(ct_sub, horner_pads.sub_pad_digits[t],
+                                        horner_pads.pads[t]));
+    RLWE_RETURN_IF_ERROR(ct_acc.AddInPlace(cts[a]));
+  }
+  return ct_acc;
+}
+
 template <typename RlweInteger>
 absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
     const RnsCiphertext& ct_query, const RnsGaloisKey& gk) const {
-  // Compute all rotations of the query vector.
-  int num_rotations = params_.rows_per_block / 2;
-  std::vector<RnsCiphertext> ct_rotated_queries;
-  ct_rotated_queries.reserve(num_rotations);
-  ct_rotated_queries.push_back(std::move(ct_query));
-  for (int i = 1; i < num_rotations; ++i) {
-    RLWE_ASSIGN_OR_RETURN(RnsCiphertext ct_sub,
-                          ct_rotated_queries[i - 1].Substitute(5));
-    RLWE_ASSIGN_OR_RETURN(RnsCiphertext ct_rot, gk.ApplyTo(ct_sub));
-    ct_rotated_queries.push_back(std::move(ct_rot));
+  if (params_.baby_step_size > 0) {
+    return absl::UnimplementedError(
+        "Baby-step giant-step rotations require a preprocessed server.");
+  }
+  if (params_.fold_blocks) {
+    return absl::UnimplementedError(
+        "Folding blocks requires a preprocessed server.");
+  }
+
+  // Compute the rotations of the query vector and the inner products with the
+  // databases, then serialize.
+  RLWE_ASSIGN_OR_RETURN(
+      auto ct_accumulators,
+      RotateAndAccumulate(ct_query, gk, /*use_preprocessed_pads=*/false));
+  return CreateResponse(std::move(ct_accumulators),
+                        /*gk_giant_step=*/nullptr, /*gk_fold=*/nullptr);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<std::vector<
+    std::vector<rlwe::RnsBfvCiphertext<rlwe::MontgomeryInt<RlweInteger>>>>>
+Server<RlweInteger>::RotateAndAccumulate(RnsCiphertext ct_query,
+                                         const RnsGaloisKey& gk,
+                                         bool use_preprocessed_pads) const {
+  if (databases_.empty()) {
+    return std::vector<std::vector<RnsCiphertext>>();
+  }
+
+  // The accumulators of all databases, indexed by (database, k).
+  std::vector<std::pair<int, int>> slots;
+  for (int d = 0; d < databases_.size(); ++d) {
+    for (int k = 0; k < databases_[d]->NumAccumulators(); ++k) {
+      slots.push_back({d, k});
+    }
+  }
+  int num_slots = slots.size();
+
+  // Every task absorbs a range of the rotations in a chunk into a partial
+  // accumulator, where the rotations are split into enough ranges to keep all
+  // threads busy when there are few blocks and databases. The partial
+  // accumulators, and the scratch space of every thread for compact diagonals,
+  // are allocated once and reused across chunks.
+  int num_threads = num_threads_ > 0 ? num_threads_ : omp_get_max_threads();
+  int num_ranges =
+      std::clamp(DivAndRoundUp(num_threads, std::max(num_slots, 1)), 1,
+                 kRotationsPerChunk);
+  int num_tasks = num_slots * num_ranges;
+  bool with_pads = !use_preprocessed_pads;
+  std::vector<Accumulator> partials(
+      num_tasks, databases_[0]->CreateZeroAccumulator(with_pads));
+  int max_range_size = DivAndRoundUp(kRotationsPerChunk, num_ranges);
+  std::vector<GatherScratch> scratches;
+  scratches.reserve(num_threads);
+  for (int i = 0; i < num_threads; ++i) {
+    RLWE_ASSIGN_OR_RETURN(GatherScratch scratch,
+                          databases_[0]->CreateGatherScratch(max_range_size));
+    scratches.push_back(std::move(scratch));
   }
-  // Compute inner products with the databases and serialize.
+  std::vector<absl::Status> statuses(num_tasks);
+
+  // Compute the rotations of the query vector one chunk at a time, and absorb
+  // each chunk before computing the next one. The residues of every rotation
+  // are exported once and shared by all tasks.
+  int num_rotations = EffectiveBabyStepSize(params_);
+  std::vector<RnsCiphertext> ct_chunk;
+  ct_chunk.reserve(kRotationsPerChunk);
+  std::vector<absl::StatusOr<QueryResidues>> chunk_residues(kRotationsPerChunk);
+  std::vector<QueryResidues> rotated_queries(kRotationsPerChunk);
+  for (int begin = 0; begin < num_rotations; begin += kRotationsPerChunk) {
+    int end = std::min(begin + kRotationsPerChunk, num_rotations);
+    for (int i = begin; i < end; ++i) {
+      if (i == 0) {
+        ct_chunk.push_back(std::move(ct_query));
+        continue;
+      }
+      RLWE_ASSIGN_OR_RETURN(RnsCiphertext ct_rot,
+                            ct_chunk.back().Substitute(5));
+      if (use_preprocessed_pads) {
+        RLWE_ASSIGN_OR_RETURN(
+            ct_rot, gk.ApplyToWithRandomPad(ct_rot, ct_sub_pad_digits_[i - 1],
+                                            ct_pads_[i]));
+      } else {
+        RLWE_ASSIGN_OR_RETURN(ct_rot, gk.ApplyTo(ct_rot));
+      }
+      if (i == begin) {
+        ct_chunk.clear();
+      }
+      ct_chunk.push_back(std::move(ct_rot));
+    }
+
+    int chunk_size = end - begin;
+#pragma omp parallel for num_threads(num_threads)
+    for (int j = 0; j < chunk_size; ++j) {
+      chunk_residues[j] = ExportCiphertextResidues<ModularInt>(
+          ct_chunk[j], with_pads, rns_moduli_);
+    }
+    for (int j = 0; j < chunk_size; ++j) {
+      RLWE_ASSIGN_OR_RETURN(rotated_queries[j], std::move(chunk_residues[j]));
+    }
+
+#pragma omp parallel for num_threads(num_threads) schedule(dynamic)
+    for (int t = 0; t < num_tasks; ++t) {
+      auto [d, k] = slots[t / num_ranges];
+      int r = t % num_ranges;
+      int range_begin = r * chunk_size / num_ranges;
+      int range_end = (r + 1) * chunk_size / num_ranges;
+      if (range_begin == range_end || !statuses[t].ok()) {
+        continue;
+      }
+      statuses[t] = databases_[d]->AccumulateRotatedQueries(
+          k, begin + range_begin,
+          absl::MakeConstSpan(rotated_queries)
+              .subspan(range_begin, range_end - range_begin),
+          with_pads, partials[t], scratches[omp_get_thread_num()]);
+    }
+  }
+  for (auto const& status : statuses) {
+    RLWE_RETURN_IF_ERROR(status);
+  }
+
+  // Reduce the partial accumulators, which are still lazy sums.
+  std::vector<std::vector<Accumulator>> accumulators(databases_.size());
+  for (int slot = 0; slot < num_slots; ++slot) {
+    Accumulator accumulator = std::move(partials[slot * num_ranges]);
+    for (int r = 1; r < num_ranges; ++r) {
+      const Accumulator& partial = partials[slot * num_ranges + r];
+      RLWE_RETURN_IF_ERROR(accumulator.b.AddInPlace(partial.b, rns_moduli_));
+      RLWE_RETURN_IF_ERROR(accumulator.a.AddInPlace(partial.a, rns_moduli_));
+    }
+    accumulators[slots[slot].first].push_back(std::move(accumulator));
+  }
+  std::vector<std::vector<RnsCiphertext>> ct_accumulators;
+  ct_accumulators.reserve(databases_.size());
+  for (int d = 0; d < databases_.size(); ++d) {
+    RLWE_ASSIGN_OR_RETURN(
+        auto ct_inner_products,
+        databases_[d]->ExportAccumulators(accumulators[d], with_pads));
+    ct_accumulators.push_back(std::move(ct_inner_products));
+  }
+  return ct_accumulators;
+}
+
+template <typename RlweInteger>
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::CreateResponse(
+    std::vector<std::vector<RnsCiphertext>> ct_accumulators,
+    const RnsGaloisKey* gk_giant_step, const RnsGaloisKey* gk_fold) const {
+  int log_n = rns_context_->LogN();
+  int giant_step_power = 0;
+  if (gk_giant_step != nullptr) {
+    giant_step_power = RotationGaloisPower(params_.baby_step_size, log_n);
+  }
+  int fold_power = 0;
+  if (gk_fold != nullptr) {
+    fold_power = RotationGaloisPower(params_.rows_per_block, log_n);
+  }
+  int num_blocks_per_fold = NumBlocksPerFold(params_);
+
   LinPirResponse response;
-  for (auto const& database : databases_) {
+  response.mutable_ct_inner_products()->Reserve(databases_.size());
+  for (int d = 0; d < databases_.size(); ++d) {
+    std::vector<RnsCiphertext>& ct_blocks = ct_accumulators[d];
+    if (gk_giant_step != nullptr) {
+      // Combine the partial inner products of every block by Horner's rule,
+      // using the precomputed "a" components of the giant-step rotations.
+      int num_blocks = databases_[d]->NumBlocks();
+      int num_giant_steps = databases_[d]->NumGiantSteps();
+      std::vector<RnsCiphertext> ct_combined_blocks;
+      ct_combined_blocks.reserve(num_blocks);
+      for (int i = 0; i < num_blocks; ++i) {
+        RLWE_ASSIGN_OR_RETURN(
+            RnsCiphertext ct_block,
+            CombineByHorner(absl::MakeSpan(ct_blocks).subspan(
+                                i * num_giant_steps, num_giant_steps),
+                            giant_step_power, *gk_giant_step,
+                            giant_step_pads_[d][i]));
+        ct_combined_blocks.push_back(std::move(ct_block));
+      }
+      ct_blocks = std::move(ct_combined_blocks);
+    }
+    if (gk_fold != nullptr) {
+      // Sum up the results of the blocks in every fold rotated by multiples of
+      // rows_per_block, again by Horner's rule.
+      int num_folds = ct_blocks.size() / num_blocks_per_fold;
+      std::vector<RnsCiphertext> ct_folds;
+      ct_folds.reserve(num_folds);
+      for (int f = 0; f < num_folds; ++f) {
+        RLWE_ASSIGN_OR_RETURN(
+            RnsCiphertext ct_fold,
+            CombineByHorner(absl::MakeSpan(ct_blocks).subspan(
+                                f * num_blocks_per_fold, num_blocks_per_fold),
+                            fold_power, *gk_fold, fold_pads_[d][f]));
+        ct_folds.push_back(std::move(ct_fold));
+      }
+      ct_blocks = std::move(ct_folds);
+    }
+
     LinPirResponse::EncryptedInnerProduct inner_product;
-    RLWE_ASSIGN_OR_RETURN(std::vector<RnsCiphertext> ct_blocks,
-                          database->InnerProductWith(ct_rotated_queries));
+    inner_product.mutable_ct_blocks()->Reserve(ct_blocks.size());
     for (auto const& ct : ct_blocks) {
       RLWE_ASSIGN_OR_RETURN(*inner_product.add_ct_blocks(), ct.Serialize());
     }
@@ -206,92 +543,73 @@ absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
   return response;
 }
 
-// TODO: You know what to do
 template <typename RlweInteger>
-absl::Status Server<RlweInteger>::PreprocessRequest(
-    std::vector<rlwe::SerializedRnsPolynomial>& proto_ct_query_bs,
-    const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>& proto_gk_key_bs
-) {
-    // Deserialize the "b" components from request and build the query ciphertexts
-    // and the Galois key.
-    int num_rotations = params_.rows_per_block / 2;
-    batch_size_ = proto_ct_query_bs.size();
-    rotated_queries_.clear();
-    rotated_queries_.resize(batch_size_);
-    for (int i = 0; i < batch_size_; i++) {
-        RLWE_ASSIGN_OR_RETURN(
-            RnsPolynomial ct_query_b,
-            RnsPolynomial::Deserialize(proto_ct_query_bs[i], rns_moduli_)
-        );
-        rotated_queries_[i].reserve(num_rotations);
-        rotated_queries_[i].push_back(RnsCiphertext({std::move(ct_query_b), ct_pads_[0]}, rns_moduli_,
-                         /*power_of_s=*/1, /*error=*/0, &rns_error_params_,
-                         rns_context_));
-    }
+absl::StatusOr<
+    std::unique_ptr<const typename Server<RlweInteger>::PreparedRequest>>
+Server<RlweInteger>::PrepareRequest(
+    absl::Span<const rlwe::SerializedRnsPolynomial> proto_ct_query_bs,
+    const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+        proto_gk_key_bs) const {
+  if (params_.baby_step_size > 0) {
+    return absl::UnimplementedError(
+        "Prepared requests do not support baby-step giant-step rotations.");
+  }
+  if (params_.fold_blocks) {
+    return absl::UnimplementedError(
+        "Prepared requests do not support folding blocks.");
+  }
+  if (ct_pads_.empty()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
 
-    std::vector<RnsPolynomial> gk_key_bs;
-    gk_key_bs.reserve(proto_gk_key_bs.size());
-    for (int i = 0; i < proto_gk_key_bs.size(); ++i) {
-        RLWE_ASSIGN_OR_RETURN(
-            RnsPolynomial gk_key_b,
-            RnsPolynomial::Deserialize(proto_gk_key_bs[i], rns_moduli_));
-        gk_key_bs.push_back(std::move(gk_key_b));
-    }
+  // Deserialize the "b" components and build the query ciphertexts and the
+  // Galois key.
+  RLWE_ASSIGN_OR_RETURN(RnsGaloisKey gk, DeserializeGaloisKey(proto_gk_key_bs));
+  std::vector<RnsCiphertext> ct_queries;
+  ct_queries.reserve(proto_ct_query_bs.size());
+  for (auto const& proto_ct_query_b : proto_ct_query_bs) {
     RLWE_ASSIGN_OR_RETURN(
-      RnsGaloisKey gk,
-      RnsGaloisKey::CreateFromKeyComponents(
-          gk_pads_, std::move(gk_key_bs), /*power=*/5, &rns_gadget_,
-          rns_moduli_, prng_seed_gk_pad_, params_.prng_type));
-
-    gk_ = std::make_unique<RnsGaloisKey>(std::move(gk));
-  
-    // Print the size of the rotated queries
-    // 
-    // We can just look at one rotation, look the number of coefficients
-    // + the number of RNS components, multiply by the size
-    auto q = rotated_queries_[0][0];
-    uint64_t q_bytes = q.Len() * q.NumCoeffs() * q.Moduli().size() * sizeof(RlweInteger);
-    uint64_t q_kb = (q_bytes * rotated_queries_.size()) / (1 << 10);
-    
-    auto gk_bytes = (*gk_).Serialize().value().ByteSizeLong();
-    uint64_t gk_kb = gk_bytes / (1 << 10);
-    
-    std::cout << "Query size (" << rotated_queries_.size() << "): " << q_kb << " KB, "
-        << "Rotation Key: " << gk_kb << " KB" << std::endl;
-    
-
-    return absl::OkStatus();
+        RnsPolynomial ct_query_b,
+        RnsPolynomial::Deserialize(proto_ct_query_b, rns_moduli_));
+    ct_queries.push_back(RnsCiphertext(
+        {std::move(ct_query_b), ct_pads_[0]}, rns_moduli_, /*power_of_s=*/1,
+        /*error=*/0, &rns_error_params_, rns_context_));
+  }
+  return absl::WrapUnique<const PreparedRequest>(
+      new PreparedRequest(std::move(ct_queries), std::move(gk)));
 }
 
 template <typename RlweInteger>
-absl::StatusOr<std::vector<LinPirResponse>> Server<RlweInteger>::ProcessRequest() {
-    int num_rotations = params_.rows_per_block / 2;
-
-  // Compute inner products with the databases and serialize.
-  std::vector<LinPirResponse> responses(batch_size_);
-  #pragma omp parallel for 
-  for (int i = 0; i < batch_size_; i++) {
-    // Compute all rotations of the query vector.
-    for (int j = 1; j < num_rotations; ++j) {
-        RnsCiphertext ct_sub = rotated_queries_[i][j - 1].Substitute(5).value();
-        RnsCiphertext ct_rot = (*gk_).ApplyToWithRandomPad(ct_sub, ct_sub_pad_digits_[j - 1], ct_pads_[j]).value();
-        rotated_queries_[i].push_back(std::move(ct_rot));
-    }
-
-    responses[i].mutable_ct_inner_products()->Reserve(databases_.size());
-    for (auto const& database : databases_) {
-      std::vector<RnsCiphertext> ct_blocks = database->InnerProductWithPreprocessedPads(rotated_queries_[i]).value();
-      LinPirResponse::EncryptedInnerProduct inner_product;
-      inner_product.mutable_ct_blocks()->Reserve(ct_blocks.size());
-      for (auto const& ct : ct_blocks) {
-        *inner_product.add_ct_blocks() = ct.Serialize().value();
-      }
-      *responses[i].add_ct_inner_products() = std::move(inner_product);
-    }
-    rotated_queries_[i].erase(rotated_queries_[i].begin() + 1, rotated_queries_[i].end());
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::ProcessPreparedRequest(
+    const PreparedRequest& prepared_request, int index) const {
+  if (index < 0 || index >= prepared_request.BatchSize()) {
+    return absl::InvalidArgumentError("`index` is out of range.");
   }
-  
+  RLWE_ASSIGN_OR_RETURN(
+      auto ct_accumulators,
+      RotateAndAccumulate(prepared_request.ct_queries_[index],
+                          prepared_request.gk_,
+                          /*use_preprocessed_pads=*/true));
+  return CreateResponse(std::move(ct_accumulators),
+                        /*gk_giant_step=*/nullptr, /*gk_fold=*/nullptr);
+}
 
+template <typename RlweInteger>
+absl::StatusOr<std::vector<LinPirResponse>>
+Server<RlweInteger>::ProcessPreparedRequest(
+    const PreparedRequest& prepared_request) const {
+  int batch_size = prepared_request.BatchSize();
+  std::vector<absl::StatusOr<LinPirResponse>> answers(batch_size);
+#pragma omp parallel for
+  for (int i = 0; i < batch_size; ++i) {
+    answers[i] = ProcessPreparedRequest(prepared_request, i);
+  }
+  std::vector<LinPirResponse> responses;
+  responses.reserve(batch_size);
+  for (auto& answer : answers) {
+    RLWE_ASSIGN_OR_RETURN(LinPirResponse response, std::move(answer));
+    responses.push_back(std::move(response));
+  }
   return responses;
 }
 
@@ -300,58 +618,187 @@ absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
     const ::rlwe::SerializedRnsPolynomial& proto_ct_query_b,
     const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
         proto_gk_key_bs) const {
-  // Deserialize the "b" components from request and build the query ciphertext
-  // and the Galois key.
+  return HandleRequest(
+      proto_ct_query_b, proto_gk_key_bs,
+      google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>());
+}
+
+template <typename RlweInteger>
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
+    const ::rlwe::SerializedRnsPolynomial& proto_ct_query_b,
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        proto_gk_key_bs,
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        proto_gk_giant_step_key_bs) const {
+  return HandleRequest(
+      proto_ct_query_b, proto_gk_key_bs, proto_gk_giant_step_key_bs,
+      google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>());
+}
+
+template <typename RlweInteger>
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
+    const ::rlwe::SerializedRnsPolynomial& proto_ct_query_b,
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        proto_gk_key_bs,
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        proto_gk_giant_step_key_bs,
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        proto_gk_fold_key_bs) const {
+  // Deserialize the "b" components from request.
   RLWE_ASSIGN_OR_RETURN(
       RnsPolynomial ct_query_b,
       RnsPolynomial::Deserialize(proto_ct_query_b, rns_moduli_));
+  RLWE_ASSIGN_OR_RETURN(std::vector<RnsPolynomial> gk_key_bs,
+                        DeserializePolynomials(proto_gk_key_bs));
+  RLWE_ASSIGN_OR_RETURN(std::vector<RnsPolynomial> gk_giant_step_key_bs,
+                        DeserializePolynomials(proto_gk_giant_step_key_bs));
+  RLWE_ASSIGN_OR_RETURN(std::vector<RnsPolynomial> gk_fold_key_bs,
+                        DeserializePolynomials(proto_gk_fold_key_bs));
+  return HandleRequest(std::move(ct_query_b), std::move(gk_key_bs),
+                       std::move(gk_giant_step_key_bs),
+                       std::move(gk_fold_key_bs));
+}
+
+template <typename RlweInteger>
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
+    RnsPolynomial ct_query_b, std::vector<RnsPolynomial> gk_key_bs,
+    std::vector<RnsPolynomial> gk_giant_step_key_bs,
+    std::vector<RnsPolynomial> gk_fold_key_bs) const {
+  if (params_.baby_step_size > 0 && gk_giant_step_key_bs.empty()) {
+    return absl::InvalidArgumentError(
+        "Request must contain a Galois key for the giant steps.");
+  }
+  if (params_.fold_blocks && gk_fold_key_bs.empty()) {
+    return absl::InvalidArgumentError(
+        "Request must contain a Galois key for folding blocks.");
+  }
+  if (ct_pads_.empty() || gk_pads_.empty()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
+  if (params_.baby_step_size > 0 && giant_step_pads_.empty()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
+  if (params_.fold_blocks && gk_fold_pads_.empty()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
+  }
+  if (ct_query_b.LogN() != rns_context_->LogN()) {
+    return absl::InvalidArgumentError(
+        "`ct_query_b` has an unexpected number of coefficients.");
+  }
+
+  // Build the query ciphertext and the Galois keys.
   RnsCiphertext ct_query({std::move(ct_query_b), ct_pads_[0]}, rns_moduli_,
                          /*power_of_s=*/1, /*error=*/0, &rns_error_params_,
                          rns_context_);
 
-  std::vector<RnsPolynomial> gk_key_bs;
-  gk_key_bs.reserve(proto_gk_key_bs.size());
-  for (int i = 0; i < proto_gk_key_bs.size(); ++i) {
+  RLWE_ASSIGN_OR_RETURN(RnsGaloisKey gk,
+                        CreateGaloisKey(std::move(gk_key_bs), gk_pads_,
+                                        /*power=*/5, prng_seed_gk_pad_));
+  std::unique_ptr<RnsGaloisKey> gk_giant_step;
+  if (params_.baby_step_size > 0) {
+    int giant_step_power =
+        RotationGaloisPower(params_.baby_step_size, rns_context_->LogN());
+    RLWE_ASSIGN_OR_RETURN(
+        RnsGaloisKey gk_giant,
+        CreateGaloisKey(std::move(gk_giant_step_key_bs), gk_giant_step_pads_,
+                        giant_step_power, prng_seed_gk_giant_step_pad_));
+    gk_giant_step = std::make_unique<RnsGaloisKey>(std::move(gk_giant));
+  }
+  std::unique_ptr<RnsGaloisKey> gk_fold;
+  if (params_.fold_blocks) {
+    int fold_power =
+        RotationGaloisPower(params_.rows_per_block, rns_context_->LogN());
     RLWE_ASSIGN_OR_RETURN(
-        RnsPolynomial gk_key_b,
-        RnsPolynomial::Deserialize(proto_gk_key_bs[i], rns_moduli_));
-    gk_key_bs.push_back(std::move(gk_key_b));
+        RnsGaloisKey gk_fold_blocks,
+        CreateGaloisKey(std::move(gk_fold_key_bs), gk_fold_pads_, fold_power,
+                        prng_seed_gk_fold_pad_));
+    gk_fold = std::make_unique<RnsGaloisKey>(std::move(gk_fold_blocks));
   }
+
+  // Compute the rotations of the query vector, i.e. the baby steps, and the
+  // inner products with the databases, then serialize them.
   RLWE_ASSIGN_OR_RETURN(
-      RnsGaloisKey gk,
-      RnsGaloisKey::CreateFromKeyComponents(
-          gk_pads_, std::move(gk_key_bs), /*power=*/5, &rns_gadget_,
-          rns_moduli_, prng_seed_gk_pad_, params_.prng_type));
-    
-  // Compute all rotations of the query vector.
-  int num_rotations = params_.rows_per_block / 2;
-  std::vector<RnsCiphertext> ct_rotated_queries;
-  ct_rotated_queries.reserve(num_rotations);
-  ct_rotated_queries.push_back(std::move(ct_query));
-  for (int i = 1; i < num_rotations; ++i) {
-    RLWE_ASSIGN_OR_RETURN(RnsCiphertext ct_sub,
-                          ct_rotated_queries[i - 1].Substitute(5));
-    RLWE_ASSIGN_OR_RETURN(RnsCiphertext ct_rot,
-                          gk.ApplyToWithRandomPad(
-                              ct_sub, ct_sub_pad_digits_[i - 1], ct_pads_[i]));
-    ct_rotated_queries.push_back(std::move(ct_rot));
+      auto ct_accumulators,
+      RotateAndAccumulate(std::move(ct_query), gk,
+                          /*use_preprocessed_pads=*/true));
+  return CreateResponse(std::move(ct_accumulators), gk_giant_step.get(),
+                        gk_fold.get());
+}
+
+template <typename RlweInteger>
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
+    const ::rlwe::SerializedRnsPolynomial& proto_ct_query_b,
+    absl::string_view prng_seed_ct_query_pad, const RnsGaloisKey& gk) const {
+  RLWE_ASSIGN_OR_RETURN(
+      RnsPolynomial ct_query_b,
+      RnsPolynomial::Deserialize(proto_ct_query_b, rns_moduli_));
+  return HandleRequest(std::move(ct_query_b), prng_seed_ct_query_pad, gk);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<LinPirResponse> Server<RlweInteger>::HandleRequest(
+    RnsPolynomial ct_query_b, absl::string_view prng_seed_ct_query_pad,
+    const RnsGaloisKey& gk) const {
+  if (ct_query_b.LogN() != rns_context_->LogN()) {
+    return absl::InvalidArgumentError(
+        "`ct_query_b` has an unexpected number of coefficients.");
   }
 
-  // Compute inner products with the databases and serialize them.
-  LinPirResponse response;
-  response.mutable_ct_inner_products()->Reserve(databases_.size());
-  for (auto const& database : databases_) {
-    RLWE_ASSIGN_OR_RETURN(
-        std::vector<RnsCiphertext> ct_blocks,
-        database->InnerProductWithPreprocessedPads(ct_rotated_queries));
-    LinPirResponse::EncryptedInnerProduct inner_product;
-    inner_product.mutable_ct_blocks()->Reserve(ct_blocks.size());
-    for (auto const& ct : ct_blocks) {
-      RLWE_ASSIGN_OR_RETURN(*inner_product.add_ct_blocks(), ct.Serialize());
-    }
-    *response.add_ct_inner_products() = std::move(inner_product);
+  // Expand the "a" component of the query ciphertext in the same way as the
+  // client, which must be negated as in `Preprocess()`.
+  RLWE_ASSIGN_OR_RETURN(std::unique_ptr<rlwe::SecurePrng> prng_ct,
+                        CreateQueryPadPrng(params_, prng_seed_ct_query_pad));
+  RLWE_ASSIGN_OR_RETURN(
+      RnsPolynomial ct_pad,
+      RnsPolynomial::SampleUniform(rns_context_->LogN(), prng_ct.get(),
+                                   rns_moduli_));
+  RLWE_RETURN_IF_ERROR(ct_pad.NegateInPlace(rns_moduli_));
+
+  RnsCiphertext ct_query({std::move(ct_query_b), std::move(ct_pad)},
+                         rns_moduli_, /*power_of_s=*/1, /*error=*/0,
+                         &rns_error_params_, rns_context_);
+  return HandleRequest(ct_query, gk);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsGaloisKey<rlwe::MontgomeryInt<RlweInteger>>>
+Server<RlweInteger>::DeserializeGaloisKey(
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        proto_gk_key_bs) const {
+  if (gk_pads_.empty()) {
+    return absl::FailedPreconditionError("Server has not been preprocessed.");
   }
-  return response;
+  RLWE_ASSIGN_OR_RETURN(std::vector<RnsPolynomial> gk_key_bs,
+                        DeserializePolynomials(proto_gk_key_bs));
+  return CreateGaloisKey(std::move(gk_key_bs), gk_pads_, /*power=*/5,
+                         prng_seed_gk_pad_);
+}
+
+template <typename RlweInteger>
+absl::StatusOr<
+    std::vector<rlwe::RnsPolynomial<rlwe::MontgomeryInt<RlweInteger>>>>
+Server<RlweInteger>::DeserializePolynomials(
+    const google::protobuf::RepeatedPtrField<::rlwe::SerializedRnsPolynomial>&
+        protos) const {
+  std::vector<RnsPolynomial> polys;
+  polys.reserve(protos.size());
+  for (int i = 0; i < protos.size(); ++i) {
+    RLWE_ASSIGN_OR_RETURN(RnsPolynomial poly,
+                          RnsPolynomial::Deserialize(protos[i], rns_moduli_));
+    polys.push_back(std::move(poly));
+  }
+  return polys;
+}
+
+template <typename RlweInteger>
+absl::StatusOr<rlwe::RnsGaloisKey<rlwe::MontgomeryInt<RlweInteger>>>
+Server<RlweInteger>::CreateGaloisKey(std::vector<RnsPolynomial> gk_key_bs,
+                                     const std::vector<RnsPolynomial>& gk_pads,
+                                     int power,
+                                     absl::string_view prng_seed_gk_pad) const {
+  return RnsGaloisKey::CreateFromKeyComponents(
+      gk_pads, std::move(gk_key_bs), power, &rns_gadget_, rns_moduli_,
+      prng_seed_gk_pad, params_.prng_type);
 }
 
 template class Server<Uint32>;
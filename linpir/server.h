@@ -24,9 +24,11 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/span.h"
 #include "google/protobuf/repeated_ptr_field.h"
 #include "linpir/database.h"
 #include "linpir/parameters.h"
+#include "linpir/residues.h"
 #include "linpir/serialization.pb.h"
 #include "shell_encryption/montgomery.h"
 #include "shell_encryption/rns/rns_bfv_ciphertext.h"
@@ -84,31 +86,119 @@ class Server {
   // This variant requires the server and the database are preprocessed.
   absl::StatusOr<LinPirResponse> HandleRequest(
       const LinPirRequest& request) const {
-    return HandleRequest(request.ct_query_b(), request.gk_key_bs());
+    return HandleRequest(request.ct_query_b(), request.gk_key_bs(),
+                         request.gk_giant_step_key_bs(),
+                         request.gk_fold_key_bs());
   }
 
 
-  // TODO
-  absl::Status PreprocessRequest(
-    std::vector<rlwe::SerializedRnsPolynomial>& ct_query_bs,
-    const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>& proto_gk_key_bs
-  );
-  
-  absl::StatusOr<std::vector<LinPirResponse>> ProcessRequest();
+  // A batch of LinPir queries that share a Galois key, deserialized once by
+  // `PrepareRequest`. It is immutable, so any number of threads can process
+  // the same prepared request concurrently, and any number of prepared
+  // requests can coexist. It must be destroyed before the server, and it is
+  // invalidated by calling `Preprocess()` again.
+  class PreparedRequest {
+   public:
+    int BatchSize() const { return ct_queries_.size(); }
+
+   private:
+    friend class Server;
+
+    PreparedRequest(std::vector<RnsCiphertext> ct_queries, RnsGaloisKey gk)
+        : ct_queries_(std::move(ct_queries)), gk_(std::move(gk)) {}
+
+    const std::vector<RnsCiphertext> ct_queries_;
+    const RnsGaloisKey gk_;
+  };
+
+  // Returns a prepared request holding the query ciphertexts with the given
+  // "b" components and the Galois key with the given "b" components.
+  // This requires the server and the database are preprocessed, and it does
+  // not support baby-step giant-step rotations or folding blocks.
+  absl::StatusOr<std::unique_ptr<const PreparedRequest>> PrepareRequest(
+      absl::Span<const rlwe::SerializedRnsPolynomial> proto_ct_query_bs,
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_key_bs) const;
+
+  // Process the query at `index` in `prepared_request`.
+  absl::StatusOr<LinPirResponse> ProcessPreparedRequest(
+      const PreparedRequest& prepared_request, int index) const;
+
+  // Process all queries in `prepared_request`, in parallel.
+  absl::StatusOr<std::vector<LinPirResponse>> ProcessPreparedRequest(
+      const PreparedRequest& prepared_request) const;
 
   // Process a LinPir request represented by individual protos.
-  // This variant requires the server and the database are preprocessed.
+  // This variant requires the server and the database are preprocessed, and
+  // baby-step giant-step rotations and folding blocks to be disabled.
   absl::StatusOr<LinPirResponse> HandleRequest(
       const rlwe::SerializedRnsPolynomial& proto_ct_query_b,
       const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
           proto_gk_key_bs) const;
 
+  // This variant also takes the "b" components of the Galois key for the giant
+  // steps, which must be given if `baby_step_size` is positive.
+  absl::StatusOr<LinPirResponse> HandleRequest(
+      const rlwe::SerializedRnsPolynomial& proto_ct_query_b,
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_key_bs,
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_giant_step_key_bs) const;
+
+  // This variant also takes the "b" components of the Galois key for folding
+  // blocks, which must be given if `fold_blocks` is set.
+  absl::StatusOr<LinPirResponse> HandleRequest(
+      const rlwe::SerializedRnsPolynomial& proto_ct_query_b,
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_key_bs,
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_giant_step_key_bs,
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_fold_key_bs) const;
+
+  // Process a LinPir request given by the deserialized "b" components of the
+  // query ciphertext and of the Galois keys, e.g. read in place from a receive
+  // buffer. The components for the giant steps and for folding blocks must be
+  // given if `baby_step_size` is positive and if `fold_blocks` is set.
+  // This variant requires the server and the database are preprocessed.
+  absl::StatusOr<LinPirResponse> HandleRequest(
+      RnsPolynomial ct_query_b, std::vector<RnsPolynomial> gk_key_bs,
+      std::vector<RnsPolynomial> gk_giant_step_key_bs,
+      std::vector<RnsPolynomial> gk_fold_key_bs) const;
+
   // Process a LinPir request represented by a ciphertext encrypting the vector
   // and a Galois automorphism key.
-  // This variant does not require preprocessing.
+  // This variant does not require preprocessing, and it does not support
+  // baby-step giant-step rotations or folding blocks.
   absl::StatusOr<LinPirResponse> HandleRequest(const RnsCiphertext& ct_query,
                                                const RnsGaloisKey& gk) const;
 
+  // Process a LinPir request whose query ciphertext has its "a" component
+  // expanded from `prng_seed_ct_query_pad` instead of the server's PRNG seed,
+  // using a Galois key that was deserialized earlier by `DeserializeGaloisKey`.
+  // This allows a client to encrypt many queries under the same secret key and
+  // Galois key, at the cost of not using the preprocessed ciphertext pads.
+  absl::StatusOr<LinPirResponse> HandleRequest(
+      const rlwe::SerializedRnsPolynomial& proto_ct_query_b,
+      absl::string_view prng_seed_ct_query_pad, const RnsGaloisKey& gk) const;
+
+  // This variant takes the deserialized "b" component of the query ciphertext.
+  absl::StatusOr<LinPirResponse> HandleRequest(
+      RnsPolynomial ct_query_b, absl::string_view prng_seed_ct_query_pad,
+      const RnsGaloisKey& gk) const;
+
+  // Returns the Galois key with the given "b" components and the "a"
+  // components generated from the server's PRNG seed.
+  // This requires the server to be preprocessed.
+  absl::StatusOr<RnsGaloisKey> DeserializeGaloisKey(
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          proto_gk_key_bs) const;
+
+  // Sets the number of threads used to compute the inner products of a
+  // request, where 0 means the OpenMP default. The work is split into tasks
+  // over (database, block, range of rotations).
+  void SetNumThreads(int num_threads) { num_threads_ = num_threads; }
+
   // Accessors to the PRNG seeds for generating a LinPir request.
   absl::string_view PrngSeedForCiphertextRandomPads() const {
     return prng_seed_ct_pad_;
@@ -118,6 +208,10 @@ class Server {
   }
 
  private:
+  using Accumulator = typename Database<RlweInteger>::Accumulator;
+  using GatherScratch = typename Database<RlweInteger>::GatherScratch;
+  using QueryResidues = CiphertextResidues<RlweInteger>;
+
   explicit Server(RlweParameters<RlweInteger> params,
                   std::string prng_seed_ct_pad, std::string prng_seed_gk_pad,
                   const RnsContext* rns_context,
@@ -133,6 +227,63 @@ class Server {
         rns_gadget_(std::move(rns_gadget)),
         databases_(std::move(databases)) {}
 
+  // Returns the polynomials serialized in `protos`.
+  absl::StatusOr<std::vector<RnsPolynomial>> DeserializePolynomials(
+      const google::protobuf::RepeatedPtrField<rlwe::SerializedRnsPolynomial>&
+          protos) const;
+
+  // Returns the Galois key with the given "b" components and "a" components.
+  absl::StatusOr<RnsGaloisKey> CreateGaloisKey(
+      std::vector<RnsPolynomial> gk_key_bs,
+      const std::vector<RnsPolynomial>& gk_pads, int power,
+      absl::string_view prng_seed_gk_pad) const;
+
+  // Preprocessed polynomials for combining ciphertexts c[0], ..., c[m-1] by
+  // Horner's rule, i.e. acc = c[m-1], then acc = Rot(acc) + c[a] for
+  // a = m-2, ..., 0, where Rot is a rotation. Entry t holds the digits of the
+  // substituted "a" component going into the t'th rotation and the "a"
+  // component coming out of it.
+  struct HornerPads {
+    std::vector<std::vector<RnsPolynomial>> sub_pad_digits;
+    std::vector<RnsPolynomial> pads;
+  };
+
+  // Precomputes `giant_step_pads_` and `fold_pads_` from the preprocessed
+  // databases.
+  absl::Status PreprocessResponses();
+
+  // Sets `horner_pads` to the pads for combining ciphertexts whose "a"
+  // components are `pads` by Horner's rule, where Rot is the Galois
+  // automorphism with `power` and its key has the "a" components `gk_pads`.
+  // Returns the "a" component of the result.
+  absl::StatusOr<RnsPolynomial> PreprocessHorner(
+      absl::Span<const RnsPolynomial> pads, int power,
+      absl::Span<const RnsPolynomial> gk_pads, HornerPads& horner_pads) const;
+
+  // Returns `cts` combined by Horner's rule, where Rot is the Galois
+  // automorphism with `power` and the key `gk`, using the pads precomputed by
+  // `PreprocessHorner`. The ciphertexts in `cts` are consumed.
+  absl::StatusOr<RnsCiphertext> CombineByHorner(
+      absl::Span<RnsCiphertext> cts, int power, const RnsGaloisKey& gk,
+      const HornerPads& horner_pads) const;
+
+  // Computes the rotations of `ct_query` in chunks of a few rotations, and
+  // absorbs each chunk into the lazy accumulators of every database in
+  // parallel before computing the next one, so that only one chunk of
+  // rotations is alive at any time. If `use_preprocessed_pads` is true, the
+  // rotations use the preprocessed digits and the accumulators get the
+  // preprocessed "a" components.
+  absl::StatusOr<std::vector<std::vector<RnsCiphertext>>> RotateAndAccumulate(
+      RnsCiphertext ct_query, const RnsGaloisKey& gk,
+      bool use_preprocessed_pads) const;
+
+  // Serializes the accumulated inner products of every database, after
+  // combining the giant steps of every block if `gk_giant_step` is not null,
+  // and then the blocks of every fold if `gk_fold` is not null.
+  absl::StatusOr<LinPirResponse> CreateResponse(
+      std::vector<std::vector<RnsCiphertext>> ct_accumulators,
+      const RnsGaloisKey* gk_giant_step, const RnsGaloisKey* gk_fold) const;
+
   const RlweParameters<RlweInteger> params_;
 
   std::string prng_seed_ct_pad_;
@@ -146,15 +297,27 @@ class Server {
   // Holding the matrices via mutable pointers to perform preprocessing tasks.
   std::vector<Database<RlweInteger>*> databases_;
 
+  // The number of threads for computing inner products, or 0 for the default.
+  int num_threads_ = 0;
+
   // Preprocessed polynomials to be used in `HandleRequest`.
   std::vector<RnsPolynomial> ct_pads_;
   std::vector<std::vector<RnsPolynomial>> ct_sub_pad_digits_;
   std::vector<RnsPolynomial> gk_pads_;
 
-  // TODO: Test stuff
-  std::vector<std::vector<RnsCiphertext>> rotated_queries_;
-  std::unique_ptr<RnsGaloisKey> gk_;
-  size_t batch_size_;
+  // Preprocessed polynomials for the giant steps of every database block, when
+  // `baby_step_size` is positive, where the partial inner products of a block
+  // are combined by Horner's rule.
+  std::string prng_seed_gk_giant_step_pad_;
+  std::vector<RnsPolynomial> gk_giant_step_pads_;
+  std::vector<std::vector<HornerPads>> giant_step_pads_;  // [db][block]
+
+  // Preprocessed polynomials for every fold of database blocks, when
+  // `fold_blocks` is set, where the blocks of a fold are combined by Horner's
+  // rule with rotations by rows_per_block.
+  std::string prng_seed_gk_fold_pad_;
+  std::vector<RnsPolynomial> gk_fold_pads_;
+  std::vector<std::vector<HornerPads>> fold_pads_;  // [db][fold]
 };
 
 }  // namespace linpir
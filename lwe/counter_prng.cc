@@ -0,0 +1,236 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/counter_prng.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+#include "Eigen/Core"
+#include "absl/log/check.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "lwe/types.h"
+#include "openssl/chacha.h"
+#include "openssl/evp.h"
+#include "openssl/rand.h"
+#include "shell_encryption/integral_types.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace lwe {
+
+namespace {
+
+// The stream is generated in blocks of ChaCha20, which are 4 AES blocks.
+constexpr int kBlockBytes = 64;
+constexpr int kNonceBytes = 12;
+constexpr int kAesBlockBytes = 16;
+constexpr int kAesBlocksPerBlock = kBlockBytes / kAesBlockBytes;
+
+// The number of rows of a matrix expanded at once by a thread.
+constexpr int kRowsPerChunk = 16;
+
+// Writes the ChaCha20 keystream from block `block` to `output`, whose size is
+// a multiple of the block size. The high 32 bits of the 64-bit block counter
+// are held in the first word of the nonce, which is what the 64-bit counter of
+// the original ChaCha20 is with a zero nonce.
+void ChaChaBlocks(const uint8_t* key, uint64_t block, uint8_t* output,
+                  size_t size) {
+  std::memset(output, 0, size);
+  while (size > 0) {
+    // The 32-bit counter must not wrap around within a call.
+    uint32_t counter = static_cast<uint32_t>(block);
+    uint64_t num_blocks = std::min<uint64_t>(size / kBlockBytes,
+                                             (uint64_t{1} << 32) - counter);
+    uint8_t nonce[kNonceBytes] = {0};
+    uint32_t block_high = static_cast<uint32_t>(block >> 32);
+    for (int i = 0; i < 4; ++i) {
+      nonce[i] = static_cast<uint8_t>(block_high >> (8 * i));
+    }
+    size_t num_bytes = num_blocks * kBlockBytes;
+    CRYPTO_chacha_20(output, output, num_bytes, key, nonce, counter);
+    output += num_bytes;
+    size -= num_bytes;
+    block += num_blocks;
+  }
+}
+
+// Writes the AES-256-CTR keystream from block `block` to `output`, whose size
+// is a multiple of the block size. Block `block` starts at the AES counter
+// 4 * `block`, held in the IV as a 128-bit big-endian integer, whose high 64
+// bits are zero as byte positions fit in 64 bits.
+void AesCtrBlocks(const uint8_t* key, uint64_t block, uint8_t* output,
+                  size_t size) {
+  uint8_t iv[kAesBlockBytes] = {0};
+  uint64_t counter = block * kAesBlocksPerBlock;
+  for (int i = 0; i < 8; ++i) {
+    iv[kAesBlockBytes - 1 - i] = static_cast<uint8_t>(counter >> (8 * i));
+  }
+  std::memset(output, 0, size);
+  EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+  CHECK(ctx != nullptr);
+  CHECK_EQ(EVP_EncryptInit_ex(ctx, EVP_aes_256_ctr(), nullptr, key, iv), 1);
+  while (size > 0) {
+    // EVP_EncryptUpdate takes the length as an int.
+    int num_bytes = static_cast<int>(std::min<size_t>(size, 1 << 30));
+    int num_written_bytes;
+    CHECK_EQ(EVP_EncryptUpdate(ctx, output, &num_written_bytes, output,
+                               num_bytes),
+             1);
+    output += num_bytes;
+    size -= num_bytes;
+  }
+  EVP_CIPHER_CTX_free(ctx);
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<CounterPrng>> CounterPrng::Create(
+    absl::string_view seed, CounterPrngCipher cipher) {
+  if (seed.size() != kSeedBytes) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("`seed` must have ", kSeedBytes, " bytes."));
+  }
+  if (!(cipher == CounterPrngCipher::kChaCha20 ||
+        cipher == CounterPrngCipher::kAes256Ctr)) {
+    return absl::InvalidArgumentError("Invalid `cipher`.");
+  }
+  return std::unique_ptr<CounterPrng>(
+      new CounterPrng(std::string(seed), cipher));
+}
+
+absl::StatusOr<std::string> CounterPrng::GenerateSeed() {
+  std::string seed(kSeedBytes, 0);
+  if (RAND_bytes(reinterpret_cast<uint8_t*>(seed.data()), seed.size()) != 1) {
+    return absl::InternalError("Failed to generate a seed.");
+  }
+  return seed;
+}
+
+absl::StatusOr<rlwe::Uint8> CounterPrng::Rand8() {
+  if (buffer_begin_ == buffer_end_) {
+    Refill();
+  }
+  return buffer_[buffer_begin_++];
+}
+
+absl::StatusOr<rlwe::Uint64> CounterPrng::Rand64() {
+  uint8_t bytes[sizeof(rlwe::Uint64)];
+  if (buffer_end_ - buffer_begin_ >= sizeof(bytes)) {
+    std::memcpy(bytes, buffer_.data() + buffer_begin_, sizeof(bytes));
+    buffer_begin_ += sizeof(bytes);
+  } else {
+    for (int i = 0; i < sizeof(bytes); ++i) {
+      RLWE_ASSIGN_OR_RETURN(bytes[i], Rand8());
+    }
+  }
+  rlwe::Uint64 value;
+  std::memcpy(&value, bytes, sizeof(value));
+  return value;
+}
+
+void CounterPrng::SampleBytes(absl::Span<uint8_t> output) {
+  uint8_t* dst = output.data();
+  size_t size = output.size();
+  size_t num_buffered_bytes =
+      std::min<size_t>(size, buffer_end_ - buffer_begin_);
+  std::memcpy(dst, buffer_.data() + buffer_begin_, num_buffered_bytes);
+  buffer_begin_ += num_buffered_bytes;
+  size -= num_buffered_bytes;
+  FillBytes(next_position_,
+            absl::MakeSpan(dst + num_buffered_bytes, size));
+  next_position_ += size;
+}
+
+void CounterPrng::Refill() {
+  FillBytes(next_position_, absl::MakeSpan(buffer_));
+  next_position_ += buffer_.size();
+  buffer_begin_ = 0;
+  buffer_end_ = buffer_.size();
+}
+
+void CounterPrng::FillBytes(uint64_t position,
+                            absl::Span<uint8_t> output) const {
+  const uint8_t* key = reinterpret_cast<const uint8_t*>(key_.data());
+  auto* blocks = cipher_ == CounterPrngCipher::kAes256Ctr ? AesCtrBlocks
+                                                           : ChaChaBlocks;
+  uint8_t* dst = output.data();
+  size_t size = output.size();
+
+  // A partial block at the beginning.
+  uint64_t block = position / kBlockBytes;
+  int offset = position % kBlockBytes;
+  if (offset > 0 && size > 0) {
+    uint8_t buffer[kBlockBytes];
+    blocks(key, block, buffer, kBlockBytes);
+    size_t num_bytes = std::min<size_t>(size, kBlockBytes - offset);
+    std::memcpy(dst, buffer + offset, num_bytes);
+    dst += num_bytes;
+    size -= num_bytes;
+    ++block;
+  }
+
+  // The whole blocks are written directly into `output`.
+  size_t num_whole_bytes = size - size % kBlockBytes;
+  blocks(key, block, dst, num_whole_bytes);
+  dst += num_whole_bytes;
+  size -= num_whole_bytes;
+  block += num_whole_bytes / kBlockBytes;
+
+  // A partial block at the end.
+  if (size > 0) {
+    uint8_t buffer[kBlockBytes];
+    blocks(key, block, buffer, kBlockBytes);
+    std::memcpy(dst, buffer, size);
+  }
+}
+
+absl::StatusOr<Matrix> SampleUniformMatrixInParallel(int num_rows,
+                                                     int num_cols,
+                                                     const CounterPrng& prng) {
+  if (num_rows < 0) {
+    return absl::InvalidArgumentError("num_rows must be non-negative.");
+  }
+  if (num_cols < 0) {
+    return absl::InvalidArgumentError("num_cols must be non-negative.");
+  }
+
+  // The stream is in row-major order, so each thread expands a chunk of rows
+  // at once into a row-major buffer before copying it to the matrix.
+  using RowMajorMatrix =
+      Eigen::Matrix<Integer, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  Matrix output(num_rows, num_cols);
+  int num_chunks = (num_rows + kRowsPerChunk - 1) / kRowsPerChunk;
+#pragma omp parallel for
+  for (int chunk = 0; chunk < num_chunks; ++chunk) {
+    int first_row = chunk * kRowsPerChunk;
+    int chunk_rows = std::min(kRowsPerChunk, num_rows - first_row);
+    RowMajorMatrix buffer(chunk_rows, num_cols);
+    prng.FillUniform(static_cast<uint64_t>(first_row) * num_cols,
+                     absl::MakeSpan(buffer.data(), buffer.size()));
+    output.middleRows(first_row, chunk_rows) = buffer;
+  }
+  return output;
+}
+
+}  // namespace lwe
+}  // namespace hintless_pir
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LWE_COUNTER_PRNG_H_
+#define HINTLESS_PIR_LWE_COUNTER_PRNG_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/string_view.h"
+#include "absl/types/span.h"
+#include "lwe/types.h"
+#include "shell_encryption/integral_types.h"
+#include "shell_encryption/prng/prng.h"
+
+namespace hintless_pir {
+namespace lwe {
+
+// The stream ciphers that a `CounterPrng` can use.
+enum class CounterPrngCipher {
+  // ChaCha20 with a zero nonce and a 64-bit block counter.
+  kChaCha20,
+  // AES-256 in counter mode with a 128-bit big-endian counter starting at 0,
+  // which runs on the AES instructions of the CPU (e.g. AES-NI or VAES on
+  // x86-64, and the cryptography extensions on ARMv8) when available.
+  kAes256Ctr,
+};
+
+// A PRNG in counter mode, whose output stream is the keystream of a stream
+// cipher from `CounterPrngCipher` under the seed as the key. Unlike
+// the PRNGs of the SHELL library, any part of the stream can be generated
+// directly from its position, so that a long stream can be split into pieces,
+// e.g. by rows of a matrix, that are expanded independently by multiple
+// threads, and the result is identical to consuming the stream sequentially.
+class CounterPrng final : public rlwe::SecurePrng {
+ public:
+  static constexpr int kSeedBytes = 32;
+
+  // Creates a PRNG from a seed of `kSeedBytes` bytes, whose stream is the
+  // keystream of `cipher`.
+  static absl::StatusOr<std::unique_ptr<CounterPrng>> Create(
+      absl::string_view seed,
+      CounterPrngCipher cipher = CounterPrngCipher::kChaCha20);
+
+  // Returns a fresh random seed.
+  static absl::StatusOr<std::string> GenerateSeed();
+
+  static int SeedLength() { return kSeedBytes; }
+
+  CounterPrngCipher Cipher() const { return cipher_; }
+
+  // Returns the next byte(s) of the stream as in other SHELL PRNGs, starting
+  // from the position set by `Seek`.
+  absl::StatusOr<rlwe::Uint8> Rand8() override;
+  absl::StatusOr<rlwe::Uint64> Rand64() override;
+
+  // Writes the next `output.size()` bytes of the stream to `output`. All but
+  // the buffered bytes are generated directly into `output`.
+  void SampleBytes(absl::Span<uint8_t> output);
+
+  // Writes the next `output.size()` integers of the stream to `output`, read
+  // in host byte order.
+  void SampleUniform(absl::Span<Integer> output) {
+    SampleBytes(absl::MakeSpan(reinterpret_cast<uint8_t*>(output.data()),
+                               output.size() * sizeof(Integer)));
+  }
+
+  // Moves the sequential interface above to the byte `position` of the stream.
+  void Seek(uint64_t position) {
+    next_position_ = position;
+    buffer_begin_ = buffer_end_ = 0;
+  }
+
+  // Writes the bytes of the stream at [`position`, `position` +
+  // `output.size()`) to `output`. This does not change the position of the
+  // sequential interface, and it is safe to call concurrently.
+  void FillBytes(uint64_t position, absl::Span<uint8_t> output) const;
+
+  // Writes the `output.size()` uniformly random integers starting at the
+  // `index`'th integer of the stream to `output`, where the stream is read as
+  // integers in host byte order. On little-endian hosts, this is the same as
+  // sampling them by `SampleUniformVectorInPlace` using the sequential
+  // interface from byte position `index * sizeof(Integer)`.
+  void FillUniform(uint64_t index, absl::Span<Integer> output) const {
+    FillBytes(index * sizeof(Integer),
+              absl::MakeSpan(reinterpret_cast<uint8_t*>(output.data()),
+                             output.size() * sizeof(Integer)));
+  }
+
+ private:
+  // The number of bytes buffered by the sequential interface.
+  static constexpr int kBufferBytes = 4096;
+
+  CounterPrng(std::string key, CounterPrngCipher cipher)
+      : key_(std::move(key)), cipher_(cipher), buffer_(kBufferBytes) {}
+
+  // Refills the buffer of the sequential interface from `next_position_`.
+  void Refill();
+
+  const std::string key_;
+  const CounterPrngCipher cipher_;
+
+  // The sequential interface reads the bytes at [buffer_begin_, buffer_end_)
+  // of the buffer, which are followed by the stream from `next_position_`.
+  uint64_t next_position_ = 0;
+  std::vector<uint8_t> buffer_;
+  int buffer_begin_ = 0;
+  int buffer_end_ = 0;
+};
+
+// Samples a `num_rows` x `num_cols` matrix of uniformly random integers from
+// `prng`, where row i is expanded from the integers of the stream starting at
+// index i * `num_cols`. The rows are expanded in parallel, and the result is
+// the same as sampling the rows one after another using `SampleUniformMatrix`
+// with a fresh `CounterPrng` of the same seed and cipher, when `num_cols` is
+// even.
+absl::StatusOr<Matrix> SampleUniformMatrixInParallel(int num_rows,
+                                                     int num_cols,
+                                                     const CounterPrng& prng);
+
+}  // namespace lwe
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LWE_COUNTER_PRNG_H_
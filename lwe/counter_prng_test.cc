@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/counter_prng.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/strings/escaping.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lwe/sample_error.h"
+#include "lwe/types.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+
+// The first two blocks of the ChaCha20 keystream under the all-zero key and
+// nonce, from the test vectors in RFC 8439, Appendix A.1.
+constexpr absl::string_view kZeroKeyStream =
+    "76b8e0ada0f13d90405d6ae55386bd28bdd219b8a08ded1aa836efcc8b770dc7"
+    "da41597c5157488d7724e03fb8d84a376a43b8f41518a11cc387b669b2ee6586"
+    "9f07e7be5551387a98ba977c732d080dcb0f29a048e3656912c6533e32ee7aed"
+    "29b721769ce64e43d57133b074d839d531ed1f28510afb45ace10a1f4b794d6f";
+
+// The first four blocks of the AES-256-CTR keystream under the all-zero key,
+// with the counter starting at 0, i.e. the encryptions of 0, 1, 2, and 3.
+constexpr absl::string_view kZeroKeyAesStream =
+    "dc95c078a2408989ad48a21492842087530f8afbc74536b9a963b4f1c4cb738b"
+    "cea7403d4d606b6e074ec5d3baf39d18726003ca37a62a74d1a2f58e7506358e";
+
+std::string Hex(absl::Span<const uint8_t> bytes) {
+  return absl::BytesToHexString(absl::string_view(
+      reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+}
+
+TEST(CounterPrngTest, CreateFailsIfSeedHasWrongSize) {
+  EXPECT_THAT(CounterPrng::Create(std::string(CounterPrng::kSeedBytes - 1, 0)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CounterPrng::Create(std::string(CounterPrng::kSeedBytes + 1, 0)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CounterPrngTest, StreamIsChaCha20KeyStream) {
+  ASSERT_OK_AND_ASSIGN(auto prng, CounterPrng::Create(std::string(
+                                      CounterPrng::kSeedBytes, 0)));
+  std::vector<uint8_t> bytes(kZeroKeyStream.size() / 2);
+  prng->FillBytes(0, absl::MakeSpan(bytes));
+  EXPECT_EQ(Hex(bytes), kZeroKeyStream);
+
+  // Any window of the stream can be generated from its position.
+  for (int position : {1, 63, 64, 70}) {
+    std::vector<uint8_t> window(bytes.size() - position);
+    prng->FillBytes(position, absl::MakeSpan(window));
+    EXPECT_EQ(Hex(window), kZeroKeyStream.substr(2 * position));
+  }
+
+  // The sequential interface reads the same stream.
+  std::vector<uint8_t> sequential_bytes;
+  for (int i = 0; i < bytes.size(); ++i) {
+    ASSERT_OK_AND_ASSIGN(uint8_t byte, prng->Rand8());
+    sequential_bytes.push_back(byte);
+  }
+  EXPECT_EQ(sequential_bytes, bytes);
+}
+
+TEST(CounterPrngTest, StreamIsAes256CtrKeyStream) {
+  ASSERT_OK_AND_ASSIGN(
+      auto prng, CounterPrng::Create(std::string(CounterPrng::kSeedBytes, 0),
+                                     CounterPrngCipher::kAes256Ctr));
+  std::vector<uint8_t> bytes(kZeroKeyAesStream.size() / 2);
+  prng->FillBytes(0, absl::MakeSpan(bytes));
+  EXPECT_EQ(Hex(bytes), kZeroKeyAesStream);
+
+  for (int position : {1, 15, 16, 33}) {
+    std::vector<uint8_t> window(bytes.size() - position);
+    prng->FillBytes(position, absl::MakeSpan(window));
+    EXPECT_EQ(Hex(window), kZeroKeyAesStream.substr(2 * position));
+  }
+
+  // The keystreams of different ciphers under the same key are different.
+  ASSERT_OK_AND_ASSIGN(auto chacha_prng, CounterPrng::Create(std::string(
+                                             CounterPrng::kSeedBytes, 0)));
+  std::vector<uint8_t> chacha_bytes(bytes.size());
+  chacha_prng->FillBytes(0, absl::MakeSpan(chacha_bytes));
+  EXPECT_NE(chacha_bytes, bytes);
+}
+
+TEST(CounterPrngTest, SequentialAndRandomAccessStreamsMatch) {
+  ASSERT_OK_AND_ASSIGN(std::string seed, CounterPrng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(auto prng, CounterPrng::Create(seed));
+  ASSERT_OK_AND_ASSIGN(auto other_prng, CounterPrng::Create(seed));
+
+  // Mixes sequential reads of different sizes that cross the buffer boundary.
+  constexpr int kNumValues = 3001;
+  std::vector<Integer> expected(kNumValues);
+  prng->FillUniform(0, absl::MakeSpan(expected));
+  std::vector<Integer> values;
+  for (int i = 0; i + 2 <= kNumValues;) {
+    if (i % 7 == 0) {
+      std::vector<Integer> chunk(std::min(333, kNumValues - i));
+      other_prng->SampleUniform(absl::MakeSpan(chunk));
+      values.insert(values.end(), chunk.begin(), chunk.end());
+      i += chunk.size();
+    } else {
+      ASSERT_OK_AND_ASSIGN(uint64_t r64, other_prng->Rand64());
+      values.push_back(static_cast<Integer>(r64));
+      values.push_back(static_cast<Integer>(r64 >> 32));
+      i += 2;
+    }
+  }
+  values.resize(std::min<int>(values.size(), kNumValues));
+  EXPECT_THAT(values, ::testing::ElementsAreArray(expected.data(),
+                                                   values.size()));
+
+  // Seeking restarts the sequential interface at the given position.
+  other_prng->Seek(10 * sizeof(Integer));
+  ASSERT_OK_AND_ASSIGN(uint64_t r64, other_prng->Rand64());
+  EXPECT_EQ(static_cast<Integer>(r64), expected[10]);
+  EXPECT_EQ(static_cast<Integer>(r64 >> 32), expected[11]);
+}
+
+class CounterPrngCipherTest
+    : public ::testing::TestWithParam<CounterPrngCipher> {};
+
+TEST_P(CounterPrngCipherTest, ParallelMatrixMatchesSequentialExpansion) {
+  ASSERT_OK_AND_ASSIGN(std::string seed, CounterPrng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(auto prng, CounterPrng::Create(seed, GetParam()));
+  ASSERT_OK_AND_ASSIGN(auto sequential_prng,
+                       CounterPrng::Create(seed, GetParam()));
+  for (auto [num_rows, num_cols] : {std::pair{37, 1024}, std::pair{1, 2}}) {
+    ASSERT_OK_AND_ASSIGN(
+        Matrix matrix,
+        SampleUniformMatrixInParallel(num_rows, num_cols, *prng));
+    sequential_prng->Seek(0);
+    ASSERT_OK_AND_ASSIGN(
+        Matrix expected,
+        SampleUniformMatrix(num_rows, num_cols, sequential_prng.get()));
+    EXPECT_EQ(matrix, expected);
+  }
+  EXPECT_THAT(SampleUniformMatrixInParallel(-1, 2, *prng),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+INSTANTIATE_TEST_SUITE_P(CounterPrngCiphers, CounterPrngCipherTest,
+                         testing::Values(CounterPrngCipher::kChaCha20,
+                                         CounterPrngCipher::kAes256Ctr));
+
+}  // namespace
+}  // namespace lwe
+}  // namespace hintless_pir
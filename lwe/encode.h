@@ -31,7 +31,7 @@ inline absl::Status EncodeMessageInPlace(Vector& message,
         absl::StrCat("The log scaling factor, ", log_scaling_factor,
                      ", should be >= 0 and <= ", kIntBitwidth));
   }
-  message *= (1 << log_scaling_factor);
+  message *= Integer{1} << log_scaling_factor;
   return absl::OkStatus();
 }
 
@@ -44,12 +44,12 @@ inline absl::Status RemoveErrorInPlace(Vector& noisy_message,
         "The log scaling factor, ", log_scaling_factor, ", should be >= 0"));
   }
   // noisy_message := \Delta m + e + (\Delta/2)
-  noisy_message.array() += (1 << (log_scaling_factor - 1));
+  noisy_message.array() += Integer{1} << (log_scaling_factor - 1);
   // = floor(m + 1/2 + e/\Delta) = nearest_int(m + e/\Delta)
-  noisy_message.array() /= (1 << log_scaling_factor);
+  noisy_message.array() /= Integer{1} << log_scaling_factor;
   // Result may be large, reduce back to the ptxt space
   noisy_message = noisy_message.array().unaryExpr([&](Integer x) {
-    return x % (1 << (kIntBitwidth - log_scaling_factor));
+    return x % (Integer{1} << (kIntBitwidth - log_scaling_factor));
   });
   return absl::OkStatus();
 }
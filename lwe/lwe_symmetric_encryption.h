@@ -16,14 +16,21 @@
 #ifndef HINTLESS_PIR_LWE_SYMMETRIC_ENCRYPTION_H_
 #define HINTLESS_PIR_LWE_SYMMETRIC_ENCRYPTION_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <utility>
+#include <vector>
 
 #include "Eigen/Core"
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "lwe/counter_prng.h"
 #include "lwe/encode.h"
+#include "lwe/ring_pad.h"
 #include "lwe/sample_error.h"
+#include "lwe/ternary_product_hwy.h"
 #include "lwe/types.h"
 #include "shell_encryption/prng/prng.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
@@ -46,6 +53,19 @@ static absl::StatusOr<Matrix> ExpandPad(int num_rows, int num_cols,
   return SampleUniformMatrix(num_rows, num_cols, encryption_prng);
 }
 
+// Expands the pad from a counter-mode prng, with the rows expanded in parallel.
+// The pad is the same as the one expanded by `ExpandPad` from a fresh
+// `CounterPrng` with the same seed when `num_cols` is even.
+static absl::StatusOr<Matrix> ExpandPadInParallel(
+    int num_rows, int num_cols, const CounterPrng& encryption_prng) {
+  if (num_rows < 1) {
+    return absl::InvalidArgumentError("The number of rows must be positive.");
+  } else if (num_cols < 1) {
+    return absl::InvalidArgumentError("The number of cols must be positive.");
+  }
+  return SampleUniformMatrixInParallel(num_rows, num_cols, encryption_prng);
+}
+
 // This file implements the somewhat homomorphic symmetric-key encryption scheme
 // used in SimplePIR
 // https://eprint.iacr.org/2022/949
@@ -159,10 +179,94 @@ class SymmetricLweKey {
     // Samples the Centered binomial and adds it to the (encoded) plaintext
     RLWE_RETURN_IF_ERROR(SampleAndAddCenteredBinomialInPlace(plaintext, prng));
     // Adds pad * s to the encoded vector \Delta * m + e
-    plaintext += pad * key_;
+    return internal::AddColMajorTernaryProduct(
+        absl::MakeConstSpan(pad.data(), pad.size()), Len(), plus_bits_,
+        minus_bits_, absl::MakeSpan(plaintext.data(), plaintext.size()));
+  }
+
+  // Adds the products of the key with the rows of a pad to `result`, where
+  // `pad_rows` holds result.size() rows of `Len()` integers in row-major order,
+  // e.g. a tile of a pad that is expanded a few rows at a time.
+  absl::Status AddPadRowsProductInPlace(absl::Span<const Integer> pad_rows,
+                                        absl::Span<Integer> result) const {
+    return internal::AddRowMajorTernaryProduct(pad_rows, Len(), plus_bits_,
+                                               minus_bits_, result);
+  }
+
+  // Encrypts the plaintext as `EncryptFromPadInPlace` with the pad that
+  // `ExpandPad` would expand from `pad_prng`, without holding the pad in
+  // memory: the pad is expanded in tiles of `kPadRowsPerTile` rows, and each
+  // tile is multiplied with the ternary key by `AddPadRowsProductInPlace`.
+  // The key length must be even.
+  template <typename PadPrng, typename Prng = rlwe::SingleThreadHkdfPrng>
+  absl::Status EncryptFromPadPrngInPlace(Vector& plaintext, PadPrng* pad_prng,
+                                         const int log_scaling_factor,
+                                         Prng* prng) const {
+    if (prng == nullptr) {
+      return absl::InvalidArgumentError("The prng must not be null");
+    } else if (pad_prng == nullptr) {
+      return absl::InvalidArgumentError("The pad prng must not be null");
+    } else if (log_scaling_factor < 0 || log_scaling_factor > kIntBitwidth) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("The log scaling factor, ", log_scaling_factor,
+                       ", should be >= 0 and <= ", kIntBitwidth));
+    } else if (plaintext.size() < 1) {
+      return absl::InvalidArgumentError("The plaintext must not be empty.");
+    } else if (Len() % 2 != 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The key length, ", Len(), ", must be even to expand the pad."));
+    }
+    // Encodes the vector
+    RLWE_RETURN_IF_ERROR(EncodeMessageInPlace(plaintext, log_scaling_factor));
+    // Samples the Centered binomial and adds it to the (encoded) plaintext
+    RLWE_RETURN_IF_ERROR(SampleAndAddCenteredBinomialInPlace(plaintext, prng));
+    // Adds pad * s to the encoded vector \Delta * m + e, one tile of rows at a
+    // time. As the rows have an even length, expanding a tile at once is the
+    // same as expanding its rows one by one as `SampleUniformMatrix` does.
+    int num_rows = plaintext.size();
+    Vector pad_tile(std::min(num_rows, kPadRowsPerTile) * Len());
+    for (int i = 0; i < num_rows; i += kPadRowsPerTile) {
+      int tile_rows = std::min(num_rows - i, kPadRowsPerTile);
+      pad_tile.conservativeResize(tile_rows * Len());
+      RLWE_RETURN_IF_ERROR(SampleUniformVectorInPlace(pad_tile, pad_prng));
+      RLWE_RETURN_IF_ERROR(AddPadRowsProductInPlace(
+          absl::MakeConstSpan(pad_tile.data(), pad_tile.size()),
+          absl::MakeSpan(plaintext.data() + i, tile_rows)));
+    }
     return absl::OkStatus();
   }
 
+  // Encrypts the plaintext as `EncryptFromPadInPlace` with the dense matrix
+  // of the ring-structured `pad`, where pad * s is computed with NTTs.
+  template <typename Prng = rlwe::SingleThreadHkdfPrng>
+  absl::Status EncryptFromRingPadInPlace(Vector& plaintext, const RingPad& pad,
+                                         const int log_scaling_factor,
+                                         Prng* prng) const {
+    if (prng == nullptr) {
+      return absl::InvalidArgumentError("The prng must not be null");
+    } else if (log_scaling_factor < 0 || log_scaling_factor > kIntBitwidth) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("The log scaling factor, ", log_scaling_factor,
+                       ", should be >= 0 and <= ", kIntBitwidth));
+    } else if (plaintext.size() != pad.NumRows()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The plaintext size, ", plaintext.size(),
+          ", does not match the number of rows of the pad, ", pad.NumRows()));
+    } else if (Len() != pad.NumCols()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The key length, ", Len(),
+          ", does not match the number of cols of the pad, ", pad.NumCols()));
+    }
+    // Encodes the vector
+    RLWE_RETURN_IF_ERROR(EncodeMessageInPlace(plaintext, log_scaling_factor));
+    // Samples the Centered binomial and adds it to the (encoded) plaintext
+    RLWE_RETURN_IF_ERROR(SampleAndAddCenteredBinomialInPlace(plaintext, prng));
+    // Adds pad * s to the encoded vector \Delta * m + e
+    return pad.AddProductInPlace(
+        absl::MakeConstSpan(key_.data(), key_.size()),
+        absl::MakeSpan(plaintext.data(), plaintext.size()));
+  }
+
   // Encrypts the plaintext using learning-with-errors (LWE) encryption.
   // Takes the matrix `pad` as input, and returns the ciphertext.
   // Defers validating inputs to EncryptFromPadInPlace.
@@ -191,7 +295,11 @@ class SymmetricLweKey {
           "The key length, ", Len(),
           ", does not match the number of cols of A, ", pad.cols()));
     }
-    b -= pad * key_;
+    Vector pad_product = Vector::Zero(b.size());
+    RLWE_RETURN_IF_ERROR(internal::AddColMajorTernaryProduct(
+        absl::MakeConstSpan(pad.data(), pad.size()), Len(), plus_bits_,
+        minus_bits_, absl::MakeSpan(pad_product.data(), pad_product.size())));
+    b -= pad_product;
     return b;
   }
 
@@ -204,16 +312,37 @@ class SymmetricLweKey {
     return noisy_m;
   }
 
+  // The number of rows of a pad that `EncryptFromPadPrngInPlace` expands at a
+  // time.
+  static constexpr int kPadRowsPerTile = 16;
+
   // Accessors.
   int Len() const { return key_.size(); }
   const Vector& Key() { return key_; }
 
  private:
   // A constructor. Does not take ownership of params.
-  explicit SymmetricLweKey(Vector key) : key_(std::move(key)) {}
+  explicit SymmetricLweKey(Vector key)
+      : key_(std::move(key)),
+        plus_bits_((key_.size() + 63) / 64),
+        minus_bits_((key_.size() + 63) / 64) {
+    for (int i = 0; i < key_.size(); ++i) {
+      if (key_[i] == 1) {
+        plus_bits_[i / 64] |= uint64_t{1} << (i % 64);
+      } else if (key_[i] != 0) {
+        minus_bits_[i / 64] |= uint64_t{1} << (i % 64);
+      }
+    }
+  }
 
   // The contents of the key itself.
   Vector key_;
+
+  // Bitmasks of the ternary key coefficients that are 1 and -1, where bit i of
+  // word i / 64 is set iff key_[i] is 1 (resp. -1). Products with the key are
+  // computed from these by additions and subtractions only.
+  std::vector<uint64_t> plus_bits_;
+  std::vector<uint64_t> minus_bits_;
 };
 
 }  // namespace lwe
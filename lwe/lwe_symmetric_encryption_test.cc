@@ -20,9 +20,12 @@
 
 #include "Eigen/Core"
 #include "absl/status/status.h"
+#include "absl/types/span.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
 #include "lwe/encode.h"
+#include "lwe/ring_pad.h"
+#include "lwe/sample_error.h"
 #include "lwe/types.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
 #include "shell_encryption/testing/status_matchers.h"
@@ -365,6 +368,120 @@ TEST_F(SymmetricLweEncryptionTest, ExtractErrorAndMessageWrongDimKeyTest) {
                                testing::HasSubstr("The key length, ")));
 }
 
+// Checks that encrypting with a streamed pad gives the same ciphertext as
+// encrypting with the expanded pad.
+TEST_F(SymmetricLweEncryptionTest, EncryptFromPadPrngMatchesExpandedPad) {
+  Vector plaintext = Vector::Zero(num_rows_);
+  for (int i = 0; i < num_rows_; ++i) {
+    plaintext[i] = i;
+  }
+  ASSERT_OK_AND_ASSIGN(SymmetricLweKey key,
+                       SymmetricLweKey::Sample(num_cols_, prng_.get()));
+
+  ASSERT_OK_AND_ASSIGN(std::string pad_seed, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(std::string enc_seed, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(auto pad_prng, Prng::Create(pad_seed));
+  ASSERT_OK_AND_ASSIGN(auto enc_prng, Prng::Create(enc_seed));
+  ASSERT_OK_AND_ASSIGN(Matrix pad,
+                       ExpandPad(num_rows_, num_cols_, pad_prng.get()));
+  ASSERT_OK_AND_ASSIGN(Vector expected,
+                       key.EncryptFromPad(plaintext, pad, log_scaling_factor_,
+                                          enc_prng.get()));
+
+  ASSERT_OK_AND_ASSIGN(pad_prng, Prng::Create(pad_seed));
+  ASSERT_OK_AND_ASSIGN(enc_prng, Prng::Create(enc_seed));
+  Vector b = plaintext;
+  ASSERT_OK(key.EncryptFromPadPrngInPlace(b, pad_prng.get(),
+                                          log_scaling_factor_,
+                                          enc_prng.get()));
+  EXPECT_EQ(b, expected);
+
+  auto c = SymmetricLweCiphertext(pad, b, log_scaling_factor_);
+  ASSERT_OK_AND_ASSIGN(Vector decrypted, key.Decrypt(c));
+  EXPECT_EQ(decrypted, plaintext);
+}
+
+// Checks that the multiply-free products with the ternary key match the
+// matrix-vector products, for dimensions that are not multiples of 64.
+TEST_F(SymmetricLweEncryptionTest, PadProductsMatchMatrixVectorProduct) {
+  constexpr int kPadRows = 37;
+  constexpr int kPadCols = 1026;
+  ASSERT_OK_AND_ASSIGN(SymmetricLweKey key,
+                       SymmetricLweKey::Sample(kPadCols, prng_.get()));
+  ASSERT_OK_AND_ASSIGN(Matrix pad,
+                       SampleUniformMatrix(kPadRows, kPadCols, prng_.get()));
+  Vector b = Vector::Zero(kPadRows);
+  for (int i = 0; i < kPadRows; ++i) {
+    b[i] = i;
+  }
+  Vector expected = pad * key.Key();
+
+  auto c = SymmetricLweCiphertext(pad, b, log_scaling_factor_);
+  ASSERT_OK_AND_ASSIGN(Vector noisy_m, key.ExtractErrorAndMessage(c));
+  EXPECT_EQ(noisy_m, b - expected);
+
+  // The same product from the pad stored in row-major order.
+  Eigen::Matrix<Integer, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      pad_rows = pad;
+  Vector product = Vector::Zero(kPadRows);
+  ASSERT_OK(key.AddPadRowsProductInPlace(
+      absl::MakeConstSpan(pad_rows.data(), pad_rows.size()),
+      absl::MakeSpan(product.data(), product.size())));
+  EXPECT_EQ(product, expected);
+}
+
+// Checks that encrypting from a ring-structured pad matches encrypting from
+// its dense matrix, for a power-of-two key length and a number of rows that
+// is not a multiple of it.
+TEST_F(SymmetricLweEncryptionTest, EncryptFromRingPadMatchesDensePad) {
+  constexpr int kRingDim = 16;
+  Vector plaintext = Vector::Zero(num_rows_);
+  for (int i = 0; i < num_rows_; ++i) {
+    plaintext[i] = i;
+  }
+  ASSERT_OK_AND_ASSIGN(SymmetricLweKey key,
+                       SymmetricLweKey::Sample(kRingDim, prng_.get()));
+  ASSERT_OK_AND_ASSIGN(RingPad ring_pad,
+                       RingPad::Expand(num_rows_, kRingDim, prng_.get()));
+  Matrix pad = ring_pad.ToMatrix();
+
+  ASSERT_OK_AND_ASSIGN(std::string enc_seed, Prng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(auto enc_prng, Prng::Create(enc_seed));
+  ASSERT_OK_AND_ASSIGN(Vector expected,
+                       key.EncryptFromPad(plaintext, pad, log_scaling_factor_,
+                                          enc_prng.get()));
+  ASSERT_OK_AND_ASSIGN(enc_prng, Prng::Create(enc_seed));
+  Vector b = plaintext;
+  ASSERT_OK(key.EncryptFromRingPadInPlace(b, ring_pad, log_scaling_factor_,
+                                          enc_prng.get()));
+  EXPECT_EQ(b, expected);
+
+  auto c = SymmetricLweCiphertext(pad, b, log_scaling_factor_);
+  ASSERT_OK_AND_ASSIGN(Vector decrypted, key.Decrypt(c));
+  EXPECT_EQ(decrypted, plaintext);
+
+  EXPECT_THAT(key.EncryptFromRingPadInPlace(plaintext, ring_pad,
+                                            log_scaling_factor_,
+                                            static_cast<Prng*>(nullptr)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  Vector short_plaintext = Vector::Zero(num_rows_ - 1);
+  EXPECT_THAT(key.EncryptFromRingPadInPlace(short_plaintext, ring_pad,
+                                            log_scaling_factor_, prng_.get()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+// Checks if passing a nullptr pad prng to EncryptFromPadPrngInPlace is caught
+TEST_F(SymmetricLweEncryptionTest, EncryptFromPadPrngInPlaceNullPrngTest) {
+  Vector plaintext = Vector::Zero(num_rows_);
+  ASSERT_OK_AND_ASSIGN(SymmetricLweKey key,
+                       SymmetricLweKey::Sample(num_cols_, prng_.get()));
+  EXPECT_THAT(key.EncryptFromPadPrngInPlace(plaintext,
+                                            static_cast<Prng*>(nullptr),
+                                            log_scaling_factor_, prng_.get()),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       testing::HasSubstr("The pad prng must not be null")));
+}
+
 TEST_F(SymmetricLweEncryptionTest, SampleTooSmallKeyTest) {
   EXPECT_THAT(SymmetricLweKey::Sample(0, prng_.get()),
               StatusIs(absl::StatusCode::kInvalidArgument,
@@ -0,0 +1,119 @@
+// Copyright 2024 Google LLC
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/flags/flag.h"
+#include "absl/flags/parse.h"
+#include "benchmark/benchmark.h"
+#include "gtest/gtest.h"
+#include "lwe/counter_prng.h"
+#include "lwe/lwe_symmetric_encryption.h"
+#include "lwe/types.h"
+#include "shell_encryption/prng/single_thread_chacha_prng.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+
+ABSL_FLAG(int, num_rows, 1024, "Number of rows of the pad");
+ABSL_FLAG(int, num_cols, 1408, "Number of cols of the pad");
+
+namespace hintless_pir {
+namespace lwe {
+namespace {
+
+// Reports the throughput of expanding a pad of `num_rows` x `num_cols`
+// integers per iteration.
+void SetPadBytesProcessed(benchmark::State& state, int64_t num_rows,
+                          int64_t num_cols) {
+  state.SetBytesProcessed(state.iterations() * num_rows * num_cols *
+                          sizeof(Integer));
+}
+
+// Expands the pad from a PRNG of SHELL.
+template <typename Prng>
+void BM_ExpandPad(benchmark::State& state) {
+  int64_t num_rows = absl::GetFlag(FLAGS_num_rows);
+  int64_t num_cols = absl::GetFlag(FLAGS_num_cols);
+  std::string seed = Prng::GenerateSeed().value();
+  for (auto _ : state) {
+    auto prng = Prng::Create(seed).value();
+    auto pad = ExpandPad(num_rows, num_cols, prng.get());
+    benchmark::DoNotOptimize(pad);
+  }
+  SetPadBytesProcessed(state, num_rows, num_cols);
+}
+BENCHMARK_TEMPLATE(BM_ExpandPad, rlwe::SingleThreadHkdfPrng);
+BENCHMARK_TEMPLATE(BM_ExpandPad, rlwe::SingleThreadChaChaPrng);
+
+// Expands the pad sequentially from a counter-mode PRNG, whose rows are
+// sampled in bulk.
+void BM_ExpandPadCounterPrng(benchmark::State& state) {
+  int64_t num_rows = absl::GetFlag(FLAGS_num_rows);
+  int64_t num_cols = absl::GetFlag(FLAGS_num_cols);
+  auto cipher = static_cast<CounterPrngCipher>(state.range(0));
+  std::string seed = CounterPrng::GenerateSeed().value();
+  for (auto _ : state) {
+    auto prng = CounterPrng::Create(seed, cipher).value();
+    auto pad = ExpandPad(num_rows, num_cols, prng.get());
+    benchmark::DoNotOptimize(pad);
+  }
+  SetPadBytesProcessed(state, num_rows, num_cols);
+}
+BENCHMARK(BM_ExpandPadCounterPrng)
+    ->ArgName("cipher")
+    ->Arg(static_cast<int>(CounterPrngCipher::kChaCha20))
+    ->Arg(static_cast<int>(CounterPrngCipher::kAes256Ctr));
+
+// Expands the pad from a counter-mode PRNG with the rows in parallel.
+void BM_ExpandPadInParallel(benchmark::State& state) {
+  int64_t num_rows = absl::GetFlag(FLAGS_num_rows);
+  int64_t num_cols = absl::GetFlag(FLAGS_num_cols);
+  auto cipher = static_cast<CounterPrngCipher>(state.range(0));
+  std::string seed = CounterPrng::GenerateSeed().value();
+  auto prng = CounterPrng::Create(seed, cipher).value();
+  for (auto _ : state) {
+    auto pad = ExpandPadInParallel(num_rows, num_cols, *prng);
+    benchmark::DoNotOptimize(pad);
+  }
+  SetPadBytesProcessed(state, num_rows, num_cols);
+}
+BENCHMARK(BM_ExpandPadInParallel)
+    ->ArgName("cipher")
+    ->Arg(static_cast<int>(CounterPrngCipher::kChaCha20))
+    ->Arg(static_cast<int>(CounterPrngCipher::kAes256Ctr))
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace lwe
+}  // namespace hintless_pir
+
+// Declare benchmark_filter flag, which will be defined by benchmark library.
+// Use it to check if any benchmarks were specified explicitly.
+//
+namespace benchmark {
+extern std::string FLAGS_benchmark_filter;
+}
+using benchmark::FLAGS_benchmark_filter;
+
+int main(int argc, char* argv[]) {
+  FLAGS_benchmark_filter = "";
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+  if (!FLAGS_benchmark_filter.empty()) {
+    benchmark::RunSpecifiedBenchmarks();
+  }
+  benchmark::Shutdown();
+  return 0;
+}
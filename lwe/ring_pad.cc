@@ -0,0 +1,374 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/ring_pad.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "absl/numeric/int128.h"
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "lwe/types.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace internal {
+
+namespace {
+
+constexpr uint64_t kModulus = NegacyclicNtt::kModulus;
+
+// 2^64 mod P.
+constexpr uint64_t kEpsilon = 0xFFFFFFFF;
+
+// A generator of the multiplicative group of Z_P.
+constexpr uint64_t kGenerator = 7;
+
+uint64_t AddMod(uint64_t x, uint64_t y) {
+  uint64_t sum = x + y;
+  // On overflow, sum - P modulo 2^64 is the sum + 2^64 - P.
+  if (sum < x || sum >= kModulus) {
+    sum -= kModulus;
+  }
+  return sum;
+}
+
+uint64_t SubMod(uint64_t x, uint64_t y) {
+  return x >= y ? x - y : x - y + kModulus;
+}
+
+// Returns x * y mod P, by reducing the 128-bit product with
+// 2^64 = 2^32 - 1 and 2^96 = -1 modulo P.
+uint64_t MulMod(uint64_t x, uint64_t y) {
+  absl::uint128 product = absl::uint128{x} * y;
+  uint64_t low = absl::Uint128Low64(product);
+  uint64_t high = absl::Uint128High64(product);
+  uint64_t high_high = high >> 32;
+  uint64_t high_low = high & kEpsilon;
+
+  uint64_t t = low - high_high;
+  if (low < high_high) {
+    t -= kEpsilon;  // Borrowed 2^64 = 2^32 - 1.
+  }
+  uint64_t u = high_low * kEpsilon;
+  uint64_t result = t + u;
+  if (result < u) {
+    result += kEpsilon;  // Carried 2^64 = 2^32 - 1.
+  }
+  return result >= kModulus ? result - kModulus : result;
+}
+
+uint64_t PowMod(uint64_t x, uint64_t e) {
+  uint64_t result = 1;
+  for (; e > 0; e >>= 1) {
+    if (e & 1) {
+      result = MulMod(result, x);
+    }
+    x = MulMod(x, x);
+  }
+  return result;
+}
+
+int ReverseBits(int x, int num_bits) {
+  int result = 0;
+  for (int i = 0; i < num_bits; ++i) {
+    result = (result << 1) | ((x >> i) & 1);
+  }
+  return result;
+}
+
+// The number of 16-bit limbs of an LWE integer.
+constexpr int kLimbBits = 16;
+constexpr int kNumLimbs = kIntBitwidth / kLimbBits;
+
+}  // namespace
+
+absl::StatusOr<NegacyclicNtt> NegacyclicNtt::Create(int n) {
+  if (n < 2 || !absl::has_single_bit(static_cast<uint32_t>(n))) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The degree, ", n, ", must be a power of two >= 2."));
+  }
+  int log_n = absl::countr_zero(static_cast<uint32_t>(n));
+  uint64_t psi =
+      PowMod(kGenerator, (kModulus - 1) / (2 * static_cast<uint64_t>(n)));
+  uint64_t psi_inv = PowMod(psi, kModulus - 2);
+  std::vector<uint64_t> psi_powers(n), psi_inv_powers(n);
+  uint64_t power = 1, inv_power = 1;
+  for (int i = 0; i < n; ++i) {
+    psi_powers[ReverseBits(i, log_n)] = power;
+    psi_inv_powers[ReverseBits(i, log_n)] = inv_power;
+    power = MulMod(power, psi);
+    inv_power = MulMod(inv_power, psi_inv);
+  }
+  return NegacyclicNtt(std::move(psi_powers), std::move(psi_inv_powers),
+                       PowMod(n, kModulus - 2));
+}
+
+void NegacyclicNtt::Forward(absl::Span<uint64_t> values) const {
+  // Cooley-Tukey butterflies with the twists by powers of psi merged in.
+  int n = Degree();
+  for (int m = 1, t = n / 2; m < n; m *= 2, t /= 2) {
+    for (int i = 0; i < m; ++i) {
+      uint64_t w = psi_powers_[m + i];
+      uint64_t* x = values.data() + 2 * i * t;
+      for (int j = 0; j < t; ++j) {
+        uint64_t u = x[j];
+        uint64_t v = MulMod(x[j + t], w);
+        x[j] = AddMod(u, v);
+        x[j + t] = SubMod(u, v);
+      }
+    }
+  }
+}
+
+void NegacyclicNtt::InverseUnscaled(absl::Span<uint64_t> values) const {
+  // Gentleman-Sande butterflies with the twists by powers of psi^-1 merged in.
+  int n = Degree();
+  for (int m = n / 2, t = 1; m >= 1; m /= 2, t *= 2) {
+    for (int i = 0; i < m; ++i) {
+      uint64_t w = psi_inv_powers_[m + i];
+      uint64_t* x = values.data() + 2 * i * t;
+      for (int j = 0; j < t; ++j) {
+        uint64_t u = x[j];
+        uint64_t v = x[j + t];
+        x[j] = AddMod(u, v);
+        x[j + t] = MulMod(SubMod(u, v), w);
+      }
+    }
+  }
+}
+
+std::vector<uint64_t> ScaledLimbTransforms(const NegacyclicNtt& ntt,
+                                           absl::Span<const Integer> coeffs) {
+  int n = ntt.Degree();
+  int num_polys = coeffs.size() / n;
+  std::vector<uint64_t> transforms(coeffs.size() * kNumLimbs);
+  for (int k = 0; k < num_polys; ++k) {
+    for (int l = 0; l < kNumLimbs; ++l) {
+      int64_t offset = (static_cast<int64_t>(k) * kNumLimbs + l) * n;
+      auto limb = absl::MakeSpan(transforms).subspan(offset, n);
+      for (int i = 0; i < n; ++i) {
+        Integer x = coeffs[static_cast<int64_t>(k) * n + i];
+        limb[i] = (static_cast<uint64_t>(x) >> (l * kLimbBits)) & 0xFFFF;
+      }
+      ntt.Forward(limb);
+      for (uint64_t& x : limb) {
+        x = MulMod(x, ntt.InverseDegree());
+      }
+    }
+  }
+  return transforms;
+}
+
+namespace {
+
+// Returns the entries of `vec` as integers modulo P, or an error if one of
+// them is not a signed integer of absolute value less than 2^16. The rest of
+// `result` is filled with zeros.
+absl::Status LiftSmallVector(absl::Span<const Integer> vec,
+                             absl::Span<uint64_t> result) {
+  using SignedInteger = std::make_signed_t<Integer>;
+  for (int i = 0; i < vec.size(); ++i) {
+    auto x = static_cast<SignedInteger>(vec[i]);
+    if (x <= -(SignedInteger{1} << kLimbBits) ||
+        x >= (SignedInteger{1} << kLimbBits)) {
+      return absl::InvalidArgumentError(
+          "The entries of the vector must be less than 2^16 in absolute "
+          "value.");
+    }
+    result[i] = x >= 0 ? static_cast<uint64_t>(x)
+                       : kModulus - static_cast<uint64_t>(-x);
+  }
+  std::fill(result.begin() + vec.size(), result.end(), 0);
+  return absl::OkStatus();
+}
+
+// Returns the transform of limb l of polynomial k in `transforms`, as laid
+// out by `ScaledLimbTransforms` for polynomials of degree < n.
+const uint64_t* LimbTransform(const std::vector<uint64_t>& transforms, int n,
+                              int k, int l) {
+  return transforms.data() + (static_cast<int64_t>(k) * kNumLimbs + l) * n;
+}
+
+// Returns the sum over limbs l of x_l * 2^(16 l) modulo 2^kIntBitwidth, where
+// the x_l are read in balanced representation modulo P, which is exact as the
+// products are less than P / 2 in absolute value.
+Integer CombineLimbs(const uint64_t (&limbs)[kNumLimbs]) {
+  uint64_t result = 0;
+  for (int l = 0; l < kNumLimbs; ++l) {
+    // A value above P / 2 is negative, and x - P modulo 2^64 is its two's
+    // complement.
+    uint64_t x = limbs[l] > kModulus / 2 ? limbs[l] - kModulus : limbs[l];
+    result += x << (l * kLimbBits);
+  }
+  return static_cast<Integer>(result);
+}
+
+}  // namespace
+}  // namespace internal
+
+using internal::kModulus;
+using internal::kNumLimbs;
+
+absl::StatusOr<RingPad> RingPad::Create(int num_rows, int num_cols,
+                                        std::vector<Integer> coeffs) {
+  if (num_rows < 1) {
+    return absl::InvalidArgumentError("The number of rows must be positive.");
+  }
+  RLWE_ASSIGN_OR_RETURN(internal::NegacyclicNtt ntt,
+                        internal::NegacyclicNtt::Create(num_cols));
+  int64_t num_blocks = (num_rows + num_cols - 1) / num_cols;
+  if (coeffs.size() != num_blocks * num_cols) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The number of coefficients, ", coeffs.size(), ", must be ",
+        num_blocks * num_cols, " for ", num_rows, " rows."));
+  }
+  std::vector<uint64_t> limb_transforms =
+      internal::ScaledLimbTransforms(ntt, coeffs);
+  return RingPad(num_rows, std::move(ntt), std::move(coeffs),
+                 std::move(limb_transforms));
+}
+
+Matrix RingPad::ToMatrix() const {
+  int n = NumCols();
+  Matrix matrix(num_rows_, n);
+  for (int row = 0; row < num_rows_; ++row) {
+    absl::Span<const Integer> a = Block(row / n);
+    int i = row % n;
+    for (int j = 0; j < n; ++j) {
+      // X^i in a(X) * X^j comes from a_{i-j}, wrapping around with X^n = -1.
+      matrix(row, j) = i >= j ? a[i - j] : Integer{0} - a[n + i - j];
+    }
+  }
+  return matrix;
+}
+
+absl::Status RingPad::AddProductInPlace(absl::Span<const Integer> vec,
+                                        absl::Span<Integer> result) const {
+  int n = NumCols();
+  if (vec.size() != n) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The size of `vec`, ", vec.size(), ", must be the number of cols, ",
+        n, "."));
+  } else if (result.size() != num_rows_) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The size of `result`, ", result.size(),
+        ", must be the number of rows, ", num_rows_, "."));
+  }
+  std::vector<uint64_t> vec_transform(n);
+  RLWE_RETURN_IF_ERROR(
+      internal::LiftSmallVector(vec, absl::MakeSpan(vec_transform)));
+  ntt_.Forward(absl::MakeSpan(vec_transform));
+
+  // Block k of the product is a_k(X) * vec(X), computed limb by limb.
+  std::vector<std::vector<uint64_t>> products(kNumLimbs,
+                                              std::vector<uint64_t>(n));
+  for (int k = 0; k < NumBlocks(); ++k) {
+    for (int l = 0; l < kNumLimbs; ++l) {
+      const uint64_t* limb_transform =
+          internal::LimbTransform(limb_transforms_, n, k, l);
+      for (int i = 0; i < n; ++i) {
+        products[l][i] = internal::MulMod(vec_transform[i], limb_transform[i]);
+      }
+      ntt_.InverseUnscaled(absl::MakeSpan(products[l]));
+    }
+    int block_rows = std::min(n, num_rows_ - k * n);
+    for (int i = 0; i < block_rows; ++i) {
+      uint64_t limbs[kNumLimbs];
+      for (int l = 0; l < kNumLimbs; ++l) {
+        limbs[l] = products[l][i];
+      }
+      result[k * n + i] += internal::CombineLimbs(limbs);
+    }
+  }
+  return absl::OkStatus();
+}
+
+TransposedRingPad TransposedRingPad::Create(const RingPad& pad) {
+  int n = pad.NumCols();
+  std::vector<Integer> reversed_coeffs;
+  reversed_coeffs.reserve(static_cast<int64_t>(pad.NumBlocks()) * n);
+  for (int k = 0; k < pad.NumBlocks(); ++k) {
+    absl::Span<const Integer> a = pad.Block(k);
+    reversed_coeffs.push_back(a[0]);
+    for (int i = 1; i < n; ++i) {
+      reversed_coeffs.push_back(Integer{0} - a[n - i]);
+    }
+  }
+  std::vector<uint64_t> limb_transforms =
+      internal::ScaledLimbTransforms(pad.ntt_, reversed_coeffs);
+  return TransposedRingPad(pad.NumRows(), pad.ntt_,
+                           std::move(limb_transforms));
+}
+
+absl::Status TransposedRingPad::AddProductInPlace(
+    absl::Span<const Integer> vec, absl::Span<Integer> result) const {
+  int n = NumCols();
+  if (vec.size() != num_rows_) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The size of `vec`, ", vec.size(), ", must be the number of rows, ",
+        num_rows_, "."));
+  } else if (result.size() != n) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The size of `result`, ", result.size(),
+        ", must be the number of cols, ", n, "."));
+  }
+
+  // Accumulates a_k(X^-1) * vec_k(X) over the blocks k in the NTT domain.
+  // Each of the at most 2^31 terms of a coefficient is less than 2^32 in
+  // absolute value, so the sums stay below P / 2 in absolute value.
+  std::vector<std::vector<uint64_t>> sums(kNumLimbs,
+                                          std::vector<uint64_t>(n, 0));
+  std::vector<uint64_t> chunk_transform(n);
+  int num_blocks = (num_rows_ + n - 1) / n;
+  for (int k = 0; k < num_blocks; ++k) {
+    int block_rows = std::min(n, num_rows_ - k * n);
+    RLWE_RETURN_IF_ERROR(internal::LiftSmallVector(
+        vec.subspan(static_cast<int64_t>(k) * n, block_rows),
+        absl::MakeSpan(chunk_transform)));
+    ntt_.Forward(absl::MakeSpan(chunk_transform));
+    for (int l = 0; l < kNumLimbs; ++l) {
+      const uint64_t* limb_transform =
+          internal::LimbTransform(limb_transforms_, n, k, l);
+      for (int i = 0; i < n; ++i) {
+        sums[l][i] = internal::AddMod(
+            sums[l][i],
+            internal::MulMod(chunk_transform[i], limb_transform[i]));
+      }
+    }
+  }
+  for (int l = 0; l < kNumLimbs; ++l) {
+    ntt_.InverseUnscaled(absl::MakeSpan(sums[l]));
+  }
+  for (int i = 0; i < n; ++i) {
+    uint64_t limbs[kNumLimbs];
+    for (int l = 0; l < kNumLimbs; ++l) {
+      limbs[l] = sums[l][i];
+    }
+    result[i] += internal::CombineLimbs(limbs);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace lwe
+}  // namespace hintless_pir
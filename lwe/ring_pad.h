@@ -0,0 +1,205 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LWE_RING_PAD_H_
+#define HINTLESS_PIR_LWE_RING_PAD_H_
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"
+#include "absl/status/statusor.h"
+#include "absl/types/span.h"
+#include "lwe/sample_error.h"
+#include "lwe/types.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+#include "shell_encryption/status_macros.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace internal {
+
+// Negacyclic number-theoretic transform of polynomials in Z_P[X] / (X^n + 1)
+// for the prime P = 2^64 - 2^32 + 1, whose multiplicative group has a subgroup
+// of order 2^32, so that n can be any power of two up to 2^31. The transform
+// maps a product of polynomials to the coefficient-wise product of their
+// transforms.
+class NegacyclicNtt {
+ public:
+  static constexpr uint64_t kModulus = 0xFFFFFFFF00000001;
+
+  // Returns the transform of degree `n`, which must be a power of two in
+  // [2, 2^31].
+  static absl::StatusOr<NegacyclicNtt> Create(int n);
+
+  int Degree() const { return psi_powers_.size(); }
+
+  // Returns 1 / n mod P, by which the output of `InverseUnscaled` must be
+  // multiplied.
+  uint64_t InverseDegree() const { return n_inv_; }
+
+  // Transforms `values` in place, where the output is in bit-reversed order.
+  void Forward(absl::Span<uint64_t> values) const;
+
+  // Inverts `Forward` in place up to the factor `InverseDegree()`.
+  void InverseUnscaled(absl::Span<uint64_t> values) const;
+
+ private:
+  NegacyclicNtt(std::vector<uint64_t> psi_powers,
+                std::vector<uint64_t> psi_inv_powers, uint64_t n_inv)
+      : psi_powers_(std::move(psi_powers)),
+        psi_inv_powers_(std::move(psi_inv_powers)),
+        n_inv_(n_inv) {}
+
+  // The powers of a primitive 2n-th root of unity psi and of its inverse, in
+  // bit-reversed order of the exponents.
+  std::vector<uint64_t> psi_powers_;
+  std::vector<uint64_t> psi_inv_powers_;
+  uint64_t n_inv_;
+};
+
+// Returns the transforms, scaled by 1 / n, of the 16-bit limbs of each
+// polynomial of degree < n in `coeffs`, which holds the polynomials one after
+// another. The transform of limb l of polynomial k starts at index
+// (k * kIntBitwidth / 16 + l) * n.
+std::vector<uint64_t> ScaledLimbTransforms(const NegacyclicNtt& ntt,
+                                           absl::Span<const Integer> coeffs);
+
+}  // namespace internal
+
+// A pad of LWE ciphertexts with the structure of Ring-LWE. Its rows are split
+// into blocks of n = `NumCols()` rows, and block k is the negacyclic matrix of
+// a polynomial a_k(X) in Z_q[X] / (X^n + 1), i.e. the product of the block
+// with a vector s is the coefficient vector of a_k(X) * s(X) mod X^n + 1. The
+// last block is truncated to the remaining rows.
+//
+// Only the n coefficients of each a_k are expanded from the seed, instead of
+// n^2 integers per block, and the products of the pad and of its transpose
+// with a vector are computed with negacyclic NTTs in O(n log n) per block
+// instead of O(n^2). Since q is a power of two, the products are computed
+// exactly over the NTT-friendly prime of `NegacyclicNtt` for each 16-bit limb
+// of the pad, which requires the vectors to have small entries, e.g. ternary
+// keys or plaintexts of at most 16 bits.
+//
+// The security of the pad then relies on Ring-LWE rather than plain LWE, for
+// which n must be a power of two so that X^n + 1 is a cyclotomic polynomial.
+class RingPad {
+ public:
+  // Returns the pad of `num_rows` rows and `num_cols` columns, where the
+  // coefficients of a_0, a_1, ... are given one after another in `coeffs`.
+  // `num_cols` must be a power of two, and `coeffs` must hold `num_cols`
+  // coefficients per block.
+  static absl::StatusOr<RingPad> Create(int num_rows, int num_cols,
+                                        std::vector<Integer> coeffs);
+
+  // Expands the pad from a prng, which samples the coefficients of the blocks
+  // one after another as `SampleUniformVectorInPlace` does.
+  template <typename Prng = rlwe::SingleThreadHkdfPrng>
+  static absl::StatusOr<RingPad> Expand(int num_rows, int num_cols,
+                                        Prng* prng) {
+    if (num_rows < 1) {
+      return absl::InvalidArgumentError("The number of rows must be positive.");
+    } else if (num_cols < 2) {
+      return absl::InvalidArgumentError(
+          "The number of cols must be at least 2.");
+    } else if (prng == nullptr) {
+      return absl::InvalidArgumentError("The prng must not be null.");
+    }
+    int num_blocks = (num_rows + num_cols - 1) / num_cols;
+    Vector coeffs(static_cast<int64_t>(num_blocks) * num_cols);
+    RLWE_RETURN_IF_ERROR(SampleUniformVectorInPlace(coeffs, prng));
+    return Create(num_rows, num_cols,
+                  std::vector<Integer>(coeffs.begin(), coeffs.end()));
+  }
+
+  // Returns the pad as a dense matrix.
+  Matrix ToMatrix() const;
+
+  // Adds pad * `vec` to `result`, where the entries of `vec` are read as
+  // signed integers of absolute value less than 2^16, e.g. a ternary key.
+  absl::Status AddProductInPlace(absl::Span<const Integer> vec,
+                                 absl::Span<Integer> result) const;
+
+  // Accessors.
+  int NumRows() const { return num_rows_; }
+  int NumCols() const { return ntt_.Degree(); }
+  int NumBlocks() const { return coeffs_.size() / NumCols(); }
+
+  // Returns the coefficients of a_k.
+  absl::Span<const Integer> Block(int k) const {
+    return absl::MakeConstSpan(coeffs_).subspan(
+        static_cast<int64_t>(k) * NumCols(), NumCols());
+  }
+
+ private:
+  friend class TransposedRingPad;
+
+  RingPad(int num_rows, internal::NegacyclicNtt ntt,
+          std::vector<Integer> coeffs, std::vector<uint64_t> limb_transforms)
+      : num_rows_(num_rows),
+        ntt_(std::move(ntt)),
+        coeffs_(std::move(coeffs)),
+        limb_transforms_(std::move(limb_transforms)) {}
+
+  int num_rows_;
+  internal::NegacyclicNtt ntt_;
+
+  // The coefficients of a_0, a_1, ... one after another.
+  std::vector<Integer> coeffs_;
+
+  // The scaled transforms of the limbs of a_k, see `ScaledLimbTransforms`.
+  std::vector<uint64_t> limb_transforms_;
+};
+
+// The transpose of a `RingPad`, precomputed in the NTT domain to be multiplied
+// with many vectors, e.g. the rows of the database when computing the hint.
+// The transpose of the negacyclic matrix of a_k(X) is that of
+// a_k(X^-1) = a_0 - a_{n-1} X - ... - a_1 X^{n-1}, so the product of the
+// transpose with a vector is the sum over blocks k of a_k(X^-1) times the k'th
+// chunk of n entries of the vector, which is accumulated in the NTT domain and
+// transformed back once.
+class TransposedRingPad {
+ public:
+  static TransposedRingPad Create(const RingPad& pad);
+
+  // Adds pad^T * `vec` to `result`, where the entries of `vec` are read as
+  // signed integers of absolute value less than 2^16, e.g. plaintexts of at
+  // most 16 bits. This is safe to call concurrently.
+  absl::Status AddProductInPlace(absl::Span<const Integer> vec,
+                                 absl::Span<Integer> result) const;
+
+  int NumRows() const { return num_rows_; }
+  int NumCols() const { return ntt_.Degree(); }
+
+ private:
+  TransposedRingPad(int num_rows, internal::NegacyclicNtt ntt,
+                    std::vector<uint64_t> limb_transforms)
+      : num_rows_(num_rows),
+        ntt_(std::move(ntt)),
+        limb_transforms_(std::move(limb_transforms)) {}
+
+  // The number of rows of the pad, i.e. the length of the input vectors.
+  int num_rows_;
+  internal::NegacyclicNtt ntt_;
+
+  // The scaled transforms of the limbs of a_k(X^-1).
+  std::vector<uint64_t> limb_transforms_;
+};
+
+}  // namespace lwe
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LWE_RING_PAD_H_
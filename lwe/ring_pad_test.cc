@@ -0,0 +1,230 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/ring_pad.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/numeric/int128.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lwe/types.h"
+#include "shell_encryption/prng/single_thread_hkdf_prng.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+using Prng = rlwe::SingleThreadHkdfPrng;
+
+// A number of rows that is not a multiple of the number of cols, so that the
+// last block is truncated.
+constexpr int kNumRows = 70;
+constexpr int kNumCols = 32;
+
+std::unique_ptr<Prng> CreatePrng() {
+  std::string prng_seed = Prng::GenerateSeed().value();
+  return Prng::Create(prng_seed).value();
+}
+
+// Returns a vector of `length` signed integers in [-bound, bound], stored
+// modulo 2^kIntBitwidth.
+Vector SampleSmallVector(int length, int bound) {
+  absl::BitGen bitgen;
+  Vector vec(length);
+  for (int i = 0; i < length; ++i) {
+    vec[i] = static_cast<Integer>(
+        absl::Uniform<int>(absl::IntervalClosed, bitgen, -bound, bound));
+  }
+  return vec;
+}
+
+TEST(NegacyclicNttTest, CreateFailsIfDegreeIsNotPowerOfTwo) {
+  EXPECT_THAT(internal::NegacyclicNtt::Create(0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(internal::NegacyclicNtt::Create(1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(internal::NegacyclicNtt::Create(24),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(NegacyclicNttTest, ForwardMapsProductsToCoefficientWiseProducts) {
+  constexpr uint64_t kModulus = internal::NegacyclicNtt::kModulus;
+  ASSERT_OK_AND_ASSIGN(auto ntt, internal::NegacyclicNtt::Create(kNumCols));
+  absl::BitGen bitgen;
+  std::vector<uint64_t> a(kNumCols), b(kNumCols);
+  for (int i = 0; i < kNumCols; ++i) {
+    a[i] = absl::Uniform<uint64_t>(bitgen, 0, 1 << 16);
+    b[i] = absl::Uniform<uint64_t>(bitgen, 0, 1 << 16);
+  }
+
+  // a(X) * b(X) mod X^n + 1, whose coefficients are less than P / 2 in
+  // absolute value.
+  std::vector<int64_t> expected(kNumCols, 0);
+  for (int i = 0; i < kNumCols; ++i) {
+    for (int j = 0; j < kNumCols; ++j) {
+      int64_t product = static_cast<int64_t>(a[i] * b[j]);
+      if (i + j < kNumCols) {
+        expected[i + j] += product;
+      } else {
+        expected[i + j - kNumCols] -= product;
+      }
+    }
+  }
+
+  ntt.Forward(absl::MakeSpan(a));
+  ntt.Forward(absl::MakeSpan(b));
+  std::vector<uint64_t> product(kNumCols);
+  for (int i = 0; i < kNumCols; ++i) {
+    product[i] = static_cast<uint64_t>(absl::uint128{a[i]} * b[i] % kModulus);
+  }
+  ntt.InverseUnscaled(absl::MakeSpan(product));
+  for (int i = 0; i < kNumCols; ++i) {
+    uint64_t x = static_cast<uint64_t>(absl::uint128{product[i]} *
+                                       ntt.InverseDegree() % kModulus);
+    int64_t signed_x = x > kModulus / 2 ? -static_cast<int64_t>(kModulus - x)
+                                        : static_cast<int64_t>(x);
+    EXPECT_EQ(signed_x, expected[i]);
+  }
+}
+
+TEST(RingPadTest, CreateFailsIfParametersAreInvalid) {
+  EXPECT_THAT(RingPad::Create(kNumRows, 24, std::vector<Integer>(3 * 24)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RingPad::Create(0, kNumCols, std::vector<Integer>()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RingPad::Create(kNumRows, kNumCols,
+                              std::vector<Integer>(2 * kNumCols)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  auto prng = CreatePrng();
+  Prng* null_prng = nullptr;
+  EXPECT_THAT(RingPad::Expand(kNumRows, kNumCols, null_prng),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RingPad::Expand(kNumRows, 1, prng.get()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(RingPadTest, ExpandIsDeterministic) {
+  std::string prng_seed = Prng::GenerateSeed().value();
+  ASSERT_OK_AND_ASSIGN(auto prng0, Prng::Create(prng_seed));
+  ASSERT_OK_AND_ASSIGN(auto prng1, Prng::Create(prng_seed));
+  ASSERT_OK_AND_ASSIGN(auto pad0,
+                       RingPad::Expand(kNumRows, kNumCols, prng0.get()));
+  ASSERT_OK_AND_ASSIGN(auto pad1,
+                       RingPad::Expand(kNumRows, kNumCols, prng1.get()));
+  EXPECT_EQ(pad0.NumRows(), kNumRows);
+  EXPECT_EQ(pad0.NumCols(), kNumCols);
+  EXPECT_EQ(pad0.NumBlocks(), 3);
+  EXPECT_EQ(pad0.ToMatrix(), pad1.ToMatrix());
+}
+
+TEST(RingPadTest, ToMatrixHasNegacyclicBlocks) {
+  auto prng = CreatePrng();
+  ASSERT_OK_AND_ASSIGN(auto pad,
+                       RingPad::Expand(kNumRows, kNumCols, prng.get()));
+  Matrix matrix = pad.ToMatrix();
+  ASSERT_EQ(matrix.rows(), kNumRows);
+  ASSERT_EQ(matrix.cols(), kNumCols);
+  for (int row = 0; row < kNumRows; ++row) {
+    absl::Span<const Integer> a = pad.Block(row / kNumCols);
+    int i = row % kNumCols;
+    // The first column holds a_k, and each column is the previous one
+    // multiplied by X, where X^n = -1.
+    EXPECT_EQ(matrix(row, 0), a[i]);
+    for (int j = 1; j < kNumCols; ++j) {
+      Integer expected = i == 0 ? Integer{0} - a[kNumCols - j]
+                                : matrix(row - 1, j - 1);
+      EXPECT_EQ(matrix(row, j), expected);
+    }
+  }
+}
+
+TEST(RingPadTest, AddProductInPlaceMatchesDenseProduct) {
+  auto prng = CreatePrng();
+  ASSERT_OK_AND_ASSIGN(auto pad,
+                       RingPad::Expand(kNumRows, kNumCols, prng.get()));
+  for (int bound : {1, (1 << 16) - 1}) {
+    Vector vec = SampleSmallVector(kNumCols, bound);
+    Vector result = SampleSmallVector(kNumRows, 1 << 16);
+    Vector expected = result + pad.ToMatrix() * vec;
+    ASSERT_OK(pad.AddProductInPlace(vec, absl::MakeSpan(result)));
+    EXPECT_EQ(result, expected);
+  }
+}
+
+TEST(RingPadTest, AddProductInPlaceFailsIfInputsAreInvalid) {
+  auto prng = CreatePrng();
+  ASSERT_OK_AND_ASSIGN(auto pad,
+                       RingPad::Expand(kNumRows, kNumCols, prng.get()));
+  Vector vec = Vector::Zero(kNumCols);
+  Vector short_vec = Vector::Zero(kNumCols - 1);
+  Vector result = Vector::Zero(kNumRows);
+  Vector long_result = Vector::Zero(kNumRows + 1);
+  EXPECT_THAT(pad.AddProductInPlace(short_vec, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(pad.AddProductInPlace(vec, absl::MakeSpan(long_result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  vec[1] = Integer{1} << 16;
+  EXPECT_THAT(pad.AddProductInPlace(vec, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(TransposedRingPadTest, AddProductInPlaceMatchesDenseProduct) {
+  auto prng = CreatePrng();
+  ASSERT_OK_AND_ASSIGN(auto pad,
+                       RingPad::Expand(kNumRows, kNumCols, prng.get()));
+  TransposedRingPad transposed_pad = TransposedRingPad::Create(pad);
+  EXPECT_EQ(transposed_pad.NumRows(), kNumRows);
+  EXPECT_EQ(transposed_pad.NumCols(), kNumCols);
+  for (int bound : {1, 255, (1 << 16) - 1}) {
+    Vector vec = SampleSmallVector(kNumRows, bound);
+    Vector result = SampleSmallVector(kNumCols, 1 << 16);
+    Vector expected = result + pad.ToMatrix().transpose() * vec;
+    ASSERT_OK(transposed_pad.AddProductInPlace(vec, absl::MakeSpan(result)));
+    EXPECT_EQ(result, expected);
+  }
+}
+
+TEST(TransposedRingPadTest, AddProductInPlaceFailsIfInputsAreInvalid) {
+  auto prng = CreatePrng();
+  ASSERT_OK_AND_ASSIGN(auto pad,
+                       RingPad::Expand(kNumRows, kNumCols, prng.get()));
+  TransposedRingPad transposed_pad = TransposedRingPad::Create(pad);
+  Vector vec = Vector::Zero(kNumRows);
+  Vector short_vec = Vector::Zero(kNumRows - 1);
+  Vector result = Vector::Zero(kNumCols);
+  Vector short_result = Vector::Zero(kNumCols - 1);
+  EXPECT_THAT(
+      transposed_pad.AddProductInPlace(short_vec, absl::MakeSpan(result)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      transposed_pad.AddProductInPlace(vec, absl::MakeSpan(short_result)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  vec[kNumRows - 1] = Integer{0} - (Integer{1} << 16);
+  EXPECT_THAT(transposed_pad.AddProductInPlace(vec, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace lwe
+}  // namespace hintless_pir
@@ -18,6 +18,7 @@
 
 #include <algorithm>
 #include <cstdint>
+#include <type_traits>
 #include <vector>
 
 #include "Eigen/Core"
@@ -25,21 +26,45 @@
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
 #include "absl/strings/str_cat.h"
+#include "absl/types/span.h"
+#include "lwe/counter_prng.h"
+#include "lwe/sample_error_hwy.h"
 #include "lwe/types.h"
-#include "shell_encryption/bits_util.h"
 #include "shell_encryption/prng/single_thread_hkdf_prng.h"
 #include "shell_encryption/status_macros.h"
 
 namespace hintless_pir {
 namespace lwe {
 
-// Takes as input a uint32_t buffer, and adds an i.i.d. Centered Binomial
+// Fills `words` with uniformly random 64-bit words from `prng`, in the same
+// order as calling `prng->Rand64()` for each word. A `CounterPrng` generates
+// all words at once.
+template <typename Prng = rlwe::SingleThreadHkdfPrng>
+static absl::Status SampleRandomWordsInPlace(absl::Span<uint64_t> words,
+                                             Prng* prng) {
+  if (prng == nullptr) {
+    return absl::InvalidArgumentError("prng must not be null.");
+  }
+  if constexpr (std::is_same_v<Prng, CounterPrng>) {
+    prng->SampleBytes(absl::MakeSpan(reinterpret_cast<uint8_t*>(words.data()),
+                                     words.size() * sizeof(uint64_t)));
+    return absl::OkStatus();
+  }
+  for (uint64_t& word : words) {
+    RLWE_ASSIGN_OR_RETURN(word, prng->Rand64());
+  }
+  return absl::OkStatus();
+}
+
+// Takes as input a buffer, and adds an i.i.d. Centered Binomial
 // (of Variance 8) to each coordinate of the buffer.
 //
 // These are distributed according to
 // \sum_{i=1}^16 B_i-B_i' for i.i.d. random coinflips B_i, B_i'.
 //
-// We sample (B_i, B_i') during each loop iteration for efficiency.
+// We sample (B_i, B_i') for a pair of coefficients from each 64-bit random
+// word. The random words are drawn at once, and the popcounts are computed
+// with SIMD instructions.
 template <typename Prng = rlwe::SingleThreadHkdfPrng>
 static absl::Status SampleAndAddCenteredBinomialInPlace(Vector& buffer,
                                                         Prng* prng) {
@@ -54,18 +79,12 @@ static absl::Status SampleAndAddCenteredBinomialInPlace(Vector& buffer,
   }
 
   // Optimizes that the variance = 8 exactly
-  // so we need one PRNG call per pair of two coefficients (32 bits each).
-  // Masks for extracting 4 groups of 16 bits from 64 bits.
-  constexpr uint64_t mask = 0xFFFF;
-  for (unsigned int i = 0; i < num_coeffs; i += 2) {
-    // Computing \sum_i=1^16 B_i - B_i' for i and i+1 in parallel
-    RLWE_ASSIGN_OR_RETURN(uint64_t r64, prng->Rand64());
-    buffer[i] += rlwe::internal::CountOnes64(r64 & mask);
-    buffer[i] -= rlwe::internal::CountOnes64(r64 & (mask << 16));
-    buffer[i + 1] += rlwe::internal::CountOnes64(r64 & mask << 32);
-    buffer[i + 1] -= rlwe::internal::CountOnes64(r64 & (mask << 48));
-  }
-  return absl::OkStatus();
+  // so we need one 64-bit random word per pair of two coefficients.
+  std::vector<uint64_t> random_words(num_coeffs / 2);
+  RLWE_RETURN_IF_ERROR(
+      SampleRandomWordsInPlace(absl::MakeSpan(random_words), prng));
+  return internal::AddCenteredBinomialFromRandomWords(
+      random_words, absl::MakeSpan(buffer.data(), num_coeffs));
 }
 
 // Samples a centered binomial, allocating and returning the Vector it is
@@ -81,16 +100,17 @@ static absl::StatusOr<Vector> SampleCenteredBinomial(int num_coeffs,
   // afterwards.
   Vector output = Vector::Zero(num_coeffs + (num_coeffs % 2));
   RLWE_RETURN_IF_ERROR(SampleAndAddCenteredBinomialInPlace(output, prng));
-  output.resize(num_coeffs);
+  output.conservativeResize(num_coeffs);
   return output;
 }
 
-// Samples a vector whose coefficients are uniformly random I.I.D. ternary,
-// i.e. uniformly random over {-1, 0, 1}, represented modulo 2^32.
+// Overwrites `buffer` with uniformly random I.I.D. ternary coefficients, i.e.
+// uniformly random over {-1, 0, 1}, represented modulo 2^32.
 template <typename Prng = rlwe::SingleThreadHkdfPrng>
-static absl::StatusOr<Vector> SampleUniformTernary(int num_coeffs, Prng* prng) {
+static absl::Status SampleUniformTernaryInPlace(Vector& buffer, Prng* prng) {
+  int num_coeffs = buffer.size();
   if (num_coeffs <= 0) {
-    return absl::InvalidArgumentError("`num_coeffs` must be positive.");
+    return absl::InvalidArgumentError("`buffer` must not be empty.");
   }
   if (prng == nullptr) {
     return absl::InvalidArgumentError("`prng` must not be null.");
@@ -100,44 +120,72 @@ static absl::StatusOr<Vector> SampleUniformTernary(int num_coeffs, Prng* prng) {
   // "A constant-time sampler for close-to-uniform bitsliced ternary vectors"
   // by Pierre Karpman, https://hal.archives-ouvertes.fr/hal-03777885
   // An element from {-1, 0, 1} is represented using two bits: 0 as (0,0), 1 as
-  // (1,0), and -1 as (1,1). The algorithm samples in batches two uniformly
-  // random 8-bit integers, r0 and r1, and uses a mask to indicate if a certain
-  // bit in r0 and r1 is the invalid representation (0,1) and needs re-sample.
-  Integer plus = 1;
-  Integer minus = -plus;
-  std::vector<Integer> coeffs;
-  coeffs.reserve(num_coeffs);
-  while (num_coeffs > 0) {
-    int num_filled_coeffs = std::min(num_coeffs, 8);
-    // The mask to indicate if a bit index requires re-sampling.
-    uint8_t missing_bits =
-        num_filled_coeffs < 8 ? (1 << num_filled_coeffs) - 1 : ~0;
-    uint8_t encoding_bits0 = 0;
-    uint8_t encoding_bits1 = 0;
-    while (missing_bits != 0) {
-      RLWE_ASSIGN_OR_RETURN(uint8_t rand_bits0, prng->Rand8());
-      RLWE_ASSIGN_OR_RETURN(uint8_t rand_bits1, prng->Rand8());
-      encoding_bits0 ^= (rand_bits0 & missing_bits);
-      encoding_bits1 ^= (rand_bits1 & missing_bits);
-      missing_bits = ~encoding_bits0 & encoding_bits1;
-    }
+  // (1,0), and -1 as (1,1). The coefficients are bitsliced into pairs of
+  // 64-bit words, which are sampled from pairs of uniformly random words, and
+  // a mask per word indicates the bits with the invalid representation (0,1)
+  // that need re-sampling. Every round draws the random words of all words
+  // with missing bits at once, and re-samples them with SIMD instructions.
+  int num_words = (num_coeffs + 63) / 64;
+  std::vector<uint64_t> bits0(num_words, 0);
+  std::vector<uint64_t> bits1(num_words, 0);
+  std::vector<uint64_t> missing_bits(num_words, ~uint64_t{0});
+  if (num_coeffs % 64 != 0) {
+    missing_bits.back() = (uint64_t{1} << (num_coeffs % 64)) - 1;
+  }
 
-    for (int i = 0; i < num_filled_coeffs; ++i) {
-      uint8_t mask = 1 << i;
-      bool bit0 = ((encoding_bits0 & mask) > 0);
-      bool bit1 = ((encoding_bits1 & mask) > 0);
-      Integer is_plus = -static_cast<Integer>(bit0 && !bit1);
-      Integer is_minus = -static_cast<Integer>(bit0 && bit1);
-      Integer value = (is_plus & plus) | (is_minus & minus);
-      coeffs.push_back(value);
+  // The indices of the words with missing bits, and their gathered bits.
+  std::vector<int> indices(num_words);
+  for (int i = 0; i < num_words; ++i) {
+    indices[i] = i;
+  }
+  std::vector<uint64_t> random_bits, round_bits0, round_bits1, round_missing;
+  while (!indices.empty()) {
+    int num_round_words = indices.size();
+    random_bits.resize(2 * num_round_words);
+    RLWE_RETURN_IF_ERROR(
+        SampleRandomWordsInPlace(absl::MakeSpan(random_bits), prng));
+    round_bits0.resize(num_round_words);
+    round_bits1.resize(num_round_words);
+    round_missing.resize(num_round_words);
+    for (int k = 0; k < num_round_words; ++k) {
+      round_bits0[k] = bits0[indices[k]];
+      round_bits1[k] = bits1[indices[k]];
+      round_missing[k] = missing_bits[indices[k]];
     }
-    num_coeffs -= num_filled_coeffs;
+    absl::Span<const uint64_t> random_span = random_bits;
+    RLWE_RETURN_IF_ERROR(internal::ResampleBitslicedTernary(
+        random_span.subspan(0, num_round_words),
+        random_span.subspan(num_round_words), absl::MakeSpan(round_bits0),
+        absl::MakeSpan(round_bits1), absl::MakeSpan(round_missing)));
+    int num_missing_words = 0;
+    for (int k = 0; k < num_round_words; ++k) {
+      bits0[indices[k]] = round_bits0[k];
+      bits1[indices[k]] = round_bits1[k];
+      missing_bits[indices[k]] = round_missing[k];
+      if (round_missing[k] != 0) {
+        indices[num_missing_words++] = indices[k];
+      }
+    }
+    indices.resize(num_missing_words);
+  }
+  return internal::DecodeBitslicedTernary(
+      bits0, bits1, absl::MakeSpan(buffer.data(), num_coeffs));
+}
+
+// Samples a vector whose coefficients are uniformly random I.I.D. ternary,
+// i.e. uniformly random over {-1, 0, 1}, represented modulo 2^32.
+template <typename Prng = rlwe::SingleThreadHkdfPrng>
+static absl::StatusOr<Vector> SampleUniformTernary(int num_coeffs, Prng* prng) {
+  if (num_coeffs <= 0) {
+    return absl::InvalidArgumentError("`num_coeffs` must be positive.");
   }
-  Eigen::Map<Vector> map(coeffs.data(), coeffs.size());
-  return map;
+  Vector output(num_coeffs);
+  RLWE_RETURN_IF_ERROR(SampleUniformTernaryInPlace(output, prng));
+  return output;
 }
 
-// Samples a vector of uniforms without allocating
+// Samples a vector of uniforms without allocating. Every 64-bit random word
+// holds two 32-bit coefficients, or one 64-bit coefficient.
 template <typename Prng = rlwe::SingleThreadHkdfPrng>
 static absl::Status SampleUniformVectorInPlace(Vector& buffer, Prng* prng) {
   int num_coeffs = buffer.size();
@@ -148,6 +196,19 @@ static absl::Status SampleUniformVectorInPlace(Vector& buffer, Prng* prng) {
   if (prng == nullptr) {
     return absl::InvalidArgumentError("prng must not be null.");
   }
+  if constexpr (std::is_same_v<Prng, CounterPrng>) {
+    // Expands the stream directly into `buffer` in bulk. On little-endian
+    // hosts, this is the same as the loop below.
+    prng->SampleUniform(absl::MakeSpan(buffer.data(), num_coeffs));
+    return absl::OkStatus();
+  }
+  if constexpr (sizeof(Integer) == sizeof(uint64_t)) {
+    for (int i = 0; i < num_coeffs; ++i) {
+      RLWE_ASSIGN_OR_RETURN(uint64_t sample, prng->Rand64());
+      buffer[i] = static_cast<Integer>(sample);
+    }
+    return absl::OkStatus();
+  }
   constexpr uint64_t low_mask = 0x00000000ffffffff;
   for (int i = 0; i < num_coeffs; i += 2) {
     RLWE_ASSIGN_OR_RETURN(uint64_t sample, prng->Rand64());
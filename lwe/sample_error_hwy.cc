@@ -0,0 +1,275 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/sample_error_hwy.h"
+
+#include <cstdint>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "hwy/detect_targets.h"
+#include "lwe/types.h"
+#include "shell_encryption/bits_util.h"
+
+// Highway implementations.
+// clang-format off
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "lwe/sample_error_hwy.cc"
+#include "hwy/foreach_target.h"  // IWYU pragma: keep
+// clang-format on
+
+// Must come after foreach_target.h to avoid redefinition errors.
+#include "hwy/highway.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace hintless_pir::lwe::internal {
+namespace HWY_NAMESPACE {
+
+#if HWY_TARGET == HWY_SCALAR
+
+absl::Status AddCenteredBinomialFromRandomWordsHwy(
+    absl::Span<const uint64_t> random_words, absl::Span<Integer> buffer) {
+  return AddCenteredBinomialFromRandomWordsNoHwy(random_words, buffer);
+}
+
+absl::Status ResampleBitslicedTernaryHwy(
+    absl::Span<const uint64_t> random_bits0,
+    absl::Span<const uint64_t> random_bits1, absl::Span<uint64_t> bits0,
+    absl::Span<uint64_t> bits1, absl::Span<uint64_t> missing_bits) {
+  return ResampleBitslicedTernaryNoHwy(random_bits0, random_bits1, bits0,
+                                       bits1, missing_bits);
+}
+
+absl::Status DecodeBitslicedTernaryHwy(absl::Span<const uint64_t> bits0,
+                                       absl::Span<const uint64_t> bits1,
+                                       absl::Span<Integer> output) {
+  return DecodeBitslicedTernaryNoHwy(bits0, bits1, output);
+}
+
+#else
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+absl::Status AddCenteredBinomialFromRandomWordsHwy(
+    absl::Span<const uint64_t> random_words, absl::Span<Integer> buffer) {
+  if (buffer.size() != 2 * random_words.size()) {
+    return absl::InvalidArgumentError(
+        "`buffer` must have twice as many coefficients as `random_words`.");
+  }
+
+  // Every 64-bit random word is read as two 32-bit lanes, the low half first,
+  // which hold the random bits of two consecutive coefficients. The popcounts
+  // are widened to the coefficients when they have 64 bits.
+  const hn::ScalableTag<Integer> d;
+  const hn::Rebind<uint32_t, decltype(d)> d32;
+  const int N = hn::Lanes(d);
+  const uint32_t* random_halves =
+      reinterpret_cast<const uint32_t*>(random_words.data());
+  const auto low_mask = hn::Set(d32, uint32_t{0xFFFF});
+  auto widen = [&](auto x) {
+    if constexpr (sizeof(Integer) == sizeof(uint32_t)) {
+      return x;
+    } else {
+      return hn::PromoteTo(d, x);
+    }
+  };
+
+  int num_coeffs = buffer.size();
+  int i = 0;
+  for (; i + N <= num_coeffs; i += N) {
+    auto x = hn::LoadU(d32, random_halves + i);
+    auto plus = widen(hn::PopulationCount(hn::And(x, low_mask)));
+    auto minus = widen(hn::PopulationCount(hn::ShiftRight<16>(x)));
+    auto y = hn::LoadU(d, buffer.data() + i);
+    hn::StoreU(hn::Sub(hn::Add(y, plus), minus), d, buffer.data() + i);
+  }
+
+  // Handle the remaining coefficients that didn't take a full lane.
+  if (i < num_coeffs) {
+    return AddCenteredBinomialFromRandomWordsNoHwy(
+        random_words.subspan(i / 2), buffer.subspan(i));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ResampleBitslicedTernaryHwy(
+    absl::Span<const uint64_t> random_bits0,
+    absl::Span<const uint64_t> random_bits1, absl::Span<uint64_t> bits0,
+    absl::Span<uint64_t> bits1, absl::Span<uint64_t> missing_bits) {
+  int num_words = missing_bits.size();
+  if (random_bits0.size() != num_words || random_bits1.size() != num_words ||
+      bits0.size() != num_words || bits1.size() != num_words) {
+    return absl::InvalidArgumentError(
+        "All bit vectors must have the same length.");
+  }
+
+  const hn::ScalableTag<uint64_t> d64;
+  const int N = hn::Lanes(d64);
+  int i = 0;
+  for (; i + N <= num_words; i += N) {
+    auto missing = hn::LoadU(d64, missing_bits.data() + i);
+    auto r0 = hn::LoadU(d64, random_bits0.data() + i);
+    auto r1 = hn::LoadU(d64, random_bits1.data() + i);
+    auto b0 = hn::Xor(hn::LoadU(d64, bits0.data() + i), hn::And(r0, missing));
+    auto b1 = hn::Xor(hn::LoadU(d64, bits1.data() + i), hn::And(r1, missing));
+    hn::StoreU(b0, d64, bits0.data() + i);
+    hn::StoreU(b1, d64, bits1.data() + i);
+    hn::StoreU(hn::AndNot(b0, b1), d64, missing_bits.data() + i);
+  }
+
+  // Handle the remaining words that didn't take a full lane.
+  if (i < num_words) {
+    return ResampleBitslicedTernaryNoHwy(
+        random_bits0.subspan(i), random_bits1.subspan(i), bits0.subspan(i),
+        bits1.subspan(i), missing_bits.subspan(i));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status DecodeBitslicedTernaryHwy(absl::Span<const uint64_t> bits0,
+                                       absl::Span<const uint64_t> bits1,
+                                       absl::Span<Integer> output) {
+  constexpr int kBitsPerHalf = 32;
+  const hn::ScalableTag<Integer> d;
+  const int N = hn::Lanes(d);
+  if (N > kBitsPerHalf) {
+    // A vector would span more than one half of a word.
+    return DecodeBitslicedTernaryNoHwy(bits0, bits1, output);
+  }
+  if (bits0.size() != bits1.size()) {
+    return absl::InvalidArgumentError(
+        "`bits0` and `bits1` must have the same length.");
+  }
+  if (output.size() > 64 * bits0.size()) {
+    return absl::InvalidArgumentError(
+        "`output` must have at most 64 coefficients per word of bits.");
+  }
+
+  // Every vector of N coefficients is encoded by N consecutive bits of a half
+  // of a word, as N divides 32. Lane j tests bit j of the half, shifted to the
+  // position of the vector.
+  const auto one = hn::Set(d, Integer{1});
+  const auto minus_one = hn::Set(d, static_cast<Integer>(-1));
+  int num_coeffs = output.size();
+  int i = 0;
+  for (; i + N <= num_coeffs; i += N) {
+    int word = i / 64;
+    int shift = i % 64;
+    Integer half0 = static_cast<Integer>(bits0[word] >> (shift & ~31));
+    Integer half1 = static_cast<Integer>(bits1[word] >> (shift & ~31));
+    auto lane_bits = hn::Shl(one, hn::Iota(d, shift % kBitsPerHalf));
+    auto is_nonzero = hn::TestBit(hn::Set(d, half0), lane_bits);
+    auto is_minus = hn::TestBit(hn::Set(d, half1), lane_bits);
+    auto value = hn::IfThenElseZero(is_nonzero,
+                                    hn::IfThenElse(is_minus, minus_one, one));
+    hn::StoreU(value, d, output.data() + i);
+  }
+
+  // Handle the remaining coefficients that didn't take a full lane.
+  for (; i < num_coeffs; ++i) {
+    output[i] = DecodeBitslicedTernaryValue(bits0, bits1, i);
+  }
+  return absl::OkStatus();
+}
+
+#endif  // HWY_TARGET == HWY_SCALAR
+
+}  // namespace HWY_NAMESPACE
+}  // namespace hintless_pir::lwe::internal
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE || HWY_IDE
+namespace hintless_pir::lwe::internal {
+
+absl::Status AddCenteredBinomialFromRandomWordsNoHwy(
+    absl::Span<const uint64_t> random_words, absl::Span<Integer> buffer) {
+  if (buffer.size() != 2 * random_words.size()) {
+    return absl::InvalidArgumentError(
+        "`buffer` must have twice as many coefficients as `random_words`.");
+  }
+  constexpr uint64_t mask = 0xFFFF;
+  for (int i = 0; i < random_words.size(); ++i) {
+    uint64_t r64 = random_words[i];
+    buffer[2 * i] += rlwe::internal::CountOnes64(r64 & mask);
+    buffer[2 * i] -= rlwe::internal::CountOnes64(r64 & (mask << 16));
+    buffer[2 * i + 1] += rlwe::internal::CountOnes64(r64 & (mask << 32));
+    buffer[2 * i + 1] -= rlwe::internal::CountOnes64(r64 & (mask << 48));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ResampleBitslicedTernaryNoHwy(
+    absl::Span<const uint64_t> random_bits0,
+    absl::Span<const uint64_t> random_bits1, absl::Span<uint64_t> bits0,
+    absl::Span<uint64_t> bits1, absl::Span<uint64_t> missing_bits) {
+  int num_words = missing_bits.size();
+  if (random_bits0.size() != num_words || random_bits1.size() != num_words ||
+      bits0.size() != num_words || bits1.size() != num_words) {
+    return absl::InvalidArgumentError(
+        "All bit vectors must have the same length.");
+  }
+  for (int i = 0; i < num_words; ++i) {
+    bits0[i] ^= random_bits0[i] & missing_bits[i];
+    bits1[i] ^= random_bits1[i] & missing_bits[i];
+    missing_bits[i] = ~bits0[i] & bits1[i];
+  }
+  return absl::OkStatus();
+}
+
+absl::Status DecodeBitslicedTernaryNoHwy(absl::Span<const uint64_t> bits0,
+                                         absl::Span<const uint64_t> bits1,
+                                         absl::Span<Integer> output) {
+  if (bits0.size() != bits1.size()) {
+    return absl::InvalidArgumentError(
+        "`bits0` and `bits1` must have the same length.");
+  }
+  if (output.size() > 64 * bits0.size()) {
+    return absl::InvalidArgumentError(
+        "`output` must have at most 64 coefficients per word of bits.");
+  }
+  for (int i = 0; i < output.size(); ++i) {
+    output[i] = DecodeBitslicedTernaryValue(bits0, bits1, i);
+  }
+  return absl::OkStatus();
+}
+
+HWY_EXPORT(AddCenteredBinomialFromRandomWordsHwy);
+HWY_EXPORT(ResampleBitslicedTernaryHwy);
+HWY_EXPORT(DecodeBitslicedTernaryHwy);
+
+absl::Status AddCenteredBinomialFromRandomWords(
+    absl::Span<const uint64_t> random_words, absl::Span<Integer> buffer) {
+  return HWY_DYNAMIC_DISPATCH(AddCenteredBinomialFromRandomWordsHwy)(
+      random_words, buffer);
+}
+
+absl::Status ResampleBitslicedTernary(absl::Span<const uint64_t> random_bits0,
+                                      absl::Span<const uint64_t> random_bits1,
+                                      absl::Span<uint64_t> bits0,
+                                      absl::Span<uint64_t> bits1,
+                                      absl::Span<uint64_t> missing_bits) {
+  return HWY_DYNAMIC_DISPATCH(ResampleBitslicedTernaryHwy)(
+      random_bits0, random_bits1, bits0, bits1, missing_bits);
+}
+
+absl::Status DecodeBitslicedTernary(absl::Span<const uint64_t> bits0,
+                                    absl::Span<const uint64_t> bits1,
+                                    absl::Span<Integer> output) {
+  return HWY_DYNAMIC_DISPATCH(DecodeBitslicedTernaryHwy)(bits0, bits1,
+                                                         output);
+}
+
+}  // namespace hintless_pir::lwe::internal
+#endif  // HWY_ONCE || HWY_IDE
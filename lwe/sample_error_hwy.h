@@ -0,0 +1,92 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LWE_SAMPLE_ERROR_HWY_H_
+#define HINTLESS_PIR_LWE_SAMPLE_ERROR_HWY_H_
+
+#include <stdint.h>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "lwe/types.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace internal {
+
+// Adds to buffer[2i] and buffer[2i + 1] the centered binomials of variance 8
+// given by the low and the high 32 bits of random_words[i], where the
+// centered binomial of 32 bits x is the number of ones in the low 16 bits of
+// x minus the number of ones in its high 16 bits. `buffer` must have
+// 2 * random_words.size() coefficients.
+// This version is implemented using SIMD instructions via the highway library.
+absl::Status AddCenteredBinomialFromRandomWords(
+    absl::Span<const uint64_t> random_words, absl::Span<Integer> buffer);
+
+// Centered binomial sampling implemented without using highway SIMD
+// intrinsics.
+absl::Status AddCenteredBinomialFromRandomWordsNoHwy(
+    absl::Span<const uint64_t> random_words, absl::Span<Integer> buffer);
+
+// One round of the bitsliced rejection sampling of uniform ternary values,
+// where bit j of (bits0[i], bits1[i]) encodes the value of coefficient
+// 64 * i + j as 0 -> (0, 0), 1 -> (1, 0), and -1 -> (1, 1). Re-samples the
+// bits set in missing_bits[i] from random_bits0[i] and random_bits1[i], and
+// then sets missing_bits[i] to the bits holding the invalid encoding (0, 1).
+// Returns an error if the spans have different lengths.
+// This version is implemented using SIMD instructions via the highway library.
+absl::Status ResampleBitslicedTernary(absl::Span<const uint64_t> random_bits0,
+                                      absl::Span<const uint64_t> random_bits1,
+                                      absl::Span<uint64_t> bits0,
+                                      absl::Span<uint64_t> bits1,
+                                      absl::Span<uint64_t> missing_bits);
+
+// Bitsliced ternary re-sampling implemented without using highway SIMD
+// intrinsics.
+absl::Status ResampleBitslicedTernaryNoHwy(
+    absl::Span<const uint64_t> random_bits0,
+    absl::Span<const uint64_t> random_bits1, absl::Span<uint64_t> bits0,
+    absl::Span<uint64_t> bits1, absl::Span<uint64_t> missing_bits);
+
+// Returns the ternary value of coefficient i encoded by the bits of `bits0` and
+// `bits1` as in `ResampleBitslicedTernary`, represented modulo 2^kIntBitwidth.
+inline Integer DecodeBitslicedTernaryValue(absl::Span<const uint64_t> bits0,
+                                           absl::Span<const uint64_t> bits1,
+                                           int i) {
+  uint64_t bit = uint64_t{1} << (i % 64);
+  Integer is_nonzero = -static_cast<Integer>((bits0[i / 64] & bit) != 0);
+  Integer is_minus = -static_cast<Integer>((bits1[i / 64] & bit) != 0);
+  return is_nonzero & (is_minus | Integer{1});
+}
+
+// Writes the ternary values encoded by the bits of `bits0` and `bits1` as in
+// `ResampleBitslicedTernary` to `output`, represented modulo 2^kIntBitwidth.
+// `output` must have at most 64 * bits0.size() coefficients.
+// This version is implemented using SIMD instructions via the highway library.
+absl::Status DecodeBitslicedTernary(absl::Span<const uint64_t> bits0,
+                                    absl::Span<const uint64_t> bits1,
+                                    absl::Span<Integer> output);
+
+// Bitsliced ternary decoding implemented without using highway SIMD
+// intrinsics.
+absl::Status DecodeBitslicedTernaryNoHwy(absl::Span<const uint64_t> bits0,
+                                         absl::Span<const uint64_t> bits1,
+                                         absl::Span<Integer> output);
+
+}  // namespace internal
+}  // namespace lwe
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LWE_SAMPLE_ERROR_HWY_H_
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/sample_error_hwy.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lwe/types.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace internal {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+
+// Number of words that is not a multiple of the number of lanes.
+constexpr int kNumWords = 37;
+
+std::vector<uint64_t> SampleWords(int num_words) {
+  absl::BitGen bitgen;
+  std::vector<uint64_t> words(num_words);
+  for (uint64_t& word : words) {
+    word = absl::Uniform<uint64_t>(bitgen);
+  }
+  return words;
+}
+
+TEST(SampleErrorHwyTest, FailsIfLengthsMismatch) {
+  std::vector<uint64_t> words(kNumWords, 0);
+  std::vector<uint64_t> short_words(kNumWords - 1, 0);
+  std::vector<Integer> buffer(2 * kNumWords - 2);
+  EXPECT_THAT(
+      AddCenteredBinomialFromRandomWords(words, absl::MakeSpan(buffer)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      AddCenteredBinomialFromRandomWordsNoHwy(words, absl::MakeSpan(buffer)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::vector<uint64_t> bits0(kNumWords), bits1(kNumWords);
+  EXPECT_THAT(ResampleBitslicedTernary(words, short_words,
+                                       absl::MakeSpan(bits0),
+                                       absl::MakeSpan(bits1),
+                                       absl::MakeSpan(short_words)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  std::vector<Integer> output(64 * kNumWords + 1);
+  EXPECT_THAT(DecodeBitslicedTernary(bits0, bits1, absl::MakeSpan(output)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(DecodeBitslicedTernary(bits0, short_words,
+                                     absl::MakeSpan(output).subspan(1)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(SampleErrorHwyTest, CenteredBinomialMatchesNoHwy) {
+  std::vector<uint64_t> words = SampleWords(kNumWords);
+  std::vector<Integer> buffer(2 * kNumWords);
+  for (int i = 0; i < buffer.size(); ++i) {
+    buffer[i] = i;
+  }
+  std::vector<Integer> expected = buffer;
+  ASSERT_OK(AddCenteredBinomialFromRandomWords(words, absl::MakeSpan(buffer)));
+  ASSERT_OK(
+      AddCenteredBinomialFromRandomWordsNoHwy(words, absl::MakeSpan(expected)));
+  EXPECT_EQ(buffer, expected);
+
+  // Each coefficient gets the popcount of its low 16 bits minus the popcount
+  // of its high 16 bits.
+  EXPECT_EQ(buffer[0],
+            static_cast<Integer>(absl::popcount(words[0] & 0xFFFF) -
+                                 absl::popcount(words[0] & 0xFFFF0000)));
+}
+
+TEST(SampleErrorHwyTest, BitslicedTernaryMatchesNoHwy) {
+  std::vector<uint64_t> random_bits0 = SampleWords(kNumWords);
+  std::vector<uint64_t> random_bits1 = SampleWords(kNumWords);
+  std::vector<uint64_t> bits0 = SampleWords(kNumWords);
+  std::vector<uint64_t> bits1 = SampleWords(kNumWords);
+  std::vector<uint64_t> missing_bits = SampleWords(kNumWords);
+  std::vector<uint64_t> expected_bits0 = bits0, expected_bits1 = bits1,
+                        expected_missing_bits = missing_bits;
+  ASSERT_OK(ResampleBitslicedTernary(
+      random_bits0, random_bits1, absl::MakeSpan(bits0), absl::MakeSpan(bits1),
+      absl::MakeSpan(missing_bits)));
+  ASSERT_OK(ResampleBitslicedTernaryNoHwy(
+      random_bits0, random_bits1, absl::MakeSpan(expected_bits0),
+      absl::MakeSpan(expected_bits1), absl::MakeSpan(expected_missing_bits)));
+  EXPECT_EQ(bits0, expected_bits0);
+  EXPECT_EQ(bits1, expected_bits1);
+  EXPECT_EQ(missing_bits, expected_missing_bits);
+  for (int i = 0; i < kNumWords; ++i) {
+    EXPECT_EQ(missing_bits[i], ~bits0[i] & bits1[i]);
+  }
+
+  // Decode a number of coefficients that is not a multiple of 64.
+  for (int num_coeffs : {64 * kNumWords, 64 * kNumWords - 13, 5}) {
+    std::vector<Integer> output(num_coeffs), expected(num_coeffs);
+    ASSERT_OK(DecodeBitslicedTernary(bits0, bits1, absl::MakeSpan(output)));
+    ASSERT_OK(
+        DecodeBitslicedTernaryNoHwy(bits0, bits1, absl::MakeSpan(expected)));
+    EXPECT_EQ(output, expected);
+    for (int i = 0; i < num_coeffs; ++i) {
+      bool bit0 = (bits0[i / 64] >> (i % 64)) & 1;
+      bool bit1 = (bits1[i / 64] >> (i % 64)) & 1;
+      Integer value = bit0 ? (bit1 ? static_cast<Integer>(-1) : 1) : 0;
+      ASSERT_EQ(output[i], value) << "at coefficient " << i;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace lwe
+}  // namespace hintless_pir
@@ -22,12 +22,15 @@
 #include "lwe/sample_error.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "gmock/gmock.h"
 #include "gtest/gtest.h"
+#include "lwe/counter_prng.h"
 #include "lwe/types.h"
+#include "shell_encryption/prng/prng.h"
 #include "shell_encryption/testing/status_matchers.h"
 #include "shell_encryption/testing/status_testing.h"
 #include "shell_encryption/testing/testing_prng.h"
@@ -87,6 +90,43 @@ TEST(SampleErrorTest, CheckUniformTernary) {
   }
 }
 
+TEST(SampleErrorTest, UniformTernaryIsBalanced) {
+  constexpr int kNumCoeffs = 30000;
+  auto prng = std::make_unique<TestingPrng>(0);
+  ASSERT_OK_AND_ASSIGN(Vector key,
+                       SampleUniformTernary(kNumCoeffs, prng.get()));
+  int num_plus = 0, num_minus = 0;
+  for (int k = 0; k < kNumCoeffs; ++k) {
+    num_plus += key[k] == 1;
+    num_minus += key[k] == static_cast<Integer>(-1);
+  }
+  // Each value is expected 10000 times, with a standard deviation of ~82.
+  EXPECT_NEAR(num_plus, kNumCoeffs / 3, 500);
+  EXPECT_NEAR(num_minus, kNumCoeffs / 3, 500);
+  EXPECT_NEAR(kNumCoeffs - num_plus - num_minus, kNumCoeffs / 3, 500);
+}
+
+TEST(SampleErrorTest, BulkSamplingMatchesSequentialSampling) {
+  // A `CounterPrng` draws the random words at once, which must be the same as
+  // calling `Rand64()` through the generic interface.
+  ASSERT_OK_AND_ASSIGN(std::string seed, CounterPrng::GenerateSeed());
+  ASSERT_OK_AND_ASSIGN(auto prng, CounterPrng::Create(seed));
+  ASSERT_OK_AND_ASSIGN(auto other_prng, CounterPrng::Create(seed));
+  rlwe::SecurePrng* generic_prng = other_prng.get();
+  for (int num_coeffs : {1400, 1, 64, 1023}) {
+    ASSERT_OK_AND_ASSIGN(Vector key,
+                         SampleUniformTernary(num_coeffs, prng.get()));
+    ASSERT_OK_AND_ASSIGN(Vector expected_key,
+                         SampleUniformTernary(num_coeffs, generic_prng));
+    EXPECT_EQ(key, expected_key);
+    ASSERT_OK_AND_ASSIGN(Vector error,
+                         SampleCenteredBinomial(num_coeffs, prng.get()));
+    ASSERT_OK_AND_ASSIGN(Vector expected_error,
+                         SampleCenteredBinomial(num_coeffs, generic_prng));
+    EXPECT_EQ(error, expected_error);
+  }
+}
+
 TEST(SampleErrorTest, BinomialNegCoeffsTest) {
   auto prng = std::make_unique<TestingPrng>(0);
   auto status = SampleCenteredBinomial(-1, prng.get());
@@ -0,0 +1,235 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/ternary_product_hwy.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/numeric/bits.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "hwy/detect_targets.h"
+#include "lwe/types.h"
+#include "shell_encryption/status_macros.h"
+
+// Highway implementations.
+// clang-format off
+#undef HWY_TARGET_INCLUDE
+#define HWY_TARGET_INCLUDE "lwe/ternary_product_hwy.cc"
+#include "hwy/foreach_target.h"  // IWYU pragma: keep
+// clang-format on
+
+// Must come after foreach_target.h to avoid redefinition errors.
+#include "hwy/highway.h"
+
+HWY_BEFORE_NAMESPACE();
+namespace hintless_pir::lwe::internal {
+namespace HWY_NAMESPACE {
+
+#if HWY_TARGET == HWY_SCALAR
+
+absl::Status AddRowMajorTernaryProductHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result) {
+  return AddRowMajorTernaryProductNoHwy(matrix, num_cols, plus_bits,
+                                        minus_bits, result);
+}
+
+absl::Status AddColMajorTernaryProductHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result) {
+  return AddColMajorTernaryProductNoHwy(matrix, num_cols, plus_bits,
+                                        minus_bits, result);
+}
+
+#else
+
+namespace hn = hwy::HWY_NAMESPACE;
+
+absl::Status AddRowMajorTernaryProductHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result) {
+  RLWE_RETURN_IF_ERROR(ValidateTernaryProduct(matrix, num_cols, plus_bits,
+                                              minus_bits, result));
+
+  // Expand the bitmasks to lane masks of all ones or all zeros once, so that
+  // every row is reduced by masked additions and subtractions only.
+  const hn::ScalableTag<Integer> d;
+  const int N = hn::Lanes(d);
+  int num_full_cols = num_cols - num_cols % N;
+  std::vector<Integer> plus_lanes(num_full_cols), minus_lanes(num_full_cols);
+  for (int j = 0; j < num_full_cols; ++j) {
+    plus_lanes[j] = -static_cast<Integer>((plus_bits[j / 64] >> (j % 64)) & 1);
+    minus_lanes[j] =
+        -static_cast<Integer>((minus_bits[j / 64] >> (j % 64)) & 1);
+  }
+
+  for (int i = 0; i < result.size(); ++i) {
+    const Integer* row = matrix.data() + static_cast<size_t>(i) * num_cols;
+    auto sum = hn::Zero(d);
+    for (int j = 0; j < num_full_cols; j += N) {
+      auto a = hn::LoadU(d, row + j);
+      sum = hn::Add(sum, hn::And(a, hn::LoadU(d, plus_lanes.data() + j)));
+      sum = hn::Sub(sum, hn::And(a, hn::LoadU(d, minus_lanes.data() + j)));
+    }
+    Integer row_sum = hn::ReduceSum(d, sum);
+
+    // Handle the remaining columns that didn't take a full lane.
+    for (int j = num_full_cols; j < num_cols; ++j) {
+      row_sum += TernaryCoefficient(plus_bits, minus_bits, j) * row[j];
+    }
+    result[i] += row_sum;
+  }
+  return absl::OkStatus();
+}
+
+// Adds (sign = 1) or subtracts (sign = -1) `column` to `result`.
+template <int sign>
+void AccumulateColumn(const Integer* column, absl::Span<Integer> result) {
+  const hn::ScalableTag<Integer> d;
+  const int N = hn::Lanes(d);
+  int num_rows = result.size();
+  int i = 0;
+  for (; i + N <= num_rows; i += N) {
+    auto a = hn::LoadU(d, column + i);
+    auto r = hn::LoadU(d, result.data() + i);
+    r = sign > 0 ? hn::Add(r, a) : hn::Sub(r, a);
+    hn::StoreU(r, d, result.data() + i);
+  }
+  for (; i < num_rows; ++i) {
+    result[i] = sign > 0 ? result[i] + column[i] : result[i] - column[i];
+  }
+}
+
+absl::Status AddColMajorTernaryProductHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result) {
+  RLWE_RETURN_IF_ERROR(ValidateTernaryProduct(matrix, num_cols, plus_bits,
+                                              minus_bits, result));
+
+  // The selected columns are accumulated into one block of `result` at a time,
+  // which stays in the L1 cache while the columns are streamed through.
+  constexpr int kRowsPerBlock = 2048;
+  int num_rows = result.size();
+  for (int begin = 0; begin < num_rows; begin += kRowsPerBlock) {
+    auto block = result.subspan(begin, kRowsPerBlock);
+    const Integer* columns = matrix.data() + begin;
+    for (int w = 0; w < plus_bits.size(); ++w) {
+      for (uint64_t bits = plus_bits[w]; bits != 0; bits &= bits - 1) {
+        int j = 64 * w + absl::countr_zero(bits);
+        if (j >= num_cols) break;
+        AccumulateColumn<1>(columns + static_cast<size_t>(j) * num_rows,
+                            block);
+      }
+      for (uint64_t bits = minus_bits[w]; bits != 0; bits &= bits - 1) {
+        int j = 64 * w + absl::countr_zero(bits);
+        if (j >= num_cols) break;
+        AccumulateColumn<-1>(columns + static_cast<size_t>(j) * num_rows,
+                             block);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+#endif  // HWY_TARGET == HWY_SCALAR
+
+}  // namespace HWY_NAMESPACE
+}  // namespace hintless_pir::lwe::internal
+HWY_AFTER_NAMESPACE();
+
+#if HWY_ONCE || HWY_IDE
+namespace hintless_pir::lwe::internal {
+
+absl::Status ValidateTernaryProduct(absl::Span<const Integer> matrix,
+                                    int num_cols,
+                                    absl::Span<const uint64_t> plus_bits,
+                                    absl::Span<const uint64_t> minus_bits,
+                                    absl::Span<const Integer> result) {
+  if (num_cols < 0 ||
+      matrix.size() != static_cast<size_t>(num_cols) * result.size()) {
+    return absl::InvalidArgumentError(
+        "`matrix` must have `num_cols` columns and `result.size()` rows.");
+  }
+  int num_words = (num_cols + 63) / 64;
+  if (plus_bits.size() != num_words || minus_bits.size() != num_words) {
+    return absl::InvalidArgumentError(
+        "`plus_bits` and `minus_bits` must have one bit per column.");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status AddRowMajorTernaryProductNoHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result) {
+  RLWE_RETURN_IF_ERROR(ValidateTernaryProduct(matrix, num_cols, plus_bits,
+                                              minus_bits, result));
+  for (int i = 0; i < result.size(); ++i) {
+    const Integer* row = matrix.data() + static_cast<size_t>(i) * num_cols;
+    Integer row_sum = 0;
+    for (int j = 0; j < num_cols; ++j) {
+      row_sum += TernaryCoefficient(plus_bits, minus_bits, j) * row[j];
+    }
+    result[i] += row_sum;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status AddColMajorTernaryProductNoHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result) {
+  RLWE_RETURN_IF_ERROR(ValidateTernaryProduct(matrix, num_cols, plus_bits,
+                                              minus_bits, result));
+  int num_rows = result.size();
+  for (int j = 0; j < num_cols; ++j) {
+    Integer coefficient = TernaryCoefficient(plus_bits, minus_bits, j);
+    const Integer* column = matrix.data() + static_cast<size_t>(j) * num_rows;
+    for (int i = 0; i < num_rows; ++i) {
+      result[i] += coefficient * column[i];
+    }
+  }
+  return absl::OkStatus();
+}
+
+HWY_EXPORT(AddRowMajorTernaryProductHwy);
+HWY_EXPORT(AddColMajorTernaryProductHwy);
+
+absl::Status AddRowMajorTernaryProduct(absl::Span<const Integer> matrix,
+                                       int num_cols,
+                                       absl::Span<const uint64_t> plus_bits,
+                                       absl::Span<const uint64_t> minus_bits,
+                                       absl::Span<Integer> result) {
+  return HWY_DYNAMIC_DISPATCH(AddRowMajorTernaryProductHwy)(
+      matrix, num_cols, plus_bits, minus_bits, result);
+}
+
+absl::Status AddColMajorTernaryProduct(absl::Span<const Integer> matrix,
+                                       int num_cols,
+                                       absl::Span<const uint64_t> plus_bits,
+                                       absl::Span<const uint64_t> minus_bits,
+                                       absl::Span<Integer> result) {
+  return HWY_DYNAMIC_DISPATCH(AddColMajorTernaryProductHwy)(
+      matrix, num_cols, plus_bits, minus_bits, result);
+}
+
+}  // namespace hintless_pir::lwe::internal
+#endif  // HWY_ONCE || HWY_IDE
@@ -0,0 +1,93 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef HINTLESS_PIR_LWE_TERNARY_PRODUCT_HWY_H_
+#define HINTLESS_PIR_LWE_TERNARY_PRODUCT_HWY_H_
+
+#include <stdint.h>
+
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "lwe/types.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace internal {
+
+// Multiply-free products A * s of an integer matrix A with a ternary vector s,
+// which is given by two bitmasks: bit j of plus_bits[j / 64] is set iff
+// s[j] = 1, and bit j of minus_bits[j / 64] is set iff s[j] = -1. The product
+// is a sum of the columns of A selected by `plus_bits` minus the sum of the
+// columns selected by `minus_bits`, modulo 2^kIntBitwidth.
+
+// Returns an error if `matrix` does not have `num_cols` columns and
+// `result.size()` rows, or if the bitmasks do not have one bit per column.
+absl::Status ValidateTernaryProduct(absl::Span<const Integer> matrix,
+                                    int num_cols,
+                                    absl::Span<const uint64_t> plus_bits,
+                                    absl::Span<const uint64_t> minus_bits,
+                                    absl::Span<const Integer> result);
+
+// Returns the j'th coefficient of the ternary vector, which is 1, 0, or -1
+// modulo 2^kIntBitwidth.
+inline Integer TernaryCoefficient(absl::Span<const uint64_t> plus_bits,
+                                  absl::Span<const uint64_t> minus_bits,
+                                  int j) {
+  Integer plus = (plus_bits[j / 64] >> (j % 64)) & 1;
+  Integer minus = (minus_bits[j / 64] >> (j % 64)) & 1;
+  return plus - minus;
+}
+
+// Adds A * s to `result`, where A is the result.size() x num_cols matrix
+// stored in row-major order in `matrix`, e.g. a tile of rows of a pad that is
+// expanded a few rows at a time. Each row is reduced against the bitmasks
+// expanded to lane masks, using masked SIMD additions and subtractions.
+// This version is implemented using SIMD instructions via the highway library.
+absl::Status AddRowMajorTernaryProduct(absl::Span<const Integer> matrix,
+                                       int num_cols,
+                                       absl::Span<const uint64_t> plus_bits,
+                                       absl::Span<const uint64_t> minus_bits,
+                                       absl::Span<Integer> result);
+
+// Row-major ternary product implemented without using highway SIMD
+// intrinsics.
+absl::Status AddRowMajorTernaryProductNoHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result);
+
+// Adds A * s to `result`, where A is the result.size() x num_cols matrix
+// stored in column-major order in `matrix`, e.g. an `lwe::Matrix`. The
+// selected columns are added to and subtracted from `result` with SIMD
+// instructions, one block of rows at a time.
+// This version is implemented using SIMD instructions via the highway library.
+absl::Status AddColMajorTernaryProduct(absl::Span<const Integer> matrix,
+                                       int num_cols,
+                                       absl::Span<const uint64_t> plus_bits,
+                                       absl::Span<const uint64_t> minus_bits,
+                                       absl::Span<Integer> result);
+
+// Column-major ternary product implemented without using highway SIMD
+// intrinsics.
+absl::Status AddColMajorTernaryProductNoHwy(
+    absl::Span<const Integer> matrix, int num_cols,
+    absl::Span<const uint64_t> plus_bits,
+    absl::Span<const uint64_t> minus_bits, absl::Span<Integer> result);
+
+}  // namespace internal
+}  // namespace lwe
+}  // namespace hintless_pir
+
+#endif  // HINTLESS_PIR_LWE_TERNARY_PRODUCT_HWY_H_
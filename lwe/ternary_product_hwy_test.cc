@@ -0,0 +1,153 @@
+/*
+ * Copyright 2024 Google LLC.
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "lwe/ternary_product_hwy.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/random/random.h"
+#include "absl/status/status.h"
+#include "absl/types/span.h"
+#include "gmock/gmock.h"
+#include "gtest/gtest.h"
+#include "lwe/types.h"
+#include "shell_encryption/testing/status_testing.h"
+
+namespace hintless_pir {
+namespace lwe {
+namespace internal {
+namespace {
+
+using ::rlwe::testing::StatusIs;
+
+// Dimensions that are not multiples of the number of lanes or of 64.
+constexpr int kNumRows = 37;
+constexpr int kNumCols = 1027;
+
+struct TernaryVector {
+  std::vector<int> coeffs;
+  std::vector<uint64_t> plus_bits;
+  std::vector<uint64_t> minus_bits;
+};
+
+TernaryVector SampleTernaryVector(int length) {
+  absl::BitGen bitgen;
+  TernaryVector s{.coeffs = std::vector<int>(length),
+                  .plus_bits = std::vector<uint64_t>((length + 63) / 64),
+                  .minus_bits = std::vector<uint64_t>((length + 63) / 64)};
+  for (int j = 0; j < length; ++j) {
+    s.coeffs[j] = absl::Uniform<int>(absl::IntervalClosed, bitgen, -1, 1);
+    if (s.coeffs[j] == 1) {
+      s.plus_bits[j / 64] |= uint64_t{1} << (j % 64);
+    } else if (s.coeffs[j] == -1) {
+      s.minus_bits[j / 64] |= uint64_t{1} << (j % 64);
+    }
+  }
+  return s;
+}
+
+std::vector<Integer> SampleMatrix(int num_rows, int num_cols) {
+  absl::BitGen bitgen;
+  std::vector<Integer> matrix(num_rows * num_cols);
+  for (Integer& a : matrix) {
+    a = absl::Uniform<Integer>(bitgen);
+  }
+  return matrix;
+}
+
+// Returns result + A * s computed with multiplications, where A[i][j] is
+// `matrix[i * row_stride + j * col_stride]`.
+std::vector<Integer> ExpectedProduct(const std::vector<Integer>& matrix,
+                                     int row_stride, int col_stride,
+                                     const TernaryVector& s,
+                                     std::vector<Integer> result) {
+  for (int i = 0; i < result.size(); ++i) {
+    for (int j = 0; j < s.coeffs.size(); ++j) {
+      result[i] += static_cast<Integer>(s.coeffs[j]) *
+                   matrix[i * row_stride + j * col_stride];
+    }
+  }
+  return result;
+}
+
+TEST(TernaryProductHwyTest, FailsIfLengthsMismatch) {
+  TernaryVector s = SampleTernaryVector(kNumCols);
+  std::vector<Integer> matrix = SampleMatrix(kNumRows, kNumCols);
+  std::vector<Integer> result(kNumRows - 1);
+  EXPECT_THAT(AddRowMajorTernaryProduct(matrix, kNumCols, s.plus_bits,
+                                        s.minus_bits, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(AddColMajorTernaryProductNoHwy(matrix, kNumCols, s.plus_bits,
+                                             s.minus_bits,
+                                             absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  result.resize(kNumRows);
+  std::vector<uint64_t> short_bits(s.plus_bits.size() - 1);
+  EXPECT_THAT(AddColMajorTernaryProduct(matrix, kNumCols, short_bits,
+                                        s.minus_bits, absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(AddRowMajorTernaryProductNoHwy(matrix, kNumCols, s.plus_bits,
+                                             short_bits,
+                                             absl::MakeSpan(result)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(TernaryProductHwyTest, RowMajorMatchesMultiplication) {
+  for (int num_cols : {kNumCols, 64, 3}) {
+    TernaryVector s = SampleTernaryVector(num_cols);
+    std::vector<Integer> matrix = SampleMatrix(kNumRows, num_cols);
+    std::vector<Integer> initial = SampleMatrix(kNumRows, 1);
+    std::vector<Integer> expected =
+        ExpectedProduct(matrix, num_cols, 1, s, initial);
+
+    std::vector<Integer> result = initial;
+    ASSERT_OK(AddRowMajorTernaryProduct(matrix, num_cols, s.plus_bits,
+                                        s.minus_bits, absl::MakeSpan(result)));
+    EXPECT_EQ(result, expected);
+    result = initial;
+    ASSERT_OK(AddRowMajorTernaryProductNoHwy(matrix, num_cols, s.plus_bits,
+                                             s.minus_bits,
+                                             absl::MakeSpan(result)));
+    EXPECT_EQ(result, expected);
+  }
+}
+
+TEST(TernaryProductHwyTest, ColMajorMatchesMultiplication) {
+  // More rows than the block size of the SIMD implementation.
+  for (int num_rows : {kNumRows, 4099}) {
+    TernaryVector s = SampleTernaryVector(kNumCols);
+    std::vector<Integer> matrix = SampleMatrix(num_rows, kNumCols);
+    std::vector<Integer> initial = SampleMatrix(num_rows, 1);
+    std::vector<Integer> expected =
+        ExpectedProduct(matrix, 1, num_rows, s, initial);
+
+    std::vector<Integer> result = initial;
+    ASSERT_OK(AddColMajorTernaryProduct(matrix, kNumCols, s.plus_bits,
+                                        s.minus_bits, absl::MakeSpan(result)));
+    EXPECT_EQ(result, expected);
+    result = initial;
+    ASSERT_OK(AddColMajorTernaryProductNoHwy(matrix, kNumCols, s.plus_bits,
+                                             s.minus_bits,
+                                             absl::MakeSpan(result)));
+    EXPECT_EQ(result, expected);
+  }
+}
+
+}  // namespace
+}  // namespace internal
+}  // namespace lwe
+}  // namespace hintless_pir
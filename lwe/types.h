@@ -26,15 +26,26 @@ namespace hintless_pir {
 namespace lwe {
 
 // Unsigned integer type to store an LWE ciphertext element. Either uint32_t or
-// uint64_t for practical LWE parameters.
+// uint64_t for practical LWE parameters. It is uint32_t by default, and
+// uint64_t when HINTLESS_PIR_LWE_INTEGER_64 is defined, e.g. by building with
+// `--define=lwe_integer=uint64`. A 64-bit LWE modulus leaves room for larger
+// plaintext moduli, so that wide records are split into fewer shards.
+#ifdef HINTLESS_PIR_LWE_INTEGER_64
+using Integer = uint64_t;
+#else
 using Integer = uint32_t;
+#endif
 using Matrix = Eigen::Matrix<Integer, Eigen::Dynamic, Eigen::Dynamic>;
 using Vector = Eigen::Vector<Integer, Eigen::Dynamic>;
 
 // Unsigned integer type to store an LWE plaintext element. This will be the
 // type of the database element. Either uint8_t or uint16_t for practical LWE
-// parameters.
+// parameters, where the larger one is used with 64-bit LWE integers.
+#ifdef HINTLESS_PIR_LWE_INTEGER_64
+using PlainInteger = uint16_t;
+#else
 using PlainInteger = uint8_t;
+#endif
 
 // Required to use Eigen without templates, see
 // https://eigen.tuxfamily.org/dox/TopicFunctionTakingEigenTypes.html